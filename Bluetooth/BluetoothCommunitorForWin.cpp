@@ -365,4 +365,9 @@ BluetoothError BluetoothCommunitorForWin::disconnect()
 		m_d->socket = INVALID_SOCKET;
 	}
 	return BTH_E_SUCCESS;
+}
+
+int BluetoothCommunitorForWin::nativeHandle() const
+{
+	return m_d->socket == INVALID_SOCKET ? -1 : (int)m_d->socket;
 }
\ No newline at end of file
@@ -122,3 +122,8 @@ BluetoothError BluetootDevicehManager::disconnect()
 {
 	return m_bthCommt->disconnect();
 }
+
+int BluetootDevicehManager::nativeHandle() const
+{
+	return m_bthCommt->nativeHandle();
+}
@@ -54,6 +54,11 @@ public:
      */
 	BluetoothError disconnect() override;
 
+	/**
+     * @brief 连接的套接字，配合CoExecutor在协程中等待数据，避免每个设备占用一个线程
+     */
+	int nativeHandle() const override;
+
 private:
 #ifdef _MSC_VER
 	std::unique_ptr<IBluetoothCommunitor> m_bthCommt = std::make_unique<BluetoothCommunitorForWin>();
@@ -55,6 +55,9 @@ public:
 	virtual BluetoothError recv(std::vector<uint8_t>& data) = 0;
 
 	virtual BluetoothError disconnect() = 0;
+
+	/** 已连接的套接字，用于CoExecutor::readable等待可读，不支持时返回-1 */
+	virtual int nativeHandle() const { return -1; }
 };
 
 #ifdef _MSC_VER
@@ -77,6 +80,8 @@ public:
 
 	BluetoothError disconnect() override;
 
+	int nativeHandle() const override;
+
 private:
 	std::unique_ptr<struct BthCommPrivateData> m_d = nullptr;
 };
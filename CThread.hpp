@@ -26,7 +26,11 @@ template <typename T>
 class CThread
 {
 public:
-	CThread();
+    /**
+     * @param persistent  常驻模式：线程在两次run之间挂起等待(futex / WaitOnAddress)，
+     *                    run不再创建线程，join只等待本次任务完成
+     */
+	explicit CThread(bool persistent = false);
 	~CThread();
 
     /**
@@ -44,10 +48,16 @@ public:
     T getReturnValue();
 
 	/**
-	 * @brief 阻塞等待线程完成
+	 * @brief 阻塞等待线程完成（常驻模式下等待当前任务完成）
 	 */
 	void join();
 
+    /**
+     * @brief      设置在新线程上、任务执行前调用的函数，用于线程命名、绑核、调度优先级
+     * @param hook 常驻模式下只在线程启动时调用一次
+     */
+    void setStartHook(std::function<void()> hook);
+
     /**
      * @brief  获取线程ID
      * @return 线程id
@@ -63,10 +73,15 @@ public:
 private:
 #ifdef _MSC_VER
     static unsigned __stdcall threadProc(void* p);
+    static unsigned __stdcall persistentProc(void* p);
 #else // _MSC_VER
     static void* threadProc(void* p);
+    static void* persistentProc(void* p);
 #endif // UNIX 
 
+    bool createThread();
+    void joinThread();
+
 private:
 #ifdef _MSC_VER
     uintptr_t m_thread = NULL;
@@ -76,21 +91,46 @@ private:
     std::atomic_bool m_bRunning = false;
     std::packaged_task<T()> m_task;
     std::future<T> m_future;
+    std::function<void()> m_startHook;
+
+    // 常驻模式
+    bool m_persistent = false;
+    std::atomic<uint32_t> m_runSeq = 0;     // 每次run加一，唤醒挂起的线程
+    std::atomic_bool m_bQuit = false;
 };
 
 template<typename T>
-CThread<T>::CThread()
+CThread<T>::CThread(bool persistent)
+    : m_persistent(persistent)
 {
 }
 
 template<typename T>
 CThread<T>::~CThread()
 {
-    join();
+    if (m_persistent && m_thread != NULL) {
+        join();
+        m_bQuit.store(true);
+        m_runSeq.fetch_add(1, std::memory_order_release);
+        m_runSeq.notify_one();
+    }
+    joinThread();
 }
 
 template<typename T>
 inline void CThread<T>::join()
+{
+    if (m_persistent) {
+        while (m_bRunning.load(std::memory_order_acquire)) {
+            m_bRunning.wait(true, std::memory_order_acquire);
+        }
+        return;
+    }
+    joinThread();
+}
+
+template<typename T>
+inline void CThread<T>::joinThread()
 {
 	if (m_thread != NULL) {
 #ifdef _MSC_VER
@@ -110,13 +150,21 @@ inline uint64_t CThread<T>::threadID() const
     if (m_thread != NULL) {
 #ifdef _MSC_VER
         id = ::GetThreadId((HANDLE)m_thread);
-#else // _MSC_VER
+#elif defined(__APPLE__)
         id = pthread_getunique_np(m_thread);
+#else // __APPLE__
+        id = (uint64_t)m_thread;
 #endif // UNIX
     }
     return id;
 }
 
+template<typename T>
+inline void CThread<T>::setStartHook(std::function<void()> hook)
+{
+    m_startHook = std::move(hook);
+}
+
 template<typename T>
 inline bool CThread<T>::isRunning() const
 {
@@ -131,11 +179,53 @@ void* CThread<T>::threadProc(void* p)
 #endif // UNIX
 {
     CThread<T>* thr = static_cast<CThread<T>*>(p);
+    if (thr->m_startHook) {
+        thr->m_startHook();
+    }
     thr->m_task();
     thr->m_bRunning.store(false);
     return NULL;
 }
 
+template<typename T>
+#ifdef _MSC_VER
+unsigned __stdcall CThread<T>::persistentProc(void* p)
+#else // _MSC_VER
+void* CThread<T>::persistentProc(void* p)
+#endif // UNIX
+{
+    CThread<T>* thr = static_cast<CThread<T>*>(p);
+    if (thr->m_startHook) {
+        thr->m_startHook();
+    }
+    uint32_t seen = 0;
+    for (;;) {
+        // 挂起直到下一次run或析构
+        thr->m_runSeq.wait(seen, std::memory_order_acquire);
+        seen = thr->m_runSeq.load(std::memory_order_acquire);
+        if (thr->m_bQuit.load()) {
+            break;
+        }
+        thr->m_task();
+        thr->m_bRunning.store(false, std::memory_order_release);
+        thr->m_bRunning.notify_all();
+    }
+    return NULL;
+}
+
+template<typename T>
+inline bool CThread<T>::createThread()
+{
+#ifdef _MSC_VER
+    m_thread = ::_beginthreadex(NULL, 0, m_persistent ? persistentProc : threadProc, (void*)this, 0, NULL);
+#else // _MSC_VER
+    if (pthread_create(&m_thread, NULL, m_persistent ? persistentProc : threadProc, (void*)this) != 0) {
+        m_thread = NULL;
+    }
+#endif // UNIX
+    return m_thread != NULL;
+}
+
 template<typename T>
 template<typename Func, typename ...Args>
 inline bool CThread<T>::run(Func&& func, Args&&... args)
@@ -150,12 +240,16 @@ inline bool CThread<T>::run(Func&& func, Args&&... args)
     m_future = m_task.get_future();
     m_bRunning.store(true);
 
-#ifdef _MSC_VER
-    m_thread = ::_beginthreadex(NULL, 0, threadProc, (void*)this, 0, NULL);
-#else // _MSC_VER
-    pthread_create(&m_thread, NULL, threadProc, (void*)this);
-#endif // UNIX
-    if (m_thread == NULL) {
+    if (m_persistent && m_thread != NULL) {
+        // 线程已挂起等待，直接交付任务
+        m_runSeq.fetch_add(1, std::memory_order_release);
+        m_runSeq.notify_one();
+        return true;
+    }
+    if (m_persistent) {
+        m_runSeq.fetch_add(1, std::memory_order_release);
+    }
+    if (!createThread()) {
         m_bRunning.store(false);
         return false;
     }
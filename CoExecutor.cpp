@@ -0,0 +1,677 @@
+#include "CoExecutor.h"
+#include "PlatformCommonUtils.h"
+#include <limits>
+#include <vector>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#elif defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#else
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#ifdef _MSC_VER
+#define IO_WOULD_BLOCK(err) ((err) == WSAEWOULDBLOCK)
+#define IO_INTERRUPTED(err) ((err) == WSAEINTR)
+#define IO_LAST_ERROR()     WSAGetLastError()
+#else
+#define IO_WOULD_BLOCK(err) ((err) == EAGAIN || (err) == EWOULDBLOCK)
+#define IO_INTERRUPTED(err) ((err) == EINTR)
+#define IO_LAST_ERROR()     errno
+#endif
+
+#if defined(__linux__)
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+static constexpr int64_t REACTOR_SLEEPING = std::numeric_limits<int64_t>::max();
+
+static int64_t steady_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// started eagerly, frees itself when the spawned task completes
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept {}
+    };
+};
+
+static DetachedTask run_detached(CoExecutor* exec, Task<void> task)
+{
+    co_await exec->schedule();
+    try {
+        co_await std::move(task);
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("CoExecutor: spawned task failed: %s", e.what());
+    }
+    catch (...) {
+        LOG_ERROR("CoExecutor: spawned task failed");
+    }
+}
+
+CoExecutor::CoExecutor(size_t threads):
+    m_pool(threads)
+{
+    if (!initReactor()) {
+        LOG_ERROR("CoExecutor: failed to create the reactor, I/O waits will fail");
+        return;
+    }
+    m_bRunning = true;
+    m_reactor.setStartHook([] { PlatformCommonUtils::set_current_thread_name("co-reactor"); });
+    m_reactor.run([this] { reactorLoop(); });
+}
+
+CoExecutor::~CoExecutor()
+{
+    if (m_bRunning.exchange(false)) {
+        wakeReactor();
+        m_reactor.join();
+    }
+    // cancelled waiters resume on the pool, drain it before the reactor state goes away
+    std::vector<int> fds;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& item : m_fds) {
+            fds.push_back(item.first);
+        }
+    }
+    for (int fd : fds) {
+        cancelIo(fd);
+    }
+    // nothing advances the timers any more: wake sleepers early so their tasks finish and free
+    // themselves. Destroying the handles is unsafe, a sleeper is usually a frame its awaiter owns
+    std::unordered_map<uint64_t, std::coroutine_handle<>> sleepers;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        sleepers.swap(m_sleepers);
+    }
+    for (const auto& sleeper : sleepers) {
+        resume(sleeper.second);
+    }
+    m_pool.shutdown(true);
+    closeReactor();
+}
+
+CoExecutor& CoExecutor::shared()
+{
+    static CoExecutor executor;
+    return executor;
+}
+
+void CoExecutor::spawn(Task<void> task)
+{
+    run_detached(this, std::move(task));
+}
+
+void CoExecutor::resume(std::coroutine_handle<> handle)
+{
+    if (!m_pool.post([handle] { handle.resume(); }, TaskPriority::High)) {
+        // pool is shut down, finish on the calling thread rather than leak the frame
+        handle.resume();
+    }
+}
+
+void CoExecutor::resumeAfter(std::chrono::microseconds delay, std::coroutine_handle<> handle)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_bRunning) {
+            uint64_t key = ++m_sleeperSeq;
+            m_sleepers.emplace(key, handle);
+            m_timers.scheduleAfter(delay, [this, key] { wakeSleeper(key); });
+            handle = nullptr;
+        }
+    }
+    if (handle) {
+        // shutting down, the timers no longer run: wake at once so the task finishes instead of leaking
+        resume(handle);
+        return;
+    }
+    int64_t wake = m_reactorWakeNs.load();
+    if (wake != 0 && steady_now_ns() + std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count() < wake) {
+        wakeReactor();
+    }
+}
+
+void CoExecutor::wakeSleeper(uint64_t key)
+{
+    std::coroutine_handle<> handle;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_sleepers.find(key);
+        if (it == m_sleepers.end()) {
+            return; // woken by the destructor
+        }
+        handle = it->second;
+        m_sleepers.erase(it);
+    }
+    resume(handle);
+}
+
+bool CoExecutor::addWaiter(Waiter* waiter, uint32_t timeoutMs)
+{
+    if (!m_bRunning) {
+        waiter->result = IoResult::Error;
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    FdWaiters& state = m_fds[waiter->fd];
+    Waiter*& slot = waiter->write ? state.writer : state.reader;
+    if (slot != nullptr) {
+        LOG_ERROR("CoExecutor: fd %d already has a %s waiter", waiter->fd, waiter->write ? "write" : "read");
+        waiter->result = IoResult::Error;
+        return false;
+    }
+    slot = waiter;
+    waiter->seq = ++m_waiterSeq;
+    if (timeoutMs > 0) {
+        int fd = waiter->fd;
+        bool write = waiter->write;
+        uint64_t seq = waiter->seq;
+        // onTimeout checks the waiter is still registered before touching it
+        waiter->timer = m_timers.scheduleAfter(std::chrono::milliseconds(timeoutMs), [this, fd, write, waiter, seq] {
+            onTimeout(fd, write, waiter, seq);
+        });
+    }
+    if (!armLocked(waiter->fd, state)) {
+        slot = nullptr;
+        if (waiter->timer != 0) {
+            m_timers.cancel(waiter->timer);
+        }
+        waiter->result = IoResult::Error;
+        return false;
+    }
+    lock.unlock();
+
+#ifdef _MSC_VER
+    // WSAPoll works on a snapshot of the descriptors
+    wakeReactor();
+#else
+    int64_t wake = m_reactorWakeNs.load();
+    if (timeoutMs > 0 && wake != 0 && steady_now_ns() + (int64_t)timeoutMs * 1000000 < wake) {
+        wakeReactor();
+    }
+#endif
+    return true;
+}
+
+void CoExecutor::onTimeout(int fd, bool write, Waiter* waiter, uint64_t seq)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto it = m_fds.find(fd);
+    if (it == m_fds.end()) {
+        return;
+    }
+    Waiter*& slot = write ? it->second.writer : it->second.reader;
+    if (slot != waiter || waiter->seq != seq) {
+        return;
+    }
+    slot = nullptr;
+    armLocked(fd, it->second);
+    lock.unlock();
+
+    waiter->timer = 0;
+    waiter->result = IoResult::Timeout;
+    resume(waiter->handle);
+}
+
+void CoExecutor::complete(Waiter* waiter, IoResult result)
+{
+    if (waiter->timer != 0) {
+        m_timers.cancel(waiter->timer);
+        waiter->timer = 0;
+    }
+    waiter->result = result;
+    resume(waiter->handle);
+}
+
+void CoExecutor::onEvents(int fd, bool readable, bool writable, bool error)
+{
+    Waiter* ready[2] = { nullptr, nullptr };
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_fds.find(fd);
+        if (it == m_fds.end()) {
+            return;
+        }
+        FdWaiters& state = it->second;
+        // errors and hangups wake both sides, the following recv / send reports them
+        if ((readable || error) && state.reader != nullptr) {
+            ready[0] = std::exchange(state.reader, nullptr);
+        }
+        if ((writable || error) && state.writer != nullptr) {
+            ready[1] = std::exchange(state.writer, nullptr);
+        }
+        armLocked(fd, state);
+    }
+    for (Waiter* waiter : ready) {
+        if (waiter != nullptr) {
+            complete(waiter, IoResult::Ready);
+        }
+    }
+}
+
+void CoExecutor::cancelIo(int fd)
+{
+    Waiter* cancelled[2] = { nullptr, nullptr };
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_fds.find(fd);
+        if (it == m_fds.end()) {
+            return;
+        }
+        cancelled[0] = it->second.reader;
+        cancelled[1] = it->second.writer;
+#ifdef _MSC_VER
+        m_fds.erase(it);
+#elif defined(__APPLE__)
+        struct kevent changes[2];
+        EV_SET(&changes[0], fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+        EV_SET(&changes[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+        kevent(m_pollFd, changes, 2, nullptr, 0, nullptr);
+        m_fds.erase(it);
+#else
+        if (it->second.registered) {
+            epoll_ctl(m_pollFd, EPOLL_CTL_DEL, fd, nullptr);
+        }
+        m_fds.erase(it);
+#endif
+    }
+    for (Waiter* waiter : cancelled) {
+        if (waiter != nullptr) {
+            complete(waiter, IoResult::Cancelled);
+        }
+    }
+}
+
+Task<std::optional<int>> CoExecutor::recvSome(int fd, char* buffer, int len, uint32_t timeoutMs)
+{
+    while (true) {
+#ifdef _MSC_VER
+        int n = ::recv((SOCKET)fd, buffer, len, 0);
+#else
+        int n = (int)::recv(fd, buffer, (size_t)len, 0);
+#endif
+        if (n >= 0) {
+            co_return n;
+        }
+        int err = IO_LAST_ERROR();
+        if (IO_INTERRUPTED(err)) {
+            continue;
+        }
+        if (!IO_WOULD_BLOCK(err) || co_await readable(fd, timeoutMs) != IoResult::Ready) {
+            co_return std::nullopt;
+        }
+    }
+}
+
+Task<std::optional<int>> CoExecutor::sendAll(int fd, const char* buffer, int len, uint32_t timeoutMs)
+{
+    int sent = 0;
+    while (sent < len) {
+#ifdef _MSC_VER
+        int n = ::send((SOCKET)fd, buffer + sent, len - sent, 0);
+#else
+        int n = (int)::send(fd, buffer + sent, (size_t)(len - sent), SEND_FLAGS);
+#endif
+        if (n >= 0) {
+            sent += n;
+            continue;
+        }
+        int err = IO_LAST_ERROR();
+        if (IO_INTERRUPTED(err)) {
+            continue;
+        }
+        if (!IO_WOULD_BLOCK(err) || co_await writable(fd, timeoutMs) != IoResult::Ready) {
+            co_return std::nullopt;
+        }
+    }
+    co_return sent;
+}
+
+Task<std::optional<int>> CoExecutor::readSome(int fd, char* buffer, int len, uint32_t timeoutMs)
+{
+#ifdef _MSC_VER
+    (void)fd; (void)buffer; (void)len; (void)timeoutMs;
+    co_return std::nullopt;
+#else
+    while (true) {
+        int n = (int)::read(fd, buffer, (size_t)len);
+        if (n >= 0) {
+            co_return n;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (!IO_WOULD_BLOCK(errno) || co_await readable(fd, timeoutMs) != IoResult::Ready) {
+            co_return std::nullopt;
+        }
+    }
+#endif
+}
+
+Task<std::optional<int>> CoExecutor::writeAll(int fd, const char* buffer, int len, uint32_t timeoutMs)
+{
+#ifdef _MSC_VER
+    (void)fd; (void)buffer; (void)len; (void)timeoutMs;
+    co_return std::nullopt;
+#else
+    int written = 0;
+    while (written < len) {
+        int n = (int)::write(fd, buffer + written, (size_t)(len - written));
+        if (n >= 0) {
+            written += n;
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (!IO_WOULD_BLOCK(errno) || co_await writable(fd, timeoutMs) != IoResult::Ready) {
+            co_return std::nullopt;
+        }
+    }
+    co_return written;
+#endif
+}
+
+bool CoExecutor::setNonBlocking(int fd, bool nonBlocking)
+{
+#ifdef _MSC_VER
+    u_long mode = nonBlocking ? 1 : 0;
+    return ioctlsocket((SOCKET)fd, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) {
+        return false;
+    }
+    flags = nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return fcntl(fd, F_SETFL, flags) == 0;
+#endif
+}
+
+#ifdef _MSC_VER
+
+bool CoExecutor::initReactor()
+{
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        return false;
+    }
+    // a UDP socket bound to loopback, sending to itself wakes WSAPoll
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET) {
+        return false;
+    }
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int addrLen = sizeof(addr);
+    if (bind(s, (sockaddr*)&addr, sizeof(addr)) != 0
+        || getsockname(s, (sockaddr*)&addr, &addrLen) != 0
+        || ::connect(s, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        closesocket(s);
+        return false;
+    }
+    m_wakeFd = (int)s;
+    setNonBlocking(m_wakeFd);
+    return true;
+}
+
+void CoExecutor::closeReactor()
+{
+    if (m_wakeFd != -1) {
+        closesocket((SOCKET)m_wakeFd);
+        m_wakeFd = -1;
+        WSACleanup();
+    }
+}
+
+bool CoExecutor::armLocked(int fd, FdWaiters& state)
+{
+    (void)fd;
+    state.registered = state.reader != nullptr || state.writer != nullptr;
+    return true;
+}
+
+void CoExecutor::wakeReactor()
+{
+    char byte = 0;
+    send((SOCKET)m_wakeFd, &byte, 1, 0);
+}
+
+void CoExecutor::reactorLoop()
+{
+    std::vector<WSAPOLLFD> polls;
+    while (m_bRunning) {
+        polls.clear();
+        polls.push_back({ (SOCKET)m_wakeFd, POLLRDNORM, 0 });
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto& item : m_fds) {
+                SHORT events = (item.second.reader ? POLLRDNORM : 0) | (item.second.writer ? POLLWRNORM : 0);
+                if (events != 0) {
+                    polls.push_back({ (SOCKET)item.first, events, 0 });
+                }
+            }
+        }
+
+        m_reactorWakeNs = REACTOR_SLEEPING;
+        auto timeout = m_timers.nextTimeout();
+        int waitMs = timeout == std::chrono::microseconds::max() ? -1 : (int)((timeout.count() + 999) / 1000);
+        if (waitMs >= 0) {
+            m_reactorWakeNs = steady_now_ns() + (int64_t)waitMs * 1000000;
+        }
+        int n = WSAPoll(polls.data(), (ULONG)polls.size(), waitMs);
+        m_reactorWakeNs = 0;
+
+        if (n > 0) {
+            if (polls[0].revents != 0) {
+                char drain[64];
+                while (recv((SOCKET)m_wakeFd, drain, sizeof(drain), 0) > 0) {}
+            }
+            for (size_t i = 1; i < polls.size(); ++i) {
+                SHORT revents = polls[i].revents;
+                if (revents != 0) {
+                    onEvents((int)polls[i].fd, (revents & (POLLRDNORM | POLLHUP)) != 0, (revents & POLLWRNORM) != 0, (revents & (POLLERR | POLLNVAL)) != 0);
+                }
+            }
+        }
+        m_timers.advance();
+    }
+}
+
+#elif defined(__APPLE__)
+
+bool CoExecutor::initReactor()
+{
+    m_pollFd = kqueue();
+    if (m_pollFd < 0) {
+        return false;
+    }
+    struct kevent change;
+    EV_SET(&change, 0, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+    return kevent(m_pollFd, &change, 1, nullptr, 0, nullptr) == 0;
+}
+
+void CoExecutor::closeReactor()
+{
+    if (m_pollFd >= 0) {
+        ::close(m_pollFd);
+        m_pollFd = -1;
+    }
+}
+
+bool CoExecutor::armLocked(int fd, FdWaiters& state)
+{
+    // one shot filters, re-added for every wait; deleting an already fired one fails harmlessly
+    struct kevent changes[2];
+    EV_SET(&changes[0], fd, EVFILT_READ, state.reader != nullptr ? (EV_ADD | EV_ONESHOT) : EV_DELETE, 0, 0, nullptr);
+    EV_SET(&changes[1], fd, EVFILT_WRITE, state.writer != nullptr ? (EV_ADD | EV_ONESHOT) : EV_DELETE, 0, 0, nullptr);
+    for (struct kevent& change : changes) {
+        if (kevent(m_pollFd, &change, 1, nullptr, 0, nullptr) != 0 && (change.flags & EV_ADD)) {
+            LOG_ERROR("CoExecutor: kevent(%d) failed: %s", fd, strerror(errno));
+            return false;
+        }
+    }
+    state.registered = state.reader != nullptr || state.writer != nullptr;
+    return true;
+}
+
+void CoExecutor::wakeReactor()
+{
+    struct kevent change;
+    EV_SET(&change, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+    kevent(m_pollFd, &change, 1, nullptr, 0, nullptr);
+}
+
+void CoExecutor::reactorLoop()
+{
+    struct kevent events[64];
+    while (m_bRunning) {
+        m_reactorWakeNs = REACTOR_SLEEPING;
+        auto timeout = m_timers.nextTimeout();
+        struct timespec ts;
+        struct timespec* pts = nullptr;
+        if (timeout != std::chrono::microseconds::max()) {
+            ts.tv_sec = (time_t)(timeout.count() / 1000000);
+            ts.tv_nsec = (long)(timeout.count() % 1000000) * 1000;
+            pts = &ts;
+            m_reactorWakeNs = steady_now_ns() + timeout.count() * 1000;
+        }
+        int n = kevent(m_pollFd, nullptr, 0, events, 64, pts);
+        m_reactorWakeNs = 0;
+
+        for (int i = 0; i < n; ++i) {
+            if (events[i].filter == EVFILT_USER) {
+                continue;
+            }
+            bool error = (events[i].flags & EV_ERROR) != 0;
+            onEvents((int)events[i].ident, events[i].filter == EVFILT_READ, events[i].filter == EVFILT_WRITE, error);
+        }
+        m_timers.advance();
+    }
+}
+
+#else
+
+bool CoExecutor::initReactor()
+{
+    m_pollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_pollFd < 0) {
+        return false;
+    }
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeFd < 0) {
+        return false;
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = m_wakeFd;
+    return epoll_ctl(m_pollFd, EPOLL_CTL_ADD, m_wakeFd, &ev) == 0;
+}
+
+void CoExecutor::closeReactor()
+{
+    if (m_wakeFd >= 0) {
+        ::close(m_wakeFd);
+        m_wakeFd = -1;
+    }
+    if (m_pollFd >= 0) {
+        ::close(m_pollFd);
+        m_pollFd = -1;
+    }
+}
+
+bool CoExecutor::armLocked(int fd, FdWaiters& state)
+{
+    // one shot: a fired descriptor stays disabled until the next wait re-arms it
+    struct epoll_event ev = {};
+    ev.events = (uint32_t)EPOLLONESHOT | (state.reader != nullptr ? (uint32_t)(EPOLLIN | EPOLLRDHUP) : 0u) |
+        (state.writer != nullptr ? (uint32_t)EPOLLOUT : 0u);
+    ev.data.fd = fd;
+    if (state.registered) {
+        if (epoll_ctl(m_pollFd, EPOLL_CTL_MOD, fd, &ev) == 0) {
+            return true;
+        }
+        // the descriptor was closed and its number reused without cancelIo()
+        if (errno != ENOENT) {
+            LOG_ERROR("CoExecutor: epoll_ctl(MOD, %d) failed: %s", fd, strerror(errno));
+            return false;
+        }
+        state.registered = false;
+    }
+    if ((ev.events & (EPOLLIN | EPOLLOUT)) == 0) {
+        return true;
+    }
+    if (epoll_ctl(m_pollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        LOG_ERROR("CoExecutor: epoll_ctl(ADD, %d) failed: %s", fd, strerror(errno));
+        return false;
+    }
+    state.registered = true;
+    return true;
+}
+
+void CoExecutor::wakeReactor()
+{
+    uint64_t one = 1;
+    ssize_t res = ::write(m_wakeFd, &one, sizeof(one));
+    (void)res;
+}
+
+void CoExecutor::reactorLoop()
+{
+    struct epoll_event events[64];
+    while (m_bRunning) {
+        // published before reading the wheel, a timer added meanwhile sees it and wakes us
+        m_reactorWakeNs = REACTOR_SLEEPING;
+        auto timeout = m_timers.nextTimeout();
+        int waitMs = -1;
+        if (timeout != std::chrono::microseconds::max()) {
+            waitMs = (int)((timeout.count() + 999) / 1000);
+            m_reactorWakeNs = steady_now_ns() + (int64_t)waitMs * 1000000;
+        }
+        int n = epoll_wait(m_pollFd, events, 64, waitMs);
+        m_reactorWakeNs = 0;
+
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == m_wakeFd) {
+                uint64_t value;
+                ssize_t res = ::read(m_wakeFd, &value, sizeof(value));
+                (void)res;
+                continue;
+            }
+            uint32_t mask = events[i].events;
+            onEvents(fd, (mask & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) != 0, (mask & EPOLLOUT) != 0, (mask & EPOLLERR) != 0);
+        }
+        m_timers.advance();
+    }
+}
+
+#endif
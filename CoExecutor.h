@@ -0,0 +1,198 @@
+/**
+ *   Coroutine executor with I/O readiness and timers
+ *
+ *   Coroutines resume on a small ThreadPool. One reactor thread waits for
+ *   socket / pipe readiness (Linux epoll, MacOs kqueue, Windows WSAPoll) and
+ *   drives a TimerWheel for sleeps and I/O timeouts, so thousands of device
+ *   sessions can wait concurrently without an OS thread each.
+ *
+ *   Descriptors must be non-blocking. Call cancelIo(fd) before closing a
+ *   descriptor that may still have a waiter.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <coroutine>
+#include <chrono>
+#include <future>
+#include <optional>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+#include "CoTask.h"
+#include "ThreadPool.h"
+#include "TimerWheel.h"
+#include "CThread.hpp"
+
+enum class IoResult
+{
+    Ready,
+    Timeout,
+    Cancelled,
+    Error,
+};
+
+class CoExecutor
+{
+public:
+    /**
+     * @param threads  resume threads, 0 means one per hardware thread
+     */
+    explicit CoExecutor(size_t threads = 0);
+    ~CoExecutor();
+
+    CoExecutor(const CoExecutor&) = delete;
+    CoExecutor& operator=(const CoExecutor&) = delete;
+
+    static CoExecutor& shared();
+
+    /** run a task to completion on the executor, nobody awaits it */
+    void spawn(Task<void> task);
+
+    /** block the calling thread until task finishes, do not call from a resume thread */
+    template<typename T>
+    T blockOn(Task<T> task);
+
+    /** continue on a resume thread */
+    auto schedule()
+    {
+        struct Awaiter
+        {
+            CoExecutor* exec;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { exec->resume(handle); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{ this };
+    }
+
+    /** suspend for delay without holding a thread */
+    auto sleepFor(std::chrono::microseconds delay)
+    {
+        struct Awaiter
+        {
+            CoExecutor* exec;
+            std::chrono::microseconds delay;
+            bool await_ready() const noexcept { return delay.count() <= 0; }
+            void await_suspend(std::coroutine_handle<> handle) { exec->resumeAfter(delay, handle); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{ this, delay };
+    }
+
+    /** wait until fd can be read without blocking, timeoutMs 0 waits forever */
+    auto readable(int fd, uint32_t timeoutMs = 0) { return IoAwaiter{ this, fd, false, timeoutMs, {} }; }
+    auto writable(int fd, uint32_t timeoutMs = 0) { return IoAwaiter{ this, fd, true, timeoutMs, {} }; }
+
+    /** resume the waiters of fd with IoResult::Cancelled and forget it */
+    void cancelIo(int fd);
+
+    /**
+     * @brief  recv / send on a non-blocking socket, suspending while it would block
+     * @return bytes transferred, 0 on orderly shutdown, nullopt on error or timeout
+     */
+    Task<std::optional<int>> recvSome(int fd, char* buffer, int len, uint32_t timeoutMs = 0);
+    Task<std::optional<int>> sendAll(int fd, const char* buffer, int len, uint32_t timeoutMs = 0);
+
+    /** read / write on a non-blocking pipe or FIFO (POSIX) */
+    Task<std::optional<int>> readSome(int fd, char* buffer, int len, uint32_t timeoutMs = 0);
+    Task<std::optional<int>> writeAll(int fd, const char* buffer, int len, uint32_t timeoutMs = 0);
+
+    static bool setNonBlocking(int fd, bool nonBlocking = true);
+
+private:
+    struct Waiter
+    {
+        std::coroutine_handle<> handle;
+        int fd = -1;
+        bool write = false;
+        IoResult result = IoResult::Ready;
+        TimerWheel::TimerId timer = 0;
+        uint64_t seq = 0;           // tells a re-armed waiter at the same address from a stale timeout
+    };
+
+    struct IoAwaiter
+    {
+        CoExecutor* exec;
+        int fd;
+        bool write;
+        uint32_t timeoutMs;
+        Waiter waiter;
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            waiter.handle = handle;
+            waiter.fd = fd;
+            waiter.write = write;
+            return exec->addWaiter(&waiter, timeoutMs);
+        }
+        IoResult await_resume() const noexcept { return waiter.result; }
+    };
+
+    struct FdWaiters
+    {
+        Waiter* reader = nullptr;
+        Waiter* writer = nullptr;
+        bool registered = false;
+    };
+
+    void resume(std::coroutine_handle<> handle);
+    void resumeAfter(std::chrono::microseconds delay, std::coroutine_handle<> handle);
+    void wakeSleeper(uint64_t key);
+    bool addWaiter(Waiter* waiter, uint32_t timeoutMs);
+    void onTimeout(int fd, bool write, Waiter* waiter, uint64_t seq);
+    void complete(Waiter* waiter, IoResult result);
+    void onEvents(int fd, bool readable, bool writable, bool error);
+
+    bool initReactor();
+    void closeReactor();
+    bool armLocked(int fd, FdWaiters& state);
+    void wakeReactor();
+    void reactorLoop();
+
+private:
+    ThreadPool m_pool;
+    TimerWheel m_timers;
+
+    std::mutex m_mutex;
+    std::unordered_map<int, FdWaiters> m_fds;
+    uint64_t m_waiterSeq = 0;
+    std::unordered_map<uint64_t, std::coroutine_handle<>> m_sleepers;  // sleepFor waiting on m_timers
+    uint64_t m_sleeperSeq = 0;
+
+    int m_pollFd = -1;      // epoll / kqueue
+#if !defined(__APPLE__)
+    int m_wakeFd = -1;      // eventfd, loopback UDP socket on Windows
+#endif
+    std::atomic<int64_t> m_reactorWakeNs{ 0 };  // when the reactor will wake on its own, 0 while awake
+    std::atomic_bool m_bRunning = false;
+    CThread<void> m_reactor;
+};
+
+template<typename T>
+inline T CoExecutor::blockOn(Task<T> task)
+{
+    std::promise<T> promise;
+    std::future<T> future = promise.get_future();
+    auto wrapper = [](Task<T> inner, std::promise<T>& result) -> Task<void> {
+        try {
+            if constexpr (std::is_void_v<T>) {
+                co_await std::move(inner);
+                result.set_value();
+            }
+            else {
+                result.set_value(co_await std::move(inner));
+            }
+        }
+        catch (...) {
+            result.set_exception(std::current_exception());
+        }
+    };
+    spawn(wrapper(std::move(task), promise));
+    return future.get();
+}
@@ -0,0 +1,152 @@
+/**
+ *   C++20 coroutine task
+ *
+ *   Task<T> is lazy: the body starts when it is awaited (or spawned on a
+ *   CoExecutor) and resumes its awaiter by symmetric transfer when it
+ *   finishes, so long co_await chains do not grow the stack. Exceptions
+ *   escaping the body are rethrown at the co_await.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <type_traits>
+
+template<typename T = void>
+class Task;
+
+namespace CoDetail
+{
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) const noexcept
+        {
+            auto continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    struct PromiseBase
+    {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr error;
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+        void unhandled_exception() noexcept { error = std::current_exception(); }
+    };
+
+    template<typename T>
+    struct Promise : PromiseBase
+    {
+        std::optional<T> value;
+
+        Task<T> get_return_object() noexcept;
+
+        template<typename U>
+        void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+
+        T result()
+        {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            return std::move(*value);
+        }
+    };
+
+    template<>
+    struct Promise<void> : PromiseBase
+    {
+        Task<void> get_return_object() noexcept;
+
+        void return_void() const noexcept {}
+
+        void result()
+        {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    };
+}
+
+template<typename T>
+class Task
+{
+public:
+    using promise_type = CoDetail::Promise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    explicit Task(handle_type handle) : m_handle(handle) {}
+    Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other) {
+            if (m_handle) m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task()
+    {
+        if (m_handle) m_handle.destroy();
+    }
+
+    bool valid() const { return (bool)m_handle; }
+    bool done() const { return m_handle && m_handle.done(); }
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter
+        {
+            handle_type handle;
+
+            bool await_ready() const noexcept { return !handle || handle.done(); }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            T await_resume() { return handle.promise().result(); }
+        };
+        return Awaiter{ m_handle };
+    }
+
+    /** hand over the coroutine frame, used by CoExecutor::spawn */
+    handle_type release() noexcept { return std::exchange(m_handle, nullptr); }
+
+private:
+    handle_type m_handle = nullptr;
+};
+
+namespace CoDetail
+{
+    template<typename T>
+    inline Task<T> Promise<T>::get_return_object() noexcept
+    {
+        return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+    }
+
+    inline Task<void> Promise<void>::get_return_object() noexcept
+    {
+        return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+    }
+}
@@ -0,0 +1,687 @@
+/**
+ *   Lock-free queues for hand-offs between threads
+ *
+ *   SpscQueue     bounded ring, one producer and one consumer
+ *   MpmcQueue     bounded, any number of producers and consumers (D. Vyukov)
+ *   MpscQueue     unbounded intrusive linked queue, one consumer (D. Vyukov)
+ *   SpinParkWait  spins, yields, then parks on an atomic until notified
+ *   BlockingQueue blocking push / pop with close() on top of any of them
+ *
+ *   The bounded queues allocate their slots once; MpscQueue links nodes that
+ *   live inside the items, so no queue allocates per item.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <iterator>
+#include <stddef.h>
+#include <stdint.h>
+#include "PlatformSync.h"
+
+namespace QueueDetail
+{
+    constexpr size_t CACHE_LINE = 64;
+
+    inline size_t roundUpPow2(size_t value)
+    {
+        size_t result = 2;
+        while (result < value) result <<= 1;
+        return result;
+    }
+
+    /** uninitialized storage for one T */
+    template<typename T>
+    struct Slot
+    {
+        alignas(T) unsigned char bytes[sizeof(T)];
+
+        T* ptr() { return std::launder(reinterpret_cast<T*>(bytes)); }
+
+        template<typename... Args>
+        void construct(Args&&... args) { new (bytes) T(std::forward<Args>(args)...); }
+
+        T take()
+        {
+            T* p = ptr();
+            T value(std::move(*p));
+            p->~T();
+            return value;
+        }
+    };
+}
+
+/**
+ * @brief Bounded single producer / single consumer ring
+ *
+ * Each side keeps a private copy of the other side's index and only reads
+ * the shared one when the copy says full / empty, so in steady state the
+ * indices do not bounce between cores.
+ */
+template<typename T>
+class SpscQueue
+{
+public:
+    using value_type = T;
+
+    explicit SpscQueue(size_t capacity = 1024) :
+        m_mask(QueueDetail::roundUpPow2(capacity) - 1),
+        m_slots(new QueueDetail::Slot<T>[m_mask + 1])
+    {
+    }
+
+    ~SpscQueue()
+    {
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        for (size_t i = m_head.load(std::memory_order_relaxed); i != tail; ++i) {
+            m_slots[i & m_mask].ptr()->~T();
+        }
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /** producer only */
+    template<typename... Args>
+    bool tryEmplace(Args&&... args)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_headCache > m_mask) {
+            m_headCache = m_head.load(std::memory_order_acquire);
+            if (tail - m_headCache > m_mask) {
+                return false;
+            }
+        }
+        m_slots[tail & m_mask].construct(std::forward<Args>(args)...);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPush(const T& value) { return tryEmplace(value); }
+    bool tryPush(T&& value) { return tryEmplace(std::move(value)); }
+
+    /**
+     * @brief  Push up to count items with one index update
+     * @return number of items pushed, the rest did not fit
+     */
+    template<typename It>
+    size_t tryPushBatch(It first, size_t count)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t room = m_mask + 1 - (tail - m_headCache);
+        if (room < count) {
+            m_headCache = m_head.load(std::memory_order_acquire);
+            room = m_mask + 1 - (tail - m_headCache);
+        }
+        size_t n = count < room ? count : room;
+        for (size_t i = 0; i < n; ++i, ++first) {
+            m_slots[(tail + i) & m_mask].construct(std::move(*first));
+        }
+        if (n > 0) {
+            m_tail.store(tail + n, std::memory_order_release);
+        }
+        return n;
+    }
+
+    /** consumer only */
+    bool tryPop(T& out)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tailCache) {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tailCache) {
+                return false;
+            }
+        }
+        out = m_slots[head & m_mask].take();
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** pop up to count items into out with one index update */
+    template<typename OutIt>
+    size_t tryPopBatch(OutIt out, size_t count)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t avail = m_tailCache - head;
+        if (avail < count) {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+            avail = m_tailCache - head;
+        }
+        size_t n = count < avail ? count : avail;
+        for (size_t i = 0; i < n; ++i, ++out) {
+            *out = m_slots[(head + i) & m_mask].take();
+        }
+        if (n > 0) {
+            m_head.store(head + n, std::memory_order_release);
+        }
+        return n;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+    size_t sizeApprox() const { return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire); }
+    bool empty() const { return sizeApprox() == 0; }
+
+private:
+    const size_t m_mask;
+    std::unique_ptr<QueueDetail::Slot<T>[]> m_slots;
+
+    alignas(QueueDetail::CACHE_LINE) std::atomic<size_t> m_tail{ 0 };
+    size_t m_headCache = 0;         // producer's view of m_head
+
+    alignas(QueueDetail::CACHE_LINE) std::atomic<size_t> m_head{ 0 };
+    size_t m_tailCache = 0;         // consumer's view of m_tail
+};
+
+/**
+ * @brief Bounded multi producer / multi consumer queue
+ *
+ * Every cell carries a sequence number telling whether it is free for the
+ * lap a producer or consumer is on, so an operation is one CAS on the
+ * shared index plus uncontended accesses to its own cell.
+ */
+template<typename T>
+class MpmcQueue
+{
+public:
+    using value_type = T;
+
+    explicit MpmcQueue(size_t capacity = 1024) :
+        m_mask(QueueDetail::roundUpPow2(capacity) - 1),
+        m_cells(new Cell[m_mask + 1])
+    {
+        for (size_t i = 0; i <= m_mask; ++i) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~MpmcQueue()
+    {
+        size_t tail = m_enqueuePos.load(std::memory_order_acquire);
+        for (size_t i = m_dequeuePos.load(std::memory_order_relaxed); i != tail; ++i) {
+            m_cells[i & m_mask].slot.ptr()->~T();
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    template<typename... Args>
+    bool tryEmplace(Args&&... args)
+    {
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;   // full
+            }
+            else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->slot.construct(std::forward<Args>(args)...);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPush(const T& value) { return tryEmplace(value); }
+    bool tryPush(T&& value) { return tryEmplace(std::move(value)); }
+
+    bool tryPop(T& out)
+    {
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;   // empty
+            }
+            else {
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        out = cell->slot.take();
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief  Claim a run of consecutive cells with one CAS when they are all free
+     * @return number of items pushed, may be less than count when the queue fills up
+     */
+    template<typename It>
+    size_t tryPushBatch(It first, size_t count)
+    {
+        size_t done = 0;
+        while (done < count) {
+            size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+            size_t n = 0;
+            // cells are handed out in order, so the run ends at the first one still in use
+            while (done + n < count && n <= m_mask
+                && m_cells[(pos + n) & m_mask].sequence.load(std::memory_order_acquire) == pos + n) {
+                ++n;
+            }
+            if (n == 0) {
+                if (!tryPush(std::move(*first))) {
+                    break;
+                }
+                ++first;
+                ++done;
+                continue;
+            }
+            if (!m_enqueuePos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                continue;
+            }
+            for (size_t i = 0; i < n; ++i, ++first) {
+                Cell& cell = m_cells[(pos + i) & m_mask];
+                cell.slot.construct(std::move(*first));
+                cell.sequence.store(pos + i + 1, std::memory_order_release);
+            }
+            done += n;
+        }
+        return done;
+    }
+
+    template<typename OutIt>
+    size_t tryPopBatch(OutIt out, size_t count)
+    {
+        size_t done = 0;
+        while (done < count) {
+            size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+            size_t n = 0;
+            while (done + n < count && n <= m_mask
+                && m_cells[(pos + n) & m_mask].sequence.load(std::memory_order_acquire) == pos + n + 1) {
+                ++n;
+            }
+            if (n == 0) {
+                break;
+            }
+            if (!m_dequeuePos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                continue;
+            }
+            for (size_t i = 0; i < n; ++i, ++out) {
+                Cell& cell = m_cells[(pos + i) & m_mask];
+                *out = cell.slot.take();
+                cell.sequence.store(pos + i + m_mask + 1, std::memory_order_release);
+            }
+            done += n;
+        }
+        return done;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+    size_t sizeApprox() const
+    {
+        size_t tail = m_enqueuePos.load(std::memory_order_acquire);
+        size_t head = m_dequeuePos.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+    bool empty() const { return sizeApprox() == 0; }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        QueueDetail::Slot<T> slot;
+    };
+
+    const size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+
+    alignas(QueueDetail::CACHE_LINE) std::atomic<size_t> m_enqueuePos{ 0 };
+    alignas(QueueDetail::CACHE_LINE) std::atomic<size_t> m_dequeuePos{ 0 };
+};
+
+/** link field for MpscQueue, derive the queued type from it */
+struct MpscNode
+{
+    std::atomic<MpscNode*> mpscNext{ nullptr };
+};
+
+/**
+ * @brief Unbounded multi producer / single consumer intrusive queue
+ *
+ * push is one exchange and never fails. The queue does not own the items,
+ * T must derive from MpscNode and an item may be in one queue at a time.
+ */
+template<typename T>
+class MpscQueue
+{
+    static_assert(std::is_base_of<MpscNode, T>::value, "MpscQueue items derive from MpscNode");
+
+public:
+    using value_type = T*;
+
+    MpscQueue()
+    {
+        m_head.store(&m_stub, std::memory_order_relaxed);
+        m_tail = &m_stub;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /** any thread */
+    void push(T* item)
+    {
+        pushChain(item, item);
+    }
+
+    bool tryPush(T* item)
+    {
+        push(item);
+        return true;
+    }
+
+    /** push count items with a single exchange, they stay consecutive in the queue */
+    template<typename It>
+    size_t tryPushBatch(It first, size_t count)
+    {
+        if (count == 0) {
+            return 0;
+        }
+        MpscNode* head = *first;
+        MpscNode* last = head;
+        for (size_t i = 1; i < count; ++i) {
+            ++first;
+            MpscNode* node = *first;
+            last->mpscNext.store(node, std::memory_order_relaxed);
+            last = node;
+        }
+        pushChain(head, last);
+        return count;
+    }
+
+    /**
+     * @brief  Consumer only
+     * @return nullptr if empty, or while a producer is between its two steps
+     */
+    T* pop()
+    {
+        MpscNode* tail = m_tail;
+        MpscNode* next = tail->mpscNext.load(std::memory_order_acquire);
+        if (tail == &m_stub) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            m_tail = next;
+            tail = next;
+            next = next->mpscNext.load(std::memory_order_acquire);
+        }
+        if (next != nullptr) {
+            m_tail = next;
+            return static_cast<T*>(tail);
+        }
+        if (tail != m_head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        // tail is the last item, put the stub behind it so it can be unlinked
+        pushChain(&m_stub, &m_stub);
+        next = tail->mpscNext.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            m_tail = next;
+            return static_cast<T*>(tail);
+        }
+        return nullptr;
+    }
+
+    bool tryPop(T*& out)
+    {
+        out = pop();
+        return out != nullptr;
+    }
+
+    template<typename OutIt>
+    size_t tryPopBatch(OutIt out, size_t count)
+    {
+        size_t n = 0;
+        while (n < count) {
+            T* item = pop();
+            if (item == nullptr) {
+                break;
+            }
+            *out = item;
+            ++out;
+            ++n;
+        }
+        return n;
+    }
+
+    bool empty() const
+    {
+        return m_tail->mpscNext.load(std::memory_order_acquire) == nullptr
+            && m_head.load(std::memory_order_acquire) == m_tail;
+    }
+
+private:
+    void pushChain(MpscNode* first, MpscNode* last)
+    {
+        last->mpscNext.store(nullptr, std::memory_order_relaxed);
+        MpscNode* prev = m_head.exchange(last, std::memory_order_acq_rel);
+        prev->mpscNext.store(first, std::memory_order_release);
+    }
+
+private:
+    alignas(QueueDetail::CACHE_LINE) std::atomic<MpscNode*> m_head;    // producers
+    alignas(QueueDetail::CACHE_LINE) MpscNode* m_tail;                 // consumer
+    MpscNode m_stub;
+};
+
+/**
+ * @brief Spin, then yield, then park until notified
+ *
+ * Waiters announce themselves before their final check, so notify() costs
+ * one load when nobody is parked.
+ */
+class SpinParkWait
+{
+public:
+    explicit SpinParkWait(uint32_t spins = 256, uint32_t yields = 16) :
+        m_spins(spins),
+        m_yields(yields)
+    {
+    }
+
+    /** block until ready() returns true */
+    template<typename Pred>
+    void wait(Pred&& ready)
+    {
+        for (uint32_t i = 0; i < m_spins; ++i) {
+            if (ready()) {
+                return;
+            }
+            sync_cpu_relax();
+        }
+        for (uint32_t i = 0; i < m_yields; ++i) {
+            if (ready()) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        while (true) {
+            uint32_t epoch = m_epoch.load(std::memory_order_acquire);
+            m_waiters.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (ready()) {
+                m_waiters.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            m_epoch.wait(epoch, std::memory_order_acquire);
+            m_waiters.fetch_sub(1, std::memory_order_relaxed);
+            if (ready()) {
+                return;
+            }
+        }
+    }
+
+    /** call after making ready() true */
+    void notifyOne() { notify(false); }
+    void notifyAll() { notify(true); }
+
+private:
+    void notify(bool all)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        m_epoch.fetch_add(1, std::memory_order_release);
+        if (all) {
+            m_epoch.notify_all();
+        }
+        else {
+            m_epoch.notify_one();
+        }
+    }
+
+private:
+    uint32_t m_spins;
+    uint32_t m_yields;
+    alignas(QueueDetail::CACHE_LINE) std::atomic<uint32_t> m_epoch{ 0 };
+    std::atomic<uint32_t> m_waiters{ 0 };
+};
+
+/**
+ * @brief Blocking push / pop over SpscQueue, MpmcQueue or MpscQueue
+ *
+ * The producer / consumer rules of the underlying queue still apply.
+ */
+template<typename Queue>
+class BlockingQueue
+{
+public:
+    using value_type = typename Queue::value_type;
+
+    template<typename... Args>
+    explicit BlockingQueue(Args&&... args) :
+        m_queue(std::forward<Args>(args)...)
+    {
+    }
+
+    /** false only after close() */
+    template<typename U>
+    bool push(U&& value)
+    {
+        if (isClosed()) {
+            return false;
+        }
+        // a failed tryPush leaves value untouched, so it can be retried
+        if (!m_queue.tryPush(std::forward<U>(value))) {
+            bool pushed = false;
+            m_notFull.wait([&] { return isClosed() || (pushed = m_queue.tryPush(std::forward<U>(value))); });
+            if (!pushed) {
+                return false;
+            }
+        }
+        m_notEmpty.notifyOne();
+        return true;
+    }
+
+    bool tryPush(value_type value)
+    {
+        if (isClosed() || !m_queue.tryPush(std::move(value))) {
+            return false;
+        }
+        m_notEmpty.notifyOne();
+        return true;
+    }
+
+    /** pushes everything, blocking while full; returns the count pushed before close() */
+    template<typename It>
+    size_t pushBatch(It first, size_t count)
+    {
+        size_t done = 0;
+        while (done < count && !isClosed()) {
+            size_t n = m_queue.tryPushBatch(first, count - done);
+            if (n == 0) {
+                m_notFull.wait([&] { return isClosed() || (n = m_queue.tryPushBatch(first, count - done)) > 0; });
+                if (n == 0) {
+                    break;
+                }
+            }
+            std::advance(first, n);
+            done += n;
+            m_notEmpty.notifyAll();
+        }
+        return done;
+    }
+
+    /** false when closed and drained */
+    bool pop(value_type& out)
+    {
+        if (!m_queue.tryPop(out)) {
+            bool got = false;
+            m_notEmpty.wait([&] { return (got = m_queue.tryPop(out)) || isClosed(); });
+            if (!got && !(got = m_queue.tryPop(out))) {
+                return false;
+            }
+        }
+        m_notFull.notifyOne();
+        return true;
+    }
+
+    bool tryPop(value_type& out)
+    {
+        if (!m_queue.tryPop(out)) {
+            return false;
+        }
+        m_notFull.notifyOne();
+        return true;
+    }
+
+    /** waits for at least one item, then takes up to count; 0 when closed and drained */
+    template<typename OutIt>
+    size_t popBatch(OutIt out, size_t count)
+    {
+        size_t n = 0;
+        m_notEmpty.wait([&] { return (n = m_queue.tryPopBatch(out, count)) > 0 || isClosed(); });
+        if (n == 0) {
+            n = m_queue.tryPopBatch(out, count);
+        }
+        if (n > 0) {
+            m_notFull.notifyAll();
+        }
+        return n;
+    }
+
+    /** wake every waiter, push fails from now on, pop drains what is left */
+    void close()
+    {
+        m_closed.store(true, std::memory_order_release);
+        m_notEmpty.notifyAll();
+        m_notFull.notifyAll();
+    }
+
+    bool isClosed() const { return m_closed.load(std::memory_order_acquire); }
+
+    Queue& queue() { return m_queue; }
+
+private:
+    Queue m_queue;
+    SpinParkWait m_notEmpty;
+    SpinParkWait m_notFull;
+    std::atomic_bool m_closed{ false };
+};
@@ -0,0 +1,505 @@
+#include "CpuTopology.h"
+#include "PlatformCommonUtils.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
+#include <thread>
+
+#ifdef _MSC_VER
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/resource.h>
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#include <pthread/qos.h>
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+#if !defined(_MSC_VER) && !defined(__APPLE__)
+static bool read_sys_string(const std::string& path, std::string& value)
+{
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::getline(file, value);
+    return true;
+}
+
+static int read_sys_int(const std::string& path, int fallback)
+{
+    std::string value;
+    if (!read_sys_string(path, value) || value.empty()) {
+        return fallback;
+    }
+    return atoi(value.c_str());
+}
+
+/** "0-3,8,10-11" */
+static std::vector<int> parse_cpu_list(const std::string& list)
+{
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty()) {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int first = atoi(range.c_str());
+        int last = dash == std::string::npos ? first : atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+/** "32K", "1024K", "8M" */
+static uint64_t parse_cache_size(const std::string& value)
+{
+    uint64_t size = strtoull(value.c_str(), nullptr, 10);
+    if (value.find('K') != std::string::npos) size <<= 10;
+    else if (value.find('M') != std::string::npos) size <<= 20;
+    return size;
+}
+#endif
+
+const CpuTopology& CpuTopology::shared()
+{
+    static CpuTopology topology = [] {
+        CpuTopology t;
+        t.load();
+        return t;
+    }();
+    return topology;
+}
+
+bool CpuTopology::load()
+{
+    m_cpus.clear();
+    m_caches.clear();
+    bool ok = loadPlatform();
+    if (!ok || m_cpus.empty()) {
+        // unknown layout: every logical cpu is its own core
+        m_cpus.clear();
+        unsigned count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < count; ++i) {
+            CpuInfo cpu;
+            cpu.id = (int)i;
+            cpu.core = (int)i;
+            m_cpus.push_back(cpu);
+        }
+    }
+    finish();
+    return ok;
+}
+
+void CpuTopology::finish()
+{
+    std::sort(m_cpus.begin(), m_cpus.end(), [](const CpuInfo& a, const CpuInfo& b) { return a.id < b.id; });
+
+    std::set<int> cores, packages, nodes;
+    std::map<int, int> threadsOfCore;
+    for (auto& cpu : m_cpus) {
+        cores.insert(cpu.core);
+        packages.insert(cpu.package);
+        nodes.insert(cpu.node);
+        cpu.smtIndex = threadsOfCore[cpu.core]++;
+    }
+    m_coreCount = cores.size();
+    m_packageCount = packages.size();
+    m_nodeCount = nodes.size();
+}
+
+#if defined(_MSC_VER)
+bool CpuTopology::loadPlatform()
+{
+    DWORD length = 0;
+    GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+    if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+        return false;
+    }
+    std::vector<uint8_t> buffer(length);
+    auto* info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)buffer.data();
+    if (!GetLogicalProcessorInformationEx(RelationAll, info, &length)) {
+        LOG_ERROR("GetLogicalProcessorInformationEx failed: %lu", GetLastError());
+        return false;
+    }
+
+    auto for_each_cpu = [](const GROUP_AFFINITY& affinity, auto&& fn) {
+        for (int bit = 0; bit < 64; ++bit) {
+            if (affinity.Mask & ((KAFFINITY)1 << bit)) {
+                fn(affinity.Group * 64 + bit);
+            }
+        }
+    };
+
+    std::map<int, CpuInfo> cpus;
+    int core = 0, package = 0;
+    for (DWORD offset = 0; offset < length;) {
+        auto* item = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)(buffer.data() + offset);
+        switch (item->Relationship) {
+        case RelationProcessorCore:
+            for (WORD g = 0; g < item->Processor.GroupCount; ++g) {
+                for_each_cpu(item->Processor.GroupMask[g], [&](int id) { cpus[id].id = id; cpus[id].core = core; });
+            }
+            ++core;
+            break;
+        case RelationProcessorPackage:
+            for (WORD g = 0; g < item->Processor.GroupCount; ++g) {
+                for_each_cpu(item->Processor.GroupMask[g], [&](int id) { cpus[id].package = package; });
+            }
+            ++package;
+            break;
+        case RelationNumaNode:
+            for_each_cpu(item->NumaNode.GroupMask, [&](int id) { cpus[id].node = (int)item->NumaNode.NodeNumber; });
+            break;
+        case RelationCache: {
+            CacheInfo cache;
+            cache.level = item->Cache.Level;
+            cache.type = item->Cache.Type == CacheData ? 'D' : item->Cache.Type == CacheInstruction ? 'I' : 'U';
+            cache.size = item->Cache.CacheSize;
+            cache.lineSize = item->Cache.LineSize;
+            for_each_cpu(item->Cache.GroupMask, [&](int id) { cache.cpus.push_back(id); });
+            m_caches.push_back(cache);
+            break;
+        }
+        default:
+            break;
+        }
+        offset += item->Size;
+    }
+    for (auto& entry : cpus) {
+        m_cpus.push_back(entry.second);
+    }
+    return true;
+}
+#elif defined(__APPLE__)
+template<typename T>
+static T sysctl_value(const char* name, T fallback)
+{
+    T value = 0;
+    size_t size = sizeof(value);
+    if (sysctlbyname(name, &value, &size, nullptr, 0) != 0) {
+        return fallback;
+    }
+    return value;
+}
+
+bool CpuTopology::loadPlatform()
+{
+    int logical = sysctl_value<int>("hw.logicalcpu", 0);
+    int physical = sysctl_value<int>("hw.physicalcpu", 0);
+    if (logical <= 0 || physical <= 0) {
+        return false;
+    }
+    // the kernel numbers the hardware threads of a core consecutively
+    int perCore = std::max(1, logical / physical);
+    for (int i = 0; i < logical; ++i) {
+        CpuInfo cpu;
+        cpu.id = i;
+        cpu.core = i / perCore;
+        m_cpus.push_back(cpu);
+    }
+
+    uint32_t line = (uint32_t)sysctl_value<int64_t>("hw.cachelinesize", 64);
+    auto add_cache = [&](int level, char type, const char* name, int sharedBy) {
+        uint64_t size = (uint64_t)sysctl_value<int64_t>(name, 0);
+        if (size == 0 || sharedBy <= 0) {
+            return;
+        }
+        for (int first = 0; first < logical; first += sharedBy) {
+            CacheInfo cache;
+            cache.level = level;
+            cache.type = type;
+            cache.size = size;
+            cache.lineSize = line;
+            for (int i = first; i < std::min(logical, first + sharedBy); ++i) {
+                cache.cpus.push_back(i);
+            }
+            m_caches.push_back(cache);
+        }
+    };
+    add_cache(1, 'D', "hw.l1dcachesize", perCore);
+    add_cache(1, 'I', "hw.l1icachesize", perCore);
+    add_cache(2, 'U', "hw.l2cachesize", perCore);
+    add_cache(3, 'U', "hw.l3cachesize", logical);
+    return true;
+}
+#else
+bool CpuTopology::loadPlatform()
+{
+    const std::string base = "/sys/devices/system/cpu/";
+    std::string online;
+    if (!read_sys_string(base + "online", online)) {
+        return false;
+    }
+
+    std::map<std::pair<int, int>, int> coreIds;     // (package, core_id) -> global core
+    std::set<std::string> seenCaches;
+    for (int id : parse_cpu_list(online)) {
+        std::string dir = base + "cpu" + std::to_string(id) + "/";
+        CpuInfo cpu;
+        cpu.id = id;
+        cpu.package = read_sys_int(dir + "topology/physical_package_id", 0);
+        int coreId = read_sys_int(dir + "topology/core_id", id);
+        auto key = std::make_pair(cpu.package, coreId);
+        auto it = coreIds.find(key);
+        if (it == coreIds.end()) {
+            it = coreIds.emplace(key, (int)coreIds.size()).first;
+        }
+        cpu.core = it->second;
+        m_cpus.push_back(cpu);
+
+        for (int index = 0;; ++index) {
+            std::string cacheDir = dir + "cache/index" + std::to_string(index) + "/";
+            std::string shared, type, size;
+            if (!read_sys_string(cacheDir + "shared_cpu_list", shared)) {
+                break;
+            }
+            CacheInfo cache;
+            cache.level = read_sys_int(cacheDir + "level", 0);
+            read_sys_string(cacheDir + "type", type);
+            cache.type = type == "Data" ? 'D' : type == "Instruction" ? 'I' : 'U';
+            // every cpu lists the caches it shares, keep one entry per cache
+            if (!seenCaches.insert(std::to_string(cache.level) + cache.type + shared).second) {
+                continue;
+            }
+            read_sys_string(cacheDir + "size", size);
+            cache.size = parse_cache_size(size);
+            cache.lineSize = (uint32_t)read_sys_int(cacheDir + "coherency_line_size", 64);
+            cache.cpus = parse_cpu_list(shared);
+            m_caches.push_back(cache);
+        }
+    }
+
+    // NUMA nodes, absent on kernels without CONFIG_NUMA
+    for (int node = 0;; ++node) {
+        std::string list;
+        if (!read_sys_string("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", list)) {
+            if (node > 0 || access("/sys/devices/system/node", F_OK) != 0) {
+                break;
+            }
+            continue;   // node0 may be memory only on odd machines
+        }
+        for (int id : parse_cpu_list(list)) {
+            for (auto& cpu : m_cpus) {
+                if (cpu.id == id) cpu.node = node;
+            }
+        }
+    }
+    return true;
+}
+#endif
+
+const CpuInfo* CpuTopology::findCpu(int cpu) const
+{
+    auto it = std::lower_bound(m_cpus.begin(), m_cpus.end(), cpu, [](const CpuInfo& info, int id) { return info.id < id; });
+    return it != m_cpus.end() && it->id == cpu ? &*it : nullptr;
+}
+
+std::vector<int> CpuTopology::cpusOfNode(int node) const
+{
+    std::vector<int> result;
+    for (const auto& cpu : m_cpus) {
+        if (cpu.node == node) result.push_back(cpu.id);
+    }
+    return result;
+}
+
+std::vector<int> CpuTopology::smtSiblings(int cpu) const
+{
+    std::vector<int> result;
+    const CpuInfo* info = findCpu(cpu);
+    if (info == nullptr) {
+        return result;
+    }
+    for (const auto& other : m_cpus) {
+        if (other.core == info->core) result.push_back(other.id);
+    }
+    return result;
+}
+
+const CacheInfo* CpuTopology::cacheOf(int cpu, int level) const
+{
+    const CacheInfo* best = nullptr;
+    for (const auto& cache : m_caches) {
+        if (cache.level == level && cache.type != 'I' &&
+            std::find(cache.cpus.begin(), cache.cpus.end(), cpu) != cache.cpus.end() &&
+            (best == nullptr || cache.size > best->size)) {
+            best = &cache;
+        }
+    }
+    return best;
+}
+
+std::vector<int> CpuTopology::cpuOrder(PinPolicy policy, int node) const
+{
+    std::vector<CpuInfo> order = m_cpus;
+    switch (policy) {
+    case PinPolicy::None:
+        break;
+    case PinPolicy::Node:
+        order.erase(std::remove_if(order.begin(), order.end(), [node](const CpuInfo& cpu) { return cpu.node != node; }), order.end());
+        [[fallthrough]];
+    case PinPolicy::Compact:
+        std::stable_sort(order.begin(), order.end(), [](const CpuInfo& a, const CpuInfo& b) {
+            if (a.node != b.node) return a.node < b.node;
+            if (a.package != b.package) return a.package < b.package;
+            if (a.core != b.core) return a.core < b.core;
+            return a.smtIndex < b.smtIndex;
+        });
+        break;
+    case PinPolicy::Scatter: {
+        // round robin over nodes, first hardware thread of every core before any sibling
+        std::map<int, int> rankInNode;
+        std::stable_sort(order.begin(), order.end(), [](const CpuInfo& a, const CpuInfo& b) {
+            return a.core != b.core ? a.core < b.core : a.smtIndex < b.smtIndex;
+        });
+        std::map<int, int> coreRank;
+        for (const auto& cpu : order) {
+            if (!coreRank.count(cpu.core)) coreRank[cpu.core] = rankInNode[cpu.node]++;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](const CpuInfo& a, const CpuInfo& b) {
+            if (a.smtIndex != b.smtIndex) return a.smtIndex < b.smtIndex;
+            int ra = coreRank[a.core], rb = coreRank[b.core];
+            if (ra != rb) return ra < rb;
+            return a.node < b.node;
+        });
+        break;
+    }
+    }
+
+    std::vector<int> ids;
+    ids.reserve(order.size());
+    for (const auto& cpu : order) {
+        ids.push_back(cpu.id);
+    }
+    return ids;
+}
+
+bool PlatformCommonUtils::set_current_thread_affinity(const std::vector<int>& cpus)
+{
+    if (cpus.empty()) {
+        return false;
+    }
+#if defined(_MSC_VER)
+    // a thread can only run inside one processor group
+    GROUP_AFFINITY affinity = {};
+    affinity.Group = (WORD)(cpus[0] / 64);
+    for (int cpu : cpus) {
+        if (cpu / 64 == affinity.Group) {
+            affinity.Mask |= (KAFFINITY)1 << (cpu % 64);
+        }
+    }
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr)) {
+        LOG_ERROR("SetThreadGroupAffinity failed: %lu", GetLastError());
+        return false;
+    }
+    return true;
+#elif defined(__APPLE__)
+    // no hard affinity on MacOs, threads with the same tag are kept on one L2 where possible
+    thread_affinity_policy_data_t policy = { cpus[0] + 1 };
+    kern_return_t kr = thread_policy_set(mach_thread_self(), THREAD_AFFINITY_POLICY, (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT);
+    return kr == KERN_SUCCESS;
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        LOG_ERROR("pthread_setaffinity_np failed: %s", strerror(err));
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool PlatformCommonUtils::set_current_thread_name(const std::string& name)
+{
+#if defined(_MSC_VER)
+    std::wstring wname(name.begin(), name.end());
+    return SUCCEEDED(SetThreadDescription(GetCurrentThread(), wname.c_str()));
+#elif defined(__APPLE__)
+    return pthread_setname_np(name.c_str()) == 0;
+#else
+    return pthread_setname_np(pthread_self(), name.substr(0, 15).c_str()) == 0;
+#endif
+}
+
+bool PlatformCommonUtils::set_current_thread_sched_class(ThreadSchedClass cls)
+{
+#if defined(_MSC_VER)
+    int priority = THREAD_PRIORITY_NORMAL;
+    switch (cls) {
+    case ThreadSchedClass::Normal: priority = THREAD_PRIORITY_NORMAL; break;
+    case ThreadSchedClass::Background: priority = THREAD_PRIORITY_BELOW_NORMAL; break;
+    case ThreadSchedClass::LatencyCritical: priority = THREAD_PRIORITY_ABOVE_NORMAL; break;
+    case ThreadSchedClass::Realtime: priority = THREAD_PRIORITY_TIME_CRITICAL; break;
+    }
+    return SetThreadPriority(GetCurrentThread(), priority) != FALSE;
+#elif defined(__APPLE__)
+    qos_class_t qos = QOS_CLASS_DEFAULT;
+    switch (cls) {
+    case ThreadSchedClass::Normal: qos = QOS_CLASS_DEFAULT; break;
+    case ThreadSchedClass::Background: qos = QOS_CLASS_UTILITY; break;
+    case ThreadSchedClass::LatencyCritical: qos = QOS_CLASS_USER_INTERACTIVE; break;
+    case ThreadSchedClass::Realtime: {
+        sched_param param = { sched_get_priority_max(SCHED_FIFO) };
+        return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+    }
+    }
+    return pthread_set_qos_class_self_np(qos, 0) == 0;
+#else
+    sched_param param = {};
+    int policy = SCHED_OTHER;
+    int nice = 0;
+    switch (cls) {
+    case ThreadSchedClass::Normal: break;
+    case ThreadSchedClass::Background: policy = SCHED_BATCH; nice = 10; break;
+    case ThreadSchedClass::LatencyCritical: nice = -5; break;
+    case ThreadSchedClass::Realtime: policy = SCHED_FIFO; param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 1; break;
+    }
+    int err = pthread_setschedparam(pthread_self(), policy, &param);
+    if (err != 0) {
+        LOG_ERROR("pthread_setschedparam failed: %s", strerror(err));
+        return false;
+    }
+    if (policy != SCHED_FIFO) {
+        // nice is per thread on Linux; lowering it needs CAP_SYS_NICE, keep going without
+        if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice) != 0 && nice >= 0) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+bool PlatformCommonUtils::apply_pin_policy(PinPolicy policy, size_t index, int node)
+{
+    if (policy == PinPolicy::None) {
+        return true;
+    }
+    std::vector<int> order = CpuTopology::shared().cpuOrder(policy, node);
+    if (order.empty()) {
+        return false;
+    }
+    return set_current_thread_affinity({ order[index % order.size()] });
+}
@@ -0,0 +1,108 @@
+/**
+ *   CPU topology, thread placement and thread control
+ *
+ *   Linux: /sys/devices/system/cpu and /sys/devices/system/node
+ *   MacOs: sysctl hw.*, one package and one NUMA node
+ *   Windows: GetLogicalProcessorInformationEx, cpu id = group * 64 + index
+ *
+ *   The thread helpers act on the calling thread, use them at the start of a
+ *   thread (CThread::setStartHook, ThreadPool placement) rather than from outside.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+struct CpuInfo
+{
+    int id = 0;         // logical cpu, the number used for pinning
+    int core = 0;       // physical core, unique across packages
+    int package = 0;
+    int node = 0;       // NUMA node
+    int smtIndex = 0;   // position among the hardware threads of its core
+};
+
+struct CacheInfo
+{
+    int level = 0;
+    char type = 'U';    // 'D'ata, 'I'nstruction, 'U'nified
+    uint64_t size = 0;
+    uint32_t lineSize = 0;
+    std::vector<int> cpus;  // logical cpus sharing this cache
+};
+
+enum class PinPolicy
+{
+    None,       // leave placement to the OS
+    Compact,    // fill a core's hardware threads, then the next core of the same node
+    Scatter,    // one thread per physical core across nodes first, SMT siblings last
+    Node,       // only the cpus of one NUMA node, compact inside it
+};
+
+enum class ThreadSchedClass
+{
+    Normal,
+    Background,         // bulk work, yields to everything else
+    LatencyCritical,    // socket readers, IPC pollers; best effort above normal
+    Realtime,           // fixed priority, usually needs privileges
+};
+
+class CpuTopology
+{
+public:
+    /** topology of this machine, loaded on first use */
+    static const CpuTopology& shared();
+
+    bool load();
+
+    const std::vector<CpuInfo>& cpus() const { return m_cpus; }
+    const std::vector<CacheInfo>& caches() const { return m_caches; }
+
+    size_t cpuCount() const { return m_cpus.size(); }
+    size_t coreCount() const { return m_coreCount; }
+    size_t packageCount() const { return m_packageCount; }
+    size_t nodeCount() const { return m_nodeCount; }
+
+    std::vector<int> cpusOfNode(int node) const;
+    std::vector<int> smtSiblings(int cpu) const;     // including cpu itself
+    const CpuInfo* findCpu(int cpu) const;
+
+    /** largest cache of a level visible to cpu, nullptr if unknown */
+    const CacheInfo* cacheOf(int cpu, int level) const;
+
+    /**
+     * @brief       Order in which threads should be placed, thread i goes to order[i % size]
+     * @param node  NUMA node for PinPolicy::Node
+     */
+    std::vector<int> cpuOrder(PinPolicy policy, int node = 0) const;
+
+private:
+    bool loadPlatform();
+    void finish();
+
+private:
+    std::vector<CpuInfo> m_cpus;    // sorted by id
+    std::vector<CacheInfo> m_caches;
+    size_t m_coreCount = 0;
+    size_t m_packageCount = 0;
+    size_t m_nodeCount = 0;
+};
+
+namespace PlatformCommonUtils
+{
+    /** pin the calling thread to a set of logical cpus, MacOs only records an affinity hint */
+    bool set_current_thread_affinity(const std::vector<int>& cpus);
+
+    /** visible in debuggers, top -H and crash reports; Linux truncates to 15 characters */
+    bool set_current_thread_name(const std::string& name);
+
+    bool set_current_thread_sched_class(ThreadSchedClass cls);
+
+    /** pin the calling thread as thread number index of a group placed with policy */
+    bool apply_pin_policy(PinPolicy policy, size_t index, int node = 0);
+};
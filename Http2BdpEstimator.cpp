@@ -0,0 +1,71 @@
+#include "Http2BdpEstimator.h"
+#include <algorithm>
+
+// a sample of at least 2/3 of the window means the window is the bottleneck
+static constexpr uint64_t FILL_NUM = 2;
+static constexpr uint64_t FILL_DEN = 3;
+// the window is grown to this many samples
+static constexpr uint64_t GROWTH = 2;
+
+Http2BdpEstimator::Http2BdpEstimator(uint32_t window, uint32_t limit):
+    m_window(window),
+    m_limit(limit)
+{
+}
+
+void Http2BdpEstimator::reset(uint32_t window, uint32_t limit)
+{
+    *this = Http2BdpEstimator(window, limit);
+}
+
+bool Http2BdpEstimator::onData(size_t bytes)
+{
+    if (!enabled()) {
+        return false;
+    }
+    m_sample += bytes;
+    if (m_sampling) {
+        return false;
+    }
+    // the bytes that trigger the ping belong to its round trip
+    m_sampling = true;
+    return true;
+}
+
+void Http2BdpEstimator::onPingSent(uint64_t nowNs)
+{
+    m_pingSentNs = std::max<uint64_t>(nowNs, 1);
+}
+
+uint32_t Http2BdpEstimator::onPingAck(uint64_t nowNs)
+{
+    if (m_pingSentNs == 0) {
+        return 0;
+    }
+    uint64_t rtt = std::max<uint64_t>(nowNs - m_pingSentNs, 1);
+    uint64_t sample = m_sample;
+    m_pingSentNs = 0;
+    m_sampling = false;
+    m_sample = 0;
+
+    // weighted towards the newest round trip, queues in the path change quickly
+    m_rttNs = m_rttNs == 0 ? rtt : (m_rttNs + rtt * 7) / 8;
+
+    uint64_t bandwidth = sample * 1000000000ull / m_rttNs;
+    if (bandwidth <= m_maxBandwidth) {
+        return 0;
+    }
+    m_maxBandwidth = bandwidth;
+    if (sample * FILL_DEN < (uint64_t)m_window * FILL_NUM) {
+        return 0;
+    }
+
+    uint64_t window = std::min<uint64_t>(sample * GROWTH, m_limit);
+    if (window <= m_window) {
+        return 0;
+    }
+    m_bdp = sample;
+    m_window = (uint32_t)window;
+    ++m_growths;
+    return m_window;
+}
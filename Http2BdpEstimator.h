@@ -0,0 +1,76 @@
+/**
+ *   Bandwidth-delay product estimator for Http 2.0 receive windows
+ *
+ *   The receiver sends a PING when DATA starts to arrive and counts the bytes
+ *   received until its ACK: that sample is what the link delivered in one
+ *   round trip. When a sample fills most of the current window the window is
+ *   what limits the transfer, so it is grown to twice the sample, up to a cap.
+ *   The window only grows while the measured bandwidth keeps rising, a sample
+ *   inflated by a burst after a stall does not grow it further.
+ *
+ *      if (estimator.onData(frame.length)) {
+ *          sendPing(BDP_OPAQUE);
+ *          estimator.onPingSent(TscClock::nowNs());
+ *      }
+ *      ...
+ *      if (uint32_t window = estimator.onPingAck(TscClock::nowNs())) {
+ *          // advertise window as SETTINGS_INITIAL_WINDOW_SIZE and the connection window
+ *      }
+ *
+ *   Not thread safe, Http2Connection drives it under its mutex.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class Http2BdpEstimator
+{
+public:
+    /**
+     * @param window  the receive window in use now
+     * @param limit   largest window it may grow to, 0 disables the estimator
+     */
+    Http2BdpEstimator(uint32_t window = 0, uint32_t limit = 0);
+
+    void reset(uint32_t window, uint32_t limit);
+    bool enabled() const { return m_limit > m_window; }
+
+    /**
+     * @brief  DATA of bytes arrived
+     * @return true if a BDP ping should be sent now; call onPingSent once it is queued
+     */
+    bool onData(size_t bytes);
+
+    void onPingSent(uint64_t nowNs);
+
+    /**
+     * @brief  The BDP ping was acknowledged
+     * @return the new receive window, 0 if it stays as it is
+     */
+    uint32_t onPingAck(uint64_t nowNs);
+
+    bool pingOutstanding() const { return m_pingSentNs != 0; }
+    uint32_t window() const { return m_window; }
+    uint64_t rttNs() const { return m_rttNs; }
+    uint64_t bdp() const { return m_bdp; }
+    uint64_t bandwidth() const { return m_maxBandwidth; }   // bytes per second
+    uint32_t growths() const { return m_growths; }
+
+private:
+    uint32_t m_window;
+    uint32_t m_limit;
+
+    bool m_sampling = false;        // a ping is wanted or in flight, bytes count towards m_sample
+    uint64_t m_sample = 0;
+    uint64_t m_pingSentNs = 0;
+
+    uint64_t m_rttNs = 0;           // smoothed
+    uint64_t m_bdp = 0;             // last sample that grew the window
+    uint64_t m_maxBandwidth = 0;
+    uint32_t m_growths = 0;
+};
@@ -0,0 +1,134 @@
+#include "Http2BufferPool.h"
+#include <bit>
+#include <new>
+#include <utility>
+
+/** Http2Buffer */
+Http2Buffer::Http2Buffer(Http2BufferPool* pool, uint8_t* data, size_t capacity, uint8_t sizeClass):
+    m_pool(pool),
+    m_data(data),
+    m_capacity(capacity),
+    m_sizeClass(sizeClass)
+{
+}
+
+Http2Buffer::Http2Buffer(Http2Buffer&& other) noexcept:
+    m_pool(std::exchange(other.m_pool, nullptr)),
+    m_data(std::exchange(other.m_data, nullptr)),
+    m_capacity(std::exchange(other.m_capacity, 0)),
+    m_sizeClass(other.m_sizeClass)
+{
+}
+
+Http2Buffer& Http2Buffer::operator=(Http2Buffer&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_pool = std::exchange(other.m_pool, nullptr);
+        m_data = std::exchange(other.m_data, nullptr);
+        m_capacity = std::exchange(other.m_capacity, 0);
+        m_sizeClass = other.m_sizeClass;
+    }
+    return *this;
+}
+
+void Http2Buffer::release()
+{
+    if (m_data != nullptr) {
+        m_pool->release(m_data, m_capacity, m_sizeClass);
+    }
+    m_pool = nullptr;
+    m_data = nullptr;
+    m_capacity = 0;
+}
+
+/** Http2BufferPool */
+Http2BufferPool::Http2BufferPool(size_t maxCachedBytes):
+    m_maxCachedBytes(maxCachedBytes)
+{
+}
+
+Http2BufferPool::~Http2BufferPool()
+{
+    trim();
+}
+
+Http2BufferPool& Http2BufferPool::shared()
+{
+    static Http2BufferPool pool;
+    return pool;
+}
+
+uint8_t Http2BufferPool::classOf(size_t size)
+{
+    if (size <= MIN_CLASS_SIZE) {
+        return 0;
+    }
+    size_t sizeClass = std::bit_width(size - 1) - std::bit_width(MIN_CLASS_SIZE - 1);
+    return sizeClass < CLASSES ? (uint8_t)sizeClass : UNPOOLED;
+}
+
+Http2Buffer Http2BufferPool::acquire(size_t size)
+{
+    m_acquired.fetch_add(1, std::memory_order_relaxed);
+    uint8_t sizeClass = classOf(size);
+    if (sizeClass == UNPOOLED) {
+        m_allocated.fetch_add(1, std::memory_order_relaxed);
+        return Http2Buffer(this, static_cast<uint8_t*>(::operator new(size)), size, UNPOOLED);
+    }
+
+    size_t capacity = classSize(sizeClass);
+    {
+        SizeClass& free = m_classes[sizeClass];
+        std::lock_guard<std::mutex> lock(free.mutex);
+        if (!free.free.empty()) {
+            uint8_t* data = free.free.back();
+            free.free.pop_back();
+            m_cachedBytes.fetch_sub(capacity, std::memory_order_relaxed);
+            m_reused.fetch_add(1, std::memory_order_relaxed);
+            return Http2Buffer(this, data, capacity, sizeClass);
+        }
+    }
+    m_allocated.fetch_add(1, std::memory_order_relaxed);
+    return Http2Buffer(this, static_cast<uint8_t*>(::operator new(capacity)), capacity, sizeClass);
+}
+
+void Http2BufferPool::release(uint8_t* data, size_t capacity, uint8_t sizeClass)
+{
+    if (sizeClass != UNPOOLED &&
+        m_cachedBytes.fetch_add(capacity, std::memory_order_relaxed) + capacity <= m_maxCachedBytes) {
+        SizeClass& free = m_classes[sizeClass];
+        std::lock_guard<std::mutex> lock(free.mutex);
+        free.free.push_back(data);
+        return;
+    }
+    if (sizeClass != UNPOOLED) {
+        m_cachedBytes.fetch_sub(capacity, std::memory_order_relaxed);
+    }
+    ::operator delete(data);
+}
+
+void Http2BufferPool::trim()
+{
+    for (uint8_t sizeClass = 0; sizeClass < CLASSES; ++sizeClass) {
+        std::vector<uint8_t*> idle;
+        {
+            std::lock_guard<std::mutex> lock(m_classes[sizeClass].mutex);
+            idle.swap(m_classes[sizeClass].free);
+        }
+        m_cachedBytes.fetch_sub(idle.size() * classSize(sizeClass), std::memory_order_relaxed);
+        for (uint8_t* data : idle) {
+            ::operator delete(data);
+        }
+    }
+}
+
+Http2BufferPoolStats Http2BufferPool::stats() const
+{
+    Http2BufferPoolStats stats;
+    stats.acquired = m_acquired.load(std::memory_order_relaxed);
+    stats.reused = m_reused.load(std::memory_order_relaxed);
+    stats.allocated = m_allocated.load(std::memory_order_relaxed);
+    stats.cachedBytes = m_cachedBytes.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,122 @@
+/**
+ *   Size-class buffer pool for the Http 2.0 frame path
+ *
+ *   Buffers come in power of two classes from 256 bytes to 32 MB, enough for
+ *   the largest frame SETTINGS_MAX_FRAME_SIZE allows. A released buffer goes
+ *   back to the free list of its class and the next request of that class
+ *   reuses it, so connections that come and go, and frames that are encoded
+ *   and decoded over and over, stop reaching the allocator once the pool is
+ *   warm. The pool keeps at most maxCachedBytes idle, the rest is freed.
+ *
+ *      Http2Buffer buffer = Http2BufferPool::shared().acquire(frameSize);
+ *      frame.serializeInto(buffer.data(), buffer.capacity());
+ *      // back in the pool when buffer goes out of scope
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <span>
+#include <stdint.h>
+#include <stddef.h>
+
+class Http2BufferPool;
+
+/**
+ * @brief A block from an Http2BufferPool, returned to it on destruction. Move only
+ */
+class Http2Buffer
+{
+public:
+    Http2Buffer() = default;
+    ~Http2Buffer() { release(); }
+
+    Http2Buffer(Http2Buffer&& other) noexcept;
+    Http2Buffer& operator=(Http2Buffer&& other) noexcept;
+    Http2Buffer(const Http2Buffer&) = delete;
+    Http2Buffer& operator=(const Http2Buffer&) = delete;
+
+    uint8_t* data() { return m_data; }
+    const uint8_t* data() const { return m_data; }
+
+    /** usable bytes, at least what was asked for */
+    size_t capacity() const { return m_capacity; }
+
+    std::span<uint8_t> span() { return { m_data, m_capacity }; }
+    explicit operator bool() const { return m_data != nullptr; }
+
+    /** give the block back to its pool now */
+    void release();
+
+private:
+    friend class Http2BufferPool;
+    Http2Buffer(Http2BufferPool* pool, uint8_t* data, size_t capacity, uint8_t sizeClass);
+
+private:
+    Http2BufferPool* m_pool = nullptr;
+    uint8_t* m_data = nullptr;
+    size_t m_capacity = 0;
+    uint8_t m_sizeClass = 0;
+};
+
+struct Http2BufferPoolStats
+{
+    uint64_t acquired = 0;
+    uint64_t reused = 0;        // served from a free list
+    uint64_t allocated = 0;     // had to reach the allocator
+    size_t cachedBytes = 0;     // idle in the free lists now
+};
+
+class Http2BufferPool
+{
+public:
+    static constexpr size_t MIN_CLASS_SIZE = 256;
+    static constexpr size_t CLASSES = 18;      // up to 32 MB, a 16 MB frame and its head fit
+    static constexpr uint8_t UNPOOLED = 0xFF;   // larger than the largest class, allocated as asked
+
+    /**
+     * @param maxCachedBytes  idle bytes kept for reuse, buffers released above this are freed
+     */
+    explicit Http2BufferPool(size_t maxCachedBytes = 64 << 20);
+    ~Http2BufferPool();
+
+    Http2BufferPool(const Http2BufferPool&) = delete;
+    Http2BufferPool& operator=(const Http2BufferPool&) = delete;
+
+    /** process wide pool */
+    static Http2BufferPool& shared();
+
+    /** a buffer of at least size bytes, the capacity is rounded up to its class */
+    Http2Buffer acquire(size_t size);
+
+    /** free every idle buffer */
+    void trim();
+
+    Http2BufferPoolStats stats() const;
+
+private:
+    friend class Http2Buffer;
+    void release(uint8_t* data, size_t capacity, uint8_t sizeClass);
+
+    static uint8_t classOf(size_t size);
+    static size_t classSize(uint8_t sizeClass) { return MIN_CLASS_SIZE << sizeClass; }
+
+private:
+    struct SizeClass
+    {
+        std::mutex mutex;
+        std::vector<uint8_t*> free;
+    };
+
+    size_t m_maxCachedBytes;
+    SizeClass m_classes[CLASSES];
+    std::atomic<size_t> m_cachedBytes{ 0 };
+    std::atomic<uint64_t> m_acquired{ 0 };
+    std::atomic<uint64_t> m_reused{ 0 };
+    std::atomic<uint64_t> m_allocated{ 0 };
+};
@@ -0,0 +1,1309 @@
+#include "Http2Connection.h"
+#include "PlatformCommonUtils.h"
+#include "PlatformClock.h"
+#include "CpuTopology.h"
+#include "ThreadTelemetry.h"
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+// CONTINUATION flood guard, a header block larger than this is refused
+static constexpr size_t MAX_HEADER_BLOCK = 1 << 20;
+// bound on the HPACK table we keep for the peer's decoder
+static constexpr uint32_t MAX_ENCODER_TABLE = 64 * 1024;
+static constexpr size_t READ_CHUNK = 64 * 1024;
+// PRIORITY_UPDATEs kept for streams the client has not opened yet
+static constexpr size_t MAX_EARLY_PRIORITIES = 64;
+// opaque of the PING that measures the bandwidth-delay product, ping() counts up from 1
+static constexpr uint64_t BDP_PING_OPAQUE = 0x6264702d70696e67;    // "bdp-ping"
+
+static inline uint64_t read_u64(const uint8_t* in)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+Http2Connection::Http2Connection(IEasySocket& socket, Http2Role role, IHttp2ConnectionListener* listener,
+    const Http2Settings& settings, const Http2WriterOptions& writerOptions):
+    m_socket(socket),
+    m_role(role),
+    m_listener(listener),
+    m_localSettings(settings),
+    m_nextStreamId(role == Http2Role::Client ? 1 : 2),
+    m_scheduler(settings.priorityMode),
+    m_writer(socket, writerOptions, &m_arena),
+    m_decoder(HTTP2_DEFAULT_MAX_FRAME_SIZE, &m_arena),
+    m_hpackDecoder(HPACK_DEFAULT_TABLE_SIZE)
+{
+    m_localSettings.maxFrameSize = std::clamp(m_localSettings.maxFrameSize, HTTP2_DEFAULT_MAX_FRAME_SIZE, HTTP2_MAX_FRAME_SIZE_LIMIT);
+    m_localSettings.initialWindowSize = std::min(m_localSettings.initialWindowSize, HTTP2_MAX_WINDOW_SIZE);
+    m_localSettings.connectionWindowSize = std::clamp(m_localSettings.connectionWindowSize, HTTP2_DEFAULT_WINDOW_SIZE, HTTP2_MAX_WINDOW_SIZE);
+    m_localSettings.autoWindowLimit = std::min(m_localSettings.autoWindowLimit, HTTP2_MAX_WINDOW_SIZE);
+    m_bdp.reset(m_localSettings.initialWindowSize, m_localSettings.autoWindowLimit);
+    if (m_role == Http2Role::Server) {
+        m_localSettings.enablePush = false;
+    }
+}
+
+Http2Connection::~Http2Connection()
+{
+    close();
+}
+
+bool Http2Connection::start()
+{
+    if (m_started.exchange(true)) {
+        LOG_ERROR("Http2Connection: already started");
+        return false;
+    }
+
+    applyDecoderLimits();
+
+    Http2SettingsFrame::SettingsMap settings;
+    settings[Http2SettingsFrame::HEADER_TABLE_SIZE] = m_localSettings.headerTableSize;
+    if (m_role == Http2Role::Client) {
+        settings[Http2SettingsFrame::ENABLE_PUSH] = m_localSettings.enablePush ? 1 : 0;
+    }
+    settings[Http2SettingsFrame::MAX_CONCURRENT_STREAMS] = m_localSettings.maxConcurrentStreams;
+    settings[Http2SettingsFrame::INITIAL_WINDOW_SIZE] = m_localSettings.initialWindowSize;
+    settings[Http2SettingsFrame::MAX_FRAME_SIZE] = m_localSettings.maxFrameSize;
+    if (m_localSettings.maxHeaderListSize != 0) {
+        settings[Http2SettingsFrame::MAX_HEADER_LIST_SIZE] = m_localSettings.maxHeaderListSize;
+    }
+    if (m_localSettings.priorityMode == Http2PriorityMode::Extensible) {
+        settings[Http2SettingsFrame::NO_RFC7540_PRIORITIES] = 1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_advertised = m_localSettings;
+        m_settingsInFlight.push_back(m_advertised);
+    }
+
+    m_writer.setWrittenHook([this](uint64_t ticket) { onWritten(ticket); });
+    if (!m_writer.start()) {
+        m_closed = true;
+        return false;
+    }
+    if (m_role == Http2Role::Client) {
+        m_writer.enqueueRaw(HTTP2_MAGIC.data(), HTTP2_MAGIC.size());
+    }
+    Http2SettingsFrame frame(0, 0, settings);
+    writeFrame(frame);
+    if (m_localSettings.connectionWindowSize > HTTP2_DEFAULT_WINDOW_SIZE) {
+        m_writer.windowUpdate(0, m_localSettings.connectionWindowSize - HTTP2_DEFAULT_WINDOW_SIZE);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connRecvWindow = m_localSettings.connectionWindowSize;
+    }
+
+    m_reader.setStartHook([] {
+        PlatformCommonUtils::set_current_thread_name("h2-reader");
+        ThreadTelemetry::shared().attach("h2-reader");
+    });
+    if (!m_reader.run([this] { readLoop(); })) {
+        LOG_ERROR("Http2Connection: failed to start the reader thread");
+        m_closed = true;
+        return false;
+    }
+    return true;
+}
+
+void Http2Connection::close(Http2ErrorCode error, const std::string& debugData)
+{
+    if (!m_started) {
+        m_closed = true;
+        return;
+    }
+    if (!m_goAwaySent.exchange(true) && !m_closed) {
+        uint32_t lastStreamId = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            lastStreamId = m_lastPeerStreamId;
+        }
+        Http2GoAwayFrame frame(lastStreamId, error, debugData);
+        writeFrame(frame);
+    }
+    if (!m_closed.exchange(true)) {
+        m_closeError = error;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cond.notify_all();
+    }
+    // GOAWAY and whatever is queued go out before the socket is shut down
+    m_writer.stop(true);
+    m_socket.interrupt();
+    if (m_readerThreadId.load() != PlatformCommonUtils::get_current_thread_id()) {
+        m_reader.join();
+    }
+}
+
+bool Http2Connection::goAway(Http2ErrorCode error, const std::string& debugData)
+{
+    if (!m_started || m_closed || m_goAwaySent.exchange(true)) {
+        return false;
+    }
+    uint32_t lastStreamId = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        lastStreamId = m_lastPeerStreamId;
+    }
+    Http2GoAwayFrame frame(lastStreamId, error, debugData);
+    return writeFrame(frame);
+}
+
+bool Http2Connection::updateSettings(const Http2Settings& settings)
+{
+    Http2Settings wanted = settings;
+    wanted.maxFrameSize = std::clamp(wanted.maxFrameSize, HTTP2_DEFAULT_MAX_FRAME_SIZE, HTTP2_MAX_FRAME_SIZE_LIMIT);
+    wanted.initialWindowSize = std::min(wanted.initialWindowSize, HTTP2_MAX_WINDOW_SIZE);
+    wanted.connectionWindowSize = std::min(wanted.connectionWindowSize, HTTP2_MAX_WINDOW_SIZE);
+    if (m_role == Http2Role::Server) {
+        wanted.enablePush = false;
+    }
+
+    // SETTINGS must reach the peer in the order they were queued in m_settingsInFlight
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    Http2SettingsFrame::SettingsMap changes;
+    uint32_t connectionIncrement = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_started || m_closed) {
+            return false;
+        }
+        changes = advertiseLocked(wanted);
+
+        // looser limits now, stricter ones when the ACK comes back
+        raiseInitialWindowLocked(wanted.initialWindowSize);
+        m_localSettings.maxFrameSize = std::max(m_localSettings.maxFrameSize, wanted.maxFrameSize);
+        m_localSettings.headerTableSize = std::max(m_localSettings.headerTableSize, wanted.headerTableSize);
+        if (m_localSettings.maxHeaderListSize != 0) {
+            m_localSettings.maxHeaderListSize = wanted.maxHeaderListSize == 0 ? 0 : std::max(m_localSettings.maxHeaderListSize, wanted.maxHeaderListSize);
+        }
+        // streams over a lowered limit are refused from now on, which RFC 9113 5.1.2 allows
+        m_localSettings.maxConcurrentStreams = wanted.maxConcurrentStreams;
+        m_localSettings.enablePush = wanted.enablePush;
+
+        if (wanted.connectionWindowSize > m_localSettings.connectionWindowSize) {
+            connectionIncrement = wanted.connectionWindowSize - m_localSettings.connectionWindowSize;
+            m_localSettings.connectionWindowSize = wanted.connectionWindowSize;
+            m_connRecvWindow += connectionIncrement;
+        }
+        m_limitsChanged = true;
+    }
+    if (!changes.empty()) {
+        Http2SettingsFrame frame(0, 0, changes);
+        writeFrame(frame);
+    }
+    m_writer.windowUpdate(0, connectionIncrement);
+    return true;
+}
+
+Http2SettingsFrame::SettingsMap Http2Connection::advertiseLocked(const Http2Settings& settings)
+{
+    Http2SettingsFrame::SettingsMap changes;
+    if (settings.headerTableSize != m_advertised.headerTableSize) {
+        changes[Http2SettingsFrame::HEADER_TABLE_SIZE] = settings.headerTableSize;
+    }
+    if (m_role == Http2Role::Client && settings.enablePush != m_advertised.enablePush) {
+        changes[Http2SettingsFrame::ENABLE_PUSH] = settings.enablePush ? 1 : 0;
+    }
+    if (settings.maxConcurrentStreams != m_advertised.maxConcurrentStreams) {
+        changes[Http2SettingsFrame::MAX_CONCURRENT_STREAMS] = settings.maxConcurrentStreams;
+    }
+    if (settings.initialWindowSize != m_advertised.initialWindowSize) {
+        changes[Http2SettingsFrame::INITIAL_WINDOW_SIZE] = settings.initialWindowSize;
+    }
+    if (settings.maxFrameSize != m_advertised.maxFrameSize) {
+        changes[Http2SettingsFrame::MAX_FRAME_SIZE] = settings.maxFrameSize;
+    }
+    // an unlimited list size cannot be advertised once a limit was, the largest value stands for it
+    if (settings.maxHeaderListSize != m_advertised.maxHeaderListSize) {
+        changes[Http2SettingsFrame::MAX_HEADER_LIST_SIZE] = settings.maxHeaderListSize == 0 ? 0xFFFFFFFF : settings.maxHeaderListSize;
+    }
+    if (changes.empty()) {
+        return changes;
+    }
+    m_advertised.headerTableSize = settings.headerTableSize;
+    m_advertised.enablePush = settings.enablePush;
+    m_advertised.maxConcurrentStreams = settings.maxConcurrentStreams;
+    m_advertised.initialWindowSize = settings.initialWindowSize;
+    m_advertised.maxFrameSize = settings.maxFrameSize;
+    m_advertised.maxHeaderListSize = settings.maxHeaderListSize;
+    m_settingsInFlight.push_back(m_advertised);
+    return changes;
+}
+
+void Http2Connection::applyDecoderLimits()
+{
+    Http2Settings limits;
+    bool acked = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        limits = m_localSettings;
+        acked = m_localSettingsAcked;
+    }
+    // until our first SETTINGS are acknowledged the peer may still use the defaults
+    m_decoder.setMaxFrameSize(limits.maxFrameSize);
+    m_hpackDecoder.setMaxTableSize(acked ? limits.headerTableSize : std::max(limits.headerTableSize, HPACK_DEFAULT_TABLE_SIZE));
+    m_hpackDecoder.setMaxHeaderListSize(limits.maxHeaderListSize);
+}
+
+/** writing */
+bool Http2Connection::writeFrame(Http2Frame& frame)
+{
+    return m_writer.enqueue(frame) != 0;
+}
+
+bool Http2Connection::writeHeadersLocked(uint32_t streamId, const Http2HeaderList& headers, bool endStream, uint16_t weight)
+{
+    uint32_t maxFrameSize = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        maxFrameSize = m_peerSettings.maxFrameSize;
+    }
+    m_headerBlock.clear();
+    m_encoder.encode(headers, m_headerBlock);
+
+    // HEADERS and its CONTINUATIONs are queued as one piece, no other frame may come between them
+    m_headerFrames.clear();
+    std::span<const uint8_t> block(m_headerBlock);
+    size_t first = std::min<size_t>(block.size(), maxFrameSize);
+    uint8_t flags = endStream ? Http2HeadersFrame::END_STREAM : 0;
+    if (first == block.size()) {
+        flags |= Http2HeadersFrame::END_HEADERS;
+    }
+    if (weight != 0) {
+        flags |= Http2HeadersFrame::PRIORITY;
+    }
+    Http2HeadersFrame frame(streamId, block.first(first), (Http2HeadersFrame::Flags)flags, 0, 0, (uint8_t)(weight - 1));
+    frame.serializeInto(m_headerFrames);
+    block = block.subspan(first);
+    while (!block.empty()) {
+        size_t size = std::min<size_t>(block.size(), maxFrameSize);
+        Http2ContinuationFrame continuation(streamId, block.first(size), size == block.size());
+        continuation.serializeInto(m_headerFrames);
+        block = block.subspan(size);
+    }
+    return m_writer.enqueueRaw(m_headerFrames.data(), m_headerFrames.size()) != 0;
+}
+
+/** streams */
+std::optional<uint32_t> Http2Connection::openStream(const Http2HeaderList& headers, bool endStream, const Http2Priority& priority,
+    const std::function<void(uint32_t)>& onOpen)
+{
+    if (m_role != Http2Role::Client) {
+        LOG_ERROR("Http2Connection: only clients open streams");
+        return std::nullopt;
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [&] {
+            return m_closed || m_goAwayReceived || m_localActive < m_peerSettings.maxConcurrentStreams;
+        });
+        if (m_closed || m_goAwayReceived) {
+            return std::nullopt;
+        }
+        ++m_localActive;    // the slot is held until the stream is removed
+    }
+
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    uint32_t streamId = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_nextStreamId > HTTP2_MAX_WINDOW_SIZE || m_closed) {
+            --m_localActive;
+            m_cond.notify_all();
+            if (!m_closed) {
+                LOG_ERROR("Http2Connection: stream ids exhausted, open a new connection");
+            }
+            return std::nullopt;
+        }
+        streamId = m_nextStreamId;
+        m_nextStreamId += 2;
+        auto stream = std::make_unique<Stream>();
+        stream->id = streamId;
+        stream->local = true;
+        stream->state = endStream ? Http2StreamState::HalfClosedLocal : Http2StreamState::Open;
+        stream->sendWindow = m_peerSettings.initialWindowSize;
+        stream->recvWindow = m_localSettingsAcked ? m_localSettings.initialWindowSize
+                                                  : std::max(m_localSettings.initialWindowSize, HTTP2_DEFAULT_WINDOW_SIZE);
+        m_streams.emplace(streamId, std::move(stream));
+        m_scheduler.add(streamId, priority);
+    }
+    if (onOpen) {
+        onOpen(streamId);
+    }
+
+    bool written = false;
+    if (m_localSettings.priorityMode == Http2PriorityMode::Weighted) {
+        written = writeHeadersLocked(streamId, headers, endStream, priority.weight == Http2Priority::DEFAULT_WEIGHT ? 0 : priority.weight);
+    }
+    else if (!priority.isDefault()) {
+        Http2HeaderList withPriority(headers);
+        withPriority.emplace_back("priority", priority.toString());
+        written = writeHeadersLocked(streamId, withPriority, endStream);
+    }
+    else {
+        written = writeHeadersLocked(streamId, headers, endStream);
+    }
+    if (!written) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        removeStreamLocked(streamId);
+        return std::nullopt;
+    }
+    return streamId;
+}
+
+bool Http2Connection::sendHeaders(uint32_t streamId, const Http2HeaderList& headers, bool endStream)
+{
+    bool closed = false;
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_streams.find(streamId);
+        if (m_closed || it == m_streams.end() ||
+            (it->second->state != Http2StreamState::Open && it->second->state != Http2StreamState::HalfClosedRemote)) {
+            return false;
+        }
+        if (endStream) {
+            closed = endStreamLocked(*it->second, true);
+        }
+    }
+    bool written = writeHeadersLocked(streamId, headers, endStream);
+    if (closed) {
+        notifyClosed(streamId, Http2ErrorCode::NoError);
+    }
+    return written;
+}
+
+bool Http2Connection::sendData(uint32_t streamId, std::span<const uint8_t> data, bool endStream)
+{
+    size_t maxQueued = std::max<size_t>(m_writer.options().maxQueuedData, 1);
+    size_t offset = 0;
+    uint64_t ticket = 0;
+    do {
+        size_t chunk = 0;
+        bool last = false;
+        bool closed = false;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            Stream* stream = nullptr;
+            auto it = m_streams.find(streamId);
+            if (it != m_streams.end() && offset < data.size()) {
+                it->second->sending = true;
+                updateReadyLocked(*it->second);
+            }
+            // the writer queue is kept short so a more urgent stream never waits behind much bulk DATA
+            m_cond.wait(lock, [&] {
+                if (m_closed) {
+                    return true;
+                }
+                auto it = m_streams.find(streamId);
+                stream = it == m_streams.end() ? nullptr : it->second.get();
+                if (stream == nullptr || offset == data.size()) {
+                    return true;
+                }
+                return m_connSendWindow > 0 && stream->sendWindow > 0 && m_dataQueued < maxQueued &&
+                    m_scheduler.next() == streamId;
+            });
+            if (m_closed || stream == nullptr ||
+                (stream->state != Http2StreamState::Open && stream->state != Http2StreamState::HalfClosedRemote)) {
+                if (stream != nullptr) {
+                    stream->sending = false;
+                    updateReadyLocked(*stream);
+                    m_cond.notify_all();
+                }
+                lock.unlock();
+                // frames already queued reference data, which the caller may free once we return
+                if (ticket != 0) {
+                    m_writer.waitWritten(ticket);
+                }
+                return false;
+            }
+            chunk = std::min<size_t>(data.size() - offset, m_peerSettings.maxFrameSize);
+            if (chunk > 0) {
+                chunk = (size_t)std::min<int64_t>((int64_t)chunk, std::min(m_connSendWindow, stream->sendWindow));
+                m_connSendWindow -= chunk;
+                stream->sendWindow -= chunk;
+                m_dataQueued += chunk;
+                m_scheduler.sent(streamId, chunk);
+            }
+            stream->sending = offset + chunk < data.size();
+            updateReadyLocked(*stream);
+            m_cond.notify_all();
+            last = endStream && offset + chunk == data.size();
+            if (last) {
+                closed = endStreamLocked(*stream, true);
+            }
+        }
+
+        // the payload is referenced, not copied, until the writer has sent it and recycles the frame
+        auto frame = m_arena.dataFrame(streamId, data.subspan(offset, chunk));
+        frame->setEndStream(last);
+        uint64_t queued = m_writer.enqueue(std::move(frame));
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (queued == 0 || queued <= m_lastWritten) {
+                m_dataQueued -= chunk;
+                m_cond.notify_all();
+            }
+            else if (chunk > 0) {
+                m_dataInFlight.push_back({ queued, chunk });
+            }
+        }
+        if (queued == 0) {
+            if (ticket != 0) {
+                m_writer.waitWritten(ticket);
+            }
+            return false;
+        }
+        ticket = queued;
+        offset += chunk;
+        if (closed) {
+            notifyClosed(streamId, Http2ErrorCode::NoError);
+        }
+    } while (offset < data.size());
+    return m_writer.waitWritten(ticket);
+}
+
+bool Http2Connection::resetStream(uint32_t streamId, Http2ErrorCode error)
+{
+    bool removed = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        removed = removeStreamLocked(streamId);
+    }
+    if (!removed) {
+        return false;
+    }
+    Http2RstStreamFrame frame(streamId, error);
+    writeFrame(frame);
+    notifyClosed(streamId, error);
+    return true;
+}
+
+std::optional<uint64_t> Http2Connection::ping(uint32_t timeoutMs)
+{
+    uint64_t opaque = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_closed) {
+            return std::nullopt;
+        }
+        opaque = ++m_pingSeq;
+        m_pings[opaque] = TscClock::nowNs();
+    }
+    Http2PingFrame frame(opaque);
+    if (!writeFrame(frame)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pings.erase(opaque);
+        return std::nullopt;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] {
+        return m_closed || m_pingRtts.count(opaque) != 0;
+    });
+    m_pings.erase(opaque);
+    auto it = m_pingRtts.find(opaque);
+    if (it == m_pingRtts.end()) {
+        return std::nullopt;
+    }
+    uint64_t rtt = it->second;
+    m_pingRtts.erase(it);
+    return rtt;
+}
+
+bool Http2Connection::setStreamPriority(uint32_t streamId, const Http2Priority& priority)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_closed || !m_scheduler.update(streamId, priority)) {
+            return false;
+        }
+        m_cond.notify_all();
+    }
+    if (m_role == Http2Role::Client && m_localSettings.priorityMode == Http2PriorityMode::Extensible) {
+        Http2PriorityUpdateFrame frame(streamId, priority.toString());
+        writeFrame(frame);
+    }
+    return true;
+}
+
+std::optional<Http2Priority> Http2Connection::streamPriority(uint32_t streamId) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_scheduler.priority(streamId);
+}
+
+Http2StreamState Http2Connection::streamState(uint32_t streamId) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_streams.find(streamId);
+    if (it != m_streams.end()) {
+        return it->second->state;
+    }
+    bool used = isLocalStream(streamId) ? streamId < m_nextStreamId : streamId <= m_lastPeerStreamId;
+    return used ? Http2StreamState::Closed : Http2StreamState::Idle;
+}
+
+size_t Http2Connection::activeStreams() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_streams.size();
+}
+
+Http2Settings Http2Connection::peerSettings() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_peerSettings;
+}
+
+Http2Settings Http2Connection::localSettings() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_localSettings;
+}
+
+Http2FlowStats Http2Connection::flowStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Http2FlowStats stats;
+    stats.initialWindowSize = m_localSettings.initialWindowSize;
+    stats.connectionWindowSize = m_localSettings.connectionWindowSize;
+    stats.rttNs = m_bdp.rttNs();
+    stats.bandwidth = m_bdp.bandwidth();
+    stats.bdp = m_bdp.bdp();
+    stats.growths = m_bdp.growths();
+    return stats;
+}
+
+bool Http2Connection::endStreamLocked(Stream& stream, bool local)
+{
+    switch (stream.state) {
+    case Http2StreamState::Open:
+        stream.state = local ? Http2StreamState::HalfClosedLocal : Http2StreamState::HalfClosedRemote;
+        return false;
+
+    case Http2StreamState::HalfClosedLocal:
+    case Http2StreamState::HalfClosedRemote:
+        if ((stream.state == Http2StreamState::HalfClosedLocal) != local) {
+            stream.state = Http2StreamState::Closed;
+            return removeStreamLocked(stream.id);
+        }
+        return false;
+
+    default:
+        return false;
+    }
+}
+
+bool Http2Connection::removeStreamLocked(uint32_t streamId)
+{
+    auto it = m_streams.find(streamId);
+    if (it == m_streams.end()) {
+        return false;
+    }
+    if (it->second->local) {
+        --m_localActive;
+    }
+    else {
+        --m_peerActive;
+    }
+    m_scheduler.remove(streamId);
+    m_streams.erase(it);
+    m_cond.notify_all();
+    return true;
+}
+
+void Http2Connection::notifyClosed(uint32_t streamId, Http2ErrorCode error)
+{
+    if (m_listener != nullptr) {
+        m_listener->onStreamClosed(streamId, error);
+    }
+}
+
+void Http2Connection::updateReadyLocked(Stream& stream)
+{
+    m_scheduler.setReady(stream.id, stream.sending && stream.sendWindow > 0);
+}
+
+void Http2Connection::onWritten(uint64_t ticket)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lastWritten = ticket;
+    size_t before = m_dataQueued;
+    // tickets are pushed after enqueue returns, so they are only nearly in order
+    auto written = std::remove_if(m_dataInFlight.begin(), m_dataInFlight.end(), [&](const std::pair<uint64_t, size_t>& entry) {
+        if (entry.first > ticket) {
+            return false;
+        }
+        m_dataQueued -= entry.second;
+        return true;
+    });
+    m_dataInFlight.erase(written, m_dataInFlight.end());
+    if (m_dataQueued != before) {
+        m_cond.notify_all();
+    }
+}
+
+/** reading */
+void Http2Connection::readLoop()
+{
+    m_readerThreadId = PlatformCommonUtils::get_current_thread_id();
+    Http2Buffer buffer = m_arena.buffer(READ_CHUNK);
+    while (!m_closed) {
+        std::optional<int> received = m_socket.recvRaw((char*)buffer.data(), (int)buffer.capacity());
+        if (!received) {
+            if (m_socket.recvTimedOut()) {
+                continue;
+            }
+            break;
+        }
+        const uint8_t* data = buffer.data();
+        size_t size = (size_t)*received;
+
+        if (m_role == Http2Role::Server && m_prefaceReceived < HTTP2_MAGIC.size()) {
+            size_t take = std::min(size, HTTP2_MAGIC.size() - m_prefaceReceived);
+            if (memcmp(data, HTTP2_MAGIC.data() + m_prefaceReceived, take) != 0) {
+                connectionError(Http2ErrorCode::ProtocolError, "bad connection preface");
+                break;
+            }
+            m_prefaceReceived += take;
+            data += take;
+            size -= take;
+        }
+
+        if (m_limitsChanged.exchange(false)) {
+            applyDecoderLimits();
+        }
+        m_decoder.feed(data, size);
+        Http2FrameView frame;
+        Http2FrameDecoder::Status status;
+        while ((status = m_decoder.next(frame)) == Http2FrameDecoder::Frame) {
+            if (!handleFrame(frame)) {
+                break;
+            }
+        }
+        if (status == Http2FrameDecoder::Error) {
+            connectionError(m_decoder.error(), m_decoder.errorMessage());
+        }
+    }
+
+    // whatever is still open will not complete
+    if (!m_closed.exchange(true) && m_writer.failed()) {
+        m_closeError = Http2ErrorCode::InternalError;
+    }
+    std::vector<uint32_t> orphans;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& entry : m_streams) {
+            orphans.push_back(entry.first);
+        }
+        m_streams.clear();
+        m_scheduler.clear();
+        m_localActive = 0;
+        m_peerActive = 0;
+        m_cond.notify_all();
+    }
+    Http2ErrorCode error = m_closeError.load();
+    for (uint32_t streamId : orphans) {
+        notifyClosed(streamId, error == Http2ErrorCode::NoError ? Http2ErrorCode::Cancel : error);
+    }
+    if (m_listener != nullptr) {
+        m_listener->onConnectionClosed(error);
+    }
+}
+
+bool Http2Connection::handleFrame(const Http2FrameView& frame)
+{
+    if (!m_peerSettingsReceived) {
+        if (!frame.is(Http2FrameType::Settings) || frame.hasFlag(Http2FrameView::FLAG_ACK)) {
+            return connectionError(Http2ErrorCode::ProtocolError, "preface must start with SETTINGS");
+        }
+        m_peerSettingsReceived = true;
+    }
+
+    switch (frame.frameType()) {
+    case Http2FrameType::Data:
+        return handleData(frame);
+
+    case Http2FrameType::Headers:
+        m_inBlock.assign(frame.data.begin(), frame.data.end());
+        m_inBlockStream = frame.streamId;
+        m_inBlockEndStream = frame.hasFlag(Http2FrameView::FLAG_END_STREAM);
+        m_inBlockWeight = frame.hasPriority ? (uint16_t)(frame.weight + 1) : 0;
+        if (frame.hasFlag(Http2FrameView::FLAG_END_HEADERS)) {
+            return handleHeaderBlock(m_inBlockStream, m_inBlockEndStream);
+        }
+        return true;
+
+    case Http2FrameType::Continuation:
+        if (m_inBlock.size() + frame.data.size() > MAX_HEADER_BLOCK) {
+            return connectionError(Http2ErrorCode::EnhanceYourCalm, "header block too large");
+        }
+        m_inBlock.insert(m_inBlock.end(), frame.data.begin(), frame.data.end());
+        if (frame.hasFlag(Http2FrameView::FLAG_END_HEADERS)) {
+            return handleHeaderBlock(m_inBlockStream, m_inBlockEndStream);
+        }
+        return true;
+
+    case Http2FrameType::RstStream:
+        return handleRstStream(frame);
+
+    case Http2FrameType::Settings:
+        return handleSettings(frame);
+
+    case Http2FrameType::PushPromise:
+        return connectionError(Http2ErrorCode::ProtocolError, "PUSH_PROMISE with push disabled");
+
+    case Http2FrameType::Ping:
+        return handlePing(frame);
+
+    case Http2FrameType::GoAway:
+        handleGoAway(frame);
+        return true;
+
+    case Http2FrameType::WindowUpdate:
+        return handleWindowUpdate(frame);
+
+    case Http2FrameType::Priority:
+        return handlePriority(frame);
+
+    case Http2FrameType::PriorityUpdate:
+        return handlePriorityUpdate(frame);
+
+    default:
+        // unknown types are ignored
+        return true;
+    }
+}
+
+bool Http2Connection::handleHeaderBlock(uint32_t streamId, bool endStream)
+{
+    // decode even for streams we drop, the HPACK table must stay in step with the peer
+    Http2HeaderList headers;
+    bool decoded = m_hpackDecoder.decode(m_inBlock.data(), m_inBlock.size(), headers);
+    m_inBlockStream = 0;
+    if (!decoded) {
+        return connectionError(Http2ErrorCode::CompressionError, "HPACK decoding failed");
+    }
+
+    bool closed = false;
+    Http2ErrorCode refuse = Http2ErrorCode::NoError;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_streams.find(streamId);
+        if (it != m_streams.end()) {
+            Stream& stream = *it->second;
+            if (stream.state != Http2StreamState::Open && stream.state != Http2StreamState::HalfClosedLocal) {
+                refuse = Http2ErrorCode::StreamClosed;
+            }
+            else if (endStream) {
+                closed = endStreamLocked(stream, false);
+            }
+        }
+        else if (isLocalStream(streamId)) {
+            if (streamId >= m_nextStreamId) {
+                return connectionError(Http2ErrorCode::ProtocolError, "HEADERS on an idle stream");
+            }
+            return true;    // we reset it, late frames are dropped
+        }
+        else {
+            if (m_role == Http2Role::Client) {
+                return connectionError(Http2ErrorCode::ProtocolError, "server opened a stream");
+            }
+            if (streamId <= m_lastPeerStreamId) {
+                refuse = Http2ErrorCode::StreamClosed;
+            }
+            else {
+                m_lastPeerStreamId = streamId;
+                if (m_goAwaySent || m_peerActive >= m_localSettings.maxConcurrentStreams) {
+                    refuse = Http2ErrorCode::RefusedStream;
+                }
+                else {
+                    auto stream = std::make_unique<Stream>();
+                    stream->id = streamId;
+                    stream->state = endStream ? Http2StreamState::HalfClosedRemote : Http2StreamState::Open;
+                    stream->sendWindow = m_peerSettings.initialWindowSize;
+                    stream->recvWindow = m_localSettingsAcked ? m_localSettings.initialWindowSize
+                                                              : std::max(m_localSettings.initialWindowSize, HTTP2_DEFAULT_WINDOW_SIZE);
+                    m_streams.emplace(streamId, std::move(stream));
+                    ++m_peerActive;
+                    m_scheduler.add(streamId, requestPriority(headers, streamId));
+                }
+            }
+        }
+    }
+    if (refuse != Http2ErrorCode::NoError) {
+        streamError(streamId, refuse);
+        return true;
+    }
+    if (m_listener != nullptr) {
+        m_listener->onHeaders(streamId, headers, endStream);
+    }
+    if (closed) {
+        notifyClosed(streamId, Http2ErrorCode::NoError);
+    }
+    return true;
+}
+
+Http2Priority Http2Connection::requestPriority(const Http2HeaderList& headers, uint32_t streamId)
+{
+    Http2Priority priority;
+    if (m_localSettings.priorityMode == Http2PriorityMode::Weighted) {
+        if (m_inBlockWeight != 0) {
+            priority.weight = m_inBlockWeight;
+        }
+        return priority;
+    }
+    for (const Http2Header& header : headers) {
+        if (header.name == "priority") {
+            priority = Http2Priority::parse(header.value).value_or(priority);
+            break;
+        }
+    }
+    // a PRIORITY_UPDATE that overtook the HEADERS wins over the header (RFC 9218 7.1)
+    auto early = m_earlyPriorities.find(streamId);
+    if (early != m_earlyPriorities.end()) {
+        priority = early->second;
+        m_earlyPriorities.erase(early);
+    }
+    return priority;
+}
+
+bool Http2Connection::handleData(const Http2FrameView& frame)
+{
+    uint32_t streamId = frame.streamId;
+    bool endStream = frame.hasFlag(Http2FrameView::FLAG_END_STREAM);
+    bool closed = false;
+    bool bdpPing = false;
+    Http2ErrorCode refuse = Http2ErrorCode::NoError;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // the whole payload, padding included, counts against the windows
+        if (frame.length > m_connRecvWindow) {
+            return connectionError(Http2ErrorCode::FlowControlError, "connection window exceeded");
+        }
+        m_connRecvWindow -= frame.length;
+        // tuning starts once the peer uses our SETTINGS, the windows before that are not ours to grow
+        if (m_localSettingsAcked && m_bdp.onData(frame.length)) {
+            m_bdp.onPingSent(TscClock::nowNs());
+            bdpPing = true;
+        }
+
+        auto it = m_streams.find(streamId);
+        if (it == m_streams.end()) {
+            bool idle = isLocalStream(streamId) ? streamId >= m_nextStreamId : streamId > m_lastPeerStreamId;
+            if (idle) {
+                return connectionError(Http2ErrorCode::ProtocolError, "DATA on an idle stream");
+            }
+        }
+        else {
+            Stream& stream = *it->second;
+            if (stream.state != Http2StreamState::Open && stream.state != Http2StreamState::HalfClosedLocal) {
+                refuse = Http2ErrorCode::StreamClosed;
+            }
+            else if (frame.length > stream.recvWindow) {
+                refuse = Http2ErrorCode::FlowControlError;
+            }
+            else {
+                stream.recvWindow -= frame.length;
+                if (endStream) {
+                    closed = endStreamLocked(stream, false);
+                }
+            }
+        }
+        if (it == m_streams.end() || refuse != Http2ErrorCode::NoError) {
+            endStream = false;
+            streamId = 0;
+        }
+    }
+
+    if (bdpPing) {
+        Http2PingFrame ping(BDP_PING_OPAQUE);
+        writeFrame(ping);
+    }
+    if (refuse != Http2ErrorCode::NoError) {
+        streamError(frame.streamId, refuse);
+    }
+    if (streamId != 0 && m_listener != nullptr) {
+        m_listener->onData(streamId, frame.data, endStream);
+    }
+    // discarded data still has to be credited to the connection
+    creditWindow(endStream ? 0 : streamId, frame.length);
+    if (closed) {
+        notifyClosed(streamId, Http2ErrorCode::NoError);
+    }
+    return !m_closed;
+}
+
+void Http2Connection::raiseInitialWindowLocked(uint32_t window)
+{
+    // the peer adds the same delta to its stream windows when the SETTINGS arrive,
+    // crediting it here first only makes us accept that DATA a little early
+    uint32_t current = m_localSettingsAcked ? m_localSettings.initialWindowSize
+                                            : std::max(m_localSettings.initialWindowSize, HTTP2_DEFAULT_WINDOW_SIZE);
+    if (window > current) {
+        for (auto& entry : m_streams) {
+            entry.second->recvWindow += window - current;
+        }
+    }
+    m_localSettings.initialWindowSize = std::max(m_localSettings.initialWindowSize, window);
+}
+
+void Http2Connection::creditWindow(uint32_t streamId, uint32_t bytes)
+{
+    if (bytes == 0) {
+        return;
+    }
+    uint32_t connectionIncrement = 0;
+    uint32_t streamIncrement = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connRecvUnacked += bytes;
+        if (m_connRecvUnacked >= m_localSettings.connectionWindowSize / 2) {
+            connectionIncrement = m_connRecvUnacked;
+            m_connRecvWindow += m_connRecvUnacked;
+            m_connRecvUnacked = 0;
+        }
+        auto it = streamId == 0 ? m_streams.end() : m_streams.find(streamId);
+        if (it != m_streams.end()) {
+            Stream& stream = *it->second;
+            stream.recvUnacked += bytes;
+            if (stream.recvUnacked >= m_localSettings.initialWindowSize / 2) {
+                streamIncrement = stream.recvUnacked;
+                stream.recvWindow += stream.recvUnacked;
+                stream.recvUnacked = 0;
+            }
+        }
+    }
+    // the writer merges these with updates still queued for the same stream
+    m_writer.windowUpdate(0, connectionIncrement);
+    m_writer.windowUpdate(streamId, streamIncrement);
+}
+
+uint32_t Http2Connection::growWindowLocked(uint32_t window, Http2SettingsFrame::SettingsMap& changes)
+{
+    Http2Settings advertised = m_advertised;
+    advertised.initialWindowSize = std::max(window, m_advertised.initialWindowSize);
+    changes = advertiseLocked(advertised);
+    raiseInitialWindowLocked(window);
+    if (window <= m_localSettings.connectionWindowSize) {
+        return 0;
+    }
+    uint32_t increment = window - m_localSettings.connectionWindowSize;
+    m_localSettings.connectionWindowSize = window;
+    m_connRecvWindow += increment;
+    return increment;
+}
+
+bool Http2Connection::handleSettings(const Http2FrameView& frame)
+{
+    if (frame.hasFlag(Http2FrameView::FLAG_ACK)) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_settingsInFlight.empty()) {
+                return connectionError(Http2ErrorCode::ProtocolError, "SETTINGS ACK without SETTINGS");
+            }
+            // what the peer uses now is the acknowledged SETTINGS, or anything looser still on its way
+            Http2Settings effective = m_settingsInFlight.front();
+            m_settingsInFlight.pop_front();
+            for (const Http2Settings& pending : m_settingsInFlight) {
+                effective.initialWindowSize = std::max(effective.initialWindowSize, pending.initialWindowSize);
+                effective.maxFrameSize = std::max(effective.maxFrameSize, pending.maxFrameSize);
+                effective.headerTableSize = std::max(effective.headerTableSize, pending.headerTableSize);
+                if (effective.maxHeaderListSize != 0) {
+                    effective.maxHeaderListSize = pending.maxHeaderListSize == 0 ? 0 : std::max(effective.maxHeaderListSize, pending.maxHeaderListSize);
+                }
+            }
+            uint32_t current = m_localSettingsAcked ? m_localSettings.initialWindowSize
+                                                    : std::max(m_localSettings.initialWindowSize, HTTP2_DEFAULT_WINDOW_SIZE);
+            m_localSettingsAcked = true;
+            int64_t delta = (int64_t)effective.initialWindowSize - current;
+            for (auto& entry : m_streams) {
+                entry.second->recvWindow += delta;
+            }
+            m_localSettings.initialWindowSize = effective.initialWindowSize;
+            m_localSettings.maxFrameSize = effective.maxFrameSize;
+            m_localSettings.headerTableSize = effective.headerTableSize;
+            m_localSettings.maxHeaderListSize = effective.maxHeaderListSize;
+        }
+        applyDecoderLimits();
+        return true;
+    }
+
+    std::optional<uint32_t> tableSize;
+    Http2Settings applied;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < frame.settingsCount(); ++i) {
+            uint32_t value = frame.settingValue(i);
+            switch (frame.settingId(i)) {
+            case Http2SettingsFrame::HEADER_TABLE_SIZE:
+                m_peerSettings.headerTableSize = value;
+                tableSize = std::min(value, MAX_ENCODER_TABLE);
+                break;
+
+            case Http2SettingsFrame::ENABLE_PUSH:
+                if (value > 1 || (m_role == Http2Role::Client && value != 0)) {
+                    return connectionError(Http2ErrorCode::ProtocolError, "invalid SETTINGS_ENABLE_PUSH");
+                }
+                m_peerSettings.enablePush = value == 1;
+                break;
+
+            case Http2SettingsFrame::MAX_CONCURRENT_STREAMS:
+                m_peerSettings.maxConcurrentStreams = value;
+                break;
+
+            case Http2SettingsFrame::INITIAL_WINDOW_SIZE: {
+                if (value > HTTP2_MAX_WINDOW_SIZE) {
+                    return connectionError(Http2ErrorCode::FlowControlError, "SETTINGS_INITIAL_WINDOW_SIZE too large");
+                }
+                // changes apply to every open stream, windows may go negative (RFC 9113 6.9.2)
+                int64_t delta = (int64_t)value - m_peerSettings.initialWindowSize;
+                for (auto& entry : m_streams) {
+                    entry.second->sendWindow += delta;
+                    if (entry.second->sendWindow > HTTP2_MAX_WINDOW_SIZE) {
+                        return connectionError(Http2ErrorCode::FlowControlError, "stream window overflow");
+                    }
+                    updateReadyLocked(*entry.second);
+                }
+                m_peerSettings.initialWindowSize = value;
+                break;
+            }
+
+            case Http2SettingsFrame::MAX_FRAME_SIZE:
+                if (value < HTTP2_DEFAULT_MAX_FRAME_SIZE || value > HTTP2_MAX_FRAME_SIZE_LIMIT) {
+                    return connectionError(Http2ErrorCode::ProtocolError, "invalid SETTINGS_MAX_FRAME_SIZE");
+                }
+                m_peerSettings.maxFrameSize = value;
+                break;
+
+            case Http2SettingsFrame::MAX_HEADER_LIST_SIZE:
+                m_peerSettings.maxHeaderListSize = value;
+                break;
+
+            default:
+                break;
+            }
+        }
+        applied = m_peerSettings;
+        m_cond.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        if (tableSize) {
+            m_encoder.setMaxTableSize(*tableSize);
+        }
+        Http2SettingsFrame ack(Http2SettingsFrame::FLAG_ACK);
+        writeFrame(ack);
+    }
+    if (m_listener != nullptr) {
+        m_listener->onSettings(applied);
+    }
+    return true;
+}
+
+bool Http2Connection::handleWindowUpdate(const Http2FrameView& frame)
+{
+    uint32_t increment = frame.windowIncrement;
+    if (frame.streamId == 0) {
+        if (increment == 0) {
+            return connectionError(Http2ErrorCode::ProtocolError, "zero WINDOW_UPDATE");
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connSendWindow += increment;
+        if (m_connSendWindow > HTTP2_MAX_WINDOW_SIZE) {
+            return connectionError(Http2ErrorCode::FlowControlError, "connection window overflow");
+        }
+        m_cond.notify_all();
+        return true;
+    }
+
+    Http2ErrorCode error = Http2ErrorCode::NoError;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_streams.find(frame.streamId);
+        if (it == m_streams.end()) {
+            return true;
+        }
+        if (increment == 0) {
+            error = Http2ErrorCode::ProtocolError;
+        }
+        else {
+            it->second->sendWindow += increment;
+            if (it->second->sendWindow > HTTP2_MAX_WINDOW_SIZE) {
+                error = Http2ErrorCode::FlowControlError;
+            }
+            updateReadyLocked(*it->second);
+            m_cond.notify_all();
+        }
+    }
+    if (error != Http2ErrorCode::NoError) {
+        streamError(frame.streamId, error);
+    }
+    return true;
+}
+
+bool Http2Connection::handleRstStream(const Http2FrameView& frame)
+{
+    bool removed = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        bool idle = isLocalStream(frame.streamId) ? frame.streamId >= m_nextStreamId : frame.streamId > m_lastPeerStreamId;
+        if (idle) {
+            return connectionError(Http2ErrorCode::ProtocolError, "RST_STREAM on an idle stream");
+        }
+        removed = removeStreamLocked(frame.streamId);
+    }
+    if (removed) {
+        notifyClosed(frame.streamId, (Http2ErrorCode)frame.errorCode);
+    }
+    return true;
+}
+
+bool Http2Connection::handlePing(const Http2FrameView& frame)
+{
+    uint64_t opaque = read_u64(frame.data.data());
+    if (frame.hasFlag(Http2FrameView::FLAG_ACK) && opaque == BDP_PING_OPAQUE) {
+        uint32_t window = 0;
+        uint32_t connectionIncrement = 0;
+        Http2SettingsFrame::SettingsMap changes;
+        // the SETTINGS go out in the order they were queued in m_settingsInFlight
+        std::lock_guard<std::mutex> writeLock(m_writeMutex);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            window = m_bdp.onPingAck(TscClock::nowNs());
+            if (window != 0) {
+                connectionIncrement = growWindowLocked(window, changes);
+            }
+        }
+        if (!changes.empty()) {
+            Http2SettingsFrame settings(0, 0, changes);
+            writeFrame(settings);
+        }
+        m_writer.windowUpdate(0, connectionIncrement);
+        return true;
+    }
+    if (frame.hasFlag(Http2FrameView::FLAG_ACK)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_pings.find(opaque);
+        if (it != m_pings.end()) {
+            m_pingRtts[opaque] = TscClock::nowNs() - it->second;
+            m_pings.erase(it);
+            m_cond.notify_all();
+        }
+        return true;
+    }
+    Http2PingFrame ack(opaque, true);
+    writeFrame(ack);
+    return true;
+}
+
+void Http2Connection::handleGoAway(const Http2FrameView& frame)
+{
+    std::vector<uint32_t> refused;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_goAwayReceived = true;
+        m_goAwayLastStreamId = frame.lastStreamId;
+        for (const auto& entry : m_streams) {
+            if (entry.second->local && entry.first > frame.lastStreamId) {
+                refused.push_back(entry.first);
+            }
+        }
+        for (uint32_t streamId : refused) {
+            removeStreamLocked(streamId);
+        }
+        m_cond.notify_all();
+    }
+    if ((Http2ErrorCode)frame.errorCode != Http2ErrorCode::NoError) {
+        LOG_ERROR("Http2Connection: GOAWAY error %u, last stream %u", frame.errorCode, frame.lastStreamId);
+    }
+    for (uint32_t streamId : refused) {
+        notifyClosed(streamId, Http2ErrorCode::RefusedStream);
+    }
+    if (m_listener != nullptr) {
+        m_listener->onGoAway(frame.lastStreamId, (Http2ErrorCode)frame.errorCode,
+            std::string_view((const char*)frame.data.data(), frame.data.size()));
+    }
+}
+
+bool Http2Connection::handlePriority(const Http2FrameView& frame)
+{
+    // PRIORITY is deprecated by RFC 9113, only the weight is used and only in Weighted mode
+    if (m_localSettings.priorityMode != Http2PriorityMode::Weighted) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::optional<Http2Priority> priority = m_scheduler.priority(frame.streamId);
+    if (priority) {
+        priority->weight = (uint16_t)(frame.weight + 1);
+        m_scheduler.update(frame.streamId, *priority);
+        m_cond.notify_all();
+    }
+    return true;
+}
+
+bool Http2Connection::handlePriorityUpdate(const Http2FrameView& frame)
+{
+    if (m_role == Http2Role::Client) {
+        return connectionError(Http2ErrorCode::ProtocolError, "PRIORITY_UPDATE from a server");
+    }
+    if (frame.prioritizedStreamId == 0 || isLocalStream(frame.prioritizedStreamId)) {
+        return connectionError(Http2ErrorCode::ProtocolError, "PRIORITY_UPDATE for an invalid stream");
+    }
+    if (m_localSettings.priorityMode != Http2PriorityMode::Extensible) {
+        return true;
+    }
+    // an unparsable field is ignored, like a bad priority header
+    std::optional<Http2Priority> priority = Http2Priority::parse(
+        std::string_view((const char*)frame.data.data(), frame.data.size()));
+    if (!priority) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_scheduler.update(frame.prioritizedStreamId, *priority)) {
+        m_cond.notify_all();
+    }
+    else if (frame.prioritizedStreamId > m_lastPeerStreamId && m_earlyPriorities.size() < MAX_EARLY_PRIORITIES) {
+        m_earlyPriorities[frame.prioritizedStreamId] = *priority;
+    }
+    return true;
+}
+
+bool Http2Connection::connectionError(Http2ErrorCode error, const char* reason)
+{
+    // called on the reader thread, often with m_mutex held: m_lastPeerStreamId is only written
+    // by this thread, and waiters are woken when readLoop winds down right after
+    LOG_ERROR("Http2Connection: connection error %u: %s", (uint32_t)error, reason);
+    if (!m_goAwaySent.exchange(true)) {
+        Http2GoAwayFrame frame(m_lastPeerStreamId, error, reason);
+        writeFrame(frame);
+    }
+    if (!m_closed.exchange(true)) {
+        m_closeError = error;
+    }
+    return false;
+}
+
+void Http2Connection::streamError(uint32_t streamId, Http2ErrorCode error)
+{
+    bool removed = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        removed = removeStreamLocked(streamId);
+    }
+    Http2RstStreamFrame frame(streamId, error);
+    writeFrame(frame);
+    if (removed) {
+        notifyClosed(streamId, error);
+    }
+}
@@ -0,0 +1,341 @@
+/**
+ *   Http 2.0 connection over an IEasySocket
+ *
+ *   Multiplexes many streams on one socket: preface and SETTINGS exchange,
+ *   the stream state machine of RFC 9113 5.1, connection and stream flow
+ *   control with automatic WINDOW_UPDATE, CONTINUATION reassembly, PING and
+ *   GOAWAY. A reader thread decodes incoming frames and reports them to an
+ *   IHttp2ConnectionListener; any thread may open streams and send on them.
+ *   When several streams send at once, an Http2PriorityScheduler decides
+ *   whose DATA fills the connection window and the writer queue next. With
+ *   autoWindowLimit set, the receive windows grow from PING-measured
+ *   bandwidth-delay products so bulk downloads are limited by the link.
+ *
+ *      Http2Connection connection(socket, Http2Role::Client, &listener);
+ *      connection.start();
+ *      auto id = connection.openStream({ { ":method", "GET" }, { ":scheme", "http" },
+ *                                        { ":path", "/" }, { ":authority", "device" } }, true);
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <unordered_map>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <optional>
+#include <string>
+#include <span>
+#include <stdint.h>
+#include "IEasySocket.h"
+#include "CThread.hpp"
+#include "Http2Frame.h"
+#include "Http2FrameDecoder.h"
+#include "Http2Hpack.h"
+#include "Http2FrameWriter.h"
+#include "Http2FrameArena.h"
+#include "Http2Priority.h"
+#include "Http2BdpEstimator.h"
+
+enum class Http2Role
+{
+    Client,     // sends the preface, opens odd streams
+    Server      // expects the preface
+};
+
+/** RFC 9113 5.1, reserved states are not used since push is not supported */
+enum class Http2StreamState
+{
+    Idle,
+    Open,
+    HalfClosedLocal,    // we sent END_STREAM
+    HalfClosedRemote,   // the peer sent END_STREAM
+    Closed
+};
+
+static constexpr uint32_t HTTP2_DEFAULT_WINDOW_SIZE = 65535;
+static constexpr uint32_t HTTP2_MAX_WINDOW_SIZE = 0x7FFFFFFF;
+
+struct Http2Settings
+{
+    uint32_t headerTableSize = HPACK_DEFAULT_TABLE_SIZE;
+    bool enablePush = false;
+    uint32_t maxConcurrentStreams = 100;
+    uint32_t initialWindowSize = HTTP2_DEFAULT_WINDOW_SIZE;
+    uint32_t maxFrameSize = HTTP2_DEFAULT_MAX_FRAME_SIZE;
+    uint32_t maxHeaderListSize = 0;     // 0: no limit, not advertised
+
+    // not a SETTINGS parameter: the connection receive window, opened with a WINDOW_UPDATE on stream 0
+    uint32_t connectionWindowSize = HTTP2_DEFAULT_WINDOW_SIZE;
+
+    // not a SETTINGS parameter: how our DATA is scheduled; Extensible also sends SETTINGS_NO_RFC7540_PRIORITIES
+    Http2PriorityMode priorityMode = Http2PriorityMode::Extensible;
+
+    // not a SETTINGS parameter: grow INITIAL_WINDOW_SIZE and the connection window up to this
+    // as the measured bandwidth-delay product requires, 0 keeps the windows as configured
+    uint32_t autoWindowLimit = 0;
+};
+
+/** receive window auto-tuning state */
+struct Http2FlowStats
+{
+    uint32_t initialWindowSize = 0;     // what we advertise now
+    uint32_t connectionWindowSize = 0;
+    uint64_t rttNs = 0;                 // smoothed over BDP pings
+    uint64_t bandwidth = 0;             // highest bytes per second measured
+    uint64_t bdp = 0;                   // bytes per round trip at the last growth
+    uint32_t growths = 0;
+};
+
+/**
+ * @brief Events of a connection, called on its reader thread
+ * @note  Do not block in a callback on something only the reader thread can deliver,
+ *        such as sendData waiting for a WINDOW_UPDATE; hand such work to another thread
+ */
+class IHttp2ConnectionListener
+{
+public:
+    virtual ~IHttp2ConnectionListener() {}
+
+    /** a complete header block: request / response headers, or trailers when endStream is set */
+    virtual void onHeaders(uint32_t /*streamId*/, Http2HeaderList& /*headers*/, bool /*endStream*/) {}
+
+    /** payload of a DATA frame, padding removed; the window is credited back after this returns */
+    virtual void onData(uint32_t /*streamId*/, std::span<const uint8_t> /*data*/, bool /*endStream*/) {}
+
+    /** both sides ended the stream (NoError) or it was reset */
+    virtual void onStreamClosed(uint32_t /*streamId*/, Http2ErrorCode /*error*/) {}
+
+    /** the peer will not process streams above lastStreamId; ours above it were closed with RefusedStream */
+    virtual void onGoAway(uint32_t /*lastStreamId*/, Http2ErrorCode /*error*/, std::string_view /*debugData*/) {}
+
+    /** the peer's SETTINGS were applied and acknowledged */
+    virtual void onSettings(const Http2Settings& /*peerSettings*/) {}
+
+    /** the reader thread is exiting, no more callbacks follow */
+    virtual void onConnectionClosed(Http2ErrorCode /*error*/) {}
+};
+
+class Http2Connection
+{
+public:
+    /**
+     * @param socket    connected socket, it must outlive the connection and is not closed by it
+     * @param listener  may be null
+     */
+    Http2Connection(IEasySocket& socket, Http2Role role, IHttp2ConnectionListener* listener,
+        const Http2Settings& settings = {}, const Http2WriterOptions& writerOptions = {});
+    ~Http2Connection();
+
+    Http2Connection(const Http2Connection&) = delete;
+    Http2Connection& operator=(const Http2Connection&) = delete;
+
+    /** send the preface and our SETTINGS, then start the reader thread */
+    bool start();
+
+    /**
+     * @brief       Send GOAWAY and stop the reader thread
+     * @param error NoError for a graceful close
+     */
+    void close(Http2ErrorCode error = Http2ErrorCode::NoError, const std::string& debugData = {});
+
+    /**
+     * @brief  Send GOAWAY but keep the connection open: streams the peer opens from now on are
+     *         refused, those in progress finish. Call close() once activeStreams() drops to 0
+     * @return false if GOAWAY was already sent
+     */
+    bool goAway(Http2ErrorCode error = Http2ErrorCode::NoError, const std::string& debugData = {});
+
+    /**
+     * @brief  Advertise new SETTINGS. Values that let the peer send more apply at once,
+     *         stricter ones once the peer acknowledges them. connectionWindowSize can only grow,
+     *         priorityMode and autoWindowLimit keep their values from the constructor
+     * @return false if the connection is closed
+     */
+    bool updateSettings(const Http2Settings& settings);
+
+    bool isOpen() const { return !m_closed.load(std::memory_order_acquire); }
+
+    /**
+     * @brief           Open a stream by sending its HEADERS, waiting while the peer's
+     *                  MAX_CONCURRENT_STREAMS is reached
+     * @param priority  schedules our DATA on the stream; a non default one is also sent to the
+     *                  peer as the priority header, or as HEADERS priority fields in Weighted mode
+     * @param onOpen    called with the stream id before the HEADERS go out, so the caller can route
+     *                  callbacks for the stream that may arrive before this returns; it must not call
+     *                  back into the connection
+     * @return          stream id, nullopt if the connection is closed or going away
+     */
+    std::optional<uint32_t> openStream(const Http2HeaderList& headers, bool endStream, const Http2Priority& priority = {},
+        const std::function<void(uint32_t)>& onOpen = {});
+
+    /** reprioritize a stream; a client in Extensible mode also tells the server with PRIORITY_UPDATE */
+    bool setStreamPriority(uint32_t streamId, const Http2Priority& priority);
+
+    /** send response headers or trailers on an open stream */
+    bool sendHeaders(uint32_t streamId, const Http2HeaderList& headers, bool endStream);
+
+    /**
+     * @brief  Send data in frames of the peer's MAX_FRAME_SIZE without copying it,
+     *         blocking while the connection or stream window is exhausted
+     * @return false if the stream was reset or the connection closed first
+     */
+    bool sendData(uint32_t streamId, std::span<const uint8_t> data, bool endStream);
+
+    /** reset a stream, both sides drop it */
+    bool resetStream(uint32_t streamId, Http2ErrorCode error = Http2ErrorCode::Cancel);
+
+    /**
+     * @brief           Round trip of a PING
+     * @param timeoutMs give up after this long
+     * @return          round trip time in ns
+     */
+    std::optional<uint64_t> ping(uint32_t timeoutMs = 5000);
+
+    Http2StreamState streamState(uint32_t streamId) const;
+    std::optional<Http2Priority> streamPriority(uint32_t streamId) const;
+    size_t activeStreams() const;
+    Http2Settings peerSettings() const;
+    /** what we advertise, the windows change as they are auto-tuned */
+    Http2Settings localSettings() const;
+    Http2FlowStats flowStats() const;
+    Http2Role role() const { return m_role; }
+    Http2WriterStats writerStats() const { return m_writer.stats(); }
+
+protected:
+    struct Stream
+    {
+        uint32_t id = 0;
+        Http2StreamState state = Http2StreamState::Idle;
+        int64_t sendWindow = 0;
+        int64_t recvWindow = 0;
+        uint32_t recvUnacked = 0;       // consumed but not yet returned with WINDOW_UPDATE
+        bool local = false;             // opened by us
+        bool sending = false;           // a sendData call has data left
+    };
+
+    /** queue a copy of the frame on the writer */
+    bool writeFrame(Http2Frame& frame);
+
+    /**
+     * @brief        Encode and queue HEADERS plus CONTINUATION, holding m_writeMutex
+     * @param weight RFC 7540 weight to send in the HEADERS priority fields, 0 for none
+     */
+    bool writeHeadersLocked(uint32_t streamId, const Http2HeaderList& headers, bool endStream, uint16_t weight = 0);
+
+private:
+    void readLoop();
+    bool handleFrame(const Http2FrameView& frame);
+    bool handleData(const Http2FrameView& frame);
+    bool handleHeaderBlock(uint32_t streamId, bool endStream);
+    bool handleSettings(const Http2FrameView& frame);
+    bool handleWindowUpdate(const Http2FrameView& frame);
+    bool handleRstStream(const Http2FrameView& frame);
+    bool handlePing(const Http2FrameView& frame);
+    void handleGoAway(const Http2FrameView& frame);
+    bool handlePriority(const Http2FrameView& frame);
+    bool handlePriorityUpdate(const Http2FrameView& frame);
+    /** priority of a stream the peer opened, from its header block and any PRIORITY_UPDATE that came first */
+    Http2Priority requestPriority(const Http2HeaderList& headers, uint32_t streamId);
+
+    /** connection error: GOAWAY and stop reading, reader thread only */
+    bool connectionError(Http2ErrorCode error, const char* reason);
+    /** stream error: RST_STREAM and drop the stream */
+    void streamError(uint32_t streamId, Http2ErrorCode error);
+
+    /** with m_mutex held: end of stream from one side, closes the stream when both ended */
+    bool endStreamLocked(Stream& stream, bool local);
+    /** with m_mutex held: drop the stream, returns true if it existed */
+    bool removeStreamLocked(uint32_t streamId);
+    void notifyClosed(uint32_t streamId, Http2ErrorCode error);
+
+    /** with m_mutex held: a stream is schedulable while it has data to send and stream window */
+    void updateReadyLocked(Stream& stream);
+    /** writer thread: DATA up to ticket left the queue, make room for the next scheduled stream */
+    void onWritten(uint64_t ticket);
+
+    /** give consumed bytes back to the peer once half a window has been used */
+    void creditWindow(uint32_t streamId, uint32_t bytes);
+
+    /**
+     * @brief         With m_mutex held: the estimator asked for a larger receive window
+     * @param changes Output, the SETTINGS to send
+     * @return        the connection window increment
+     */
+    uint32_t growWindowLocked(uint32_t window, Http2SettingsFrame::SettingsMap& changes);
+    /** with m_mutex held: let every stream receive up to window, before the peer has seen it */
+    void raiseInitialWindowLocked(uint32_t window);
+    /** with m_mutex held: the SETTINGS frame for what changed from m_advertised, which is updated */
+    Http2SettingsFrame::SettingsMap advertiseLocked(const Http2Settings& settings);
+    /** reader thread: size the decoders for the SETTINGS in effect */
+    void applyDecoderLimits();
+
+    bool isLocalStream(uint32_t streamId) const { return (streamId & 1) == (m_role == Http2Role::Client ? 1u : 0u); }
+
+protected:
+    IEasySocket& m_socket;
+    Http2Role m_role;
+    IHttp2ConnectionListener* m_listener;
+    Http2Settings m_localSettings;
+
+    // streams, windows and peer settings
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::unordered_map<uint32_t, std::unique_ptr<Stream>> m_streams;
+    Http2Settings m_peerSettings;
+    int64_t m_connSendWindow = HTTP2_DEFAULT_WINDOW_SIZE;
+    int64_t m_connRecvWindow = HTTP2_DEFAULT_WINDOW_SIZE;
+    uint32_t m_connRecvUnacked = 0;
+    uint32_t m_nextStreamId;
+    uint32_t m_lastPeerStreamId = 0;
+    size_t m_localActive = 0;
+    size_t m_peerActive = 0;
+    bool m_localSettingsAcked = false;
+    Http2Settings m_advertised;                     // what the last SETTINGS we sent said
+    std::deque<Http2Settings> m_settingsInFlight;   // SETTINGS sent, oldest first, waiting for their ACK
+    bool m_goAwayReceived = false;
+    uint32_t m_goAwayLastStreamId = 0;
+    std::unordered_map<uint64_t, uint64_t> m_pings;     // opaque -> sent ns, 0 once acked with the rtt stored in m_pingRtts
+    std::unordered_map<uint64_t, uint64_t> m_pingRtts;
+    uint64_t m_pingSeq = 0;
+    Http2PriorityScheduler m_scheduler;
+    std::unordered_map<uint32_t, Http2Priority> m_earlyPriorities;  // PRIORITY_UPDATE for streams not yet opened
+    std::vector<std::pair<uint64_t, size_t>> m_dataInFlight;        // writer ticket, DATA bytes
+    size_t m_dataQueued = 0;
+    uint64_t m_lastWritten = 0;
+    Http2BdpEstimator m_bdp;
+
+    // DATA frame objects and buffers of this connection, reused instead of allocated per frame
+    Http2FrameArena m_arena;
+
+    // the HPACK encoder and the order header blocks are queued in, taken before m_mutex when both are needed
+    std::mutex m_writeMutex;
+    HpackEncoder m_encoder;
+    std::vector<uint8_t> m_headerBlock;
+    std::vector<uint8_t> m_headerFrames;
+    Http2FrameWriter m_writer;
+
+    // reader thread only
+    Http2FrameDecoder m_decoder;
+    HpackDecoder m_hpackDecoder;
+    std::vector<uint8_t> m_inBlock;     // header block being reassembled from CONTINUATION
+    uint32_t m_inBlockStream = 0;
+    bool m_inBlockEndStream = false;
+    uint16_t m_inBlockWeight = 0;       // effective RFC 7540 weight from the HEADERS priority fields, 0 if none
+    size_t m_prefaceReceived = 0;
+    bool m_peerSettingsReceived = false;
+    std::atomic_bool m_limitsChanged{ false };      // m_localSettings changed, resize the decoders
+
+    CThread<void> m_reader;
+    std::atomic_bool m_started{ false };
+    std::atomic_bool m_closed{ false };
+    std::atomic_bool m_goAwaySent{ false };
+    std::atomic<int> m_readerThreadId{ 0 };
+    std::atomic<Http2ErrorCode> m_closeError{ Http2ErrorCode::NoError };
+};
@@ -1,4 +1,19 @@
 #include "Http2Frame.h"
+#include "Http2Hpack.h"
+#include "PlatformCommonUtils.h"
+#include <string.h>
+#include <assert.h>
+
+// the longest padding a frame can carry
+static const uint8_t s_padding[256] = {};
+
+static inline void write_u32(uint8_t* out, uint32_t value)
+{
+    out[0] = (value >> 24) & 0xFF; // MSB
+    out[1] = (value >> 16) & 0xFF;
+    out[2] = (value >> 8) & 0xFF;
+    out[3] = value & 0xFF; // LSB
+}
 
 /** Http2Frame */
 Http2Frame::Http2Frame(uint32_t streamId, uint8_t flags, uint8_t type):
@@ -11,32 +26,162 @@ Http2Frame::Http2Frame(uint32_t streamId, uint8_t flags, uint8_t type):
 
 std::vector<uint8_t> Http2Frame::serialize()
 {
-    std::vector<uint8_t> body = serializeBody();
-    m_bodyLen = (uint32_t)body.size();
-    std::vector<uint8_t> head = serializeHead();
-    head.insert(head.end(), body.begin(), body.end());
-    return head;
+    std::vector<uint8_t> frame;
+    serializeInto(frame);
+    return frame;
 }
 
 std::vector<uint8_t> Http2Frame::serializeHead()
 {
-    std::vector<uint8_t> header;
-    header.reserve(9);
+    m_bodyLen = bodySize();
+    std::vector<uint8_t> header(HTTP2_HEAD_SIZE);
+    writeHead(header.data(), m_bodyLen);
+    return header;
+}
 
+void Http2Frame::writeHead(uint8_t* out, uint32_t bodyLen) const
+{
     // Length spread 8 bit of 24
-    header.push_back((m_bodyLen >> 16) & 0xFF); 
-    header.push_back((m_bodyLen >> 8) & 0xFF);  
-    header.push_back(m_bodyLen & 0xFF);         
+    out[0] = (bodyLen >> 16) & 0xFF;
+    out[1] = (bodyLen >> 8) & 0xFF;
+    out[2] = bodyLen & 0xFF;
 
-    header.push_back(m_type);  // type 
-    header.push_back(m_flags); // flags 
+    out[3] = m_type;  // type
+    out[4] = m_flags; // flags
 
-    header.push_back((m_streamId >> 24) & 0xFF); // MSB
-    header.push_back((m_streamId >> 16) & 0xFF);
-    header.push_back((m_streamId >> 8) & 0xFF);
-    header.push_back(m_streamId & 0xFF); // LSB
+    write_u32(out + 5, m_streamId);
+}
 
-    return header;
+size_t Http2Frame::serializeInto(uint8_t* buffer, size_t capacity)
+{
+    m_bodyLen = bodySize();
+    size_t size = HTTP2_HEAD_SIZE + m_bodyLen;
+    if (buffer == nullptr || capacity < size) {
+        return 0;
+    }
+    writeHead(buffer, m_bodyLen);
+    serializeBodyInto(buffer + HTTP2_HEAD_SIZE);
+    return size;
+}
+
+size_t Http2Frame::serializeInto(std::vector<uint8_t>& out)
+{
+    size_t offset = out.size();
+    out.resize(offset + frameSize());
+    return serializeInto(out.data() + offset, out.size() - offset);
+}
+
+size_t Http2Frame::serializeIov(Http2IoVec* iov)
+{
+    // small control frames: one contiguous piece, in a pooled buffer kept for the life of the frame
+    size_t size = frameSize();
+    if (m_scratch.capacity() < size) {
+        m_scratch = Http2BufferPool::shared().acquire(size);
+    }
+    iov[0] = { m_scratch.data(), serializeInto(m_scratch.data(), m_scratch.capacity()) };
+    return 1;
+}
+
+/** Http2SettingsList */
+Http2SettingsList::Http2SettingsList(std::initializer_list<Entry> entries)
+{
+    for (const Entry& entry : entries) {
+        set(entry.first, entry.second);
+    }
+}
+
+size_t Http2SettingsList::lowerBound(uint16_t id) const
+{
+    size_t index = 0;
+    while (index < m_size && m_entries[index].first < id) {
+        ++index;
+    }
+    return index;
+}
+
+uint32_t& Http2SettingsList::operator[](uint16_t id)
+{
+    size_t index = lowerBound(id);
+    if (index < m_size && m_entries[index].first == id) {
+        return m_entries[index].second;
+    }
+    if (!set(id, 0)) {
+        // a caller bug: every defined setting fits, only a list filled with made-up ids runs out
+        assert(!"Http2SettingsList is full");
+        m_overflow = 0;
+        return m_overflow;
+    }
+    return m_entries[index].second;
+}
+
+bool Http2SettingsList::set(uint16_t id, uint32_t value)
+{
+    size_t index = lowerBound(id);
+    if (index < m_size && m_entries[index].first == id) {
+        m_entries[index].second = value;
+        return true;
+    }
+    if (m_size == CAPACITY) {
+        LOG_ERROR("Http2SettingsList: full, setting 0x%x = %u dropped", id, value);
+        return false;
+    }
+    for (size_t i = m_size; i > index; --i) {
+        m_entries[i] = m_entries[i - 1];
+    }
+    m_entries[index] = { id, value };
+    ++m_size;
+    return true;
+}
+
+const uint32_t* Http2SettingsList::find(uint16_t id) const
+{
+    size_t index = lowerBound(id);
+    return index < m_size && m_entries[index].first == id ? &m_entries[index].second : nullptr;
+}
+
+bool Http2SettingsList::erase(uint16_t id)
+{
+    size_t index = lowerBound(id);
+    if (index == m_size || m_entries[index].first != id) {
+        return false;
+    }
+    for (size_t i = index + 1; i < m_size; ++i) {
+        m_entries[i - 1] = m_entries[i];
+    }
+    --m_size;
+    return true;
+}
+
+bool Http2SettingsList::operator==(const Http2SettingsList& other) const
+{
+    if (m_size != other.m_size) {
+        return false;
+    }
+    for (size_t i = 0; i < m_size; ++i) {
+        if (m_entries[i] != other.m_entries[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t Http2Frame::gatherPayload(Http2IoVec* iov, const uint8_t* prefix, size_t prefixLen,
+    const uint8_t* payload, size_t payloadLen, uint8_t padLength)
+{
+    m_bodyLen = bodySize();
+    writeHead(m_prefix, m_bodyLen);
+    if (prefixLen > 0) {
+        memcpy(m_prefix + HTTP2_HEAD_SIZE, prefix, prefixLen);
+    }
+    size_t count = 0;
+    iov[count++] = { m_prefix, HTTP2_HEAD_SIZE + prefixLen };
+    if (payloadLen > 0) {
+        iov[count++] = { payload, payloadLen };
+    }
+    if (padLength > 0) {
+        iov[count++] = { s_padding, padLength };
+    }
+    return count;
 }
 
 /** Http2SettingsFrame */
@@ -48,18 +193,20 @@ Http2SettingsFrame::Http2SettingsFrame(uint8_t flags, uint32_t streamID, const S
 
 std::vector<uint8_t> Http2SettingsFrame::serializeBody()
 {
-    std::vector<uint8_t> serialized;
-    serialized.reserve(m_settings.size() * 6);
+    std::vector<uint8_t> serialized(bodySize());
+    serializeBodyInto(serialized.data());
+    return serialized;
+}
+
+void Http2SettingsFrame::serializeBodyInto(uint8_t* out) const
+{
     for (const auto& entry : m_settings) {
-        // Each setting consists of a 1-byte setting ID and a 4-byte setting value
-        serialized.push_back((entry.first >> 8) & 0xFF);
-        serialized.push_back(entry.first & 0xFF);
-        serialized.push_back((entry.second >> 24) & 0xFF);  // MSB
-        serialized.push_back((entry.second >> 16) & 0xFF);
-        serialized.push_back((entry.second >> 8) & 0xFF);
-        serialized.push_back(entry.second & 0xFF);  // LSB
+        // Each setting consists of a 2-byte setting ID and a 4-byte setting value
+        out[0] = (entry.first >> 8) & 0xFF;
+        out[1] = entry.first & 0xFF;
+        write_u32(out + 2, entry.second);
+        out += 6;
     }
-    return serialized;
 }
 
 /** Http2WindowUpdateFrame */
@@ -70,15 +217,16 @@ Http2WindowUpdateFrame::Http2WindowUpdateFrame(uint32_t streamId, uint32_t windo
 
 std::vector<uint8_t> Http2WindowUpdateFrame::serializeBody()
 {
-    std::vector<uint8_t> body;
-    body.reserve(4);
-    body.push_back((m_windowIncrement >> 24) & 0xFF);
-    body.push_back((m_windowIncrement >> 16) & 0xFF);
-    body.push_back((m_windowIncrement >> 8) & 0xFF);
-    body.push_back(m_windowIncrement & 0xFF);
+    std::vector<uint8_t> body(bodySize());
+    serializeBodyInto(body.data());
     return body;
 }
 
+void Http2WindowUpdateFrame::serializeBodyInto(uint8_t* out) const
+{
+    write_u32(out, m_windowIncrement);
+}
+
 /** Http2HeadersFrame */
 Http2HeadersFrame::Http2HeadersFrame(
     uint32_t streamId,
@@ -87,8 +235,9 @@ Http2HeadersFrame::Http2HeadersFrame(
     uint8_t padLength,
     uint32_t dependsOn,
     uint8_t weight)
-    : Http2Frame(streamId, (uint8_t)flags, TYPE),
+    : Http2Frame(streamId, (uint8_t)(flags | (padLength > 0 ? PADDED : 0)), TYPE),
     m_headerBlock(headerBlock),
+    m_block(m_headerBlock),
     m_padLength(padLength),
     m_dependsOn(dependsOn),
     m_weight(weight)
@@ -96,54 +245,276 @@ Http2HeadersFrame::Http2HeadersFrame(
     
 }
 
-std::vector<uint8_t> Http2HeadersFrame::serializeBody()
+Http2HeadersFrame::Http2HeadersFrame(
+    uint32_t streamId,
+    const std::vector<Http2Header>& headers,
+    HpackEncoder& encoder,
+    Flags flags,
+    uint8_t padLength,
+    uint32_t dependsOn,
+    uint8_t weight)
+    : Http2Frame(streamId, (uint8_t)(flags | (padLength > 0 ? PADDED : 0)), TYPE),
+    m_padLength(padLength),
+    m_dependsOn(dependsOn),
+    m_weight(weight)
+{
+    encoder.encode(headers, m_headerBlock);
+    m_block = m_headerBlock;
+}
+
+Http2HeadersFrame::Http2HeadersFrame(
+    uint32_t streamId,
+    std::span<const uint8_t> headerBlock,
+    Flags flags,
+    uint8_t padLength,
+    uint32_t dependsOn,
+    uint8_t weight)
+    : Http2Frame(streamId, (uint8_t)(flags | (padLength > 0 ? PADDED : 0)), TYPE),
+    m_block(headerBlock),
+    m_padLength(padLength),
+    m_dependsOn(dependsOn),
+    m_weight(weight)
+{
+}
+
+uint32_t Http2HeadersFrame::bodySize() const
+{
+    uint32_t size = (uint32_t)m_block.size();
+    if (m_flags & PADDED) {
+        size += 1 + m_padLength;
+    }
+    if (m_flags & PRIORITY) {
+        size += 5;
+    }
+    return size;
+}
+
+size_t Http2HeadersFrame::writePrefix(uint8_t* out) const
 {
-    std::vector<uint8_t> body;
-    if (m_padLength > 0 && m_flags & PADDED) {
-        body.push_back(m_padLength);
+    size_t size = 0;
+    if (m_flags & PADDED) {
+        out[size++] = m_padLength;
     }
     if (m_flags & PRIORITY) {
-        body.push_back((m_dependsOn >> 24) & 0xFF);
-        body.push_back((m_dependsOn >> 16) & 0xFF);
-        body.push_back((m_dependsOn >> 8) & 0xFF);
-        body.push_back(m_dependsOn & 0xFF);
-        body.push_back(m_weight);
-    }
-    body.insert(body.end(), m_headerBlock.begin(), m_headerBlock.end());
-    body.insert(body.end(), m_padLength, 0); // Add padding
+        write_u32(out + size, m_dependsOn);
+        out[size + 4] = m_weight;
+        size += 5;
+    }
+    return size;
+}
+
+std::vector<uint8_t> Http2HeadersFrame::serializeBody()
+{
+    std::vector<uint8_t> body(bodySize());
+    serializeBodyInto(body.data());
     return body;
 }
 
+void Http2HeadersFrame::serializeBodyInto(uint8_t* out) const
+{
+    out += writePrefix(out);
+    if (!m_block.empty()) {
+        memcpy(out, m_block.data(), m_block.size());
+    }
+    if (m_flags & PADDED) {
+        memset(out + m_block.size(), 0, m_padLength); // Add padding
+    }
+}
+
+size_t Http2HeadersFrame::serializeIov(Http2IoVec* iov)
+{
+    uint8_t prefix[6];
+    size_t prefixLen = writePrefix(prefix);
+    return gatherPayload(iov, prefix, prefixLen, m_block.data(), m_block.size(), (m_flags & PADDED) ? m_padLength : 0);
+}
+
 /** Http2DataFrame */
 Http2DataFrame::Http2DataFrame(uint32_t streamId, const std::vector<uint8_t>& data, uint8_t padLength)
-    : Http2Frame(streamId, padLength > 0 ? 0x08 : 0x00, TYPE), m_data(data), m_padLength(padLength)
+    : Http2Frame(streamId, padLength > 0 ? 0x08 : 0x00, TYPE), m_data(data), m_payload(m_data), m_padLength(padLength)
+{
+}
+
+Http2DataFrame::Http2DataFrame(uint32_t streamId, std::vector<uint8_t>&& data, uint8_t padLength)
+    : Http2Frame(streamId, padLength > 0 ? 0x08 : 0x00, TYPE), m_data(std::move(data)), m_payload(m_data), m_padLength(padLength)
+{
+}
+
+Http2DataFrame::Http2DataFrame(uint32_t streamId, std::span<const uint8_t> data, uint8_t padLength)
+    : Http2Frame(streamId, padLength > 0 ? 0x08 : 0x00, TYPE), m_payload(data), m_padLength(padLength)
+{
+}
+
+void Http2DataFrame::reset(uint32_t streamId, std::span<const uint8_t> data, uint8_t padLength)
+{
+    if (m_data.capacity() > 0) {
+        std::vector<uint8_t>().swap(m_data);
+    }
+    m_streamId = streamId;
+    m_flags = padLength > 0 ? PADDED : 0x00;
+    m_payload = data;
+    m_padLength = padLength;
+}
+
+uint32_t Http2DataFrame::bodySize() const
 {
+    return (uint32_t)m_payload.size() + (m_padLength > 0 ? 1 + m_padLength : 0);
 }
 
 std::vector<uint8_t> Http2DataFrame::serializeBody()
 {
-    std::vector<uint8_t> body;
+    std::vector<uint8_t> body(bodySize());
+    serializeBodyInto(body.data());
+    return body;
+}
+
+void Http2DataFrame::serializeBodyInto(uint8_t* out) const
+{
     if (m_padLength > 0) {
-        body.push_back(m_padLength);
+        *out++ = m_padLength;
+    }
+    if (!m_payload.empty()) {
+        memcpy(out, m_payload.data(), m_payload.size());
+    }
+    memset(out + m_payload.size(), 0, m_padLength); // Add padding
+}
+
+size_t Http2DataFrame::serializeIov(Http2IoVec* iov)
+{
+    return gatherPayload(iov, &m_padLength, m_padLength > 0 ? 1 : 0, m_payload.data(), m_payload.size(), m_padLength);
+}
+
+/** Http2RstStreamFrame */
+Http2RstStreamFrame::Http2RstStreamFrame(uint32_t streamId, Http2ErrorCode errorCode)
+    : Http2Frame(streamId, 0, TYPE), m_errorCode(errorCode)
+{
+}
+
+std::vector<uint8_t> Http2RstStreamFrame::serializeBody()
+{
+    std::vector<uint8_t> body(bodySize());
+    serializeBodyInto(body.data());
+    return body;
+}
+
+void Http2RstStreamFrame::serializeBodyInto(uint8_t* out) const
+{
+    write_u32(out, (uint32_t)m_errorCode);
+}
+
+/** Http2PingFrame */
+Http2PingFrame::Http2PingFrame(uint64_t opaque, bool ack)
+    : Http2Frame(0, ack ? FLAG_ACK : 0, TYPE), m_opaque(opaque)
+{
+}
+
+std::vector<uint8_t> Http2PingFrame::serializeBody()
+{
+    std::vector<uint8_t> body(bodySize());
+    serializeBodyInto(body.data());
+    return body;
+}
+
+void Http2PingFrame::serializeBodyInto(uint8_t* out) const
+{
+    write_u32(out, (uint32_t)(m_opaque >> 32));
+    write_u32(out + 4, (uint32_t)m_opaque);
+}
+
+/** Http2GoAwayFrame */
+Http2GoAwayFrame::Http2GoAwayFrame(uint32_t lastStreamId, Http2ErrorCode errorCode, const std::string& debugData)
+    : Http2Frame(0, 0, TYPE), m_lastStreamId(lastStreamId), m_errorCode(errorCode), m_debugData(debugData)
+{
+}
+
+std::vector<uint8_t> Http2GoAwayFrame::serializeBody()
+{
+    std::vector<uint8_t> body(bodySize());
+    serializeBodyInto(body.data());
+    return body;
+}
+
+void Http2GoAwayFrame::serializeBodyInto(uint8_t* out) const
+{
+    write_u32(out, m_lastStreamId & 0x7FFFFFFF);
+    write_u32(out + 4, (uint32_t)m_errorCode);
+    if (!m_debugData.empty()) {
+        memcpy(out + 8, m_debugData.data(), m_debugData.size());
+    }
+}
+
+/** Http2ContinuationFrame */
+Http2ContinuationFrame::Http2ContinuationFrame(uint32_t streamId, std::span<const uint8_t> fragment, bool endHeaders)
+    : Http2Frame(streamId, endHeaders ? END_HEADERS : 0, TYPE), m_fragment(fragment)
+{
+}
+
+std::vector<uint8_t> Http2ContinuationFrame::serializeBody()
+{
+    return std::vector<uint8_t>(m_fragment.begin(), m_fragment.end());
+}
+
+void Http2ContinuationFrame::serializeBodyInto(uint8_t* out) const
+{
+    if (!m_fragment.empty()) {
+        memcpy(out, m_fragment.data(), m_fragment.size());
     }
-    body.insert(body.end(), m_data.begin(), m_data.end());
-    body.insert(body.end(), m_padLength, 0); // Add padding
+}
+
+size_t Http2ContinuationFrame::serializeIov(Http2IoVec* iov)
+{
+    return gatherPayload(iov, nullptr, 0, m_fragment.data(), m_fragment.size(), 0);
+}
+
+/** Http2PriorityUpdateFrame */
+Http2PriorityUpdateFrame::Http2PriorityUpdateFrame(uint32_t prioritizedStreamId, const std::string& fieldValue)
+    : Http2Frame(0, 0, TYPE), m_prioritizedStreamId(prioritizedStreamId), m_fieldValue(fieldValue)
+{
+}
+
+std::vector<uint8_t> Http2PriorityUpdateFrame::serializeBody()
+{
+    std::vector<uint8_t> body(bodySize());
+    serializeBodyInto(body.data());
     return body;
 }
 
-Http2FrameHeadParser::Http2FrameHeadParser(const std::vector<uint8_t>& data):
-    m_data(data)
+void Http2PriorityUpdateFrame::serializeBodyInto(uint8_t* out) const
 {
+    write_u32(out, m_prioritizedStreamId & 0x7FFFFFFF);
+    if (!m_fieldValue.empty()) {
+        memcpy(out + 4, m_fieldValue.data(), m_fieldValue.size());
+    }
+}
+
+Http2FrameHeadParser::Http2FrameHeadParser(const std::vector<uint8_t>& data)
+{
+    setFrameHead(data);
+}
+
+Http2FrameHeadParser::Http2FrameHeadParser(const uint8_t* head)
+{
+    setFrameHead(head);
 }
 
 void Http2FrameHeadParser::setFrameHead(const std::vector<uint8_t>& frameHead)
 {
-    m_data = frameHead;
+    m_valid = frameHead.size() >= HTTP2_HEAD_SIZE;
+    if (m_valid) {
+        memcpy(m_data, frameHead.data(), HTTP2_HEAD_SIZE);
+    }
+}
+
+void Http2FrameHeadParser::setFrameHead(const uint8_t* head)
+{
+    m_valid = head != nullptr;
+    if (m_valid) {
+        memcpy(m_data, head, HTTP2_HEAD_SIZE);
+    }
 }
 
 Http2FrameHeadParser::FrameType Http2FrameHeadParser::getFrameType()
 {
-    if (m_data.size() < 9) {
+    if (!m_valid) {
         return Http2FrameHeadParser::None;
     }
     uint8_t type = m_data[3];
@@ -170,7 +541,7 @@ Http2FrameHeadParser::FrameType Http2FrameHeadParser::getFrameType()
 
 uint32_t Http2FrameHeadParser::getDataSize()
 {
-    if (m_data.size() < 9) {
+    if (!m_valid) {
         return 0;
     }
     // big endian
@@ -181,7 +552,7 @@ uint32_t Http2FrameHeadParser::getDataSize()
 
 uint8_t Http2FrameHeadParser::getFlags()
 {
-    if (m_data.size() < 9) {
+    if (!m_valid) {
         return 0;
     }
     return m_data[4];
@@ -189,7 +560,7 @@ uint8_t Http2FrameHeadParser::getFlags()
 
 uint32_t Http2FrameHeadParser::getStreamId()
 {
-    if (m_data.size() < 9) {
+    if (!m_valid) {
         return 0;
     }
     // big endian
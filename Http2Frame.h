@@ -10,7 +10,16 @@
 #pragma once
 
 #include <vector>
-#include <map>
+#include <span>
+#include <string>
+#include <utility>
+#include <initializer_list>
+#include <stdint.h>
+#include <stddef.h>
+#include "Http2BufferPool.h"
+
+struct Http2Header;
+class HpackEncoder;
 
 static constexpr uint32_t HTTP2_HEAD_SIZE = 9;
 
@@ -19,12 +28,67 @@ static const std::vector<uint8_t> HTTP2_MAGIC = {
     '\r', '\n', 'S', 'M', '\r', '\n', '\r', '\n'
 };
 
+// SETTINGS_MAX_FRAME_SIZE bounds (RFC 9113 6.5.2)
+static constexpr uint32_t HTTP2_DEFAULT_MAX_FRAME_SIZE = 16384;
+static constexpr uint32_t HTTP2_MAX_FRAME_SIZE_LIMIT = 16777215;
+
+/** frame types of RFC 9113 section 6 */
+enum class Http2FrameType : uint8_t
+{
+    Data = 0x00,
+    Headers = 0x01,
+    Priority = 0x02,
+    RstStream = 0x03,
+    Settings = 0x04,
+    PushPromise = 0x05,
+    Ping = 0x06,
+    GoAway = 0x07,
+    WindowUpdate = 0x08,
+    Continuation = 0x09,
+    PriorityUpdate = 0x10   // RFC 9218 7.1
+};
+
+/** error codes of RFC 9113 section 7, carried by RST_STREAM and GOAWAY */
+enum class Http2ErrorCode : uint32_t
+{
+    NoError = 0x00,
+    ProtocolError = 0x01,
+    InternalError = 0x02,
+    FlowControlError = 0x03,
+    SettingsTimeout = 0x04,
+    StreamClosed = 0x05,
+    FrameSizeError = 0x06,
+    RefusedStream = 0x07,
+    Cancel = 0x08,
+    CompressionError = 0x09,
+    ConnectError = 0x0a,
+    EnhanceYourCalm = 0x0b,
+    InadequateSecurity = 0x0c,
+    Http11Required = 0x0d
+};
+
+/**
+ * @brief One piece of a serialized frame for writev / WSASend, it points into the frame or the caller's payload
+ */
+struct Http2IoVec
+{
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
 class Http2Frame
 {
 public:
+    // head, frame prefix (pad length, priority) and padding need at most this many pieces besides the payload
+    static constexpr size_t MAX_IOVECS = 3;
+
     Http2Frame(uint32_t streamId, uint8_t flags, uint8_t type);
 	virtual ~Http2Frame() {}
 
+    // frames may point into their own storage
+    Http2Frame(const Http2Frame&) = delete;
+    Http2Frame& operator=(const Http2Frame&) = delete;
+
 	/** serialize all data */
 	virtual std::vector<uint8_t> serialize();
 
@@ -34,11 +98,97 @@ public:
     /** serialize body data */
 	virtual std::vector<uint8_t> serializeBody() = 0;
 
+    /** body length in bytes, without the 9 byte head */
+    virtual uint32_t bodySize() const = 0;
+
+    /** head plus body */
+    size_t frameSize() const { return HTTP2_HEAD_SIZE + bodySize(); }
+
+    /**
+     * @brief          Write head and body straight into a caller buffer
+     * @param buffer   Output, at least frameSize() bytes
+     * @param capacity Size of buffer
+     * @return         Bytes written, 0 if the buffer is too small
+     */
+    size_t serializeInto(uint8_t* buffer, size_t capacity);
+
+    /** append the frame to out, growing it once */
+    size_t serializeInto(std::vector<uint8_t>& out);
+
+    /**
+     * @brief        Describe the frame as pieces for a gather write, the payload is not copied
+     * @param iov    Output, room for MAX_IOVECS entries
+     * @return       Number of entries used
+     * @note         The pieces point into this frame and the payload it references, both must outlive the write
+     */
+    virtual size_t serializeIov(Http2IoVec* iov);
+
+    uint32_t streamId() const { return m_streamId; }
+    uint8_t flags() const { return m_flags; }
+    uint8_t type() const { return m_type; }
+
+protected:
+    /** write the body into out, which has room for bodySize() bytes */
+    virtual void serializeBodyInto(uint8_t* out) const = 0;
+
+    /** write the 9 byte head for a body of bodyLen bytes */
+    void writeHead(uint8_t* out, uint32_t bodyLen) const;
+
+    /** head, pad length and priority fields of a frame whose payload is gathered separately */
+    size_t gatherPayload(Http2IoVec* iov, const uint8_t* prefix, size_t prefixLen,
+        const uint8_t* payload, size_t payloadLen, uint8_t padLength);
+
 protected:
 	uint32_t m_streamId;
 	uint8_t m_flags;
 	uint8_t m_type;
 	uint32_t m_bodyLen;
+
+    // serializeIov storage for the head and the small fields in front of the payload
+    uint8_t m_prefix[HTTP2_HEAD_SIZE + 6];
+    Http2Buffer m_scratch;
+};
+
+/**
+ * @brief SETTINGS entries in a fixed array instead of a tree, kept in id order.
+ *        Holds every setting RFC 9113 and its extensions define without allocating.
+ *        SettingsMap used to be a std::map; code using map members needs find() / set() now
+ */
+class Http2SettingsList
+{
+public:
+    using Entry = std::pair<uint16_t, uint32_t>;
+    static constexpr size_t CAPACITY = 16;
+
+    Http2SettingsList() = default;
+    Http2SettingsList(std::initializer_list<Entry> entries);
+
+    /** the value of id, added as 0 if missing; asserts when the list is full, release builds log and drop the write */
+    uint32_t& operator[](uint16_t id);
+
+    /** false, and logged, if the list is full */
+    bool set(uint16_t id, uint32_t value);
+    const uint32_t* find(uint16_t id) const;
+    bool contains(uint16_t id) const { return find(id) != nullptr; }
+    bool erase(uint16_t id);
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    void clear() { m_size = 0; }
+
+    const Entry* begin() const { return m_entries; }
+    const Entry* end() const { return m_entries + m_size; }
+
+    bool operator==(const Http2SettingsList& other) const;
+
+private:
+    /** index of id, or where it would be inserted */
+    size_t lowerBound(uint16_t id) const;
+
+private:
+    Entry m_entries[CAPACITY] = {};
+    size_t m_size = 0;
+    uint32_t m_overflow = 0;
 };
 
 /**
@@ -65,15 +215,20 @@ public:
         INITIAL_WINDOW_SIZE = 0x04,
         MAX_FRAME_SIZE = 0x05,
         MAX_HEADER_LIST_SIZE = 0x06,
-        ENABLE_CONNECT_PROTOCOL = 0x08
+        ENABLE_CONNECT_PROTOCOL = 0x08,
+        NO_RFC7540_PRIORITIES = 0x09
     };
-    using SettingsMap = std::map<SettingOption, uint32_t>;
+    using SettingsMap = Http2SettingsList;
 
     Http2SettingsFrame(uint8_t flags = 0, uint32_t streamID = STREAM_ASSOC_NO_STREAM, const SettingsMap& settings = {});
 
 public:
 	std::vector<uint8_t> serializeBody() override;
+    uint32_t bodySize() const override { return (uint32_t)m_settings.size() * 6; }
     SettingsMap m_settings;
+
+protected:
+    void serializeBodyInto(uint8_t* out) const override;
 };
 
 /**
@@ -87,6 +242,10 @@ public:
     Http2WindowUpdateFrame(uint32_t streamId, uint32_t windowIncrement);
 
     std::vector<uint8_t> serializeBody() override;
+    uint32_t bodySize() const override { return 4; }
+
+protected:
+    void serializeBodyInto(uint8_t* out) const override;
 
 private:
     uint32_t m_windowIncrement;
@@ -117,10 +276,39 @@ public:
         uint32_t dependsOn = 0,
         uint8_t weight = 0);
 
+    /** HPACK encode headers with the connection's encoder */
+    Http2HeadersFrame(
+        uint32_t streamId,
+        const std::vector<Http2Header>& headers,
+        HpackEncoder& encoder,
+        Flags flags,
+        uint8_t padLength = 0,
+        uint32_t dependsOn = 0,
+        uint8_t weight = 0);
+
+    /** reference the header block instead of copying it, it must outlive the frame */
+    Http2HeadersFrame(
+        uint32_t streamId,
+        std::span<const uint8_t> headerBlock,
+        Flags flags,
+        uint8_t padLength = 0,
+        uint32_t dependsOn = 0,
+        uint8_t weight = 0);
+
     std::vector<uint8_t> serializeBody() override;
+    uint32_t bodySize() const override;
+    size_t serializeIov(Http2IoVec* iov) override;
+
+protected:
+    void serializeBodyInto(uint8_t* out) const override;
+
+private:
+    /** pad length and priority fields, returns their size */
+    size_t writePrefix(uint8_t* out) const;
 
 private:
     std::vector<uint8_t> m_headerBlock;
+    std::span<const uint8_t> m_block;
     uint8_t m_padLength;
     uint32_t m_dependsOn;
     uint8_t m_weight;
@@ -134,15 +322,146 @@ class Http2DataFrame : public Http2Frame
 public:
     static constexpr uint8_t TYPE = 0x00;
 
+    // Flags
+    static constexpr uint8_t END_STREAM = 0x01;
+    static constexpr uint8_t PADDED = 0x08;
+
     Http2DataFrame(uint32_t streamId, const std::vector<uint8_t>& data, uint8_t padLength = 0);
 
+    /** take the payload over without copying */
+    Http2DataFrame(uint32_t streamId, std::vector<uint8_t>&& data, uint8_t padLength = 0);
+
+    /** reference the payload instead of copying it, it must outlive the frame */
+    Http2DataFrame(uint32_t streamId, std::span<const uint8_t> data, uint8_t padLength = 0);
+
+    /** last frame of the stream from this side */
+    void setEndStream(bool endStream) { m_flags = endStream ? (m_flags | END_STREAM) : (m_flags & ~END_STREAM); }
+
+    /** reuse the frame for another referenced payload, flags cleared; an owned payload is freed */
+    void reset(uint32_t streamId, std::span<const uint8_t> data, uint8_t padLength = 0);
+
     std::vector<uint8_t> serializeBody() override;
+    uint32_t bodySize() const override;
+    size_t serializeIov(Http2IoVec* iov) override;
+
+protected:
+    void serializeBodyInto(uint8_t* out) const override;
 
 private:
     std::vector<uint8_t> m_data;
+    std::span<const uint8_t> m_payload;
     uint8_t m_padLength;
 };
 
+/**
+ * @brief Rst Stream Frame
+ */
+class Http2RstStreamFrame : public Http2Frame
+{
+public:
+    static constexpr uint8_t TYPE = 0x03;
+
+    Http2RstStreamFrame(uint32_t streamId, Http2ErrorCode errorCode);
+
+    std::vector<uint8_t> serializeBody() override;
+    uint32_t bodySize() const override { return 4; }
+
+protected:
+    void serializeBodyInto(uint8_t* out) const override;
+
+private:
+    Http2ErrorCode m_errorCode;
+};
+
+/**
+ * @brief Ping Frame
+ */
+class Http2PingFrame : public Http2Frame
+{
+public:
+    static constexpr uint8_t TYPE = 0x06;
+    static constexpr uint8_t FLAG_ACK = 0x01;
+
+    /** opaque is echoed by the peer in the ACK */
+    Http2PingFrame(uint64_t opaque, bool ack = false);
+
+    std::vector<uint8_t> serializeBody() override;
+    uint32_t bodySize() const override { return 8; }
+
+protected:
+    void serializeBodyInto(uint8_t* out) const override;
+
+private:
+    uint64_t m_opaque;
+};
+
+/**
+ * @brief GoAway Frame
+ */
+class Http2GoAwayFrame : public Http2Frame
+{
+public:
+    static constexpr uint8_t TYPE = 0x07;
+
+    Http2GoAwayFrame(uint32_t lastStreamId, Http2ErrorCode errorCode, const std::string& debugData = {});
+
+    std::vector<uint8_t> serializeBody() override;
+    uint32_t bodySize() const override { return 8 + (uint32_t)m_debugData.size(); }
+
+protected:
+    void serializeBodyInto(uint8_t* out) const override;
+
+private:
+    uint32_t m_lastStreamId;
+    Http2ErrorCode m_errorCode;
+    std::string m_debugData;
+};
+
+/**
+ * @brief Continuation Frame, the rest of a header block too large for one HEADERS frame
+ */
+class Http2ContinuationFrame : public Http2Frame
+{
+public:
+    static constexpr uint8_t TYPE = 0x09;
+    static constexpr uint8_t END_HEADERS = 0x04;
+
+    /** reference the fragment, it must outlive the frame */
+    Http2ContinuationFrame(uint32_t streamId, std::span<const uint8_t> fragment, bool endHeaders);
+
+    std::vector<uint8_t> serializeBody() override;
+    uint32_t bodySize() const override { return (uint32_t)m_fragment.size(); }
+    size_t serializeIov(Http2IoVec* iov) override;
+
+protected:
+    void serializeBodyInto(uint8_t* out) const override;
+
+private:
+    std::span<const uint8_t> m_fragment;
+};
+
+/**
+ * @brief Priority Update Frame, RFC 9218 priority of a stream sent by the client
+ */
+class Http2PriorityUpdateFrame : public Http2Frame
+{
+public:
+    static constexpr uint8_t TYPE = 0x10;
+
+    /** fieldValue is a priority header value such as "u=1, i" */
+    Http2PriorityUpdateFrame(uint32_t prioritizedStreamId, const std::string& fieldValue);
+
+    std::vector<uint8_t> serializeBody() override;
+    uint32_t bodySize() const override { return 4 + (uint32_t)m_fieldValue.size(); }
+
+protected:
+    void serializeBodyInto(uint8_t* out) const override;
+
+private:
+    uint32_t m_prioritizedStreamId;
+    std::string m_fieldValue;
+};
+
 /**
  *  -------------  --------------
  * | Size 3byte  ||  Type 1byte  |
@@ -156,6 +475,8 @@ private:
  *  -----------------------------
  * |            Data             |
  *  -----------------------------
+ *
+ *  Http2FrameDecoder decodes whole frames out of a byte stream
  */
 class Http2FrameHeadParser 
 {
@@ -173,6 +494,10 @@ public:
     Http2FrameHeadParser(const std::vector<uint8_t>& frameHead);
     void setFrameHead(const std::vector<uint8_t>& frameHead);
 
+    /** head must point at HTTP2_HEAD_SIZE bytes */
+    explicit Http2FrameHeadParser(const uint8_t* head);
+    void setFrameHead(const uint8_t* head);
+
     /** get frame type */
     FrameType getFrameType();
 
@@ -186,5 +511,6 @@ public:
     uint32_t getStreamId();
 
 private:
-    std::vector<uint8_t> m_data;
+    uint8_t m_data[HTTP2_HEAD_SIZE] = {};
+    bool m_valid = false;
 };
\ No newline at end of file
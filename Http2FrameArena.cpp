@@ -0,0 +1,46 @@
+#include "Http2FrameArena.h"
+
+Http2FrameArena::Http2FrameArena(Http2BufferPool& pool, size_t maxFrames):
+    m_pool(pool),
+    m_maxFrames(maxFrames)
+{
+    m_dataFrames.reserve(maxFrames);
+}
+
+std::unique_ptr<Http2DataFrame> Http2FrameArena::dataFrame(uint32_t streamId, std::span<const uint8_t> data)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_dataFrames.empty()) {
+            std::unique_ptr<Http2DataFrame> frame = std::move(m_dataFrames.back());
+            m_dataFrames.pop_back();
+            ++m_stats.framesReused;
+            frame->reset(streamId, data);
+            return frame;
+        }
+        ++m_stats.framesCreated;
+    }
+    return std::make_unique<Http2DataFrame>(streamId, data);
+}
+
+void Http2FrameArena::recycle(std::unique_ptr<Http2Frame> frame)
+{
+    if (!frame || frame->type() != Http2DataFrame::TYPE) {
+        return;
+    }
+    auto data = std::unique_ptr<Http2DataFrame>(static_cast<Http2DataFrame*>(frame.release()));
+    // drop the reference to the caller's payload, it may be freed as soon as the write is done
+    data->reset(0, {});
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_dataFrames.size() < m_maxFrames) {
+        m_dataFrames.push_back(std::move(data));
+    }
+}
+
+Http2FrameArenaStats Http2FrameArena::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Http2FrameArenaStats stats = m_stats;
+    stats.framesIdle = m_dataFrames.size();
+    return stats;
+}
@@ -0,0 +1,68 @@
+/**
+ *   Per-connection arena for Http 2.0 frames
+ *
+ *   Every DATA frame a connection sends is an object the writer owns until
+ *   the bytes are on the wire. The arena keeps those objects once they are
+ *   written and hands them out again for the next DATA, and fronts the
+ *   buffer pool for the read buffer, partial frames the decoder gathers and
+ *   control frame scratch space. In steady state sending and receiving DATA
+ *   does not allocate.
+ *
+ *      auto frame = arena.dataFrame(streamId, payload);     // recycled if one is free
+ *      uint64_t ticket = writer.enqueue(std::move(frame));  // the writer gives it back once written
+ *
+ *   Thread safe: senders take frames while the writer thread returns them.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdint.h>
+#include <stddef.h>
+#include "Http2BufferPool.h"
+#include "Http2Frame.h"
+
+struct Http2FrameArenaStats
+{
+    uint64_t framesCreated = 0;
+    uint64_t framesReused = 0;
+    size_t framesIdle = 0;
+};
+
+class Http2FrameArena
+{
+public:
+    /**
+     * @param pool       where buffers come from
+     * @param maxFrames  idle DATA frames kept, about the number that can be queued in the writer at once
+     */
+    explicit Http2FrameArena(Http2BufferPool& pool = Http2BufferPool::shared(), size_t maxFrames = 256);
+
+    Http2FrameArena(const Http2FrameArena&) = delete;
+    Http2FrameArena& operator=(const Http2FrameArena&) = delete;
+
+    /** a buffer of at least size bytes, back to the pool when it is destroyed */
+    Http2Buffer buffer(size_t size) { return m_pool.acquire(size); }
+
+    /** a DATA frame referencing data, recycled if one is idle */
+    std::unique_ptr<Http2DataFrame> dataFrame(uint32_t streamId, std::span<const uint8_t> data);
+
+    /** a written frame: DATA frames are kept for reuse, others deleted */
+    void recycle(std::unique_ptr<Http2Frame> frame);
+
+    Http2FrameArenaStats stats() const;
+
+private:
+    Http2BufferPool& m_pool;
+    size_t m_maxFrames;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Http2DataFrame>> m_dataFrames;
+    Http2FrameArenaStats m_stats;
+};
@@ -0,0 +1,362 @@
+#include "Http2FrameDecoder.h"
+#include "Http2FrameArena.h"
+#include "PlatformCommonUtils.h"
+#include <string.h>
+#include <algorithm>
+
+static inline uint32_t read_u24(const uint8_t* in)
+{
+    return ((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | (uint32_t)in[2];
+}
+
+static inline uint32_t read_u32(const uint8_t* in)
+{
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | (uint32_t)in[3];
+}
+
+/** Http2FrameView */
+uint16_t Http2FrameView::settingId(size_t index) const
+{
+    const uint8_t* entry = payload.data() + index * 6;
+    return (uint16_t)((entry[0] << 8) | entry[1]);
+}
+
+uint32_t Http2FrameView::settingValue(size_t index) const
+{
+    return read_u32(payload.data() + index * 6 + 2);
+}
+
+/** Http2FrameDecoder */
+Http2FrameDecoder::Http2FrameDecoder(uint32_t maxFrameSize, Http2FrameArena* arena):
+    m_maxFrameSize(HTTP2_DEFAULT_MAX_FRAME_SIZE),
+    m_arena(arena)
+{
+    setMaxFrameSize(maxFrameSize);
+}
+
+void Http2FrameDecoder::reserve(size_t size)
+{
+    if (m_buffer.capacity() >= size) {
+        return;
+    }
+    Http2Buffer buffer = m_arena != nullptr ? m_arena->buffer(size) : Http2BufferPool::shared().acquire(size);
+    if (m_buffered > 0) {
+        memcpy(buffer.data(), m_buffer.data(), m_buffered);
+    }
+    m_buffer = std::move(buffer);
+}
+
+bool Http2FrameDecoder::setMaxFrameSize(uint32_t maxFrameSize)
+{
+    if (maxFrameSize < HTTP2_DEFAULT_MAX_FRAME_SIZE || maxFrameSize > HTTP2_MAX_FRAME_SIZE_LIMIT) {
+        LOG_ERROR("Http2FrameDecoder: max frame size %u out of range", maxFrameSize);
+        return false;
+    }
+    m_maxFrameSize = maxFrameSize;
+    return true;
+}
+
+void Http2FrameDecoder::feed(const uint8_t* data, size_t size)
+{
+    m_input = data;
+    m_inputSize = size;
+}
+
+void Http2FrameDecoder::reset()
+{
+    m_input = nullptr;
+    m_inputSize = 0;
+    m_buffered = 0;
+    m_continuationStream = 0;
+    m_error = Http2ErrorCode::NoError;
+    m_errorMessage = "";
+}
+
+Http2FrameDecoder::Status Http2FrameDecoder::fail(Http2ErrorCode error, const char* message)
+{
+    m_error = error;
+    m_errorMessage = message;
+    m_buffered = 0;
+    m_input = nullptr;
+    m_inputSize = 0;
+    return Error;
+}
+
+Http2FrameDecoder::Status Http2FrameDecoder::next(Http2FrameView& frame)
+{
+    if (m_error != Http2ErrorCode::NoError) {
+        return Error;
+    }
+
+    if (m_buffered == 0) {
+        // fast path: the whole frame is in the chunk, decode it in place
+        if (m_inputSize >= HTTP2_HEAD_SIZE) {
+            if (!checkHead(m_input)) {
+                return Error;
+            }
+            size_t total = HTTP2_HEAD_SIZE + read_u24(m_input);
+            if (m_inputSize >= total) {
+                const uint8_t* start = m_input;
+                m_input += total;
+                m_inputSize -= total;
+                return decode(start, frame) ? Frame : Error;
+            }
+        }
+        if (m_inputSize == 0) {
+            return NeedMore;
+        }
+    }
+
+    // slow path: gather the frame across chunks
+    if (m_buffered < HTTP2_HEAD_SIZE) {
+        reserve(HTTP2_HEAD_SIZE);
+        size_t take = std::min(HTTP2_HEAD_SIZE - m_buffered, m_inputSize);
+        memcpy(m_buffer.data() + m_buffered, m_input, take);
+        m_buffered += take;
+        m_input += take;
+        m_inputSize -= take;
+        if (m_buffered < HTTP2_HEAD_SIZE) {
+            return NeedMore;
+        }
+        if (!checkHead(m_buffer.data())) {
+            return Error;
+        }
+    }
+    size_t total = HTTP2_HEAD_SIZE + read_u24(m_buffer.data());
+    reserve(total);
+    size_t take = std::min(total - m_buffered, m_inputSize);
+    if (take > 0) {
+        memcpy(m_buffer.data() + m_buffered, m_input, take);
+        m_buffered += take;
+        m_input += take;
+        m_inputSize -= take;
+    }
+    if (m_buffered < total) {
+        return NeedMore;
+    }
+    m_buffered = 0;
+    return decode(m_buffer.data(), frame) ? Frame : Error;
+}
+
+bool Http2FrameDecoder::checkHead(const uint8_t* head)
+{
+    uint32_t length = read_u24(head);
+    uint8_t type = head[3];
+    uint8_t flags = head[4];
+    uint32_t streamId = read_u32(head + 5) & 0x7FFFFFFF;
+
+    if (length > m_maxFrameSize) {
+        fail(Http2ErrorCode::FrameSizeError, "frame exceeds SETTINGS_MAX_FRAME_SIZE");
+        return false;
+    }
+    if (m_continuationStream != 0 && (type != (uint8_t)Http2FrameType::Continuation || streamId != m_continuationStream)) {
+        fail(Http2ErrorCode::ProtocolError, "header block interrupted");
+        return false;
+    }
+
+    switch ((Http2FrameType)type) {
+    case Http2FrameType::Data:
+    case Http2FrameType::Headers:
+    case Http2FrameType::Priority:
+    case Http2FrameType::RstStream:
+    case Http2FrameType::PushPromise:
+    case Http2FrameType::Continuation:
+        if (streamId == 0) {
+            fail(Http2ErrorCode::ProtocolError, "frame requires a stream");
+            return false;
+        }
+        break;
+
+    case Http2FrameType::Settings:
+    case Http2FrameType::Ping:
+    case Http2FrameType::GoAway:
+    case Http2FrameType::PriorityUpdate:
+        if (streamId != 0) {
+            fail(Http2ErrorCode::ProtocolError, "connection frame on a stream");
+            return false;
+        }
+        break;
+
+    case Http2FrameType::WindowUpdate:
+    default:
+        break;
+    }
+
+    // fixed sizes are checked on the head so a bad length is not buffered first
+    switch ((Http2FrameType)type) {
+    case Http2FrameType::Priority:
+        if (length != 5) {
+            fail(Http2ErrorCode::FrameSizeError, "PRIORITY length is not 5");
+            return false;
+        }
+        break;
+
+    case Http2FrameType::RstStream:
+    case Http2FrameType::WindowUpdate:
+        if (length != 4) {
+            fail(Http2ErrorCode::FrameSizeError, "RST_STREAM / WINDOW_UPDATE length is not 4");
+            return false;
+        }
+        break;
+
+    case Http2FrameType::Settings:
+        if ((flags & Http2FrameView::FLAG_ACK) ? length != 0 : length % 6 != 0) {
+            fail(Http2ErrorCode::FrameSizeError, "bad SETTINGS length");
+            return false;
+        }
+        break;
+
+    case Http2FrameType::Ping:
+        if (length != 8) {
+            fail(Http2ErrorCode::FrameSizeError, "PING length is not 8");
+            return false;
+        }
+        break;
+
+    case Http2FrameType::GoAway:
+        if (length < 8) {
+            fail(Http2ErrorCode::FrameSizeError, "GOAWAY too short");
+            return false;
+        }
+        break;
+
+    case Http2FrameType::PriorityUpdate:
+        if (length < 4) {
+            fail(Http2ErrorCode::FrameSizeError, "PRIORITY_UPDATE too short");
+            return false;
+        }
+        break;
+
+    default:
+        break;
+    }
+    return true;
+}
+
+bool Http2FrameDecoder::stripPadding(Http2FrameView& view, std::span<const uint8_t>& body)
+{
+    if (!view.hasFlag(Http2FrameView::FLAG_PADDED)) {
+        return true;
+    }
+    if (body.empty()) {
+        fail(Http2ErrorCode::FrameSizeError, "missing pad length");
+        return false;
+    }
+    view.padLength = body[0];
+    body = body.subspan(1);
+    if (view.padLength > body.size()) {
+        fail(Http2ErrorCode::ProtocolError, "padding exceeds the payload");
+        return false;
+    }
+    body = body.first(body.size() - view.padLength);
+    return true;
+}
+
+bool Http2FrameDecoder::decode(const uint8_t* frame, Http2FrameView& view)
+{
+    view = Http2FrameView();
+    view.length = read_u24(frame);
+    view.type = frame[3];
+    view.flags = frame[4];
+    view.streamId = read_u32(frame + 5) & 0x7FFFFFFF;
+    view.payload = std::span<const uint8_t>(frame + HTTP2_HEAD_SIZE, view.length);
+
+    std::span<const uint8_t> body = view.payload;
+    switch (view.frameType()) {
+    case Http2FrameType::Data:
+        if (!stripPadding(view, body)) {
+            return false;
+        }
+        view.data = body;
+        break;
+
+    case Http2FrameType::Headers:
+        if (!stripPadding(view, body)) {
+            return false;
+        }
+        if (view.hasFlag(Http2FrameView::FLAG_PRIORITY)) {
+            if (body.size() < 5) {
+                fail(Http2ErrorCode::FrameSizeError, "HEADERS too short for priority");
+                return false;
+            }
+            uint32_t dependency = read_u32(body.data());
+            view.hasPriority = true;
+            view.exclusive = (dependency & 0x80000000) != 0;
+            view.dependsOn = dependency & 0x7FFFFFFF;
+            view.weight = body[4];
+            body = body.subspan(5);
+        }
+        view.data = body;
+        if (!view.hasFlag(Http2FrameView::FLAG_END_HEADERS)) {
+            m_continuationStream = view.streamId;
+        }
+        break;
+
+    case Http2FrameType::Priority: {
+        uint32_t dependency = read_u32(body.data());
+        view.hasPriority = true;
+        view.exclusive = (dependency & 0x80000000) != 0;
+        view.dependsOn = dependency & 0x7FFFFFFF;
+        view.weight = body[4];
+        break;
+    }
+
+    case Http2FrameType::RstStream:
+        view.errorCode = read_u32(body.data());
+        break;
+
+    case Http2FrameType::Settings:
+        break;
+
+    case Http2FrameType::PushPromise:
+        if (!stripPadding(view, body)) {
+            return false;
+        }
+        if (body.size() < 4) {
+            fail(Http2ErrorCode::FrameSizeError, "PUSH_PROMISE too short");
+            return false;
+        }
+        view.promisedStreamId = read_u32(body.data()) & 0x7FFFFFFF;
+        view.data = body.subspan(4);
+        if (!view.hasFlag(Http2FrameView::FLAG_END_HEADERS)) {
+            m_continuationStream = view.streamId;
+        }
+        break;
+
+    case Http2FrameType::Ping:
+        view.data = body;
+        break;
+
+    case Http2FrameType::GoAway:
+        view.lastStreamId = read_u32(body.data()) & 0x7FFFFFFF;
+        view.errorCode = read_u32(body.data() + 4);
+        view.data = body.subspan(8);
+        break;
+
+    case Http2FrameType::WindowUpdate:
+        view.windowIncrement = read_u32(body.data()) & 0x7FFFFFFF;
+        break;
+
+    case Http2FrameType::PriorityUpdate:
+        view.prioritizedStreamId = read_u32(body.data()) & 0x7FFFFFFF;
+        view.data = body.subspan(4);
+        break;
+
+    case Http2FrameType::Continuation:
+        if (m_continuationStream == 0) {
+            fail(Http2ErrorCode::ProtocolError, "CONTINUATION without a header block");
+            return false;
+        }
+        view.data = body;
+        if (view.hasFlag(Http2FrameView::FLAG_END_HEADERS)) {
+            m_continuationStream = 0;
+        }
+        break;
+
+    default:
+        // unknown types are passed on for the caller to ignore (RFC 9113 4.1)
+        view.data = body;
+        break;
+    }
+    return true;
+}
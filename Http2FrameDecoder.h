@@ -0,0 +1,146 @@
+/**
+ *   Incremental Http 2.0 frame decoder
+ *
+ *   Fed with whatever the socket returned, yields complete frames of every
+ *   RFC 9113 type as views. A frame that arrived whole in one chunk points
+ *   straight into that chunk; only a frame split across chunks is gathered
+ *   in a pooled buffer that is reused, so steady-state decoding does not
+ *   allocate.
+ *
+ *      decoder.feed(buffer, received);
+ *      Http2FrameView frame;
+ *      while (decoder.next(frame) == Http2FrameDecoder::Frame) {
+ *          ...
+ *      }
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <vector>
+#include <span>
+#include <stdint.h>
+#include <stddef.h>
+#include "Http2Frame.h"
+#include "Http2BufferPool.h"
+
+class Http2FrameArena;
+
+/**
+ * @brief A decoded frame, valid until the next call to Http2FrameDecoder::next / feed
+ */
+struct Http2FrameView
+{
+    // common flags
+    static constexpr uint8_t FLAG_END_STREAM = 0x01;
+    static constexpr uint8_t FLAG_ACK = 0x01;
+    static constexpr uint8_t FLAG_END_HEADERS = 0x04;
+    static constexpr uint8_t FLAG_PADDED = 0x08;
+    static constexpr uint8_t FLAG_PRIORITY = 0x20;
+
+    uint32_t length = 0;                // payload length from the head
+    uint8_t type = 0;                   // Http2FrameType, or an unknown type to be ignored
+    uint8_t flags = 0;
+    uint32_t streamId = 0;
+    std::span<const uint8_t> payload;   // whole payload as received
+
+    // DATA: data. HEADERS / PUSH_PROMISE / CONTINUATION: header block fragment.
+    // PING: the 8 opaque bytes. GOAWAY: debug data. PRIORITY_UPDATE: the priority
+    // field value. Padding is already removed.
+    std::span<const uint8_t> data;
+    uint8_t padLength = 0;
+
+    // HEADERS with FLAG_PRIORITY, and PRIORITY
+    bool hasPriority = false;
+    bool exclusive = false;
+    uint32_t dependsOn = 0;
+    uint8_t weight = 0;                 // as sent, the effective weight is weight + 1
+
+    uint32_t errorCode = 0;             // RST_STREAM, GOAWAY
+    uint32_t promisedStreamId = 0;      // PUSH_PROMISE
+    uint32_t lastStreamId = 0;          // GOAWAY
+    uint32_t windowIncrement = 0;       // WINDOW_UPDATE
+    uint32_t prioritizedStreamId = 0;   // PRIORITY_UPDATE
+
+    Http2FrameType frameType() const { return (Http2FrameType)type; }
+    bool is(Http2FrameType frameType) const { return type == (uint8_t)frameType; }
+    bool hasFlag(uint8_t flag) const { return (flags & flag) != 0; }
+
+    /** SETTINGS entries */
+    size_t settingsCount() const { return is(Http2FrameType::Settings) ? payload.size() / 6 : 0; }
+    uint16_t settingId(size_t index) const;
+    uint32_t settingValue(size_t index) const;
+};
+
+class Http2FrameDecoder
+{
+public:
+    enum Status
+    {
+        NeedMore,   // everything fed so far has been consumed
+        Frame,      // a frame was decoded
+        Error       // connection error, see error(); the decoder stays in this state
+    };
+
+    /**
+     * @param arena  where the buffer for frames split across chunks comes from, null: the shared pool
+     */
+    explicit Http2FrameDecoder(uint32_t maxFrameSize = HTTP2_DEFAULT_MAX_FRAME_SIZE, Http2FrameArena* arena = nullptr);
+
+    /**
+     * @brief Largest payload accepted, the SETTINGS_MAX_FRAME_SIZE we advertised
+     * @return false if outside [16384, 16777215]
+     */
+    bool setMaxFrameSize(uint32_t maxFrameSize);
+    uint32_t maxFrameSize() const { return m_maxFrameSize; }
+
+    /**
+     * @brief Queue a chunk for decoding. It is not copied and must stay valid until next() returns NeedMore
+     */
+    void feed(const uint8_t* data, size_t size);
+
+    /** decode the next frame of what was fed */
+    Status next(Http2FrameView& frame);
+
+    Http2ErrorCode error() const { return m_error; }
+    const char* errorMessage() const { return m_errorMessage; }
+
+    /** bytes of a partial frame held back for the next chunk */
+    size_t buffered() const { return m_buffered; }
+
+    /** drop partial input and the error state */
+    void reset();
+
+private:
+    /** check the head of a frame before its payload is gathered */
+    bool checkHead(const uint8_t* head);
+
+    /** fill in the type specific fields */
+    bool decode(const uint8_t* frame, Http2FrameView& view);
+
+    /** strip the pad length field and padding, false if the padding is too long */
+    bool stripPadding(Http2FrameView& view, std::span<const uint8_t>& body);
+
+    Status fail(Http2ErrorCode error, const char* message);
+
+    /** room for size bytes in m_buffer, keeping what is buffered */
+    void reserve(size_t size);
+
+private:
+    uint32_t m_maxFrameSize;
+    Http2FrameArena* m_arena;
+
+    const uint8_t* m_input = nullptr;
+    size_t m_inputSize = 0;
+
+    Http2Buffer m_buffer;               // partial frame, sized once for the largest frame seen
+    size_t m_buffered = 0;
+
+    // a header block is open: only CONTINUATION on this stream may follow
+    uint32_t m_continuationStream = 0;
+
+    Http2ErrorCode m_error = Http2ErrorCode::NoError;
+    const char* m_errorMessage = "";
+};
@@ -0,0 +1,326 @@
+#include "Http2FrameWriter.h"
+#include "Http2FrameArena.h"
+#include "PlatformCommonUtils.h"
+#include "PlatformClock.h"
+#include "CpuTopology.h"
+#include "ThreadTelemetry.h"
+#include <string.h>
+#include <chrono>
+
+// pieces per sendGather call, PlatformEasySocket sends at most this many at once
+static constexpr size_t MAX_GATHER = 64;
+
+/** Http2FrameWriter::Batch */
+uint8_t* Http2FrameWriter::Batch::appendSpace(size_t len)
+{
+    // consecutive copies share one piece, a run of control frames is one iovec
+    if (!pieces.empty() && pieces.back().data == nullptr && pieces.back().offset + pieces.back().size == bytes.size()) {
+        pieces.back().size += len;
+    }
+    else {
+        pieces.push_back({ nullptr, bytes.size(), len });
+    }
+    size_t offset = bytes.size();
+    bytes.resize(offset + len);
+    size += len;
+    return bytes.data() + offset;
+}
+
+void Http2FrameWriter::Batch::clear()
+{
+    bytes.clear();
+    pieces.clear();
+    frames.clear();
+    size = 0;
+}
+
+/** Http2FrameWriter */
+Http2FrameWriter::Http2FrameWriter(IEasySocket& socket, const Http2WriterOptions& options, Http2FrameArena* arena):
+    m_socket(socket),
+    m_options(options),
+    m_arena(arena)
+{
+    m_iov.reserve(MAX_GATHER);
+}
+
+Http2FrameWriter::~Http2FrameWriter()
+{
+    stop(false);
+}
+
+bool Http2FrameWriter::start()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_running) {
+            LOG_ERROR("Http2FrameWriter: already started");
+            return false;
+        }
+        m_running = true;
+        m_stopping = false;
+    }
+    m_writer.setStartHook([] {
+        PlatformCommonUtils::set_current_thread_name("h2-writer");
+        ThreadTelemetry::shared().attach("h2-writer");
+    });
+    if (!m_writer.run([this] { writeLoop(); })) {
+        LOG_ERROR("Http2FrameWriter: failed to start the writer thread");
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        return false;
+    }
+    return true;
+}
+
+void Http2FrameWriter::stop(bool drain)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return;
+        }
+        m_stopping = true;
+        m_drain = drain;
+        m_cond.notify_all();
+    }
+    m_writer.join();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+    m_pending.clear();
+    m_windowUpdates.clear();
+    m_writtenCond.notify_all();
+}
+
+uint64_t Http2FrameWriter::enqueue(Http2Frame& frame)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_running || m_stopping || m_failed) {
+        return 0;
+    }
+    if (!hasWorkLocked()) {
+        m_firstQueuedNs = TscClock::nowNs();
+    }
+    size_t written = frame.frameSize();
+    frame.serializeInto(m_pending.appendSpace(written), written);
+
+    ++m_stats.frames;
+    m_stats.bytes += written;
+    m_pending.lastTicket = ++m_nextTicket;
+    m_cond.notify_one();
+    return m_pending.lastTicket;
+}
+
+uint64_t Http2FrameWriter::enqueue(std::unique_ptr<Http2Frame> frame)
+{
+    Http2IoVec iov[Http2Frame::MAX_IOVECS + 1];
+    size_t count = frame->serializeIov(iov);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_running || m_stopping || m_failed) {
+        return 0;
+    }
+    if (!hasWorkLocked()) {
+        m_firstQueuedNs = TscClock::nowNs();
+    }
+    size_t size = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (iov[i].size == 0) {
+            continue;
+        }
+        // the head and prefix fields are small, copy them next to the frames before
+        if (iov[i].size <= HTTP2_HEAD_SIZE + 6) {
+            memcpy(m_pending.appendSpace(iov[i].size), iov[i].data, iov[i].size);
+        }
+        else {
+            m_pending.pieces.push_back({ iov[i].data, 0, iov[i].size });
+            m_pending.size += iov[i].size;
+        }
+        size += iov[i].size;
+    }
+    m_pending.frames.push_back(std::move(frame));
+
+    ++m_stats.frames;
+    m_stats.bytes += size;
+    m_pending.lastTicket = ++m_nextTicket;
+    m_cond.notify_one();
+    return m_pending.lastTicket;
+}
+
+uint64_t Http2FrameWriter::enqueueRaw(const uint8_t* data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_running || m_stopping || m_failed) {
+        return 0;
+    }
+    if (!hasWorkLocked()) {
+        m_firstQueuedNs = TscClock::nowNs();
+    }
+    memcpy(m_pending.appendSpace(size), data, size);
+    ++m_stats.frames;
+    m_stats.bytes += size;
+    m_pending.lastTicket = ++m_nextTicket;
+    m_cond.notify_one();
+    return m_pending.lastTicket;
+}
+
+void Http2FrameWriter::windowUpdate(uint32_t streamId, uint32_t increment)
+{
+    if (increment == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_running || m_stopping || m_failed) {
+        return;
+    }
+    for (WindowUpdate& update : m_windowUpdates) {
+        if (update.streamId == streamId && (uint64_t)update.increment + increment <= 0x7FFFFFFF) {
+            update.increment += increment;
+            ++m_stats.mergedWindowUpdates;
+            return;
+        }
+    }
+    if (!hasWorkLocked()) {
+        m_firstQueuedNs = TscClock::nowNs();
+    }
+    m_windowUpdates.push_back({ streamId, increment });
+    // window credit unblocks the peer, it is not held back by the cork
+    m_flushRequested = true;
+    m_cond.notify_one();
+}
+
+void Http2FrameWriter::flush()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_flushRequested = true;
+    m_cond.notify_one();
+}
+
+bool Http2FrameWriter::waitWritten(uint64_t ticket)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_writtenCond.wait(lock, [&] {
+        return m_written >= ticket || m_failed || !m_running;
+    });
+    return m_written >= ticket;
+}
+
+Http2WriterStats Http2FrameWriter::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void Http2FrameWriter::writeLoop()
+{
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [&] { return m_stopping || hasWorkLocked(); });
+            if (m_stopping && (!m_drain || !hasWorkLocked())) {
+                break;
+            }
+            if (m_options.corkUs > 0 && !m_stopping) {
+                auto corked = [&] {
+                    return m_stopping || m_flushRequested || m_pending.size >= m_options.maxBatchBytes;
+                };
+                uint64_t deadline = m_firstQueuedNs + (uint64_t)m_options.corkUs * 1000;
+                uint64_t now = TscClock::nowNs();
+                if (now < deadline && !corked()) {
+                    m_cond.wait_for(lock, std::chrono::nanoseconds(deadline - now), corked);
+                }
+            }
+            std::swap(m_pending, m_writing);
+            m_flushRequested = false;
+
+            m_windowBytes.clear();
+            for (const WindowUpdate& update : m_windowUpdates) {
+                Http2WindowUpdateFrame frame(update.streamId, update.increment);
+                frame.serializeInto(m_windowBytes);
+            }
+            if (!m_windowBytes.empty()) {
+                m_stats.frames += m_windowUpdates.size();
+                m_stats.bytes += m_windowBytes.size();
+            }
+            m_windowUpdates.clear();
+            m_writing.lastTicket = m_nextTicket;
+            ++m_stats.batches;
+        }
+
+        // window updates close the batch: never ahead of a frame queued before them, such as the preface
+        if (!m_windowBytes.empty()) {
+            m_writing.pieces.push_back({ m_windowBytes.data(), 0, m_windowBytes.size() });
+        }
+        bool ok = writeBatch(m_writing.pieces, m_writing.bytes.data());
+        if (ok && m_arena != nullptr) {
+            for (std::unique_ptr<Http2Frame>& frame : m_writing.frames) {
+                m_arena->recycle(std::move(frame));
+            }
+        }
+
+        uint64_t written = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!ok) {
+                m_writing.clear();
+                m_pending.clear();
+                m_windowUpdates.clear();
+                m_writtenCond.notify_all();
+                break;
+            }
+            m_written = written = m_writing.lastTicket;
+            m_writing.clear();
+            m_writtenCond.notify_all();
+        }
+        if (m_writtenHook) {
+            m_writtenHook(written);
+        }
+    }
+}
+
+bool Http2FrameWriter::writeBatch(const std::vector<Piece>& pieces, const uint8_t* bytes)
+{
+    size_t index = 0;
+    size_t skip = 0;    // already sent from pieces[index]
+    while (index < pieces.size()) {
+        m_iov.clear();
+        for (size_t i = index; i < pieces.size() && m_iov.size() < MAX_GATHER; ++i) {
+            const uint8_t* data = pieces[i].data != nullptr ? pieces[i].data : bytes + pieces[i].offset;
+            size_t offset = i == index ? skip : 0;
+            m_iov.push_back({ data + offset, pieces[i].size - offset });
+        }
+
+        std::optional<int> sent = m_socket.sendGather(m_iov.data(), (int)m_iov.size());
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_stats.syscalls;
+        }
+        if (!sent || *sent <= 0) {
+            fail();
+            return false;
+        }
+
+        size_t remaining = (size_t)*sent;
+        while (remaining > 0 && index < pieces.size()) {
+            size_t left = pieces[index].size - skip;
+            if (remaining < left) {
+                skip += remaining;
+                remaining = 0;
+            }
+            else {
+                remaining -= left;
+                skip = 0;
+                ++index;
+            }
+        }
+    }
+    return true;
+}
+
+void Http2FrameWriter::fail()
+{
+    if (!m_failed.exchange(true)) {
+        LOG_ERROR("Http2FrameWriter: socket write failed, dropping queued frames");
+        // the reader notices the dead socket and tears the connection down
+        m_socket.interrupt();
+    }
+}
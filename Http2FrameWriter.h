@@ -0,0 +1,166 @@
+/**
+ *   Coalescing Http 2.0 frame writer
+ *
+ *   Frames from any thread are queued per connection and a writer thread
+ *   sends them in batches with one gather write. Small frames are copied
+ *   back to back into one buffer, large DATA / HEADERS payloads are
+ *   referenced in place. WINDOW_UPDATEs for the same stream are merged into
+ *   one frame and go out at the end of the next batch. A batch is sent as
+ *   soon as the writer is free, or held for up to corkUs to collect more
+ *   frames unless maxBatchBytes is queued first.
+ *
+ *      Http2FrameWriter writer(socket);
+ *      writer.start();
+ *      writer.enqueue(pingAck);                            // copied
+ *      uint64_t ticket = writer.enqueue(std::make_unique<Http2DataFrame>(id, payload));
+ *      writer.waitWritten(ticket);                         // payload may be released now
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+#include "IEasySocket.h"
+#include "CThread.hpp"
+#include "Http2Frame.h"
+
+class Http2FrameArena;
+
+struct Http2WriterOptions
+{
+    size_t maxBatchBytes = 64 * 1024;   // a corked batch is sent once this much is queued
+    uint32_t corkUs = 0;                // hold a partial batch this long for more frames, 0 sends at once
+    size_t maxQueuedData = 128 * 1024;  // DATA a connection keeps queued here, the priority scheduler fills the room
+};
+
+struct Http2WriterStats
+{
+    uint64_t frames = 0;                // frames and raw writes queued
+    uint64_t bytes = 0;
+    uint64_t batches = 0;
+    uint64_t syscalls = 0;              // sendGather calls, more than batches only on partial writes
+    uint64_t mergedWindowUpdates = 0;   // WINDOW_UPDATEs folded into one already queued
+};
+
+class Http2FrameWriter
+{
+public:
+    /**
+     * @param arena  written frames are handed back to it for reuse, null deletes them
+     */
+    explicit Http2FrameWriter(IEasySocket& socket, const Http2WriterOptions& options = {}, Http2FrameArena* arena = nullptr);
+    ~Http2FrameWriter();
+
+    Http2FrameWriter(const Http2FrameWriter&) = delete;
+    Http2FrameWriter& operator=(const Http2FrameWriter&) = delete;
+
+    /** called on the writer thread with the last ticket of each batch once it is sent, set before start() */
+    void setWrittenHook(std::function<void(uint64_t ticket)> hook) { m_writtenHook = std::move(hook); }
+
+    bool start();
+
+    /**
+     * @brief       Stop the writer thread
+     * @param drain send what is queued first
+     */
+    void stop(bool drain = true);
+
+    /**
+     * @brief  Queue a copy of the frame, it can be reused as soon as this returns
+     * @return ticket for waitWritten, 0 if the writer is stopped or failed
+     */
+    uint64_t enqueue(Http2Frame& frame);
+
+    /**
+     * @brief  Queue a frame without copying its payload; the writer owns the frame until it is sent,
+     *         memory the frame only references must stay valid until waitWritten(ticket) returns
+     */
+    uint64_t enqueue(std::unique_ptr<Http2Frame> frame);
+
+    /** queue bytes as they are: the client preface, or frames that must stay together such as a header block */
+    uint64_t enqueueRaw(const uint8_t* data, size_t size);
+
+    /** add to the WINDOW_UPDATE pending for streamId, or queue one */
+    void windowUpdate(uint32_t streamId, uint32_t increment);
+
+    /** send what is queued without waiting out the cork */
+    void flush();
+
+    /** wait until everything up to ticket is handed to the socket, false if the writer failed or stopped first */
+    bool waitWritten(uint64_t ticket);
+
+    bool failed() const { return m_failed.load(std::memory_order_acquire); }
+    Http2WriterStats stats() const;
+    const Http2WriterOptions& options() const { return m_options; }
+
+private:
+    struct Piece
+    {
+        const uint8_t* data = nullptr;  // null: bytes at offset in the batch buffer
+        size_t offset = 0;
+        size_t size = 0;
+    };
+
+    struct Batch
+    {
+        std::vector<uint8_t> bytes;                         // copied frames, back to back
+        std::vector<Piece> pieces;
+        std::vector<std::unique_ptr<Http2Frame>> frames;    // owned until sent
+        size_t size = 0;
+        uint64_t lastTicket = 0;
+
+        /** room for len copied bytes at the end of the batch */
+        uint8_t* appendSpace(size_t len);
+        void clear();
+    };
+
+    struct WindowUpdate
+    {
+        uint32_t streamId;
+        uint32_t increment;
+    };
+
+    void writeLoop();
+    bool hasWorkLocked() const { return m_pending.size > 0 || !m_windowUpdates.empty(); }
+
+    /** send every piece of the batch, looping over partial writes */
+    bool writeBatch(const std::vector<Piece>& pieces, const uint8_t* bytes);
+    void fail();
+
+private:
+    IEasySocket& m_socket;
+    Http2WriterOptions m_options;
+    Http2FrameArena* m_arena;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;         // writer: work queued
+    std::condition_variable m_writtenCond;  // callers: a batch was sent
+    Batch m_pending;
+    std::vector<WindowUpdate> m_windowUpdates;
+    uint64_t m_nextTicket = 0;
+    uint64_t m_written = 0;
+    uint64_t m_firstQueuedNs = 0;
+    bool m_flushRequested = false;
+    bool m_running = false;
+    bool m_stopping = false;
+    bool m_drain = true;
+    Http2WriterStats m_stats;
+
+    // writer thread only
+    Batch m_writing;
+    std::vector<uint8_t> m_windowBytes;
+    std::vector<EasyIoVec> m_iov;
+
+    std::function<void(uint64_t)> m_writtenHook;
+    CThread<void> m_writer;
+    std::atomic_bool m_failed{ false };
+};
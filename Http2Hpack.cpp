@@ -0,0 +1,717 @@
+#include "Http2Hpack.h"
+#include "Http2FrameDecoder.h"
+#include "PlatformCommonUtils.h"
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+    struct StaticEntry
+    {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    // RFC 7541 Appendix A, index 1..61
+    const StaticEntry STATIC_TABLE[Hpack::STATIC_TABLE_SIZE] = {
+        { ":authority", "" },
+        { ":method", "GET" },
+        { ":method", "POST" },
+        { ":path", "/" },
+        { ":path", "/index.html" },
+        { ":scheme", "http" },
+        { ":scheme", "https" },
+        { ":status", "200" },
+        { ":status", "204" },
+        { ":status", "206" },
+        { ":status", "304" },
+        { ":status", "400" },
+        { ":status", "404" },
+        { ":status", "500" },
+        { "accept-charset", "" },
+        { "accept-encoding", "gzip, deflate" },
+        { "accept-language", "" },
+        { "accept-ranges", "" },
+        { "accept", "" },
+        { "access-control-allow-origin", "" },
+        { "age", "" },
+        { "allow", "" },
+        { "authorization", "" },
+        { "cache-control", "" },
+        { "content-disposition", "" },
+        { "content-encoding", "" },
+        { "content-language", "" },
+        { "content-length", "" },
+        { "content-location", "" },
+        { "content-range", "" },
+        { "content-type", "" },
+        { "cookie", "" },
+        { "date", "" },
+        { "etag", "" },
+        { "expect", "" },
+        { "expires", "" },
+        { "from", "" },
+        { "host", "" },
+        { "if-match", "" },
+        { "if-modified-since", "" },
+        { "if-none-match", "" },
+        { "if-range", "" },
+        { "if-unmodified-since", "" },
+        { "last-modified", "" },
+        { "link", "" },
+        { "location", "" },
+        { "max-forwards", "" },
+        { "proxy-authenticate", "" },
+        { "proxy-authorization", "" },
+        { "range", "" },
+        { "referer", "" },
+        { "refresh", "" },
+        { "retry-after", "" },
+        { "server", "" },
+        { "set-cookie", "" },
+        { "strict-transport-security", "" },
+        { "transfer-encoding", "" },
+        { "user-agent", "" },
+        { "vary", "" },
+        { "via", "" },
+        { "www-authenticate", "" },
+    };
+
+    struct HuffmanCode
+    {
+        uint32_t code;
+        uint8_t bits;
+    };
+
+    // RFC 7541 Appendix B, symbol 256 is EOS
+    const HuffmanCode HUFFMAN_CODES[257] = {
+        { 0x1ff8, 13 }, { 0x7fffd8, 23 }, { 0xfffffe2, 28 }, { 0xfffffe3, 28 },
+        { 0xfffffe4, 28 }, { 0xfffffe5, 28 }, { 0xfffffe6, 28 }, { 0xfffffe7, 28 },
+        { 0xfffffe8, 28 }, { 0xffffea, 24 }, { 0x3ffffffc, 30 }, { 0xfffffe9, 28 },
+        { 0xfffffea, 28 }, { 0x3ffffffd, 30 }, { 0xfffffeb, 28 }, { 0xfffffec, 28 },
+        { 0xfffffed, 28 }, { 0xfffffee, 28 }, { 0xfffffef, 28 }, { 0xffffff0, 28 },
+        { 0xffffff1, 28 }, { 0xffffff2, 28 }, { 0x3ffffffe, 30 }, { 0xffffff3, 28 },
+        { 0xffffff4, 28 }, { 0xffffff5, 28 }, { 0xffffff6, 28 }, { 0xffffff7, 28 },
+        { 0xffffff8, 28 }, { 0xffffff9, 28 }, { 0xffffffa, 28 }, { 0xffffffb, 28 },
+        { 0x14, 6 }, { 0x3f8, 10 }, { 0x3f9, 10 }, { 0xffa, 12 },
+        { 0x1ff9, 13 }, { 0x15, 6 }, { 0xf8, 8 }, { 0x7fa, 11 },
+        { 0x3fa, 10 }, { 0x3fb, 10 }, { 0xf9, 8 }, { 0x7fb, 11 },
+        { 0xfa, 8 }, { 0x16, 6 }, { 0x17, 6 }, { 0x18, 6 },
+        { 0x0, 5 }, { 0x1, 5 }, { 0x2, 5 }, { 0x19, 6 },
+        { 0x1a, 6 }, { 0x1b, 6 }, { 0x1c, 6 }, { 0x1d, 6 },
+        { 0x1e, 6 }, { 0x1f, 6 }, { 0x5c, 7 }, { 0xfb, 8 },
+        { 0x7ffc, 15 }, { 0x20, 6 }, { 0xffb, 12 }, { 0x3fc, 10 },
+        { 0x1ffa, 13 }, { 0x21, 6 }, { 0x5d, 7 }, { 0x5e, 7 },
+        { 0x5f, 7 }, { 0x60, 7 }, { 0x61, 7 }, { 0x62, 7 },
+        { 0x63, 7 }, { 0x64, 7 }, { 0x65, 7 }, { 0x66, 7 },
+        { 0x67, 7 }, { 0x68, 7 }, { 0x69, 7 }, { 0x6a, 7 },
+        { 0x6b, 7 }, { 0x6c, 7 }, { 0x6d, 7 }, { 0x6e, 7 },
+        { 0x6f, 7 }, { 0x70, 7 }, { 0x71, 7 }, { 0x72, 7 },
+        { 0xfc, 8 }, { 0x73, 7 }, { 0xfd, 8 }, { 0x1ffb, 13 },
+        { 0x7fff0, 19 }, { 0x1ffc, 13 }, { 0x3ffc, 14 }, { 0x22, 6 },
+        { 0x7ffd, 15 }, { 0x3, 5 }, { 0x23, 6 }, { 0x4, 5 },
+        { 0x24, 6 }, { 0x5, 5 }, { 0x25, 6 }, { 0x26, 6 },
+        { 0x27, 6 }, { 0x6, 5 }, { 0x74, 7 }, { 0x75, 7 },
+        { 0x28, 6 }, { 0x29, 6 }, { 0x2a, 6 }, { 0x7, 5 },
+        { 0x2b, 6 }, { 0x76, 7 }, { 0x2c, 6 }, { 0x8, 5 },
+        { 0x9, 5 }, { 0x2d, 6 }, { 0x77, 7 }, { 0x78, 7 },
+        { 0x79, 7 }, { 0x7a, 7 }, { 0x7b, 7 }, { 0x7ffe, 15 },
+        { 0x7fc, 11 }, { 0x3ffd, 14 }, { 0x1ffd, 13 }, { 0xffffffc, 28 },
+        { 0xfffe6, 20 }, { 0x3fffd2, 22 }, { 0xfffe7, 20 }, { 0xfffe8, 20 },
+        { 0x3fffd3, 22 }, { 0x3fffd4, 22 }, { 0x3fffd5, 22 }, { 0x7fffd9, 23 },
+        { 0x3fffd6, 22 }, { 0x7fffda, 23 }, { 0x7fffdb, 23 }, { 0x7fffdc, 23 },
+        { 0x7fffdd, 23 }, { 0x7fffde, 23 }, { 0xffffeb, 24 }, { 0x7fffdf, 23 },
+        { 0xffffec, 24 }, { 0xffffed, 24 }, { 0x3fffd7, 22 }, { 0x7fffe0, 23 },
+        { 0xffffee, 24 }, { 0x7fffe1, 23 }, { 0x7fffe2, 23 }, { 0x7fffe3, 23 },
+        { 0x7fffe4, 23 }, { 0x1fffdc, 21 }, { 0x3fffd8, 22 }, { 0x7fffe5, 23 },
+        { 0x3fffd9, 22 }, { 0x7fffe6, 23 }, { 0x7fffe7, 23 }, { 0xffffef, 24 },
+        { 0x3fffda, 22 }, { 0x1fffdd, 21 }, { 0xfffe9, 20 }, { 0x3fffdb, 22 },
+        { 0x3fffdc, 22 }, { 0x7fffe8, 23 }, { 0x7fffe9, 23 }, { 0x1fffde, 21 },
+        { 0x7fffea, 23 }, { 0x3fffdd, 22 }, { 0x3fffde, 22 }, { 0xfffff0, 24 },
+        { 0x1fffdf, 21 }, { 0x3fffdf, 22 }, { 0x7fffeb, 23 }, { 0x7fffec, 23 },
+        { 0x1fffe0, 21 }, { 0x1fffe1, 21 }, { 0x3fffe0, 22 }, { 0x1fffe2, 21 },
+        { 0x7fffed, 23 }, { 0x3fffe1, 22 }, { 0x7fffee, 23 }, { 0x7fffef, 23 },
+        { 0xfffea, 20 }, { 0x3fffe2, 22 }, { 0x3fffe3, 22 }, { 0x3fffe4, 22 },
+        { 0x7ffff0, 23 }, { 0x3fffe5, 22 }, { 0x3fffe6, 22 }, { 0x7ffff1, 23 },
+        { 0x3ffffe0, 26 }, { 0x3ffffe1, 26 }, { 0xfffeb, 20 }, { 0x7fff1, 19 },
+        { 0x3fffe7, 22 }, { 0x7ffff2, 23 }, { 0x3fffe8, 22 }, { 0x1ffffec, 25 },
+        { 0x3ffffe2, 26 }, { 0x3ffffe3, 26 }, { 0x3ffffe4, 26 }, { 0x7ffffde, 27 },
+        { 0x7ffffdf, 27 }, { 0x3ffffe5, 26 }, { 0xfffff1, 24 }, { 0x1ffffed, 25 },
+        { 0x7fff2, 19 }, { 0x1fffe3, 21 }, { 0x3ffffe6, 26 }, { 0x7ffffe0, 27 },
+        { 0x7ffffe1, 27 }, { 0x3ffffe7, 26 }, { 0x7ffffe2, 27 }, { 0xfffff2, 24 },
+        { 0x1fffe4, 21 }, { 0x1fffe5, 21 }, { 0x3ffffe8, 26 }, { 0x3ffffe9, 26 },
+        { 0xffffffd, 28 }, { 0x7ffffe3, 27 }, { 0x7ffffe4, 27 }, { 0x7ffffe5, 27 },
+        { 0xfffec, 20 }, { 0xfffff3, 24 }, { 0xfffed, 20 }, { 0x1fffe6, 21 },
+        { 0x3fffe9, 22 }, { 0x1fffe7, 21 }, { 0x1fffe8, 21 }, { 0x7ffff3, 23 },
+        { 0x3fffea, 22 }, { 0x3fffeb, 22 }, { 0x1ffffee, 25 }, { 0x1ffffef, 25 },
+        { 0xfffff4, 24 }, { 0xfffff5, 24 }, { 0x3ffffea, 26 }, { 0x7ffff4, 23 },
+        { 0x3ffffeb, 26 }, { 0x7ffffe6, 27 }, { 0x3ffffec, 26 }, { 0x3ffffed, 26 },
+        { 0x7ffffe7, 27 }, { 0x7ffffe8, 27 }, { 0x7ffffe9, 27 }, { 0x7ffffea, 27 },
+        { 0x7ffffeb, 27 }, { 0xffffffe, 28 }, { 0x7ffffec, 27 }, { 0x7ffffed, 27 },
+        { 0x7ffffee, 27 }, { 0x7ffffef, 27 }, { 0x7fffff0, 27 }, { 0x3ffffee, 26 },
+        { 0x3fffffff, 30 },
+    };
+
+    /**
+     * The decoder consumes 4 bits per step. A state is an internal node of the
+     * code tree (256 of them, the root is 0); no code is shorter than 5 bits so
+     * a step emits at most one symbol.
+     */
+    enum HuffmanFlags : uint8_t
+    {
+        HUFFMAN_EMIT = 0x01,
+        HUFFMAN_FAIL = 0x02,
+        HUFFMAN_ACCEPT = 0x04,  // the bits since the last symbol are valid padding
+    };
+
+    struct HuffmanStep
+    {
+        uint8_t state;
+        uint8_t flags;
+        uint8_t symbol;
+    };
+
+    struct HuffmanDecodeTable
+    {
+        HuffmanStep steps[256][16];
+
+        HuffmanDecodeTable()
+        {
+            // build the tree: children >= 0 are internal nodes, < 0 are leaves -(symbol + 1)
+            struct Node
+            {
+                int child[2] = { 0, 0 };
+                int depth = 0;
+                bool ones = true;
+            };
+            std::vector<Node> nodes(1);
+            for (int symbol = 0; symbol < 257; ++symbol) {
+                int current = 0;
+                const HuffmanCode& code = HUFFMAN_CODES[symbol];
+                for (int bit = code.bits - 1; bit >= 0; --bit) {
+                    int branch = (code.code >> bit) & 1;
+                    if (bit == 0) {
+                        nodes[current].child[branch] = -(symbol + 1);
+                        break;
+                    }
+                    if (nodes[current].child[branch] == 0) {
+                        Node node;
+                        node.depth = nodes[current].depth + 1;
+                        node.ones = nodes[current].ones && branch == 1;
+                        nodes[current].child[branch] = (int)nodes.size();
+                        nodes.push_back(node);
+                    }
+                    current = nodes[current].child[branch];
+                }
+            }
+
+            for (size_t state = 0; state < nodes.size(); ++state) {
+                for (int nibble = 0; nibble < 16; ++nibble) {
+                    HuffmanStep step = { 0, 0, 0 };
+                    int current = (int)state;
+                    for (int bit = 3; bit >= 0; --bit) {
+                        int next = nodes[current].child[(nibble >> bit) & 1];
+                        if (next < 0) {
+                            if (next == -257) {
+                                step.flags = HUFFMAN_FAIL;  // EOS inside a string
+                                break;
+                            }
+                            step.flags |= HUFFMAN_EMIT;
+                            step.symbol = (uint8_t)(-next - 1);
+                            current = 0;
+                        }
+                        else {
+                            current = next;
+                        }
+                    }
+                    if (!(step.flags & HUFFMAN_FAIL)) {
+                        step.state = (uint8_t)current;
+                        if (nodes[current].ones && nodes[current].depth <= 7) {
+                            step.flags |= HUFFMAN_ACCEPT;
+                        }
+                    }
+                    steps[state][nibble] = step;
+                }
+            }
+        }
+    };
+
+    const HuffmanDecodeTable& huffman_decode_table()
+    {
+        static const HuffmanDecodeTable table;
+        return table;
+    }
+
+    // field -> lowest static index, and name -> lowest static index
+    struct StaticLookup
+    {
+        std::unordered_map<std::string, size_t> fields;
+        std::unordered_map<std::string_view, size_t> names;
+
+        StaticLookup()
+        {
+            for (size_t i = Hpack::STATIC_TABLE_SIZE; i > 0; --i) {
+                const StaticEntry& entry = STATIC_TABLE[i - 1];
+                names[entry.name] = i;
+                if (!entry.value.empty()) {
+                    fields[std::string(entry.name) + '\0' + std::string(entry.value)] = i;
+                }
+            }
+        }
+    };
+
+    const StaticLookup& static_lookup()
+    {
+        static const StaticLookup lookup;
+        return lookup;
+    }
+}
+
+/** Hpack */
+std::string_view Hpack::static_name(size_t index)
+{
+    return index >= 1 && index <= STATIC_TABLE_SIZE ? STATIC_TABLE[index - 1].name : std::string_view();
+}
+
+std::string_view Hpack::static_value(size_t index)
+{
+    return index >= 1 && index <= STATIC_TABLE_SIZE ? STATIC_TABLE[index - 1].value : std::string_view();
+}
+
+void Hpack::encode_integer(std::vector<uint8_t>& out, uint64_t value, uint8_t prefixBits, uint8_t first)
+{
+    uint8_t limit = (uint8_t)((1u << prefixBits) - 1);
+    if (value < limit) {
+        out.push_back(first | (uint8_t)value);
+        return;
+    }
+    out.push_back(first | limit);
+    value -= limit;
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+bool Hpack::decode_integer(const uint8_t*& data, const uint8_t* end, uint8_t prefixBits, uint64_t& value)
+{
+    if (data >= end) {
+        return false;
+    }
+    uint8_t limit = (uint8_t)((1u << prefixBits) - 1);
+    value = *data++ & limit;
+    if (value < limit) {
+        return true;
+    }
+    // a 32-bit value needs at most 5 continuation bytes, more is padding a peer could shift out of range
+    for (int shift = 0; data < end && shift <= 28; shift += 7) {
+        uint8_t byte = *data++;
+        value += (uint64_t)(byte & 0x7F) << shift;
+        if (value > 0xFFFFFFFFull) {
+            return false;
+        }
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t Hpack::huffman_encoded_size(std::string_view value)
+{
+    uint64_t bits = 0;
+    for (unsigned char c : value) {
+        bits += HUFFMAN_CODES[c].bits;
+    }
+    return (size_t)((bits + 7) / 8);
+}
+
+void Hpack::huffman_encode(std::string_view value, std::vector<uint8_t>& out)
+{
+    size_t offset = out.size();
+    out.resize(offset + huffman_encoded_size(value));
+    uint8_t* dst = out.data() + offset;
+    uint64_t pending = 0;
+    int pendingBits = 0;
+    for (unsigned char c : value) {
+        const HuffmanCode& code = HUFFMAN_CODES[c];
+        pending = (pending << code.bits) | code.code;
+        pendingBits += code.bits;
+        while (pendingBits >= 8) {
+            pendingBits -= 8;
+            *dst++ = (uint8_t)(pending >> pendingBits);
+        }
+    }
+    if (pendingBits > 0) {
+        // pad with the most significant bits of EOS, all ones
+        *dst++ = (uint8_t)((pending << (8 - pendingBits)) | (0xFF >> pendingBits));
+    }
+}
+
+bool Hpack::huffman_decode(const uint8_t* data, size_t size, std::string& out)
+{
+    const HuffmanDecodeTable& table = huffman_decode_table();
+    // codes are at least 5 bits long
+    out.reserve(out.size() + size * 8 / 5);
+    uint8_t state = 0;
+    bool accept = true;
+    for (size_t i = 0; i < size; ++i) {
+        for (int nibble : { data[i] >> 4, data[i] & 0x0F }) {
+            const HuffmanStep& step = table.steps[state][nibble];
+            if (step.flags & HUFFMAN_FAIL) {
+                return false;
+            }
+            if (step.flags & HUFFMAN_EMIT) {
+                out.push_back((char)step.symbol);
+            }
+            state = step.state;
+            accept = (step.flags & HUFFMAN_ACCEPT) != 0;
+        }
+    }
+    return accept;
+}
+
+/** HpackDynamicTable */
+HpackDynamicTable::HpackDynamicTable(uint32_t maxSize):
+    m_ring(16),
+    m_maxSize(maxSize)
+{
+}
+
+void HpackDynamicTable::evictOldest()
+{
+    if (m_count == 0) {
+        return;
+    }
+    const Entry& entry = m_ring[m_first];
+    m_size -= entrySize(entry.name, entry.value);
+    m_first = (m_first + 1) & (m_ring.size() - 1);
+    --m_count;
+}
+
+void HpackDynamicTable::add(std::string_view name, std::string_view value)
+{
+    size_t size = entrySize(name, value);
+    while (m_count > 0 && m_size + size > m_maxSize) {
+        evictOldest();
+    }
+    ++m_inserted;
+    if (size > m_maxSize) {
+        return;
+    }
+    if (m_count == m_ring.size()) {
+        std::vector<Entry> ring(m_ring.size() * 2);
+        for (size_t i = 0; i < m_count; ++i) {
+            ring[i] = std::move(m_ring[(m_first + i) & (m_ring.size() - 1)]);
+        }
+        m_ring.swap(ring);
+        m_first = 0;
+    }
+    Entry& slot = m_ring[(m_first + m_count) & (m_ring.size() - 1)];
+    slot.name.assign(name.data(), name.size());
+    slot.value.assign(value.data(), value.size());
+    ++m_count;
+    m_size += size;
+}
+
+void HpackDynamicTable::setMaxSize(uint32_t maxSize)
+{
+    m_maxSize = maxSize;
+    while (m_size > m_maxSize) {
+        evictOldest();
+    }
+}
+
+/** HpackEncoder */
+HpackEncoder::HpackEncoder(uint32_t maxTableSize):
+    m_table(maxTableSize),
+    m_smallestTableSize(maxTableSize)
+{
+}
+
+void HpackEncoder::setMaxTableSize(uint32_t maxTableSize)
+{
+    // the smallest size since the last block must be announced too (RFC 7541 4.2)
+    m_smallestTableSize = m_sizeUpdatePending ? std::min(m_smallestTableSize, maxTableSize) : maxTableSize;
+    m_sizeUpdatePending = true;
+    while (m_table.size() > maxTableSize) {
+        forgetOldest();
+    }
+    m_table.setMaxSize(maxTableSize);
+}
+
+void HpackEncoder::encode(const Http2HeaderList& headers, std::vector<uint8_t>& out)
+{
+    if (m_sizeUpdatePending) {
+        if (m_smallestTableSize < m_table.maxSize()) {
+            Hpack::encode_integer(out, m_smallestTableSize, 5, 0x20);
+        }
+        Hpack::encode_integer(out, m_table.maxSize(), 5, 0x20);
+        m_sizeUpdatePending = false;
+    }
+    for (const Http2Header& header : headers) {
+        encodeField(header, out);
+    }
+}
+
+size_t HpackEncoder::dynamicIndex(uint64_t id) const
+{
+    uint64_t inserted = m_table.insertCount();
+    if (id + m_table.count() < inserted) {
+        return 0;
+    }
+    return Hpack::STATIC_TABLE_SIZE + (size_t)(inserted - id);
+}
+
+bool HpackEncoder::shouldIndex(const Http2Header& header) const
+{
+    if (header.sensitive || m_indexing == HpackIndexing::Never) {
+        return false;
+    }
+    if (m_indexing == HpackIndexing::Always) {
+        return true;
+    }
+    if (HpackDynamicTable::entrySize(header.name, header.value) > m_table.maxSize() / 2) {
+        return false;
+    }
+    return header.name != "authorization" && header.name != "proxy-authorization" && header.name != "set-cookie";
+}
+
+void HpackEncoder::encodeField(const Http2Header& header, std::vector<uint8_t>& out)
+{
+    const StaticLookup& statics = static_lookup();
+    m_key.assign(header.name);
+    m_key.push_back('\0');
+    m_key.append(header.value);
+
+    size_t nameIndex = 0;
+    if (!header.sensitive) {
+        auto field = statics.fields.find(m_key);
+        if (field != statics.fields.end()) {
+            Hpack::encode_integer(out, field->second, 7, 0x80);
+            return;
+        }
+        if (m_indexing != HpackIndexing::Never) {
+            auto dynamic = m_fields.find(m_key);
+            if (dynamic != m_fields.end()) {
+                if (size_t index = dynamicIndex(dynamic->second)) {
+                    Hpack::encode_integer(out, index, 7, 0x80);
+                    return;
+                }
+            }
+        }
+    }
+
+    auto name = statics.names.find(header.name);
+    if (name != statics.names.end()) {
+        nameIndex = name->second;
+    }
+    else if (m_indexing != HpackIndexing::Never) {
+        auto dynamic = m_names.find(header.name);
+        if (dynamic != m_names.end()) {
+            nameIndex = dynamicIndex(dynamic->second);
+        }
+    }
+
+    bool index = shouldIndex(header);
+    if (index) {
+        Hpack::encode_integer(out, nameIndex, 6, 0x40);
+    }
+    else {
+        Hpack::encode_integer(out, nameIndex, 4, header.sensitive ? 0x10 : 0x00);
+    }
+    if (nameIndex == 0) {
+        encodeString(header.name, out);
+    }
+    encodeString(header.value, out);
+    if (index) {
+        addEntry(header.name, header.value);
+    }
+}
+
+void HpackEncoder::encodeString(std::string_view value, std::vector<uint8_t>& out)
+{
+    bool huffman = m_huffman == HpackHuffman::Always;
+    size_t huffmanSize = 0;
+    if (m_huffman == HpackHuffman::Shorter) {
+        huffmanSize = Hpack::huffman_encoded_size(value);
+        huffman = huffmanSize < value.size();
+    }
+    if (huffman) {
+        if (huffmanSize == 0) {
+            huffmanSize = Hpack::huffman_encoded_size(value);
+        }
+        Hpack::encode_integer(out, huffmanSize, 7, 0x80);
+        Hpack::huffman_encode(value, out);
+    }
+    else {
+        Hpack::encode_integer(out, value.size(), 7, 0x00);
+        out.insert(out.end(), value.begin(), value.end());
+    }
+}
+
+void HpackEncoder::forgetOldest()
+{
+    const HpackDynamicTable::Entry& entry = m_table.oldest();
+    uint64_t id = m_table.insertCount() - m_table.count();
+    m_key.assign(entry.name);
+    m_key.push_back('\0');
+    m_key.append(entry.value);
+    auto field = m_fields.find(m_key);
+    if (field != m_fields.end() && field->second == id) {
+        m_fields.erase(field);
+    }
+    auto name = m_names.find(entry.name);
+    if (name != m_names.end() && name->second == id) {
+        m_names.erase(name);
+    }
+    m_table.evictOldest();
+}
+
+void HpackEncoder::addEntry(std::string_view name, std::string_view value)
+{
+    size_t size = HpackDynamicTable::entrySize(name, value);
+    while (m_table.count() > 0 && m_table.size() + size > m_table.maxSize()) {
+        forgetOldest();
+    }
+    m_table.add(name, value);
+    if (size <= m_table.maxSize()) {
+        uint64_t id = m_table.insertCount() - 1;
+        std::string key(name);
+        m_names[key] = id;
+        key.push_back('\0');
+        key.append(value);
+        m_fields[std::move(key)] = id;
+    }
+}
+
+/** HpackDecoder */
+HpackDecoder::HpackDecoder(uint32_t maxTableSize):
+    m_table(maxTableSize),
+    m_maxTableSize(maxTableSize)
+{
+}
+
+void HpackDecoder::setMaxTableSize(uint32_t maxTableSize)
+{
+    m_maxTableSize = maxTableSize;
+    if (m_table.maxSize() > maxTableSize) {
+        m_table.setMaxSize(maxTableSize);
+    }
+}
+
+bool HpackDecoder::readString(const uint8_t*& data, const uint8_t* end, std::string& out)
+{
+    if (data >= end) {
+        return false;
+    }
+    bool huffman = (*data & 0x80) != 0;
+    uint64_t length = 0;
+    if (!Hpack::decode_integer(data, end, 7, length) || length > (uint64_t)(end - data)) {
+        return false;
+    }
+    out.clear();
+    bool ok = true;
+    if (huffman) {
+        ok = Hpack::huffman_decode(data, (size_t)length, out);
+    }
+    else {
+        out.assign((const char*)data, (size_t)length);
+    }
+    data += length;
+    return ok;
+}
+
+bool HpackDecoder::lookup(uint64_t index, std::string& name, std::string* value)
+{
+    if (index == 0) {
+        return false;
+    }
+    if (index <= Hpack::STATIC_TABLE_SIZE) {
+        name.assign(Hpack::static_name((size_t)index));
+        if (value != nullptr) {
+            value->assign(Hpack::static_value((size_t)index));
+        }
+        return true;
+    }
+    index -= Hpack::STATIC_TABLE_SIZE + 1;
+    if (index >= m_table.count()) {
+        return false;
+    }
+    const HpackDynamicTable::Entry& entry = m_table.at((size_t)index);
+    name = entry.name;
+    if (value != nullptr) {
+        *value = entry.value;
+    }
+    return true;
+}
+
+bool HpackDecoder::decode(const uint8_t* block, size_t size, Http2HeaderList& headers)
+{
+    const uint8_t* data = block;
+    const uint8_t* end = block + size;
+    size_t listSize = 0;
+    bool fieldSeen = false;
+    while (data < end) {
+        uint8_t first = *data;
+        uint64_t index = 0;
+        if ((first & 0xE0) == 0x20) {
+            // dynamic table size update, only before the first field
+            if (fieldSeen || !Hpack::decode_integer(data, end, 5, index) || index > m_maxTableSize) {
+                LOG_ERROR("HpackDecoder: invalid table size update");
+                return false;
+            }
+            m_table.setMaxSize((uint32_t)index);
+            continue;
+        }
+        fieldSeen = true;
+
+        Http2Header header;
+        bool indexed = false;
+        if (first & 0x80) {
+            if (!Hpack::decode_integer(data, end, 7, index) || !lookup(index, header.name, &header.value)) {
+                LOG_ERROR("HpackDecoder: invalid index %llu", (unsigned long long)index);
+                return false;
+            }
+        }
+        else {
+            uint8_t prefix = 4;
+            if (first & 0x40) {
+                prefix = 6;
+                indexed = true;
+            }
+            else if (first & 0x10) {
+                header.sensitive = true;
+            }
+            if (!Hpack::decode_integer(data, end, prefix, index)) {
+                return false;
+            }
+            bool nameOk = index == 0 ? readString(data, end, header.name) : lookup(index, header.name, nullptr);
+            if (!nameOk || !readString(data, end, header.value)) {
+                LOG_ERROR("HpackDecoder: invalid literal field");
+                return false;
+            }
+            if (indexed) {
+                m_table.add(header.name, header.value);
+            }
+        }
+
+        listSize += HpackDynamicTable::entrySize(header.name, header.value);
+        if (m_maxHeaderListSize != 0 && listSize > m_maxHeaderListSize) {
+            LOG_ERROR("HpackDecoder: header list exceeds %u bytes", m_maxHeaderListSize);
+            return false;
+        }
+        headers.push_back(std::move(header));
+    }
+    return true;
+}
+
+bool HpackDecoder::decode(const Http2FrameView& frame, Http2HeaderList& headers)
+{
+    if (!frame.hasFlag(Http2FrameView::FLAG_END_HEADERS)) {
+        LOG_ERROR("HpackDecoder: header block continues in CONTINUATION frames");
+        return false;
+    }
+    return decode(frame.data.data(), frame.data.size(), headers);
+}
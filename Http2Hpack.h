@@ -0,0 +1,200 @@
+/**
+ *   HPACK header compression for Http 2.0 (RFC 7541)
+ *
+ *   Static table, a ring buffer dynamic table, integer / string coding and
+ *   Huffman coding. The Huffman decoder walks a 4 bit state table built once
+ *   from the code table, the encoder packs codes into a 64 bit accumulator.
+ *
+ *      HpackEncoder encoder;
+ *      Http2HeadersFrame frame(1, { { ":method", "GET" }, { ":path", "/" } }, encoder, Http2HeadersFrame::END_HEADERS);
+ *
+ *      HpackDecoder decoder;
+ *      Http2HeaderList headers;
+ *      if (!decoder.decode(frameView, headers)) { COMPRESSION_ERROR }
+ *
+ *   One encoder and one decoder per connection and direction, they are not thread safe.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include <stddef.h>
+
+struct Http2FrameView;
+
+// SETTINGS_HEADER_TABLE_SIZE default
+static constexpr uint32_t HPACK_DEFAULT_TABLE_SIZE = 4096;
+
+struct Http2Header
+{
+    std::string name;           // lower case
+    std::string value;
+    bool sensitive = false;     // never indexed, by us or by intermediaries
+
+    Http2Header() = default;
+    Http2Header(std::string_view headerName, std::string_view headerValue, bool neverIndex = false) :
+        name(headerName), value(headerValue), sensitive(neverIndex) {}
+};
+using Http2HeaderList = std::vector<Http2Header>;
+
+namespace Hpack
+{
+    /** number of static table entries, dynamic entries are indexed after them */
+    static constexpr size_t STATIC_TABLE_SIZE = 61;
+
+    /** name and value of static entry 1..61 */
+    std::string_view static_name(size_t index);
+    std::string_view static_value(size_t index);
+
+    /** append value with an N bit prefix; first holds the representation bits above the prefix */
+    void encode_integer(std::vector<uint8_t>& out, uint64_t value, uint8_t prefixBits, uint8_t first);
+
+    /** read an N bit prefix integer, advancing data; false if truncated or larger than 2^32 */
+    bool decode_integer(const uint8_t*& data, const uint8_t* end, uint8_t prefixBits, uint64_t& value);
+
+    /** bytes value takes once Huffman coded */
+    size_t huffman_encoded_size(std::string_view value);
+
+    /** append the Huffman coding of value */
+    void huffman_encode(std::string_view value, std::vector<uint8_t>& out);
+
+    /** append the decoding of data to out, false on an invalid code or padding */
+    bool huffman_decode(const uint8_t* data, size_t size, std::string& out);
+}
+
+/**
+ * @brief FIFO of header fields, newest first, evicted by size (RFC 7541 section 4)
+ */
+class HpackDynamicTable
+{
+public:
+    struct Entry
+    {
+        std::string name;
+        std::string value;
+    };
+
+    explicit HpackDynamicTable(uint32_t maxSize = HPACK_DEFAULT_TABLE_SIZE);
+
+    /** size of an entry: name + value + 32 */
+    static size_t entrySize(std::string_view name, std::string_view value) { return name.size() + value.size() + 32; }
+
+    /** add at index 0, evicting the oldest; an entry larger than maxSize() empties the table and is not added */
+    void add(std::string_view name, std::string_view value);
+
+    /** shrink or grow, evicting as needed */
+    void setMaxSize(uint32_t maxSize);
+
+    /** index 0 is the newest entry */
+    const Entry& at(size_t index) const { return m_ring[(m_first + m_count - 1 - index) & (m_ring.size() - 1)]; }
+    const Entry& oldest() const { return m_ring[m_first]; }
+    void evictOldest();
+
+    size_t count() const { return m_count; }
+    size_t size() const { return m_size; }
+    uint32_t maxSize() const { return m_maxSize; }
+
+    /** entries added since construction, the newest entry has id insertCount() - 1 */
+    uint64_t insertCount() const { return m_inserted; }
+
+private:
+    std::vector<Entry> m_ring;  // power of two slots, strings are reused when a slot is overwritten
+    size_t m_first = 0;         // oldest
+    size_t m_count = 0;
+    size_t m_size = 0;
+    uint32_t m_maxSize;
+    uint64_t m_inserted = 0;
+};
+
+enum class HpackIndexing
+{
+    Default,        // index fields except credentials and fields larger than half the table
+    Always,         // index every field that is not sensitive
+    Never           // no dynamic table, literals may still reference static names
+};
+
+enum class HpackHuffman
+{
+    Shorter,        // Huffman when it saves bytes
+    Always,
+    Never
+};
+
+class HpackEncoder
+{
+public:
+    explicit HpackEncoder(uint32_t maxTableSize = HPACK_DEFAULT_TABLE_SIZE);
+
+    void setIndexing(HpackIndexing indexing) { m_indexing = indexing; }
+    void setHuffman(HpackHuffman huffman) { m_huffman = huffman; }
+
+    /** peer's SETTINGS_HEADER_TABLE_SIZE, announced at the start of the next header block */
+    void setMaxTableSize(uint32_t maxTableSize);
+
+    /** append the header block for headers to out */
+    void encode(const Http2HeaderList& headers, std::vector<uint8_t>& out);
+
+    const HpackDynamicTable& table() const { return m_table; }
+
+private:
+    void encodeField(const Http2Header& header, std::vector<uint8_t>& out);
+    void encodeString(std::string_view value, std::vector<uint8_t>& out);
+    bool shouldIndex(const Http2Header& header) const;
+
+    /** 1-based HPACK index of the newest dynamic entry with this id, 0 if evicted */
+    size_t dynamicIndex(uint64_t id) const;
+    void addEntry(std::string_view name, std::string_view value);
+    void forgetOldest();
+
+private:
+    HpackDynamicTable m_table;
+    HpackIndexing m_indexing = HpackIndexing::Default;
+    HpackHuffman m_huffman = HpackHuffman::Shorter;
+
+    // name + '\0' + value and name -> id of the newest dynamic entry
+    std::unordered_map<std::string, uint64_t> m_fields;
+    std::unordered_map<std::string, uint64_t> m_names;
+    std::string m_key;
+
+    bool m_sizeUpdatePending = false;
+    uint32_t m_smallestTableSize = 0;
+};
+
+class HpackDecoder
+{
+public:
+    explicit HpackDecoder(uint32_t maxTableSize = HPACK_DEFAULT_TABLE_SIZE);
+
+    /** our SETTINGS_HEADER_TABLE_SIZE, the peer may not grow the table beyond it */
+    void setMaxTableSize(uint32_t maxTableSize);
+
+    /** our SETTINGS_MAX_HEADER_LIST_SIZE, 0 for no limit */
+    void setMaxHeaderListSize(uint32_t maxHeaderListSize) { m_maxHeaderListSize = maxHeaderListSize; }
+
+    /**
+     * @brief  Decode a complete header block, appending to headers
+     * @return false on a COMPRESSION_ERROR; the connection must be closed since the table is out of sync
+     */
+    bool decode(const uint8_t* block, size_t size, Http2HeaderList& headers);
+
+    /** decode a HEADERS or PUSH_PROMISE frame that carries END_HEADERS */
+    bool decode(const Http2FrameView& frame, Http2HeaderList& headers);
+
+    const HpackDynamicTable& table() const { return m_table; }
+
+private:
+    bool readString(const uint8_t*& data, const uint8_t* end, std::string& out);
+    bool lookup(uint64_t index, std::string& name, std::string* value);
+
+private:
+    HpackDynamicTable m_table;
+    uint32_t m_maxTableSize;
+    uint32_t m_maxHeaderListSize = 0;
+};
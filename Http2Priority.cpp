@@ -0,0 +1,336 @@
+#include "Http2Priority.h"
+#include <bit>
+#include <algorithm>
+
+// Weighted: virtual time a byte costs at weight 1, large enough that weight 256 still advances
+static constexpr uint64_t WEIGHT_SCALE = 256;
+
+static inline std::string_view trim(std::string_view text)
+{
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+static inline bool is_key(std::string_view key)
+{
+    if (key.empty() || !((key[0] >= 'a' && key[0] <= 'z') || key[0] == '*')) {
+        return false;
+    }
+    return std::all_of(key.begin(), key.end(), [](char c) {
+        return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_' || c == '-' || c == '.' || c == '*';
+    });
+}
+
+/** Http2Priority */
+std::optional<Http2Priority> Http2Priority::parse(std::string_view field)
+{
+    Http2Priority priority;
+    field = trim(field);
+    while (!field.empty()) {
+        size_t comma = field.find(',');
+        std::string_view member = trim(field.substr(0, comma));
+        field = comma == std::string_view::npos ? std::string_view() : trim(field.substr(comma + 1));
+        if (member.empty()) {
+            return std::nullopt;
+        }
+        // parameters of a member carry nothing for us
+        member = member.substr(0, member.find(';'));
+
+        size_t equals = member.find('=');
+        std::string_view key = trim(member.substr(0, equals));
+        std::string_view value = equals == std::string_view::npos ? std::string_view("?1") : trim(member.substr(equals + 1));
+        if (!is_key(key) || value.empty()) {
+            return std::nullopt;
+        }
+
+        if (key == "u") {
+            if (value.size() == 1 && value[0] >= '0' && value[0] <= '0' + LOWEST_URGENCY) {
+                priority.urgency = (uint8_t)(value[0] - '0');
+            }
+        }
+        else if (key == "i") {
+            if (value == "?1" || value == "?0") {
+                priority.incremental = value == "?1";
+            }
+        }
+    }
+    return priority;
+}
+
+std::string Http2Priority::toString() const
+{
+    std::string field;
+    if (urgency != DEFAULT_URGENCY) {
+        field = "u=";
+        field += (char)('0' + std::min(urgency, LOWEST_URGENCY));
+    }
+    if (incremental) {
+        field += field.empty() ? "i" : ", i";
+    }
+    return field;
+}
+
+/** Http2PriorityScheduler::Heap */
+template<typename Before>
+void Http2PriorityScheduler::Heap<Before>::place(Node* node, size_t slot)
+{
+    nodes[slot] = node;
+    node->slot = slot;
+}
+
+template<typename Before>
+bool Http2PriorityScheduler::Heap<Before>::siftUp(size_t slot)
+{
+    Node* node = nodes[slot];
+    size_t start = slot;
+    while (slot > 0) {
+        size_t parent = (slot - 1) / 2;
+        if (!Before()(node, nodes[parent])) {
+            break;
+        }
+        place(nodes[parent], slot);
+        slot = parent;
+    }
+    place(node, slot);
+    return slot != start;
+}
+
+template<typename Before>
+void Http2PriorityScheduler::Heap<Before>::siftDown(size_t slot)
+{
+    Node* node = nodes[slot];
+    size_t count = nodes.size();
+    while (true) {
+        size_t child = slot * 2 + 1;
+        if (child >= count) {
+            break;
+        }
+        if (child + 1 < count && Before()(nodes[child + 1], nodes[child])) {
+            ++child;
+        }
+        if (!Before()(nodes[child], node)) {
+            break;
+        }
+        place(nodes[child], slot);
+        slot = child;
+    }
+    place(node, slot);
+}
+
+template<typename Before>
+void Http2PriorityScheduler::Heap<Before>::push(Node& node)
+{
+    nodes.push_back(&node);
+    siftUp(nodes.size() - 1);
+}
+
+template<typename Before>
+void Http2PriorityScheduler::Heap<Before>::erase(Node& node)
+{
+    size_t slot = node.slot;
+    Node* last = nodes.back();
+    nodes.pop_back();
+    if (last != &node) {
+        place(last, slot);
+        reorder(*last);
+    }
+}
+
+template<typename Before>
+void Http2PriorityScheduler::Heap<Before>::reorder(Node& node)
+{
+    if (!siftUp(node.slot)) {
+        siftDown(node.slot);
+    }
+}
+
+/** Http2PriorityScheduler::Level */
+void Http2PriorityScheduler::Level::pushBack(Node& node)
+{
+    node.prev = tail;
+    node.next = nullptr;
+    if (tail != nullptr) {
+        tail->next = &node;
+    }
+    else {
+        head = &node;
+    }
+    tail = &node;
+}
+
+void Http2PriorityScheduler::Level::unlink(Node& node)
+{
+    (node.prev != nullptr ? node.prev->next : head) = node.next;
+    (node.next != nullptr ? node.next->prev : tail) = node.prev;
+    node.prev = nullptr;
+    node.next = nullptr;
+}
+
+/** Http2PriorityScheduler */
+Http2PriorityScheduler::Http2PriorityScheduler(Http2PriorityMode mode):
+    m_mode(mode)
+{
+}
+
+void Http2PriorityScheduler::add(uint32_t streamId, const Http2Priority& priority)
+{
+    auto it = m_streams.find(streamId);
+    if (it != m_streams.end()) {
+        update(streamId, priority);
+        return;
+    }
+    Node& node = m_streams[streamId];
+    node.id = streamId;
+    node.priority = priority;
+    node.priority.urgency = std::min(priority.urgency, Http2Priority::LOWEST_URGENCY);
+    node.priority.weight = std::clamp<uint16_t>(priority.weight, 1, 256);
+}
+
+bool Http2PriorityScheduler::update(uint32_t streamId, const Http2Priority& priority)
+{
+    auto it = m_streams.find(streamId);
+    if (it == m_streams.end()) {
+        return false;
+    }
+    Node& node = it->second;
+    bool ready = node.ready;
+    if (ready) {
+        unlink(node);
+    }
+    node.priority = priority;
+    node.priority.urgency = std::min(priority.urgency, Http2Priority::LOWEST_URGENCY);
+    node.priority.weight = std::clamp<uint16_t>(priority.weight, 1, 256);
+    if (ready) {
+        link(node);
+    }
+    return true;
+}
+
+void Http2PriorityScheduler::remove(uint32_t streamId)
+{
+    auto it = m_streams.find(streamId);
+    if (it == m_streams.end()) {
+        return;
+    }
+    if (it->second.ready) {
+        unlink(it->second);
+    }
+    m_streams.erase(it);
+}
+
+void Http2PriorityScheduler::clear()
+{
+    m_streams.clear();
+    for (Level& level : m_levels) {
+        level.sequential.clear();
+        level.head = nullptr;
+        level.tail = nullptr;
+    }
+    m_levelMask = 0;
+    m_byFinish.clear();
+    m_readyCount = 0;
+}
+
+void Http2PriorityScheduler::setReady(uint32_t streamId, bool ready)
+{
+    auto it = m_streams.find(streamId);
+    if (it == m_streams.end() || it->second.ready == ready) {
+        return;
+    }
+    if (ready) {
+        // a stream that was idle does not bank credit for the time it had nothing to send
+        it->second.finish = std::max(it->second.finish, m_virtualTime);
+        link(it->second);
+    }
+    else {
+        unlink(it->second);
+    }
+}
+
+uint32_t Http2PriorityScheduler::next() const
+{
+    if (m_readyCount == 0) {
+        return 0;
+    }
+    if (m_mode == Http2PriorityMode::Weighted) {
+        return m_byFinish.top()->id;
+    }
+    const Level& level = m_levels[std::countr_zero(m_levelMask)];
+    // non-incremental streams are of no use in pieces, finish them before sharing
+    return !level.sequential.empty() ? level.sequential.top()->id : level.head->id;
+}
+
+void Http2PriorityScheduler::sent(uint32_t streamId, size_t bytes)
+{
+    auto it = m_streams.find(streamId);
+    if (it == m_streams.end()) {
+        return;
+    }
+    Node& node = it->second;
+    if (m_mode == Http2PriorityMode::Weighted) {
+        uint64_t start = std::max(node.finish, m_virtualTime);
+        m_virtualTime = start;
+        node.finish = start + (uint64_t)bytes * WEIGHT_SCALE / node.priority.weight;
+        if (node.ready) {
+            m_byFinish.reorder(node);
+        }
+        return;
+    }
+    if (node.ready && node.priority.incremental) {
+        Level& level = m_levels[node.priority.urgency];
+        level.unlink(node);
+        level.pushBack(node);
+    }
+}
+
+std::optional<Http2Priority> Http2PriorityScheduler::priority(uint32_t streamId) const
+{
+    auto it = m_streams.find(streamId);
+    if (it == m_streams.end()) {
+        return std::nullopt;
+    }
+    return it->second.priority;
+}
+
+void Http2PriorityScheduler::link(Node& node)
+{
+    node.ready = true;
+    ++m_readyCount;
+    if (m_mode == Http2PriorityMode::Weighted) {
+        m_byFinish.push(node);
+        return;
+    }
+    Level& level = m_levels[node.priority.urgency];
+    if (node.priority.incremental) {
+        level.pushBack(node);
+    }
+    else {
+        level.sequential.push(node);
+    }
+    m_levelMask |= 1u << node.priority.urgency;
+}
+
+void Http2PriorityScheduler::unlink(Node& node)
+{
+    node.ready = false;
+    --m_readyCount;
+    if (m_mode == Http2PriorityMode::Weighted) {
+        m_byFinish.erase(node);
+        return;
+    }
+    Level& level = m_levels[node.priority.urgency];
+    if (node.priority.incremental) {
+        level.unlink(node);
+    }
+    else {
+        level.sequential.erase(node);
+    }
+    if (level.empty()) {
+        m_levelMask &= ~(1u << node.priority.urgency);
+    }
+}
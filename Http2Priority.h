@@ -0,0 +1,179 @@
+/**
+ *   Http 2.0 stream priority scheduler
+ *
+ *   Decides which stream's DATA goes out next when several streams of a
+ *   connection have data and window. The default mode follows the extensible
+ *   priorities of RFC 9218: the lowest urgency (0-7) is served first, within
+ *   an urgency non-incremental streams go one at a time in stream id order and
+ *   incremental streams share the link round robin, one frame per turn. The
+ *   Weighted mode is the RFC 7540 fallback: ready streams share the link in
+ *   proportion to their weight (1-256), dependencies are flattened.
+ *   Every operation is O(log n) or better, next() is O(1).
+ *
+ *      Http2PriorityScheduler scheduler;
+ *      scheduler.add(1, { 0, false });        // control stream
+ *      scheduler.add(3, { 5, true });         // bulk transfer
+ *      scheduler.setReady(1, true);
+ *      scheduler.setReady(3, true);
+ *      uint32_t id = scheduler.next();        // 1
+ *      scheduler.sent(id, 16384);
+ *
+ *   The scheduler is not thread safe, Http2Connection keeps it under its mutex.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <stdint.h>
+#include <stddef.h>
+
+enum class Http2PriorityMode
+{
+    Extensible,     // RFC 9218 urgency and incremental
+    Weighted        // RFC 7540 weights, for peers that still send PRIORITY
+};
+
+struct Http2Priority
+{
+    static constexpr uint8_t DEFAULT_URGENCY = 3;
+    static constexpr uint8_t LOWEST_URGENCY = 7;
+    static constexpr uint16_t DEFAULT_WEIGHT = 16;
+
+    uint8_t urgency = DEFAULT_URGENCY;  // 0 is the most urgent
+    bool incremental = false;           // useful in pieces, may share the link
+    uint16_t weight = DEFAULT_WEIGHT;   // Weighted mode only, 1-256
+
+    Http2Priority() = default;
+    Http2Priority(uint8_t urgencyLevel, bool isIncremental, uint16_t legacyWeight = DEFAULT_WEIGHT) :
+        urgency(urgencyLevel), incremental(isIncremental), weight(legacyWeight) {}
+
+    /**
+     * @brief  Parse a priority header or PRIORITY_UPDATE field value such as "u=1, i"
+     * @return nullopt if it is not a structured field dictionary; unknown keys and
+     *         out of range values are ignored as RFC 9218 4 asks
+     */
+    static std::optional<Http2Priority> parse(std::string_view field);
+
+    /** the field value, empty for the defaults */
+    std::string toString() const;
+
+    bool isDefault() const { return urgency == DEFAULT_URGENCY && !incremental; }
+    bool operator==(const Http2Priority& other) const = default;
+};
+
+class Http2PriorityScheduler
+{
+public:
+    explicit Http2PriorityScheduler(Http2PriorityMode mode = Http2PriorityMode::Extensible);
+
+    Http2PriorityScheduler(const Http2PriorityScheduler&) = delete;
+    Http2PriorityScheduler& operator=(const Http2PriorityScheduler&) = delete;
+
+    Http2PriorityMode mode() const { return m_mode; }
+
+    /** track a stream, it is not ready until setReady; an existing stream is reprioritized */
+    void add(uint32_t streamId, const Http2Priority& priority = {});
+
+    /** change the priority of a tracked stream, false if it is not tracked */
+    bool update(uint32_t streamId, const Http2Priority& priority);
+
+    void remove(uint32_t streamId);
+    void clear();
+
+    /** the stream has DATA queued and window to send it */
+    void setReady(uint32_t streamId, bool ready);
+
+    /** stream whose DATA should go next, 0 if none is ready */
+    uint32_t next() const;
+
+    /** bytes of streamId's DATA were sent: an incremental stream goes to the back of its urgency */
+    void sent(uint32_t streamId, size_t bytes);
+
+    bool contains(uint32_t streamId) const { return m_streams.count(streamId) != 0; }
+    std::optional<Http2Priority> priority(uint32_t streamId) const;
+    size_t size() const { return m_streams.size(); }
+    size_t readyCount() const { return m_readyCount; }
+
+private:
+    static constexpr size_t URGENCIES = Http2Priority::LOWEST_URGENCY + 1;
+
+    // streams become ready and idle with every DATA frame, so neither may allocate:
+    // the round robin links the nodes themselves, the ordered sets are heaps of node
+    // pointers whose vectors only grow
+    struct Node
+    {
+        uint32_t id = 0;
+        Http2Priority priority;
+        bool ready = false;
+        uint64_t finish = 0;                    // Weighted: virtual finish time
+        Node* prev = nullptr;                   // Extensible incremental: neighbours in the round robin
+        Node* next = nullptr;
+        size_t slot = 0;                        // index in the heap holding the node, if any
+    };
+
+    /** min-heap of ready nodes that tracks each node's slot, so a stream leaves or moves without a search */
+    template<typename Before>
+    struct Heap
+    {
+        std::vector<Node*> nodes;
+
+        bool empty() const { return nodes.empty(); }
+        Node* top() const { return nodes.front(); }
+        void push(Node& node);
+        void erase(Node& node);
+        void reorder(Node& node);               // the key of node changed
+        void clear() { nodes.clear(); }
+
+    private:
+        void place(Node* node, size_t slot);
+        bool siftUp(size_t slot);
+        void siftDown(size_t slot);
+    };
+
+    struct ById
+    {
+        bool operator()(const Node* a, const Node* b) const { return a->id < b->id; }
+    };
+
+    struct ByFinish
+    {
+        bool operator()(const Node* a, const Node* b) const
+        {
+            return a->finish != b->finish ? a->finish < b->finish : a->id < b->id;
+        }
+    };
+
+    struct Level
+    {
+        Heap<ById> sequential;                  // ready non-incremental streams, lowest id on top
+        Node* head = nullptr;                   // ready incremental streams, head goes next
+        Node* tail = nullptr;
+
+        bool empty() const { return sequential.empty() && head == nullptr; }
+        void pushBack(Node& node);
+        void unlink(Node& node);
+    };
+
+    void link(Node& node);
+    void unlink(Node& node);
+
+private:
+    Http2PriorityMode m_mode;
+    std::unordered_map<uint32_t, Node> m_streams;
+    size_t m_readyCount = 0;
+
+    // Extensible
+    Level m_levels[URGENCIES];
+    uint32_t m_levelMask = 0;                   // bit u set when m_levels[u] has a ready stream
+
+    // Weighted
+    Heap<ByFinish> m_byFinish;                  // ready streams, earliest finish time on top
+    uint64_t m_virtualTime = 0;
+};
@@ -0,0 +1,588 @@
+#include "Http2Rpc.h"
+#include "PlatformCommonUtils.h"
+#include "TimerWheel.h"
+#include <algorithm>
+#include <charconv>
+#include <string.h>
+
+// compressed flag and big endian length in front of every message
+static constexpr size_t MESSAGE_PREFIX_SIZE = 5;
+// grpc-timeout allows at most 8 digits
+static constexpr int64_t MAX_TIMEOUT_VALUE = 99999999;
+
+/**
+ * @brief State of one call, shared by the channel, its stream or future and a deadline timer
+ */
+struct Http2RpcCall
+{
+    uint32_t streamId = 0;
+    bool unary = false;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Http2RpcMessage> messages;
+    Http2HeaderList headers;
+    Http2HeaderList trailers;
+    bool headersReceived = false;
+    bool writesDone = false;
+    bool done = false;
+    Http2RpcStatus status;
+    TimerWheel::TimerId timer = 0;
+    std::promise<Http2RpcResponse> promise;     // unary calls
+
+    // the message being received, reader thread only
+    uint8_t prefix[MESSAGE_PREFIX_SIZE] = {};
+    size_t prefixSize = 0;
+    Http2RpcMessage pending;
+    size_t pendingSize = 0;
+};
+
+/**
+ * @brief Lets a deadline timer reach the channel without outliving it
+ */
+struct Http2RpcExpiry
+{
+    std::mutex mutex;
+    Http2RpcChannel* channel = nullptr;
+};
+
+static inline Http2RpcStatus make_status(Http2RpcStatusCode code, std::string message)
+{
+    Http2RpcStatus status;
+    status.code = code;
+    status.message = std::move(message);
+    return status;
+}
+
+static inline std::string_view find_header(const Http2HeaderList& headers, std::string_view name)
+{
+    for (const Http2Header& header : headers) {
+        if (header.name == name) {
+            return header.value;
+        }
+    }
+    return {};
+}
+
+/** grpc-timeout: at most 8 digits and a unit */
+static std::string encode_timeout(std::chrono::milliseconds timeout)
+{
+    int64_t ms = std::max<int64_t>(timeout.count(), 1);
+    if (ms <= MAX_TIMEOUT_VALUE) {
+        return std::to_string(ms) + "m";
+    }
+    int64_t seconds = (ms + 999) / 1000;
+    if (seconds <= MAX_TIMEOUT_VALUE) {
+        return std::to_string(seconds) + "S";
+    }
+    return std::to_string(std::min<int64_t>((seconds + 3599) / 3600, MAX_TIMEOUT_VALUE)) + "H";
+}
+
+/** grpc-message is percent encoded */
+static std::string percent_decode(std::string_view text)
+{
+    std::string decoded;
+    decoded.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        uint8_t value = 0;
+        if (text[i] == '%' && i + 2 < text.size() &&
+            std::from_chars(text.data() + i + 1, text.data() + i + 3, value, 16).ptr == text.data() + i + 3) {
+            decoded += (char)value;
+            i += 2;
+        }
+        else {
+            decoded += text[i];
+        }
+    }
+    return decoded;
+}
+
+/** what a response without grpc-status means, from its :status */
+static Http2RpcStatusCode code_of_http_status(std::string_view status)
+{
+    if (status == "400") {
+        return Http2RpcStatusCode::Internal;
+    }
+    if (status == "401") {
+        return Http2RpcStatusCode::Unauthenticated;
+    }
+    if (status == "403") {
+        return Http2RpcStatusCode::PermissionDenied;
+    }
+    if (status == "404") {
+        return Http2RpcStatusCode::Unimplemented;
+    }
+    if (status == "429" || status == "502" || status == "503" || status == "504") {
+        return Http2RpcStatusCode::Unavailable;
+    }
+    return Http2RpcStatusCode::Unknown;
+}
+
+static Http2RpcStatus status_of_trailers(const Http2HeaderList& trailers, std::string_view httpStatus)
+{
+    std::string_view code = find_header(trailers, "grpc-status");
+    if (code.empty()) {
+        if (httpStatus != "200") {
+            return make_status(code_of_http_status(httpStatus), "http status " + std::string(httpStatus));
+        }
+        return make_status(Http2RpcStatusCode::Unknown, "no grpc-status in the trailers");
+    }
+    uint32_t value = 0;
+    if (std::from_chars(code.data(), code.data() + code.size(), value).ptr != code.data() + code.size() ||
+        value > (uint32_t)Http2RpcStatusCode::Unauthenticated) {
+        return make_status(Http2RpcStatusCode::Unknown, "invalid grpc-status " + std::string(code));
+    }
+    return make_status((Http2RpcStatusCode)value, percent_decode(find_header(trailers, "grpc-message")));
+}
+
+/**
+ * @brief  End a call, under its mutex
+ * @return false if it had already ended
+ */
+static bool complete_call(Http2RpcCall& call, Http2RpcStatus status)
+{
+    if (call.done) {
+        return false;
+    }
+    call.done = true;
+    if (call.unary) {
+        Http2RpcResponse response;
+        if (status.ok() && call.messages.size() != 1) {
+            status = make_status(Http2RpcStatusCode::Internal,
+                "expected one response message, got " + std::to_string(call.messages.size()));
+        }
+        if (status.ok()) {
+            response.message = std::move(call.messages.front());
+        }
+        call.messages.clear();
+        response.status = status;
+        response.headers = call.headers;
+        response.trailers = call.trailers;
+        call.promise.set_value(std::move(response));
+    }
+    call.status = std::move(status);
+    call.cond.notify_all();
+    return true;
+}
+
+/** the deadline timer is cancelled outside the call's mutex */
+static void cancel_timer(Http2RpcCall& call)
+{
+    TimerWheel::TimerId timer = 0;
+    {
+        std::lock_guard<std::mutex> lock(call.mutex);
+        std::swap(timer, call.timer);
+    }
+    if (timer != 0) {
+        TimerWheel::shared().cancel(timer);
+    }
+}
+
+/** Http2RpcStream */
+Http2RpcStream::Http2RpcStream(Http2RpcChannel& channel, std::shared_ptr<Http2RpcCall> call):
+    m_channel(channel),
+    m_call(std::move(call))
+{
+}
+
+Http2RpcStream::~Http2RpcStream()
+{
+    cancel();
+}
+
+uint32_t Http2RpcStream::streamId() const
+{
+    return m_call->streamId;
+}
+
+bool Http2RpcStream::write(std::span<const uint8_t> message, bool last)
+{
+    return m_channel.writeMessage(*m_call, message, last);
+}
+
+bool Http2RpcStream::writesDone()
+{
+    return m_channel.endWrites(*m_call);
+}
+
+std::optional<Http2RpcMessage> Http2RpcStream::read()
+{
+    std::unique_lock<std::mutex> lock(m_call->mutex);
+    m_call->cond.wait(lock, [&] { return !m_call->messages.empty() || m_call->done; });
+    if (m_call->messages.empty()) {
+        return std::nullopt;
+    }
+    Http2RpcMessage message = std::move(m_call->messages.front());
+    m_call->messages.pop_front();
+    return message;
+}
+
+Http2RpcStatus Http2RpcStream::finish()
+{
+    std::unique_lock<std::mutex> lock(m_call->mutex);
+    m_call->cond.wait(lock, [&] { return m_call->done; });
+    m_call->messages.clear();
+    return m_call->status;
+}
+
+void Http2RpcStream::cancel()
+{
+    m_channel.cancelCall(*m_call, Http2RpcStatusCode::Cancelled, "cancelled by the client");
+}
+
+Http2HeaderList Http2RpcStream::headers() const
+{
+    std::lock_guard<std::mutex> lock(m_call->mutex);
+    return m_call->headers;
+}
+
+Http2HeaderList Http2RpcStream::trailers() const
+{
+    std::lock_guard<std::mutex> lock(m_call->mutex);
+    return m_call->trailers;
+}
+
+/** Http2RpcChannel */
+Http2RpcChannel::Http2RpcChannel(IEasySocket& socket, const Http2RpcChannelOptions& options):
+    m_options(options),
+    m_connection(socket, Http2Role::Client, this, options.settings, options.writer),
+    m_expiry(std::make_shared<Http2RpcExpiry>())
+{
+    m_expiry->channel = this;
+}
+
+Http2RpcChannel::~Http2RpcChannel()
+{
+    {
+        // waits for a deadline timer that is cancelling a call now
+        std::lock_guard<std::mutex> lock(m_expiry->mutex);
+        m_expiry->channel = nullptr;
+    }
+    close();
+}
+
+bool Http2RpcChannel::start()
+{
+    return m_connection.start();
+}
+
+void Http2RpcChannel::close()
+{
+    m_connection.close();
+    // the reader normally fails them in onConnectionClosed, unless it never ran
+    onConnectionClosed(Http2ErrorCode::NoError);
+}
+
+std::future<Http2RpcResponse> Http2RpcChannel::unary(const std::string& method, std::span<const uint8_t> request,
+    const Http2RpcCallOptions& options)
+{
+    std::shared_ptr<Http2RpcCall> call = openCall(method, options, true);
+    std::future<Http2RpcResponse> future = call->promise.get_future();
+    if (!writeMessage(*call, request, true)) {
+        cancelCall(*call, Http2RpcStatusCode::Unavailable, "request not sent");
+    }
+    return future;
+}
+
+std::unique_ptr<Http2RpcStream> Http2RpcChannel::serverStream(const std::string& method, std::span<const uint8_t> request,
+    const Http2RpcCallOptions& options)
+{
+    std::unique_ptr<Http2RpcStream> stream(new Http2RpcStream(*this, openCall(method, options, false)));
+    if (!stream->write(request, true)) {
+        cancelCall(*stream->m_call, Http2RpcStatusCode::Unavailable, "request not sent");
+    }
+    return stream;
+}
+
+std::unique_ptr<Http2RpcStream> Http2RpcChannel::bidiStream(const std::string& method, const Http2RpcCallOptions& options)
+{
+    return std::unique_ptr<Http2RpcStream>(new Http2RpcStream(*this, openCall(method, options, false)));
+}
+
+size_t Http2RpcChannel::activeCalls() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_calls.size();
+}
+
+std::shared_ptr<Http2RpcCall> Http2RpcChannel::openCall(const std::string& method, const Http2RpcCallOptions& options, bool unary)
+{
+    auto call = std::make_shared<Http2RpcCall>();
+    call->unary = unary;
+    auto deadline = std::chrono::steady_clock::now() + options.timeout;
+
+    Http2HeaderList headers = {
+        { ":method", "POST" },
+        { ":scheme", m_options.scheme },
+        { ":path", method },
+        { ":authority", m_options.authority },
+        { "te", "trailers" },
+        { "content-type", "application/grpc" },
+    };
+    if (options.timeout.count() > 0) {
+        headers.emplace_back("grpc-timeout", encode_timeout(options.timeout));
+    }
+    headers.insert(headers.end(), options.metadata.begin(), options.metadata.end());
+
+    // registered before the HEADERS go out, the answer may come before openStream returns
+    auto streamId = m_connection.openStream(headers, false, options.priority, [&](uint32_t id) {
+        call->streamId = id;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_calls[id] = call;
+    });
+    if (!streamId) {
+        if (call->streamId != 0) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_calls.erase(call->streamId);
+        }
+        std::lock_guard<std::mutex> lock(call->mutex);
+        complete_call(*call, make_status(Http2RpcStatusCode::Unavailable, "the connection is closed or going away"));
+        return call;
+    }
+
+    if (options.timeout.count() > 0) {
+        auto remaining = std::max(std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()),
+            std::chrono::microseconds(0));
+        std::weak_ptr<Http2RpcExpiry> expiry = m_expiry;
+        std::weak_ptr<Http2RpcCall> weakCall = call;
+        std::lock_guard<std::mutex> lock(call->mutex);
+        if (!call->done) {
+            call->timer = TimerWheel::shared().scheduleAfter(remaining, [expiry, weakCall] {
+                auto guard = expiry.lock();
+                auto call = weakCall.lock();
+                if (!guard || !call) {
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(guard->mutex);
+                if (guard->channel != nullptr) {
+                    guard->channel->cancelCall(*call, Http2RpcStatusCode::DeadlineExceeded, "deadline exceeded");
+                }
+            });
+        }
+    }
+    return call;
+}
+
+bool Http2RpcChannel::writeMessage(Http2RpcCall& call, std::span<const uint8_t> message, bool last)
+{
+    if (message.size() > UINT32_MAX) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(call.mutex);
+        if (call.done || call.writesDone) {
+            return false;
+        }
+        call.writesDone = last;
+    }
+    // the prefix goes in a frame of its own so the message is sent from the caller's buffer
+    uint32_t size = (uint32_t)message.size();
+    uint8_t prefix[MESSAGE_PREFIX_SIZE] = { 0, (uint8_t)(size >> 24), (uint8_t)(size >> 16), (uint8_t)(size >> 8), (uint8_t)size };
+    if (!m_connection.sendData(call.streamId, prefix, last && message.empty())) {
+        return false;
+    }
+    return message.empty() || m_connection.sendData(call.streamId, message, last);
+}
+
+bool Http2RpcChannel::endWrites(Http2RpcCall& call)
+{
+    {
+        std::lock_guard<std::mutex> lock(call.mutex);
+        if (call.done || call.writesDone) {
+            return false;
+        }
+        call.writesDone = true;
+    }
+    return m_connection.sendData(call.streamId, {}, true);
+}
+
+void Http2RpcChannel::cancelCall(Http2RpcCall& call, Http2RpcStatusCode code, const std::string& message)
+{
+    bool cancelled = false;
+    {
+        std::lock_guard<std::mutex> lock(call.mutex);
+        cancelled = complete_call(call, make_status(code, message));
+    }
+    if (!cancelled) {
+        return;
+    }
+    cancel_timer(call);
+    if (call.streamId != 0) {
+        m_connection.resetStream(call.streamId, Http2ErrorCode::Cancel);
+    }
+}
+
+std::shared_ptr<Http2RpcCall> Http2RpcChannel::findCall(uint32_t streamId) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_calls.find(streamId);
+    return it == m_calls.end() ? nullptr : it->second;
+}
+
+void Http2RpcChannel::onHeaders(uint32_t streamId, Http2HeaderList& headers, bool endStream)
+{
+    std::shared_ptr<Http2RpcCall> call = findCall(streamId);
+    if (!call) {
+        return;
+    }
+    bool completed = false;
+    std::optional<Http2ErrorCode> reset;
+    {
+        std::lock_guard<std::mutex> lock(call->mutex);
+        if (call->done) {
+            return;
+        }
+        std::string httpStatus;
+        if (!call->headersReceived) {
+            call->headersReceived = true;
+            call->headers = std::move(headers);
+            httpStatus = find_header(call->headers, ":status");
+            if (endStream) {
+                // trailers only, the status is in the headers
+                call->trailers = call->headers;
+            }
+            else if (httpStatus != "200") {
+                completed = complete_call(*call, status_of_trailers({}, httpStatus));
+                reset = Http2ErrorCode::Cancel;
+            }
+        }
+        else {
+            call->trailers = std::move(headers);
+            httpStatus = find_header(call->headers, ":status");
+        }
+        if (endStream) {
+            Http2RpcStatus status = status_of_trailers(call->trailers, httpStatus);
+            if (status.ok() && call->prefixSize != 0) {
+                status = make_status(Http2RpcStatusCode::Internal, "the last message is truncated");
+            }
+            completed = complete_call(*call, std::move(status));
+            // the server ended the call while our side was still open, close it
+            if (!call->writesDone) {
+                reset = Http2ErrorCode::NoError;
+            }
+        }
+    }
+    if (completed) {
+        cancel_timer(*call);
+        if (reset) {
+            m_connection.resetStream(streamId, *reset);
+        }
+    }
+}
+
+void Http2RpcChannel::onData(uint32_t streamId, std::span<const uint8_t> data, bool endStream)
+{
+    std::shared_ptr<Http2RpcCall> call = findCall(streamId);
+    if (!call) {
+        return;
+    }
+    bool completed = false;
+    {
+        std::lock_guard<std::mutex> lock(call->mutex);
+        if (call->done) {
+            return;
+        }
+        Http2RpcStatus failure;
+        while (!data.empty() && failure.ok()) {
+            if (call->prefixSize < MESSAGE_PREFIX_SIZE) {
+                size_t take = std::min(MESSAGE_PREFIX_SIZE - call->prefixSize, data.size());
+                memcpy(call->prefix + call->prefixSize, data.data(), take);
+                call->prefixSize += take;
+                data = data.subspan(take);
+                if (call->prefixSize < MESSAGE_PREFIX_SIZE) {
+                    break;
+                }
+                size_t size = ((size_t)call->prefix[1] << 24) | ((size_t)call->prefix[2] << 16) |
+                    ((size_t)call->prefix[3] << 8) | call->prefix[4];
+                if (call->prefix[0] != 0) {
+                    failure = make_status(Http2RpcStatusCode::Internal, "compressed messages are not supported");
+                    break;
+                }
+                if (size > m_options.maxMessageSize) {
+                    failure = make_status(Http2RpcStatusCode::ResourceExhausted,
+                        "message of " + std::to_string(size) + " bytes is over the limit");
+                    break;
+                }
+                // the only copy: DATA payload straight into the message handed to the caller
+                call->pending.resize(size);
+                call->pendingSize = 0;
+            }
+            size_t take = std::min(call->pending.size() - call->pendingSize, data.size());
+            memcpy(call->pending.data() + call->pendingSize, data.data(), take);
+            call->pendingSize += take;
+            data = data.subspan(take);
+            if (call->pendingSize == call->pending.size()) {
+                call->messages.push_back(std::move(call->pending));
+                call->pending = {};
+                call->prefixSize = 0;
+                call->cond.notify_all();
+            }
+        }
+        if (!failure.ok()) {
+            completed = complete_call(*call, std::move(failure));
+        }
+        else if (endStream) {
+            completed = complete_call(*call, make_status(Http2RpcStatusCode::Internal, "the call ended without trailers"));
+        }
+    }
+    if (completed) {
+        cancel_timer(*call);
+        m_connection.resetStream(streamId, Http2ErrorCode::Cancel);
+    }
+}
+
+void Http2RpcChannel::onStreamClosed(uint32_t streamId, Http2ErrorCode error)
+{
+    std::shared_ptr<Http2RpcCall> call;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_calls.find(streamId);
+        if (it == m_calls.end()) {
+            return;
+        }
+        call = std::move(it->second);
+        m_calls.erase(it);
+    }
+    bool completed = false;
+    {
+        std::lock_guard<std::mutex> lock(call->mutex);
+        switch (error) {
+        case Http2ErrorCode::NoError:
+            completed = complete_call(*call, make_status(Http2RpcStatusCode::Internal, "the stream closed without a status"));
+            break;
+        case Http2ErrorCode::RefusedStream:
+            completed = complete_call(*call, make_status(Http2RpcStatusCode::Unavailable, "the server refused the call"));
+            break;
+        case Http2ErrorCode::Cancel:
+            completed = complete_call(*call, make_status(Http2RpcStatusCode::Cancelled, "the server cancelled the call"));
+            break;
+        default:
+            completed = complete_call(*call, make_status(Http2RpcStatusCode::Internal,
+                "the stream was reset with error " + std::to_string((uint32_t)error)));
+            break;
+        }
+    }
+    if (completed) {
+        cancel_timer(*call);
+    }
+}
+
+void Http2RpcChannel::onConnectionClosed(Http2ErrorCode error)
+{
+    UNUSED(error);
+    std::unordered_map<uint32_t, std::shared_ptr<Http2RpcCall>> calls;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        calls.swap(m_calls);
+    }
+    for (auto& [streamId, call] : calls) {
+        bool completed = false;
+        {
+            std::lock_guard<std::mutex> lock(call->mutex);
+            completed = complete_call(*call, make_status(Http2RpcStatusCode::Unavailable, "the connection closed"));
+        }
+        if (completed) {
+            cancel_timer(*call);
+        }
+    }
+}
@@ -0,0 +1,217 @@
+/**
+ *   gRPC style RPC client over Http 2.0
+ *
+ *   A call is one stream: HEADERS with POST :path = method, then messages in
+ *   DATA, each behind a 5 byte prefix (compressed flag, big endian length).
+ *   The server ends the call with trailers carrying grpc-status and
+ *   grpc-message. Calls on a channel are multiplexed over its connection.
+ *
+ *   Outgoing messages are sent from the caller's buffer, the prefix goes in a
+ *   frame of its own; incoming ones are assembled once, straight from the
+ *   DATA payload into the vector handed to the caller. A call with a timeout
+ *   sends it as grpc-timeout and is reset with DeadlineExceeded when it
+ *   passes.
+ *
+ *      Http2RpcChannel channel(socket, { .authority = "device.local" });
+ *      channel.start();
+ *      auto reply = channel.unary("/pkg.Service/Get", request, { .timeout = std::chrono::seconds(2) });
+ *      Http2RpcResponse response = reply.get();
+ *
+ *      auto stream = channel.serverStream("/pkg.Service/Watch", request);
+ *      while (auto message = stream->read()) { ... }
+ *      Http2RpcStatus status = stream->finish();
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <unordered_map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <stdint.h>
+#include "Http2Connection.h"
+
+/** status codes of the gRPC protocol */
+enum class Http2RpcStatusCode : uint32_t
+{
+    Ok = 0,
+    Cancelled = 1,
+    Unknown = 2,
+    InvalidArgument = 3,
+    DeadlineExceeded = 4,
+    NotFound = 5,
+    AlreadyExists = 6,
+    PermissionDenied = 7,
+    ResourceExhausted = 8,
+    FailedPrecondition = 9,
+    Aborted = 10,
+    OutOfRange = 11,
+    Unimplemented = 12,
+    Internal = 13,
+    Unavailable = 14,
+    DataLoss = 15,
+    Unauthenticated = 16,
+};
+
+struct Http2RpcStatus
+{
+    Http2RpcStatusCode code = Http2RpcStatusCode::Ok;
+    std::string message;
+
+    bool ok() const { return code == Http2RpcStatusCode::Ok; }
+};
+
+using Http2RpcMessage = std::vector<uint8_t>;
+
+struct Http2RpcCallOptions
+{
+    std::chrono::milliseconds timeout{ 0 };     // 0: no deadline
+    Http2HeaderList metadata;                   // extra request headers, lower case names
+    Http2Priority priority;
+};
+
+struct Http2RpcResponse
+{
+    Http2RpcStatus status;
+    Http2RpcMessage message;                    // empty unless status is ok
+    Http2HeaderList headers;
+    Http2HeaderList trailers;
+};
+
+struct Http2RpcChannelOptions
+{
+    std::string authority;                      // :authority of every call
+    std::string scheme = "http";
+    size_t maxMessageSize = 4 << 20;            // larger incoming messages fail the call with ResourceExhausted
+    Http2Settings settings;
+    Http2WriterOptions writer;
+};
+
+class Http2RpcChannel;
+struct Http2RpcCall;
+struct Http2RpcExpiry;
+
+/**
+ * @brief A streaming call. One thread may write while another reads.
+ *        Dropping it before the call ended cancels the call; it must not outlive its channel
+ */
+class Http2RpcStream
+{
+public:
+    ~Http2RpcStream();
+
+    Http2RpcStream(const Http2RpcStream&) = delete;
+    Http2RpcStream& operator=(const Http2RpcStream&) = delete;
+
+    uint32_t streamId() const;
+
+    /**
+     * @brief      Send one message, blocking while the server's window is exhausted
+     * @param last also end our side of the call
+     * @return     false if the call has ended
+     */
+    bool write(std::span<const uint8_t> message, bool last = false);
+
+    /** end our side of the call, the server still answers */
+    bool writesDone();
+
+    /**
+     * @brief  Next message from the server, blocking until one arrives
+     * @return nullopt once the server ended the call or it failed, see finish()
+     */
+    std::optional<Http2RpcMessage> read();
+
+    /** wait for the end of the call; messages not read are dropped */
+    Http2RpcStatus finish();
+
+    /** reset the stream, the call ends with Cancelled */
+    void cancel();
+
+    /** the response headers, empty until they arrived */
+    Http2HeaderList headers() const;
+    Http2HeaderList trailers() const;
+
+private:
+    friend class Http2RpcChannel;
+    Http2RpcStream(Http2RpcChannel& channel, std::shared_ptr<Http2RpcCall> call);
+
+private:
+    Http2RpcChannel& m_channel;
+    std::shared_ptr<Http2RpcCall> m_call;
+};
+
+/**
+ * @brief Client side of gRPC style calls over one Http2Connection.
+ *        The socket must be connected and outlive the channel
+ */
+class Http2RpcChannel : private IHttp2ConnectionListener
+{
+public:
+    Http2RpcChannel(IEasySocket& socket, const Http2RpcChannelOptions& options = {});
+    ~Http2RpcChannel();
+
+    Http2RpcChannel(const Http2RpcChannel&) = delete;
+    Http2RpcChannel& operator=(const Http2RpcChannel&) = delete;
+
+    bool start();
+
+    /** fail every call in progress with Unavailable and close the connection */
+    void close();
+
+    bool isOpen() const { return m_connection.isOpen(); }
+    Http2Connection& connection() { return m_connection; }
+
+    /**
+     * @brief   One request, one response. Returns once the request is handed to the connection
+     * @param   method  "/package.Service/Method"
+     * @return  resolves when the server ended the call, the deadline passed or the connection closed
+     */
+    std::future<Http2RpcResponse> unary(const std::string& method, std::span<const uint8_t> request,
+        const Http2RpcCallOptions& options = {});
+
+    /** one request, a stream of responses */
+    std::unique_ptr<Http2RpcStream> serverStream(const std::string& method, std::span<const uint8_t> request,
+        const Http2RpcCallOptions& options = {});
+
+    /** messages both ways, write and read in any order */
+    std::unique_ptr<Http2RpcStream> bidiStream(const std::string& method, const Http2RpcCallOptions& options = {});
+
+    /** calls in progress */
+    size_t activeCalls() const;
+
+private:
+    friend class Http2RpcStream;
+    friend struct Http2RpcExpiry;
+
+    /** open the stream of a call; one the connection refused has already ended with Unavailable */
+    std::shared_ptr<Http2RpcCall> openCall(const std::string& method, const Http2RpcCallOptions& options, bool unary);
+    bool writeMessage(Http2RpcCall& call, std::span<const uint8_t> message, bool last);
+    bool endWrites(Http2RpcCall& call);
+    void cancelCall(Http2RpcCall& call, Http2RpcStatusCode code, const std::string& message);
+    std::shared_ptr<Http2RpcCall> findCall(uint32_t streamId) const;
+
+    void onHeaders(uint32_t streamId, Http2HeaderList& headers, bool endStream) override;
+    void onData(uint32_t streamId, std::span<const uint8_t> data, bool endStream) override;
+    void onStreamClosed(uint32_t streamId, Http2ErrorCode error) override;
+    void onConnectionClosed(Http2ErrorCode error) override;
+
+private:
+    Http2RpcChannelOptions m_options;
+    Http2Connection m_connection;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint32_t, std::shared_ptr<Http2RpcCall>> m_calls;
+
+    std::shared_ptr<Http2RpcExpiry> m_expiry;   // deadline timers reach the channel through it
+};
@@ -0,0 +1,452 @@
+#include "Http2Server.h"
+#include "PlatformCommonUtils.h"
+#include "ThreadPool.h"
+#include "ThreadTelemetry.h"
+#include <algorithm>
+#include <chrono>
+#ifdef _MSC_VER
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
+// pause after a failed accept, doubled while it keeps failing
+static constexpr uint32_t ACCEPT_BACKOFF_MIN_MS = 10;
+static constexpr uint32_t ACCEPT_BACKOFF_MAX_MS = 1000;
+
+/**
+ * @brief One client connection, the listener of its Http2Connection.
+ *        Callbacks run on the connection's reader thread; handlers hold a reference while they run
+ */
+class Http2ServerSession : public IHttp2ConnectionListener, public std::enable_shared_from_this<Http2ServerSession>
+{
+public:
+    Http2ServerSession(Http2Server& server, std::unique_ptr<PlatformEasySocket> socket, const Http2Settings& settings,
+        const Http2WriterOptions& writerOptions) :
+        m_server(server),
+        m_socket(std::move(socket)),
+        m_connection(*m_socket, Http2Role::Server, this, settings, writerOptions)
+    {
+    }
+
+    Http2Connection& connection() { return m_connection; }
+    bool isClosed() const { return m_closed.load(std::memory_order_acquire); }
+
+    void onHeaders(uint32_t streamId, Http2HeaderList& headers, bool endStream) override
+    {
+        auto it = m_requests.find(streamId);
+        if (it == m_requests.end()) {
+            Http2Request& request = m_requests[streamId];
+            request.streamId = streamId;
+            request.headers = std::move(headers);
+            it = m_requests.find(streamId);
+        }
+        else {
+            it->second.trailers = std::move(headers);
+        }
+        if (endStream) {
+            complete(it);
+        }
+    }
+
+    void onData(uint32_t streamId, std::span<const uint8_t> data, bool endStream) override
+    {
+        auto it = m_requests.find(streamId);
+        if (it == m_requests.end()) {
+            return;
+        }
+        if (it->second.body.size() + data.size() > m_server.m_options.maxRequestBody) {
+            m_requests.erase(it);
+            m_server.countReset();
+            m_connection.resetStream(streamId, Http2ErrorCode::RefusedStream);
+            return;
+        }
+        it->second.body.insert(it->second.body.end(), data.begin(), data.end());
+        if (endStream) {
+            complete(it);
+        }
+    }
+
+    void onStreamClosed(uint32_t streamId, Http2ErrorCode error) override
+    {
+        UNUSED(error);
+        // a request still being received was reset by the client
+        if (m_requests.erase(streamId) != 0) {
+            m_server.countReset();
+        }
+    }
+
+    void onConnectionClosed(Http2ErrorCode error) override
+    {
+        UNUSED(error);
+        m_requests.clear();
+        m_closed = true;
+    }
+
+private:
+    void complete(std::unordered_map<uint32_t, Http2Request>::iterator it)
+    {
+        Http2Request request = std::move(it->second);
+        m_requests.erase(it);
+        m_server.dispatch(shared_from_this(), std::move(request));
+    }
+
+private:
+    Http2Server& m_server;
+    std::unique_ptr<PlatformEasySocket> m_socket;
+    Http2Connection m_connection;       // declared after the socket it uses
+    std::unordered_map<uint32_t, Http2Request> m_requests;  // reader thread only, until complete
+    std::atomic_bool m_closed{ false };
+};
+
+/** Http2Request */
+std::string_view Http2Request::header(std::string_view name) const
+{
+    for (const Http2Header& entry : headers) {
+        if (entry.name == name) {
+            return entry.value;
+        }
+    }
+    return {};
+}
+
+std::string_view Http2Request::path() const
+{
+    std::string_view full = header(":path");
+    return full.substr(0, full.find('?'));
+}
+
+std::string_view Http2Request::query() const
+{
+    std::string_view full = header(":path");
+    size_t mark = full.find('?');
+    return mark == std::string_view::npos ? std::string_view() : full.substr(mark + 1);
+}
+
+/** Http2Response */
+Http2Response::Http2Response(std::shared_ptr<Http2ServerSession> session, Http2Connection& connection, uint32_t streamId):
+    m_session(std::move(session)),
+    m_connection(connection),
+    m_streamId(streamId)
+{
+}
+
+bool Http2Response::sendHeaders(int status, const Http2HeaderList& headers, bool endStream)
+{
+    if (m_headersSent || m_finished) {
+        return false;
+    }
+    Http2HeaderList block;
+    block.reserve(headers.size() + 1);
+    block.emplace_back(":status", std::to_string(status));
+    block.insert(block.end(), headers.begin(), headers.end());
+    m_headersSent = true;
+    m_finished = endStream;
+    return m_connection.sendHeaders(m_streamId, block, endStream);
+}
+
+bool Http2Response::sendData(std::span<const uint8_t> data, bool endStream)
+{
+    if (!m_headersSent || m_finished) {
+        return false;
+    }
+    m_finished = endStream;
+    return m_connection.sendData(m_streamId, data, endStream);
+}
+
+bool Http2Response::sendTrailers(const Http2HeaderList& trailers)
+{
+    if (!m_headersSent || m_finished) {
+        return false;
+    }
+    m_finished = true;
+    return m_connection.sendHeaders(m_streamId, trailers, true);
+}
+
+bool Http2Response::respond(int status, std::span<const uint8_t> body, const Http2HeaderList& headers)
+{
+    Http2HeaderList withLength(headers);
+    withLength.emplace_back("content-length", std::to_string(body.size()));
+    if (body.empty()) {
+        return sendHeaders(status, withLength, true);
+    }
+    return sendHeaders(status, withLength, false) && sendData(body, true);
+}
+
+bool Http2Response::respond(int status, std::string_view body, const Http2HeaderList& headers)
+{
+    return respond(status, std::span<const uint8_t>((const uint8_t*)body.data(), body.size()), headers);
+}
+
+bool Http2Response::reset(Http2ErrorCode error)
+{
+    if (m_finished) {
+        return false;
+    }
+    m_finished = true;
+    return m_connection.resetStream(m_streamId, error);
+}
+
+void Http2Response::finish()
+{
+    if (m_finished) {
+        return;
+    }
+    if (!m_headersSent) {
+        sendHeaders(500, {}, true);
+    }
+    else {
+        sendData({}, true);
+    }
+}
+
+/** Http2Server */
+Http2Server::Http2Server(const Http2ServerOptions& options):
+    m_options(options),
+    m_pool(options.pool != nullptr ? options.pool : &ThreadPool::shared()),
+    m_settings(options.settings)
+{
+    m_defaultHandler = [](const Http2Request&, Http2Response& response) {
+        response.respond(404, std::string_view("not found\n"), { { "content-type", "text/plain" } });
+    };
+}
+
+Http2Server::~Http2Server()
+{
+    stop(0);
+}
+
+void Http2Server::route(const std::string& path, Http2Handler handler)
+{
+    m_routes[path] = std::move(handler);
+}
+
+void Http2Server::setDefaultHandler(Http2Handler handler)
+{
+    m_defaultHandler = std::move(handler);
+}
+
+bool Http2Server::listen(const std::string& ip, int port)
+{
+    SocketSetupOptions opts;
+    opts.af = ip.find(':') != std::string::npos ? AF_INET6 : AF_INET;
+    opts.type = SOCK_STREAM;
+    opts.protocol = IPPROTO_TCP;
+    opts.ip = ip;
+    opts.port = port;
+    opts.recv_timeout = m_options.recvTimeoutMs;
+    // accepted sockets inherit it, WINDOW_UPDATE and small responses must not wait for an ACK
+    opts.no_delay = true;
+    if (!m_listener.setupSocket(opts) || !m_listener.listen()) {
+        LOG_ERROR("Http2Server: cannot listen on %s:%d: %s", ip.c_str(), port, m_listener.getErrorString().c_str());
+        m_listener.close();
+        return false;
+    }
+    m_port = m_listener.localPort();
+    return true;
+}
+
+bool Http2Server::start()
+{
+    if (m_port == 0) {
+        LOG_ERROR("Http2Server: listen() first");
+        return false;
+    }
+    if (m_running.exchange(true)) {
+        return false;
+    }
+    m_acceptor.setStartHook([] {
+        PlatformCommonUtils::set_current_thread_name("h2-accept");
+        ThreadTelemetry::shared().attach("h2-accept");
+    });
+    if (!m_acceptor.run([this] { acceptLoop(); })) {
+        LOG_ERROR("Http2Server: failed to start the accept thread");
+        m_running = false;
+        return false;
+    }
+    return true;
+}
+
+void Http2Server::stop(uint32_t drainMs)
+{
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    {
+        // wakes an accept backing off after a failure
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cond.notify_all();
+    }
+    // wakes a blocked accept
+    m_listener.interrupt();
+    m_acceptor.join();
+    m_listener.close();
+
+    std::vector<std::shared_ptr<Http2ServerSession>> sessions;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        sessions = m_sessions;
+    }
+    for (const auto& session : sessions) {
+        session->connection().goAway();
+    }
+
+    // requests already received still get their answer
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(drainMs);
+    auto drained = [&] {
+        return std::all_of(sessions.begin(), sessions.end(), [](const std::shared_ptr<Http2ServerSession>& session) {
+            return session->isClosed() || session->connection().activeStreams() == 0;
+        });
+    };
+    while (drainMs > 0 && std::chrono::steady_clock::now() < deadline) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_handlersRunning == 0 && drained()) {
+                break;
+            }
+            m_cond.wait_for(lock, std::chrono::milliseconds(10));
+        }
+    }
+
+    for (const auto& session : sessions) {
+        session->connection().close();
+    }
+    // handlers capture this server, their sends fail fast now that the connections are closed
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait(lock, [&] { return m_handlersRunning == 0; });
+    m_sessions.clear();
+    m_stats.connections = 0;
+}
+
+void Http2Server::updateSettings(const Http2Settings& settings)
+{
+    std::vector<std::shared_ptr<Http2ServerSession>> sessions;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_settings = settings;
+        sessions = m_sessions;
+    }
+    for (const auto& session : sessions) {
+        session->connection().updateSettings(settings);
+    }
+}
+
+Http2ServerStats Http2Server::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void Http2Server::acceptLoop()
+{
+    uint32_t backoffMs = 0;
+    while (m_running) {
+        std::unique_ptr<PlatformEasySocket> socket = m_listener.accept();
+        reapSessions();
+        if (!socket) {
+            if (m_listener.recvTimedOut()) {
+                continue;
+            }
+            if (!m_running) {
+                break;
+            }
+            // an aborted client, a failing socket option or running out of fds must not end
+            // the server: back off, longer while it keeps failing, and accept again
+            LOG_ERROR("Http2Server: accept failed: %s", m_listener.getErrorString().c_str());
+            backoffMs = std::min<uint32_t>(backoffMs == 0 ? ACCEPT_BACKOFF_MIN_MS : backoffMs * 2, ACCEPT_BACKOFF_MAX_MS);
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait_for(lock, std::chrono::milliseconds(backoffMs), [this] { return !m_running; });
+            continue;
+        }
+        backoffMs = 0;
+
+        std::shared_ptr<Http2ServerSession> session;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_sessions.size() >= m_options.maxConnections) {
+                ++m_stats.rejected;
+                continue;   // the socket closes as it goes out of scope
+            }
+            session = std::make_shared<Http2ServerSession>(*this, std::move(socket), m_settings, m_options.writer);
+            m_sessions.push_back(session);
+            ++m_stats.accepted;
+            m_stats.connections = m_sessions.size();
+        }
+        // the connection checks the client preface itself
+        session->connection().start();
+    }
+}
+
+void Http2Server::reapSessions()
+{
+    std::vector<std::shared_ptr<Http2ServerSession>> closed;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = std::partition(m_sessions.begin(), m_sessions.end(), [](const std::shared_ptr<Http2ServerSession>& session) {
+            return !session->isClosed();
+        });
+        closed.assign(it, m_sessions.end());
+        m_sessions.erase(it, m_sessions.end());
+        m_stats.connections = m_sessions.size();
+    }
+    // joins the reader and writer threads, outside the lock
+    for (const auto& session : closed) {
+        session->connection().close();
+    }
+}
+
+void Http2Server::dispatch(std::shared_ptr<Http2ServerSession> session, Http2Request&& request)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_handlersRunning;
+        ++m_stats.requests;
+    }
+    uint32_t streamId = request.streamId;
+    bool posted = m_pool->post([this, session, request = std::move(request)]() mutable {
+        // stop() waits for the count to reach zero, so it drops even if the response throws
+        struct HandlerDone
+        {
+            Http2Server* server;
+            ~HandlerDone() { server->handlerDone(); }
+        } done{ this };
+        handle(session, request);
+    });
+    if (!posted) {
+        // the pool is stopping: tell the client now instead of leaving the stream to its timeout
+        session->connection().resetStream(streamId, Http2ErrorCode::RefusedStream);
+        handlerDone();
+    }
+}
+
+void Http2Server::handlerDone()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    --m_handlersRunning;
+    m_cond.notify_all();
+}
+
+void Http2Server::handle(const std::shared_ptr<Http2ServerSession>& session, const Http2Request& request)
+{
+    Http2Response response(session, session->connection(), request.streamId);
+    auto it = m_routes.find(std::string(request.path()));
+    const Http2Handler& handler = it != m_routes.end() ? it->second : m_defaultHandler;
+    try {
+        handler(request, response);
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Http2Server: handler for %s threw: %s", std::string(request.path()).c_str(), e.what());
+    }
+    catch (...) {
+        LOG_ERROR("Http2Server: handler for %s threw an unknown exception", std::string(request.path()).c_str());
+    }
+    response.finish();
+}
+
+void Http2Server::countReset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_stats.resets;
+}
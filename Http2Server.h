@@ -0,0 +1,200 @@
+/**
+ *   Http 2.0 cleartext (h2c) server
+ *
+ *   Accepts prior-knowledge h2c connections on a listening PlatformEasySocket,
+ *   runs one server-role Http2Connection per client and hands every complete
+ *   request to its handler on a ThreadPool. The server's SETTINGS go out first
+ *   on every connection and can be changed at run time with updateSettings().
+ *   stop() sends GOAWAY and lets requests in progress finish.
+ *
+ *      Http2Server server;
+ *      server.route("/echo", [](const Http2Request& request, Http2Response& response) {
+ *          response.respond(200, request.body);
+ *      });
+ *      server.listen("127.0.0.1", 0);
+ *      server.start();
+ *      int port = server.port();
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <stdint.h>
+#include "CThread.hpp"
+#include "Http2Connection.h"
+#include "PlatformEasySocket.h"
+
+class ThreadPool;
+class Http2ServerSession;
+
+struct Http2ServerOptions
+{
+    Http2Settings settings;             // the server's SETTINGS, sent first on every connection
+    Http2WriterOptions writer;
+    size_t maxConnections = 256;        // connections above this are closed as soon as they are accepted
+    size_t maxRequestBody = 16 << 20;   // larger requests are reset with RefusedStream
+    int recvTimeoutMs = 1000;           // how often the acceptor looks for stop() and closed connections
+    ThreadPool* pool = nullptr;         // handlers run here, null: ThreadPool::shared()
+};
+
+struct Http2ServerStats
+{
+    uint64_t accepted = 0;
+    uint64_t rejected = 0;              // over maxConnections
+    uint64_t requests = 0;              // handed to a handler
+    uint64_t resets = 0;                // requests dropped before they were complete
+    size_t connections = 0;             // open now
+};
+
+/**
+ * @brief A complete request: headers, the whole body and trailers
+ */
+struct Http2Request
+{
+    uint32_t streamId = 0;
+    Http2HeaderList headers;
+    Http2HeaderList trailers;
+    std::vector<uint8_t> body;
+
+    /** first header of that name, empty if there is none */
+    std::string_view header(std::string_view name) const;
+    std::string_view method() const { return header(":method"); }
+    /** :path without the query */
+    std::string_view path() const;
+    /** what follows '?' in :path */
+    std::string_view query() const;
+};
+
+/**
+ * @brief The answer to one request; it may be sent at once or streamed.
+ *        Anything the handler leaves open is ended when it returns: a 500 if no headers
+ *        were sent, otherwise an empty DATA frame with END_STREAM
+ */
+class Http2Response
+{
+public:
+    uint32_t streamId() const { return m_streamId; }
+    Http2Connection& connection() { return m_connection; }
+
+    /** :status and headers, the body follows with sendData unless endStream is set */
+    bool sendHeaders(int status, const Http2HeaderList& headers = {}, bool endStream = false);
+
+    /** blocks while the client's window is exhausted, see Http2Connection::sendData */
+    bool sendData(std::span<const uint8_t> data, bool endStream = false);
+
+    /** end the response with trailers */
+    bool sendTrailers(const Http2HeaderList& trailers);
+
+    /** headers and the whole body */
+    bool respond(int status, std::span<const uint8_t> body = {}, const Http2HeaderList& headers = {});
+    bool respond(int status, std::string_view body, const Http2HeaderList& headers = {});
+
+    bool reset(Http2ErrorCode error = Http2ErrorCode::Cancel);
+
+    bool headersSent() const { return m_headersSent; }
+    bool finished() const { return m_finished; }
+
+private:
+    friend class Http2Server;
+    Http2Response(std::shared_ptr<Http2ServerSession> session, Http2Connection& connection, uint32_t streamId);
+
+    /** after the handler returned */
+    void finish();
+
+private:
+    std::shared_ptr<Http2ServerSession> m_session;  // keeps the connection alive while the handler runs
+    Http2Connection& m_connection;
+    uint32_t m_streamId;
+    bool m_headersSent = false;
+    bool m_finished = false;
+};
+
+using Http2Handler = std::function<void(const Http2Request& request, Http2Response& response)>;
+
+class Http2Server
+{
+public:
+    explicit Http2Server(const Http2ServerOptions& options = {});
+    ~Http2Server();
+
+    Http2Server(const Http2Server&) = delete;
+    Http2Server& operator=(const Http2Server&) = delete;
+
+    /** handler for an exact path, without the query; set routes before start() */
+    void route(const std::string& path, Http2Handler handler);
+
+    /** handler for paths without a route, the default answers 404 */
+    void setDefaultHandler(Http2Handler handler);
+
+    /**
+     * @brief      Bind and listen
+     * @param ip   address to bind, "127.0.0.1" for a loopback server; IPv6 if it contains ':'
+     * @param port 0 picks a free port, see port()
+     */
+    bool listen(const std::string& ip, int port);
+
+    /** the bound port */
+    int port() const { return m_port; }
+
+    /** start accepting connections */
+    bool start();
+
+    /**
+     * @brief         GOAWAY to every client, wait up to drainMs for requests in progress, then close;
+     *                returns once every running handler has returned
+     * @param drainMs 0 closes at once
+     */
+    void stop(uint32_t drainMs = 1000);
+
+    bool isRunning() const { return m_running.load(std::memory_order_acquire); }
+
+    /** send new SETTINGS on every open connection, and use them for new ones */
+    void updateSettings(const Http2Settings& settings);
+
+    Http2ServerStats stats() const;
+
+private:
+    friend class Http2ServerSession;
+
+    void acceptLoop();
+    /** close and drop sessions whose connection has ended */
+    void reapSessions();
+
+    /** from a session's reader thread: run the request's handler on the pool */
+    void dispatch(std::shared_ptr<Http2ServerSession> session, Http2Request&& request);
+    void handle(const std::shared_ptr<Http2ServerSession>& session, const Http2Request& request);
+    /** a dispatched request is finished, or was never run */
+    void handlerDone();
+    void countReset();
+
+private:
+    Http2ServerOptions m_options;
+    ThreadPool* m_pool;
+    std::unordered_map<std::string, Http2Handler> m_routes;
+    Http2Handler m_defaultHandler;
+
+    PlatformEasySocket m_listener;
+    int m_port = 0;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;     // stop(): a handler finished; acceptLoop: stop() was called
+    std::vector<std::shared_ptr<Http2ServerSession>> m_sessions;
+    Http2Settings m_settings;
+    Http2ServerStats m_stats;
+    size_t m_handlersRunning = 0;
+
+    CThread<void> m_acceptor;
+    std::atomic_bool m_running{ false };
+};
@@ -11,6 +11,14 @@
 #include <vector>
 #include <optional>
 #include <string>
+#include <stddef.h>
+
+/** one buffer of a gather write */
+struct EasyIoVec
+{
+	const void* data = nullptr;
+	size_t size = 0;
+};
 
 class IEasySocket
 {
@@ -28,4 +36,33 @@ public:
 
 	virtual std::optional<int> sendRaw(const char* byte, int len) = 0;
 	virtual std::optional<int> recvRaw(char* byte, int len) = 0;
+
+	/**
+	 * @brief  Send several buffers with one call (writev / WSASend where available)
+	 * @return bytes sent, possibly fewer than the total; nullopt on error
+	 */
+	virtual std::optional<int> sendGather(const EasyIoVec* iov, int count)
+	{
+		int total = 0;
+		for (int i = 0; i < count; ++i) {
+			std::optional<int> sent = sendRaw((const char*)iov[i].data, (int)iov[i].size);
+			if (!sent) {
+				return total > 0 ? std::optional<int>(total) : std::nullopt;
+			}
+			total += *sent;
+			if ((size_t)*sent < iov[i].size) {
+				break;
+			}
+		}
+		return total;
+	}
+
+	/** native descriptor, -1 if the socket has none */
+	virtual int nativeHandle() const { return -1; }
+
+	/** the last failed recvRaw on this thread only hit the receive timeout, the connection is still up */
+	virtual bool recvTimedOut() const { return false; }
+
+	/** wake a recvRaw blocked on another thread; the socket must still be closed afterwards */
+	virtual bool interrupt() { return false; }
 };
\ No newline at end of file
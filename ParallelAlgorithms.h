@@ -0,0 +1,402 @@
+/**
+ *   Parallel algorithms on ThreadPool
+ *
+ *   parallel_for, parallel_reduce, parallel_transform and a stable parallel
+ *   merge sort. Ranges are split lazily: a task hands the upper half of its
+ *   remaining range to the pool only while its own deque is empty, i.e. when
+ *   other workers are looking for work, so the task count adapts to the load
+ *   instead of being fixed up front. Waiting threads run queued tasks rather
+ *   than block, which makes nested calls from inside pool tasks safe.
+ *
+ *   Exceptions thrown by the callbacks cancel the remaining work and are
+ *   rethrown to the caller.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <functional>
+#include <exception>
+#include <stdexcept>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "ThreadPool.h"
+#include "PlatformSync.h"
+
+/** shared between the caller and the work it starts, cancel() stops handing out ranges */
+class CancellationToken
+{
+public:
+    void cancel() { m_cancelled.store(true, std::memory_order_release); }
+    bool isCancelled() const { return m_cancelled.load(std::memory_order_acquire); }
+    void reset() { m_cancelled.store(false, std::memory_order_release); }
+
+private:
+    std::atomic_bool m_cancelled{ false };
+};
+
+struct ParallelOptions
+{
+    size_t grain = 0;                       // smallest range handed to one call, 0 picks about 8 ranges per worker
+    ThreadPool* pool = nullptr;             // ThreadPool::shared() when null
+    const CancellationToken* cancel = nullptr;
+    TaskPriority priority = TaskPriority::Normal;
+};
+
+/**
+ * @brief Fork / join group, wait() helps the pool until every task of the group finished
+ */
+class TaskGroup
+{
+public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::shared(), const CancellationToken* token = nullptr,
+        TaskPriority priority = TaskPriority::Normal) :
+        m_pool(pool),
+        m_token(token),
+        m_priority(priority)
+    {
+    }
+
+    ~TaskGroup()
+    {
+        // tasks reference the group, never leave before they are done
+        waitDone();
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    /** tasks of a cancelled group are skipped, not run */
+    template<typename Func>
+    void run(Func&& func)
+    {
+        if (!m_pool.isAccepting() && m_pool.currentWorker() < 0) {
+            // pool is shut down, keep the result correct by running inline
+            runGuarded(func);
+            return;
+        }
+        m_pending.fetch_add(1, std::memory_order_relaxed);
+        auto task = [this, func = std::forward<Func>(func)]() mutable {
+            runGuarded(func);
+            m_pending.fetch_sub(1, std::memory_order_acq_rel);
+        };
+        if (!m_pool.post(std::move(task), m_priority)) {
+            m_pending.fetch_sub(1, std::memory_order_relaxed);
+            setError(std::make_exception_ptr(std::runtime_error("TaskGroup: thread pool shut down")));
+        }
+    }
+
+    /** wait for every task, rethrow the first exception one of them threw */
+    void wait()
+    {
+        waitDone();
+        if (m_error) {
+            std::exception_ptr error = std::exchange(m_error, nullptr);
+            std::rethrow_exception(error);
+        }
+    }
+
+    void cancel() { m_cancelled.store(true, std::memory_order_release); }
+
+    bool isCancelled() const
+    {
+        return m_cancelled.load(std::memory_order_acquire) || (m_token != nullptr && m_token->isCancelled());
+    }
+
+    ThreadPool& pool() { return m_pool; }
+
+private:
+    template<typename Func>
+    void runGuarded(Func& func)
+    {
+        if (isCancelled()) {
+            return;
+        }
+        try {
+            func();
+        }
+        catch (...) {
+            setError(std::current_exception());
+        }
+    }
+
+    void setError(std::exception_ptr error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_errorMutex);
+            if (!m_error) {
+                m_error = error;
+            }
+        }
+        cancel();
+    }
+
+    void waitDone()
+    {
+        uint32_t idle = 0;
+        while (m_pending.load(std::memory_order_acquire) != 0) {
+            if (m_pool.tryRunOne()) {
+                idle = 0;
+            }
+            else if (++idle < 64) {
+                sync_cpu_relax();
+            }
+            else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    ThreadPool& m_pool;
+    const CancellationToken* m_token;
+    TaskPriority m_priority;
+    std::atomic<size_t> m_pending{ 0 };
+    std::atomic_bool m_cancelled{ false };
+    std::mutex m_errorMutex;
+    std::exception_ptr m_error;
+};
+
+namespace ParallelDetail
+{
+    inline ThreadPool& poolOf(const ParallelOptions& options)
+    {
+        return options.pool != nullptr ? *options.pool : ThreadPool::shared();
+    }
+
+    inline size_t grainOf(const ParallelOptions& options, ThreadPool& pool, size_t count)
+    {
+        if (options.grain > 0) {
+            return options.grain;
+        }
+        size_t grain = count / (pool.size() * 8);
+        return grain > 0 ? grain : 1;
+    }
+
+    /**
+     * Body::Local is per task state: start(begin) creates it, chunk(local, b, e)
+     * processes one grain, finish(local, begin, end) sees the contiguous range
+     * the task processed itself.
+     */
+    template<typename Body>
+    void runRange(TaskGroup& group, size_t begin, size_t end, size_t grain, Body& body)
+    {
+        auto local = body.start(begin);
+        size_t first = begin;
+        while (begin < end) {
+            if (group.isCancelled()) {
+                break;
+            }
+            // split on demand; halves stay grain aligned so chunks do not shrink
+            while (end - begin > 2 * grain && group.pool().localPending() == 0) {
+                size_t half = ((end - begin) / 2 + grain - 1) / grain * grain;
+                size_t mid = begin + half;
+                group.run([&group, &body, mid, end, grain] { runRange(group, mid, end, grain, body); });
+                end = mid;
+            }
+            size_t chunkEnd = std::min(end, begin + grain);
+            body.chunk(local, begin, chunkEnd);
+            begin = chunkEnd;
+        }
+        body.finish(local, first, begin);
+    }
+
+    template<typename Func>
+    struct ForBody
+    {
+        Func& func;
+
+        struct Local {};
+        Local start(size_t) { return {}; }
+        void chunk(Local&, size_t begin, size_t end)
+        {
+            if constexpr (std::is_invocable_v<Func&, size_t, size_t>) {
+                func(begin, end);
+            }
+            else {
+                for (size_t i = begin; i < end; ++i) {
+                    func(i);
+                }
+            }
+        }
+        void finish(Local&, size_t, size_t) {}
+    };
+
+    template<typename T, typename RangeFn>
+    struct ReduceBody
+    {
+        const T& identity;
+        RangeFn& rangeFn;
+        std::mutex mutex;
+        std::vector<std::pair<size_t, T>> partials;
+
+        using Local = std::optional<T>;
+        Local start(size_t) { return Local(identity); }
+        void chunk(Local& acc, size_t begin, size_t end) { acc = rangeFn(begin, end, std::move(*acc)); }
+        void finish(Local& acc, size_t begin, size_t end)
+        {
+            if (begin == end) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            partials.emplace_back(begin, std::move(*acc));
+        }
+    };
+
+    template<typename Body>
+    bool runParallel(size_t begin, size_t end, Body& body, const ParallelOptions& options)
+    {
+        if (begin >= end) {
+            return true;
+        }
+        ThreadPool& pool = poolOf(options);
+        TaskGroup group(pool, options.cancel, options.priority);
+        size_t grain = grainOf(options, pool, end - begin);
+        runRange(group, begin, end, grain, body);
+        group.wait();
+        return !group.isCancelled();
+    }
+
+    inline bool cancelled(const CancellationToken* token)
+    {
+        return token != nullptr && token->isCancelled();
+    }
+
+    // merge [a, aEnd) and [b, bEnd) into out, splitting the larger input so both halves run in parallel
+    template<typename In, typename Out, typename Compare>
+    void parallelMerge(ThreadPool& pool, In a, In aEnd, In b, In bEnd, Out out, Compare& comp, size_t grain, const CancellationToken* token)
+    {
+        size_t na = (size_t)(aEnd - a);
+        size_t nb = (size_t)(bEnd - b);
+        if (cancelled(token)) {
+            // elements still have to reach out, just not in order
+            std::move(b, bEnd, std::move(a, aEnd, out));
+            return;
+        }
+        if (na + nb <= grain) {
+            std::merge(std::make_move_iterator(a), std::make_move_iterator(aEnd),
+                std::make_move_iterator(b), std::make_move_iterator(bEnd), out, comp);
+            return;
+        }
+        In aMid, bMid;
+        // lower_bound in the right run and upper_bound in the left keep equal keys in order
+        if (na >= nb) {
+            aMid = a + na / 2;
+            bMid = std::lower_bound(b, bEnd, *aMid, comp);
+        }
+        else {
+            bMid = b + nb / 2;
+            aMid = std::upper_bound(a, aEnd, *bMid, comp);
+        }
+        Out outMid = out + ((aMid - a) + (bMid - b));
+        TaskGroup join(pool);
+        join.run([&] { parallelMerge(pool, aMid, aEnd, bMid, bEnd, outMid, comp, grain, token); });
+        parallelMerge(pool, a, aMid, b, bMid, out, comp, grain, token);
+        join.wait();
+    }
+
+    // sorts the values held in data[0, n); the result ends up in other when toOther is set
+    template<typename Data, typename Other, typename Compare>
+    void mergeSort(ThreadPool& pool, Data data, Other other, size_t n, bool toOther, Compare& comp, size_t grain, const CancellationToken* token)
+    {
+        if (n <= grain) {
+            if (!cancelled(token)) {
+                std::stable_sort(data, data + n, comp);
+            }
+            if (toOther) {
+                std::move(data, data + n, other);
+            }
+            return;
+        }
+        size_t mid = n / 2;
+        {
+            TaskGroup join(pool);
+            join.run([&] { mergeSort(pool, data + mid, other + mid, n - mid, !toOther, comp, grain, token); });
+            mergeSort(pool, data, other, mid, !toOther, comp, grain, token);
+            join.wait();
+        }
+        if (toOther) {
+            parallelMerge(pool, data, data + mid, data + mid, data + n, other, comp, grain, token);
+        }
+        else {
+            parallelMerge(pool, other, other + mid, other + mid, other + n, data, comp, grain, token);
+        }
+    }
+}
+
+/**
+ * @brief  Call func(i) for every i in [begin, end), or func(b, e) once per range when it takes two indices
+ * @return false if cancelled before every index was visited
+ */
+template<typename Func>
+bool parallel_for(size_t begin, size_t end, Func&& func, const ParallelOptions& options = {})
+{
+    ParallelDetail::ForBody<std::remove_reference_t<Func>> body{ func };
+    return ParallelDetail::runParallel(begin, end, body, options);
+}
+
+/**
+ * @brief  Reduce [begin, end) to one value
+ * @param  rangeFn  T(size_t b, size_t e, T acc): fold indices [b, e) into acc
+ * @param  combine  T(T, T), associative; partial results are combined in index order
+ * @return the result, identity if cancelled before any range finished
+ */
+template<typename T, typename RangeFn, typename Combine>
+T parallel_reduce(size_t begin, size_t end, T identity, RangeFn&& rangeFn, Combine&& combine, const ParallelOptions& options = {})
+{
+    ParallelDetail::ReduceBody<T, std::remove_reference_t<RangeFn>> body{ identity, rangeFn, {}, {} };
+    ParallelDetail::runParallel(begin, end, body, options);
+
+    std::sort(body.partials.begin(), body.partials.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    T result = identity;
+    for (auto& partial : body.partials) {
+        result = combine(std::move(result), std::move(partial.second));
+    }
+    return result;
+}
+
+/**
+ * @brief  out[i] = func(first[i]) for every element, random access iterators
+ * @return false if cancelled
+ */
+template<typename InIt, typename OutIt, typename Func>
+bool parallel_transform(InIt first, InIt last, OutIt out, Func&& func, const ParallelOptions& options = {})
+{
+    size_t count = (size_t)std::distance(first, last);
+    return parallel_for(0, count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            out[i] = func(first[i]);
+        }
+    }, options);
+}
+
+/**
+ * @brief  Stable merge sort of a random access range, uses one temporary buffer of the same size
+ * @return false if cancelled, the range then holds every element but not in order
+ */
+template<typename It, typename Compare = std::less<>>
+bool parallel_sort(It first, It last, Compare comp = Compare(), const ParallelOptions& options = {})
+{
+    using T = typename std::iterator_traits<It>::value_type;
+    size_t count = (size_t)(last - first);
+    ThreadPool& pool = ParallelDetail::poolOf(options);
+    size_t grain = options.grain > 0 ? options.grain : std::max<size_t>(2048, count / (pool.size() * 4));
+    if (count <= grain) {
+        std::stable_sort(first, last, comp);
+        return true;
+    }
+
+    // sorted out of the buffer back into place; cancellation skips sorting but never the moves
+    std::vector<T> buffer(std::make_move_iterator(first), std::make_move_iterator(last));
+    ParallelDetail::mergeSort(pool, buffer.begin(), first, count, true, comp, grain, options.cancel);
+    return !ParallelDetail::cancelled(options.cancel);
+}
@@ -0,0 +1,232 @@
+#include "Pipeline.h"
+#include "PlatformClock.h"
+#include "ThreadTelemetry.h"
+#include "CpuTopology.h"     // set_current_thread_name for the stage threads
+
+static inline void atomic_store_max(std::atomic<uint64_t>& target, uint64_t value)
+{
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed));
+}
+
+static inline size_t latency_bucket(uint64_t ns)
+{
+    size_t bucket = 0;
+    while (ns > 1 && bucket < StageMetrics::BUCKETS - 1) {
+        ns >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+uint64_t PipelineDetail::now_ns()
+{
+    return TscClock::nowNs();
+}
+
+uint64_t StageMetrics::latencyPercentile(double percentile) const
+{
+    uint64_t total = 0;
+    for (uint64_t count : latencyHistogram) {
+        total += count;
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)(total * percentile / 100.0);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += latencyHistogram[i];
+        if (seen > target) {
+            return std::min(1ULL << (i + 1), (unsigned long long)maxLatencyNs);
+        }
+    }
+    return maxLatencyNs;
+}
+
+PipelineStageBase::PipelineStageBase(Pipeline& pipeline, const std::string& name, const StageOptions& options) :
+    m_pipeline(pipeline),
+    m_name(name),
+    m_options(options)
+{
+    if (m_options.concurrency == 0) {
+        m_options.concurrency = 1;
+    }
+}
+
+PipelineStageBase::~PipelineStageBase()
+{
+    join();
+}
+
+bool PipelineStageBase::start()
+{
+    m_live = m_options.concurrency;
+    for (uint32_t i = 0; i < m_options.concurrency; ++i) {
+        auto thread = std::make_unique<CThread<void>>();
+        std::string threadName = m_pipeline.name() + "-" + m_name + "-" + std::to_string(i);
+        thread->setStartHook([threadName] {
+            PlatformCommonUtils::set_current_thread_name(threadName);
+            ThreadTelemetry::shared().attach(threadName);
+        });
+        bool started = thread->run([this] {
+            workerLoop();
+            if (m_live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                closeOutput();
+            }
+        });
+        if (!started) {
+            LOG_ERROR("Pipeline: failed to start %s thread %u", m_name.c_str(), i);
+            // the threads that never ran still count as finished
+            if (m_live.fetch_sub(m_options.concurrency - i, std::memory_order_acq_rel) == m_options.concurrency - i) {
+                closeOutput();
+            }
+            return false;
+        }
+        m_threads.push_back(std::move(thread));
+    }
+    return true;
+}
+
+void PipelineStageBase::join()
+{
+    for (auto& thread : m_threads) {
+        thread->join();
+    }
+    m_threads.clear();
+}
+
+void PipelineStageBase::recordItem(uint64_t ns)
+{
+    m_busyNs.fetch_add(ns, std::memory_order_relaxed);
+    m_latencyHistogram[latency_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    atomic_store_max(m_maxLatencyNs, ns);
+}
+
+bool PipelineStageBase::stopRequested() const
+{
+    return m_pipeline.isStopping();
+}
+
+StageMetrics PipelineStageBase::metrics(uint64_t wallNs) const
+{
+    StageMetrics metrics;
+    metrics.name = m_name;
+    metrics.concurrency = m_options.concurrency;
+    metrics.itemsIn = m_itemsIn.load(std::memory_order_relaxed);
+    metrics.itemsOut = m_itemsOut.load(std::memory_order_relaxed);
+    metrics.dropped = m_dropped.load(std::memory_order_relaxed);
+    metrics.errors = m_errors.load(std::memory_order_relaxed);
+    metrics.busyNs = m_busyNs.load(std::memory_order_relaxed);
+    metrics.starvedNs = m_starvedNs.load(std::memory_order_relaxed);
+    metrics.blockedNs = m_blockedNs.load(std::memory_order_relaxed);
+    metrics.maxLatencyNs = m_maxLatencyNs.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < StageMetrics::BUCKETS; ++i) {
+        metrics.latencyHistogram[i] = m_latencyHistogram[i].load(std::memory_order_relaxed);
+    }
+    metrics.queueDepth = inputDepth();
+    metrics.queueCapacity = inputCapacity();
+    if (wallNs > 0) {
+        metrics.utilization = (double)metrics.busyNs / ((double)wallNs * metrics.concurrency);
+    }
+    return metrics;
+}
+
+Pipeline::Pipeline(const std::string& name) :
+    m_name(name)
+{
+}
+
+Pipeline::~Pipeline()
+{
+    if (m_started) {
+        stop(false);
+    }
+}
+
+bool Pipeline::start()
+{
+    if (m_stages.empty()) {
+        LOG_ERROR("Pipeline %s: no stages", m_name.c_str());
+        return false;
+    }
+    for (const auto& stage : m_stages) {
+        if (!stage->isConnected()) {
+            LOG_ERROR("Pipeline %s: stage %s has no downstream, end the chain with sink()", m_name.c_str(), stage->name().c_str());
+            return false;
+        }
+    }
+    if (m_started.exchange(true)) {
+        LOG_ERROR("Pipeline %s: already started", m_name.c_str());
+        return false;
+    }
+    m_startNs = PipelineDetail::now_ns();
+    // sinks first so nothing upstream blocks on a stage that is not running yet
+    for (auto it = m_stages.rbegin(); it != m_stages.rend(); ++it) {
+        if (!(*it)->start()) {
+            stop(false);
+            return false;
+        }
+    }
+    return true;
+}
+
+void Pipeline::wait()
+{
+    // the end of each stage closes the next one's input, so joining in order drains the chain
+    for (auto& stage : m_stages) {
+        stage->join();
+    }
+    uint64_t expected = 0;
+    m_endNs.compare_exchange_strong(expected, PipelineDetail::now_ns());
+}
+
+void Pipeline::stop(bool drain)
+{
+    m_stopping.store(true, std::memory_order_release);
+    if (!drain) {
+        for (auto& stage : m_stages) {
+            stage->closeInput();
+            stage->closeOutput();
+        }
+    }
+    wait();
+}
+
+std::vector<StageMetrics> Pipeline::metrics() const
+{
+    uint64_t end = m_endNs.load(std::memory_order_relaxed);
+    uint64_t wall = m_startNs == 0 ? 0 : (end != 0 ? end : PipelineDetail::now_ns()) - m_startNs;
+    std::vector<StageMetrics> result;
+    result.reserve(m_stages.size());
+    for (const auto& stage : m_stages) {
+        result.push_back(stage->metrics(wall));
+    }
+    return result;
+}
+
+void Pipeline::dump() const
+{
+    std::vector<StageMetrics> stages = metrics();
+    size_t bottleneck = 0;
+    for (size_t i = 1; i < stages.size(); ++i) {
+        if (stages[i].utilization > stages[bottleneck].utilization) {
+            bottleneck = i;
+        }
+    }
+    LOG_INFO("pipeline %s", m_name.c_str());
+    LOG_INFO("%-16s %4s %10s %10s %8s %6s %7s %10s %10s %9s %9s %8s",
+        "stage", "thr", "in", "out", "dropped", "errors", "util", "p50(ns)", "p99(ns)", "starved%", "blocked%", "queue");
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const StageMetrics& s = stages[i];
+        double threadNs = (double)(s.busyNs + s.starvedNs + s.blockedNs);
+        double starved = threadNs > 0 ? 100.0 * s.starvedNs / threadNs : 0;
+        double blocked = threadNs > 0 ? 100.0 * s.blockedNs / threadNs : 0;
+        std::string queue = s.queueCapacity == 0 ? "-" : std::to_string(s.queueDepth) + "/" + std::to_string(s.queueCapacity);
+        LOG_INFO("%-16s %4u %10llu %10llu %8llu %6llu %6.1f%% %10llu %10llu %8.1f%% %8.1f%% %8s%s",
+            s.name.c_str(), s.concurrency, (unsigned long long)s.itemsIn, (unsigned long long)s.itemsOut,
+            (unsigned long long)s.dropped, (unsigned long long)s.errors, 100.0 * s.utilization,
+            (unsigned long long)s.latencyPercentile(50), (unsigned long long)s.latencyPercentile(99),
+            starved, blocked, queue.c_str(), i == bottleneck && stages.size() > 1 ? "  <- bottleneck" : "");
+    }
+}
@@ -0,0 +1,420 @@
+/**
+ *   Dataflow pipeline of staged processing
+ *
+ *   A pipeline is a chain of stages: a source, any number of transform stages
+ *   and a sink, joined by bounded lock-free queues (BlockingQueue over
+ *   MpmcQueue). Every stage runs on its own threads with its own concurrency,
+ *   a full queue blocks the stage feeding it (back-pressure), and every stage
+ *   keeps latency, starvation, blocking and queue depth counters so dump()
+ *   shows which stage is the bottleneck.
+ *
+ *      Pipeline pipeline("import");
+ *      pipeline.source<Frame>("read", [&](Frame& frame) { return readFrame(frame); })
+ *          .then<Record>("decode", [](Frame&& frame) { return decode(frame); }, StageOptions{ 4 })
+ *          .sink("store", [&](Record&& record) { db.insert(record); });
+ *      pipeline.start();
+ *      pipeline.wait();
+ *
+ *   Items must be default constructible and movable.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <atomic>
+#include <functional>
+#include <type_traits>
+#include <algorithm>
+#include <stdint.h>
+#include "ConcurrentQueue.h"
+#include "CThread.hpp"
+#include "PlatformCommonUtils.h"
+
+struct StageOptions
+{
+    uint32_t concurrency = 1;       // threads running the stage function
+    size_t queueCapacity = 1024;    // input queue, the upstream stage blocks when it is full
+    size_t batch = 16;              // items taken from the input queue at once
+};
+
+struct StageMetrics
+{
+    static constexpr size_t BUCKETS = 32;   // bucket i counts items processed in [2^i, 2^(i+1)) ns
+
+    std::string name;
+    uint32_t concurrency = 0;
+    uint64_t itemsIn = 0;
+    uint64_t itemsOut = 0;
+    uint64_t dropped = 0;           // the stage function returned no value or threw
+    uint64_t errors = 0;            // the stage function threw
+    uint64_t busyNs = 0;            // inside the stage function, summed over threads
+    uint64_t starvedNs = 0;         // waiting for input
+    uint64_t blockedNs = 0;         // waiting for room downstream
+    uint64_t maxLatencyNs = 0;
+    uint64_t latencyHistogram[BUCKETS] = {};
+    size_t queueDepth = 0;          // input queue
+    size_t queueCapacity = 0;
+    double utilization = 0;         // busyNs / (wall time * concurrency)
+
+    /** approximate percentile (0-100) of the per item time in the stage function, in ns */
+    uint64_t latencyPercentile(double percentile) const;
+};
+
+class Pipeline;
+
+/**
+ * @brief Threads and counters shared by every kind of stage
+ */
+class PipelineStageBase
+{
+public:
+    PipelineStageBase(Pipeline& pipeline, const std::string& name, const StageOptions& options);
+    virtual ~PipelineStageBase();
+
+    PipelineStageBase(const PipelineStageBase&) = delete;
+    PipelineStageBase& operator=(const PipelineStageBase&) = delete;
+
+    const std::string& name() const { return m_name; }
+    StageMetrics metrics(uint64_t wallNs) const;
+
+protected:
+    friend class Pipeline;
+
+    bool start();
+    void join();
+
+    /** runs on each stage thread until the input is drained or the pipeline stops */
+    virtual void workerLoop() = 0;
+    /** called once, by the last thread of the stage to leave */
+    virtual void closeOutput() = 0;
+    /** drop everything queued in front of the stage and wake its threads */
+    virtual void closeInput() {}
+    virtual bool isConnected() const = 0;
+    virtual size_t inputDepth() const { return 0; }
+    virtual size_t inputCapacity() const { return 0; }
+
+    void recordItem(uint64_t ns);
+    bool stopRequested() const;
+
+protected:
+    Pipeline& m_pipeline;
+    std::string m_name;
+    StageOptions m_options;
+
+    std::atomic<uint64_t> m_itemsIn{ 0 };
+    std::atomic<uint64_t> m_itemsOut{ 0 };
+    std::atomic<uint64_t> m_dropped{ 0 };
+    std::atomic<uint64_t> m_errors{ 0 };
+    std::atomic<uint64_t> m_busyNs{ 0 };
+    std::atomic<uint64_t> m_starvedNs{ 0 };
+    std::atomic<uint64_t> m_blockedNs{ 0 };
+    std::atomic<uint64_t> m_maxLatencyNs{ 0 };
+    std::atomic<uint64_t> m_latencyHistogram[StageMetrics::BUCKETS] = {};
+
+private:
+    std::vector<std::unique_ptr<CThread<void>>> m_threads;
+    std::atomic<uint32_t> m_live{ 0 };
+};
+
+template<typename T>
+using PipelineChannel = BlockingQueue<MpmcQueue<T>>;
+
+namespace PipelineDetail
+{
+    uint64_t now_ns();
+
+    /** stage with a typed output */
+    template<typename Out>
+    class OutputStage : public PipelineStageBase
+    {
+    public:
+        using PipelineStageBase::PipelineStageBase;
+
+        void setOutput(std::shared_ptr<PipelineChannel<Out>> output) { m_output = std::move(output); }
+
+    protected:
+        bool emit(Out&& item)
+        {
+            uint64_t start = now_ns();
+            bool pushed = m_output->push(std::move(item));
+            m_blockedNs.fetch_add(now_ns() - start, std::memory_order_relaxed);
+            if (pushed) {
+                m_itemsOut.fetch_add(1, std::memory_order_relaxed);
+            }
+            return pushed;
+        }
+
+        void closeOutput() override { m_output->close(); }
+        bool isConnected() const override { return m_output != nullptr; }
+
+        std::shared_ptr<PipelineChannel<Out>> m_output;
+    };
+
+    /** stage with a typed input; Base is OutputStage<Out> or PipelineStageBase */
+    template<typename In, typename Base>
+    class InputStage : public Base
+    {
+    public:
+        InputStage(Pipeline& pipeline, const std::string& name, const StageOptions& options, std::shared_ptr<PipelineChannel<In>> input) :
+            Base(pipeline, name, options),
+            m_input(std::move(input))
+        {
+        }
+
+    protected:
+        /** take the next batch, false when the input is closed and drained */
+        bool next(std::vector<In>& batch, size_t& count)
+        {
+            uint64_t start = now_ns();
+            count = m_input->popBatch(batch.begin(), batch.size());
+            // after stop(false) whatever is still queued, or pushed just before the close, is dropped
+            while (count > 0 && m_discard.load(std::memory_order_acquire)) {
+                this->m_dropped.fetch_add(count, std::memory_order_relaxed);
+                count = m_input->popBatch(batch.begin(), batch.size());
+            }
+            this->m_starvedNs.fetch_add(now_ns() - start, std::memory_order_relaxed);
+            this->m_itemsIn.fetch_add(count, std::memory_order_relaxed);
+            return count > 0;
+        }
+
+        void closeInput() override
+        {
+            m_discard.store(true, std::memory_order_release);
+            m_input->close();
+        }
+        size_t inputDepth() const override { return m_input->queue().sizeApprox(); }
+        size_t inputCapacity() const override { return m_input->queue().capacity(); }
+
+        std::shared_ptr<PipelineChannel<In>> m_input;
+        std::atomic_bool m_discard{ false };
+    };
+
+    template<typename Out, typename Func>
+    class SourceStage : public OutputStage<Out>
+    {
+    public:
+        SourceStage(Pipeline& pipeline, const std::string& name, const StageOptions& options, Func func) :
+            OutputStage<Out>(pipeline, name, options),
+            m_func(std::move(func))
+        {
+        }
+
+    protected:
+        void workerLoop() override
+        {
+            while (!this->stopRequested()) {
+                Out item{};
+                bool more = false;
+                uint64_t start = now_ns();
+                try {
+                    more = m_func(item);
+                }
+                catch (...) {
+                    this->m_errors.fetch_add(1, std::memory_order_relaxed);
+                    LOG_ERROR("Pipeline: source %s threw, stopping it", this->m_name.c_str());
+                }
+                this->recordItem(now_ns() - start);
+                if (!more || !this->emit(std::move(item))) {
+                    break;
+                }
+                this->m_itemsIn.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        Func m_func;
+    };
+
+    template<typename In, typename Out, typename Func>
+    class TransformStage : public InputStage<In, OutputStage<Out>>
+    {
+    public:
+        TransformStage(Pipeline& pipeline, const std::string& name, const StageOptions& options,
+            std::shared_ptr<PipelineChannel<In>> input, Func func) :
+            InputStage<In, OutputStage<Out>>(pipeline, name, options, std::move(input)),
+            m_func(std::move(func))
+        {
+        }
+
+    protected:
+        void workerLoop() override
+        {
+            std::vector<In> batch(std::max<size_t>(1, this->m_options.batch));
+            size_t count = 0;
+            while (this->next(batch, count)) {
+                for (size_t i = 0; i < count; ++i) {
+                    std::optional<Out> result;
+                    uint64_t start = now_ns();
+                    try {
+                        result = m_func(std::move(batch[i]));
+                    }
+                    catch (...) {
+                        this->m_errors.fetch_add(1, std::memory_order_relaxed);
+                        LOG_ERROR("Pipeline: stage %s threw, item dropped", this->m_name.c_str());
+                    }
+                    this->recordItem(now_ns() - start);
+                    if (!result) {
+                        this->m_dropped.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+                    if (!this->emit(std::move(*result))) {
+                        return;     // downstream closed by stop(false)
+                    }
+                }
+            }
+        }
+
+        Func m_func;
+    };
+
+    template<typename In, typename Func>
+    class SinkStage : public InputStage<In, PipelineStageBase>
+    {
+    public:
+        SinkStage(Pipeline& pipeline, const std::string& name, const StageOptions& options,
+            std::shared_ptr<PipelineChannel<In>> input, Func func) :
+            InputStage<In, PipelineStageBase>(pipeline, name, options, std::move(input)),
+            m_func(std::move(func))
+        {
+        }
+
+    protected:
+        void workerLoop() override
+        {
+            std::vector<In> batch(std::max<size_t>(1, this->m_options.batch));
+            size_t count = 0;
+            while (this->next(batch, count)) {
+                for (size_t i = 0; i < count; ++i) {
+                    uint64_t start = now_ns();
+                    try {
+                        m_func(std::move(batch[i]));
+                        this->m_itemsOut.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    catch (...) {
+                        this->m_errors.fetch_add(1, std::memory_order_relaxed);
+                        LOG_ERROR("Pipeline: sink %s threw, item dropped", this->m_name.c_str());
+                    }
+                    this->recordItem(now_ns() - start);
+                }
+            }
+        }
+
+        void closeOutput() override {}
+        bool isConnected() const override { return true; }
+
+        Func m_func;
+    };
+}
+
+/**
+ * @brief Appends stages after a stage producing T
+ */
+template<typename T>
+class PipelineBuilder
+{
+public:
+    PipelineBuilder(Pipeline& pipeline, PipelineDetail::OutputStage<T>* tail) : m_pipeline(pipeline), m_tail(tail) {}
+
+    /**
+     * @brief  Add a stage running func on every item
+     * @param  func  Out(T&&) or std::optional<Out>(T&&), an empty optional drops the item
+     */
+    template<typename Out, typename Func>
+    PipelineBuilder<Out> then(const std::string& name, Func func, const StageOptions& options = {});
+
+    /** end the pipeline with func(T&&) */
+    template<typename Func>
+    void sink(const std::string& name, Func func, const StageOptions& options = {});
+
+private:
+    Pipeline& m_pipeline;
+    PipelineDetail::OutputStage<T>* m_tail;
+};
+
+class Pipeline
+{
+public:
+    explicit Pipeline(const std::string& name);
+    ~Pipeline();
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    /**
+     * @brief  Start the pipeline with func(T& out), called until it returns false
+     * @note   With concurrency > 1 func is called from several threads at once
+     */
+    template<typename T, typename Func>
+    PipelineBuilder<T> source(const std::string& name, Func func, const StageOptions& options = {})
+    {
+        auto stage = std::make_unique<PipelineDetail::SourceStage<T, Func>>(*this, name, options, std::move(func));
+        auto* tail = stage.get();
+        m_stages.push_back(std::move(stage));
+        return PipelineBuilder<T>(*this, tail);
+    }
+
+    /** start every stage, false if the chain does not end in a sink */
+    bool start();
+
+    /** wait until the source finished and everything it produced left the sink */
+    void wait();
+
+    /**
+     * @brief        Stop the sources and wait
+     * @note         A source blocked inside its function is only noticed once the function returns
+     * @param drain  true: items already queued still flow to the sink. false: they are dropped,
+     *               only the batch each stage has already taken is finished
+     */
+    void stop(bool drain = true);
+
+    bool isStopping() const { return m_stopping.load(std::memory_order_acquire); }
+    const std::string& name() const { return m_name; }
+
+    std::vector<StageMetrics> metrics() const;
+
+    /** log a table of metrics(), the stage with the highest utilization is marked as bottleneck */
+    void dump() const;
+
+private:
+    template<typename T>
+    friend class PipelineBuilder;
+
+    void addStage(std::unique_ptr<PipelineStageBase> stage) { m_stages.push_back(std::move(stage)); }
+
+private:
+    std::string m_name;
+    std::vector<std::unique_ptr<PipelineStageBase>> m_stages;
+    std::atomic_bool m_started{ false };
+    std::atomic_bool m_stopping{ false };
+    uint64_t m_startNs = 0;
+    std::atomic<uint64_t> m_endNs{ 0 };
+};
+
+template<typename T>
+template<typename Out, typename Func>
+inline PipelineBuilder<Out> PipelineBuilder<T>::then(const std::string& name, Func func, const StageOptions& options)
+{
+    auto channel = std::make_shared<PipelineChannel<T>>(options.queueCapacity);
+    m_tail->setOutput(channel);
+    auto wrapped = [func = std::move(func)](T&& item) mutable -> std::optional<Out> { return func(std::move(item)); };
+    using Stage = PipelineDetail::TransformStage<T, Out, decltype(wrapped)>;
+    auto stage = std::make_unique<Stage>(m_pipeline, name, options, channel, std::move(wrapped));
+    auto* tail = stage.get();
+    m_pipeline.addStage(std::move(stage));
+    return PipelineBuilder<Out>(m_pipeline, tail);
+}
+
+template<typename T>
+template<typename Func>
+inline void PipelineBuilder<T>::sink(const std::string& name, Func func, const StageOptions& options)
+{
+    auto channel = std::make_shared<PipelineChannel<T>>(options.queueCapacity);
+    m_tail->setOutput(channel);
+    using Stage = PipelineDetail::SinkStage<T, Func>;
+    m_pipeline.addStage(std::make_unique<Stage>(m_pipeline, name, options, channel, std::move(func)));
+}
@@ -0,0 +1,120 @@
+#include "PlatformClock.h"
+#include "PlatformCommonUtils.h"
+#include <thread>
+#include <fstream>
+#include <iterator>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_MSC_VER) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+static constexpr uint32_t CALIBRATION_MS = 10;
+static constexpr double MAX_FREQUENCY_SPREAD = 0.005;   // two calibration rounds must agree within 0.5%
+
+struct ClockSample
+{
+    uint64_t ns;
+    uint64_t counter;
+};
+
+static bool counter_disabled_by_env()
+{
+    const char* value = getenv("PLATFORM_DISABLE_TSC");
+    return value != nullptr && strcmp(value, "0") != 0;
+}
+
+static bool counter_supported()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int regs[4] = { 0 };
+    __cpuid(regs, 0x80000000);
+    if ((unsigned)regs[0] < 0x80000007u) {
+        return false;
+    }
+    __cpuid(regs, 0x80000007);
+    return (regs[3] & (1 << 8)) != 0;  // invariant TSC
+#elif defined(__x86_64__) || defined(__i386__)
+    unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007u) {
+        return false;
+    }
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    if ((edx & (1 << 8)) == 0) {
+        return false;
+    }
+#if defined(__linux__)
+    // the kernel drops tsc from the list when it has seen it misbehave (unsynchronized sockets, halts in deep C states)
+    std::ifstream file("/sys/devices/system/clocksource/clocksource0/available_clocksource");
+    if (file) {
+        std::string sources((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (sources.find("tsc") == std::string::npos) {
+            return false;
+        }
+    }
+#endif
+    return true;
+#elif defined(__aarch64__)
+    return true;    // the generic timer runs at a fixed frequency
+#else
+    return false;
+#endif
+}
+
+static ClockSample take_sample()
+{
+    // keep the read that was bracketed most tightly, an interrupt in between would skew it
+    ClockSample best{ 0, 0 };
+    uint64_t bestSpread = UINT64_MAX;
+    for (int i = 0; i < 8; ++i) {
+        uint64_t before = TscClock::readCounter();
+        uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        uint64_t after = TscClock::readCounter();
+        if (after - before < bestSpread) {
+            bestSpread = after - before;
+            best.ns = ns;
+            best.counter = before + (after - before) / 2;
+        }
+    }
+    return best;
+}
+
+static double frequency_between(const ClockSample& from, const ClockSample& to)
+{
+    if (to.ns <= from.ns || to.counter <= from.counter) {
+        return 0;
+    }
+    return (double)(to.counter - from.counter) / (double)(to.ns - from.ns);
+}
+
+TscClock::Calibration TscClock::calibrate()
+{
+    Calibration cal;
+    if (counter_disabled_by_env() || !counter_supported()) {
+        LOG_DEBUG("TscClock: counter not usable, using steady_clock");
+        return cal;
+    }
+
+    ClockSample first = take_sample();
+    std::this_thread::sleep_for(std::chrono::milliseconds(CALIBRATION_MS));
+    ClockSample middle = take_sample();
+    std::this_thread::sleep_for(std::chrono::milliseconds(CALIBRATION_MS));
+    ClockSample last = take_sample();
+
+    double f1 = frequency_between(first, middle);
+    double f2 = frequency_between(middle, last);
+    if (f1 <= 0 || f2 <= 0 || (f1 > f2 ? f1 - f2 : f2 - f1) / f1 > MAX_FREQUENCY_SPREAD) {
+        LOG_ERROR("TscClock: counter unstable during calibration (%.4f / %.4f GHz), using steady_clock", f1, f2);
+        return cal;
+    }
+
+    double ghz = frequency_between(first, last);
+    cal.useCounter = true;
+    cal.counterBase = last.counter;
+    cal.nsBase = last.ns;
+    cal.mult = (uint64_t)((double)(1ull << SHIFT) / ghz + 0.5);
+    cal.ghz = ghz;
+    LOG_DEBUG("TscClock: %.4f GHz counter", ghz);
+    return cal;
+}
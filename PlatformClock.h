@@ -0,0 +1,118 @@
+/**
+ *   Low overhead monotonic clock
+ *
+ *   TscClock reads the invariant TSC (x86) or the generic timer (arm64) and
+ *   converts cycles to nanoseconds with a fixed point multiplier calibrated
+ *   against the steady clock on first use (about 20 ms). If the counter is
+ *   missing, not invariant, rejected by the kernel or inconsistent during
+ *   calibration, it falls back to std::chrono::steady_clock.
+ *
+ *   now() is in the steady_clock time base, so the two can be compared over
+ *   short spans; over hours they drift apart by the calibration error.
+ *   Set PLATFORM_DISABLE_TSC=1 to force the fallback.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+class TscClock
+{
+public:
+    using rep = int64_t;
+    using period = std::nano;
+    using duration = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<TscClock>;
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept
+    {
+        return time_point(duration((rep)nowNs()));
+    }
+
+    /** nanoseconds in the steady_clock time base */
+    static uint64_t nowNs() noexcept
+    {
+        const Calibration& cal = calibration();
+        if (!cal.useCounter) {
+            return steadyNs();
+        }
+        // a core whose counter lags the calibrating one slightly reads below counterBase
+        int64_t ticks = (int64_t)(readCounter() - cal.counterBase);
+        return cal.nsBase + mulShift(ticks > 0 ? (uint64_t)ticks : 0, cal.mult);
+    }
+
+    /** raw counter ticks, only meaningful when isCounterUsed() */
+    static uint64_t readCounter() noexcept
+    {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t value;
+        __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(value));
+        return value;
+#else
+        return 0;
+#endif
+    }
+
+    static uint64_t cyclesToNs(uint64_t cycles) noexcept
+    {
+        return mulShift(cycles, calibration().mult);
+    }
+
+    static bool isCounterUsed() noexcept { return calibration().useCounter; }
+
+    /** counter frequency in GHz, 0 if the fallback clock is used */
+    static double frequencyGHz() noexcept { return calibration().ghz; }
+
+private:
+    static constexpr uint32_t SHIFT = 32;
+
+    struct Calibration
+    {
+        bool useCounter = false;
+        uint64_t counterBase = 0;
+        uint64_t nsBase = 0;
+        uint64_t mult = 0;      // ns = cycles * mult >> SHIFT
+        double ghz = 0;
+    };
+
+    static const Calibration& calibration() noexcept
+    {
+        static const Calibration cal = calibrate();
+        return cal;
+    }
+
+    static Calibration calibrate();
+
+    static uint64_t steadyNs() noexcept
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static uint64_t mulShift(uint64_t cycles, uint64_t mult) noexcept
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+        uint64_t high;
+        uint64_t low = _umul128(cycles, mult, &high);
+        return __shiftright128(low, high, SHIFT);
+#elif defined(__SIZEOF_INT128__)
+        return (uint64_t)(((unsigned __int128)cycles * mult) >> SHIFT);
+#else
+        return (uint64_t)((long double)cycles * mult / 4294967296.0L);
+#endif
+    }
+};
@@ -1,5 +1,6 @@
 ﻿#include "PlatformCommonIPC.h"
 #include "PlatformCommonUtils.h"
+#include "Process/ProcessForkServer.h"
 using namespace std;
 using namespace PlatformCommonUtils;
 
@@ -11,6 +12,7 @@ using namespace PlatformCommonUtils;
 #include <unistd.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <string.h>
 #endif // _MSC_VER
 
 class IInterProcessCommunitor
@@ -21,7 +23,7 @@ public:
 	virtual bool sentData(const std::string& data) = 0;
 	virtual bool receiveData(std::string& data) = 0;
 	virtual void stop() = 0;
-    
+
     virtual void setErrorCode(int error) { m_error = error; }
     virtual int getErrorCode() { return m_error; }
 
@@ -185,8 +187,9 @@ public:
     IPCWithFIFO(
                 const std::string& wfifo,
                 const std::string& rfifo,
-                const std::string processPath
-   ): m_wfifo(wfifo), m_rfifo(rfifo), m_processPath(processPath), m_pid(-1), m_fdW(-1), m_fdR(-1)
+                const std::string processPath,
+                ProcessForkServer* forkServer = nullptr
+   ): m_wfifo(wfifo), m_rfifo(rfifo), m_processPath(processPath), m_pid(-1), m_fdW(-1), m_fdR(-1), m_forkServer(forkServer)
    {}
     
     
@@ -206,7 +209,13 @@ public:
             LOG_ERROR("Failed to make read fifo with error %s\n", strerror(errno));
             return false;
         }
-        m_pid = execute_process(m_processPath);
+        m_forked = m_forkServer != nullptr && m_forkServer->isRunning();
+        if (m_forked) {
+            m_pid = m_forkServer->spawn(m_processPath);
+        }
+        else {
+            m_pid = execute_process(m_processPath);
+        }
         if (m_pid < 0) {
             remove_file(m_wfifo.c_str());
             remove_file(m_rfifo.c_str());
@@ -295,6 +304,10 @@ public:
 #ifndef _MSC_VER
         if (m_pid > 0) {
             kill(m_pid, SIGKILL);
+            if (m_forked) {
+                int exitCode = 0;
+                m_forkServer->waitExit(m_pid, exitCode, 1000); // drop the exit report
+            }
             m_pid = -1;
         }
         if (m_fdR > 0) {
@@ -317,6 +330,8 @@ private:
     int m_fdW;
     int m_fdR;
     int m_pid;
+    ProcessForkServer* m_forkServer;
+    bool m_forked = false;
 };
 
 PlatformCommonIPC::PlatformCommonIPC(const std::string& processPath, const std::string& cachePath, IPCMethod method):
@@ -342,7 +357,7 @@ bool PlatformCommonIPC::start()
 	if (m_ipcMethod == Namedpipe) {
 		m_pIPCCommtor = new IPCWithNamedPipe(m_processPath, m_pipeName);
     } else if (m_ipcMethod == FIFO) {
-        m_pIPCCommtor = new IPCWithFIFO(m_wfifo, m_rfifo, m_processPath);
+        m_pIPCCommtor = new IPCWithFIFO(m_wfifo, m_rfifo, m_processPath, m_forkServer);
     }
 	if (m_pIPCCommtor != nullptr) {
 		return m_pIPCCommtor->start();
@@ -374,6 +389,21 @@ int PlatformCommonIPC::getErrorCode() const
 	return m_pIPCCommtor->getErrorCode();
 }
 
+void PlatformCommonIPC::setErrorCode(int error)
+{
+    m_pIPCCommtor->setErrorCode(error);
+}
+
+uint32_t PlatformCommonIPC::readTimeout() const
+{
+    return m_pIPCCommtor->getReadTimeout();
+}
+
+uint32_t PlatformCommonIPC::writeTimeout() const
+{
+    return m_pIPCCommtor->getWriteTimeout();
+}
+
 void PlatformCommonIPC::setRWTimeout(uint32_t timeout)
 {
     m_pIPCCommtor->setReadTimeot(timeout);
@@ -385,3 +415,7 @@ void PlatformCommonIPC::setFIFOFileName(const std::string &wfifo, const std::str
     m_rfifo = rfifo;
 }
 
+void PlatformCommonIPC::setForkServer(ProcessForkServer* server)
+{
+    m_forkServer = server;
+}
@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include <string>
+#include "CoTask.h"
 
 #define IPC_E_TIMEOUT  1
 
@@ -23,16 +24,32 @@ public:
 	void setPipeName(const std::string& pipeName);
     /** For FIFO */
     void setFIFOFileName(const std::string& wfifo, const std::string& rfifo);
+    /** For FIFO, spawn the helper from a resident fork server instead of posix_spawn */
+    void setForkServer(class ProcessForkServer* server);
 
 	bool start();
 	bool sentData(const std::string& data);
 	bool receiveData(std::string& data);
 	void stop();
 
+	/**
+	 * Coroutine versions, in PlatformCommonIPCAsync.cpp so the blocking API
+	 * does not need CoExecutor to link. FIFO waits on the executor's reactor
+	 * instead of select(), the named pipe runs the blocking call on a resume thread.
+	 */
+	Task<bool> sentDataAsync(class CoExecutor& exec, const std::string& data);
+	Task<bool> receiveDataAsync(class CoExecutor& exec, std::string& data);
+
 	int getErrorCode() const;
 
 	void setRWTimeout(uint32_t timeout /** sec */);
 
+private:
+	/** for the coroutine versions, which use the FIFOs directly */
+	void setErrorCode(int error);
+	uint32_t readTimeout() const;
+	uint32_t writeTimeout() const;
+
 private:
 	std::string m_processPath;
 	std::string m_pipeName;
@@ -40,6 +57,7 @@ private:
     std::string m_wfifo;
     std::string m_rfifo;
 	IPCMethod m_ipcMethod;
+	class ProcessForkServer* m_forkServer = nullptr;
 
 	int m_errorCode = 0;
 	class IInterProcessCommunitor* m_pIPCCommtor = nullptr;
@@ -0,0 +1,80 @@
+#include "PlatformCommonIPC.h"
+#include "PlatformCommonUtils.h"
+#include "CoExecutor.h"
+
+#ifndef _MSC_VER
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+using namespace PlatformCommonUtils;
+
+Task<bool> PlatformCommonIPC::sentDataAsync(CoExecutor& exec, const std::string& data)
+{
+	if (m_pIPCCommtor == nullptr) {
+		co_return false;
+	}
+#ifndef _MSC_VER
+	if (m_ipcMethod == FIFO) {
+		setErrorCode(0);
+		int fd = open(m_wfifo.c_str(), O_WRONLY | O_NONBLOCK);
+		if (fd < 0) {
+			LOG_ERROR("Open write pipe failed with error %s\n", strerror(errno));
+			co_return false;
+		}
+		bool res = false;
+		IoResult ready = co_await exec.writable(fd, writeTimeout() * 1000);
+		if (ready == IoResult::Timeout) {
+			LOG_INFO("sent timeout");
+			setErrorCode(IPC_E_TIMEOUT);
+		}
+		else if (ready == IoResult::Ready) {
+			auto size = co_await exec.writeAll(fd, data.c_str(), (int)data.size(), writeTimeout() * 1000);
+			res = size.has_value() && *size > 0;
+		}
+		exec.cancelIo(fd);
+		close(fd);
+		co_return res;
+	}
+#endif
+	co_await exec.schedule();
+	co_return sentData(data);
+}
+
+Task<bool> PlatformCommonIPC::receiveDataAsync(CoExecutor& exec, std::string& data)
+{
+	if (m_pIPCCommtor == nullptr) {
+		co_return false;
+	}
+#ifndef _MSC_VER
+	if (m_ipcMethod == FIFO) {
+		setErrorCode(0);
+		int fd = open(m_rfifo.c_str(), O_RDONLY | O_NONBLOCK);
+		if (fd < 0) {
+			LOG_ERROR("Open read pipe failed with error %s\n", strerror(errno));
+			co_return false;
+		}
+		bool res = false;
+		IoResult ready = co_await exec.readable(fd, readTimeout() * 1000);
+		if (ready == IoResult::Timeout) {
+			LOG_INFO("receive timeout");
+			setErrorCode(IPC_E_TIMEOUT);
+		}
+		else if (ready == IoResult::Ready) {
+			char buffer[1024];
+			auto count = co_await exec.readSome(fd, buffer, sizeof(buffer), readTimeout() * 1000);
+			if (count.has_value() && *count > 0) {
+				data = std::string(buffer, *count);
+				res = true;
+			}
+		}
+		exec.cancelIo(fd);
+		close(fd);
+		co_return res;
+	}
+#endif
+	co_await exec.schedule();
+	co_return receiveData(data);
+}
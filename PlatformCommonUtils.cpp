@@ -1,4 +1,6 @@
 ﻿#include "PlatformCommonUtils.h"
+#include "PlatformSync.h"
+#include "PlatformClock.h"
 #include <dirent.h>
 #include <assert.h>
 #include <stdio.h>
@@ -8,6 +10,8 @@
 #include <array>
 #include <unordered_map>
 #include <unordered_set>
+#include <atomic>
+#include <thread>
 
 #ifdef _MSC_VER
 #include <Windows.h>
@@ -17,15 +21,23 @@
 #pragma comment(lib, "Shlwapi.lib")
 #pragma warning(disable : 4996)
 #else
-#include <mach-o/dyld.h>
 #include <iconv.h>
 #include <spawn.h>
 #include <sys/stat.h>
 #include <signal.h>
 #include <errno.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
+#include <cstring>
+#include <sstream>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
 #include <libproc.h>
+#else
+#include <sys/syscall.h>
+#include <limits.h>
+#endif
 #endif
 
 using namespace std;
@@ -37,10 +49,17 @@ static std::string s_log_tag_name = "DEV";
 
 static std::pair<PlatformCommonUtils::log_info_callback, void*> s_log_cb{ nullptr, nullptr };
 
-static std::unordered_map<int, std::chrono::high_resolution_clock::time_point> s_start_time_clock;
+static thread_local TscClock::time_point s_start_time_clock;
 
 static std::unordered_set<int> s_log_disable_set;
 
+// recent worst oversleep of the coarse sleep in precise_usleep, decays slowly
+#ifdef _MSC_VER
+static std::atomic<int64_t> s_sleep_overshoot_ns{ 1000000 };
+#else
+static std::atomic<int64_t> s_sleep_overshoot_ns{ 100000 };
+#endif
+
 static char* dirname(char* path)
 {
 	static char buffer[260];
@@ -127,7 +146,7 @@ static char* string_build_path(const char* elem, ...)
 	return out;
 }
 
-// Macos: pid, path, args...
+// Macos/Linux: pid, path, args...
 // Windows: PPROCESSENTRY32, args...
 template<typename Func, typename... Args>
 static bool traverse_process(Func&& cb, Args&&... args)
@@ -154,7 +173,7 @@ static bool traverse_process(Func&& cb, Args&&... args)
 	} while (Process32NextW(hSnapshot, &ps));
 	CloseHandle(hSnapshot);
 	return true;
-#else
+#elif defined(__APPLE__)
 	pid_t pid;
 	int buffer_size = proc_listpids(PROC_ALL_PIDS, 0, nullptr, 0);
 	pid_t* pids = (pid_t*)malloc(buffer_size);
@@ -172,6 +191,32 @@ static bool traverse_process(Func&& cb, Args&&... args)
 	}
 	free(pids);
 	return true;
+#else
+	DIR* dir = opendir("/proc");
+	if (dir == nullptr) return false;
+	static const char deleted_suffix[] = " (deleted)";
+	char linkbuf[64];
+	char pathbuf[PATH_MAX];
+	struct dirent* ent;
+	while ((ent = readdir(dir)) != nullptr) {
+		char* end = nullptr;
+		long pid = strtol(ent->d_name, &end, 10);
+		if (pid <= 0 || *end != '\0') continue;
+		snprintf(linkbuf, sizeof(linkbuf), "/proc/%ld/exe", pid);
+		ssize_t len = readlink(linkbuf, pathbuf, sizeof(pathbuf) - 1);
+		if (len <= 0) continue; // kernel thread or no permission
+		pathbuf[len] = '\0';
+		// binary replaced on disk while running, still the same program
+		size_t suffix_len = sizeof(deleted_suffix) - 1;
+		if ((size_t)len > suffix_len && strcmp(pathbuf + len - suffix_len, deleted_suffix) == 0) {
+			pathbuf[len - suffix_len] = '\0';
+		}
+		if (cb((pid_t)pid, (const char*)pathbuf, std::forward<Args>(args)...)) {
+			break;
+		}
+	}
+	closedir(dir);
+	return true;
 #endif
 }
 
@@ -809,7 +854,7 @@ void PlatformCommonUtils::mutex_lock(mutex_t mutex)
 #ifdef _MSC_VER
 	EnterCriticalSection(mutex);
 #else 
-	pthread_mutex_lock(&mutex);
+	pthread_mutex_lock(mutex);
 #endif
 }
 
@@ -818,7 +863,7 @@ void PlatformCommonUtils::mutex_unlock(mutex_t mutex)
 #ifdef _MSC_VER
 	LeaveCriticalSection(mutex);
 #else 
-	pthread_mutex_unlock(&mutex);
+	pthread_mutex_unlock(mutex);
 #endif
 }
 
@@ -926,19 +971,25 @@ bool PlatformCommonUtils::is_debug()
 
 std::string PlatformCommonUtils::get_current_time()
 {
-	char time_buffer[20] = { 0 };
-	auto now = std::chrono::system_clock::now();
-	std::time_t now_time = std::chrono::system_clock::to_time_t(now);
-	std::strftime(time_buffer, sizeof(time_buffer), "%Y-%m-%d %H:%M:%S", std::localtime(&now_time));
-	return std::string(time_buffer);
+	// every log line asks for the time, only format it again when the second changes
+	thread_local std::time_t s_last_time = 0;
+	thread_local char s_time_buffer[20] = { 0 };
+	std::time_t now_time = std::time(nullptr);
+	if (now_time != s_last_time) {
+		std::strftime(s_time_buffer, sizeof(s_time_buffer), "%Y-%m-%d %H:%M:%S", std::localtime(&now_time));
+		s_last_time = now_time;
+	}
+	return std::string(s_time_buffer);
 }
 
 int PlatformCommonUtils::get_current_thread_id()
 {
 #ifdef _MSC_VER
 	return GetCurrentThreadId();
-#else
+#elif defined(__APPLE__)
 	return mach_thread_self();
+#else
+	return (int)syscall(SYS_gettid);
 #endif // WIN32
 }
 
@@ -1182,7 +1233,9 @@ int PlatformCommonUtils::execute_process(const std::string& cmd)
     char **environ = nullptr;
     posix_spawnattr_t attr;
     posix_spawnattr_init(&attr);
+#ifdef POSIX_SPAWN_CLOEXEC_DEFAULT
     posix_spawnattr_setflags(&attr, POSIX_SPAWN_CLOEXEC_DEFAULT);
+#endif
     
     pid_t pid;
     std::vector<char*> args;
@@ -1357,6 +1410,15 @@ std::string PlatformCommonUtils::get_current_directory_path()
 	char szCurPath[MAX_PATH];
 	GetCurrentDirectoryA(MAX_PATH, szCurPath);
 	return string{ szCurPath };
+#elif defined(__linux__)
+	char buffer[PATH_MAX];
+	ssize_t len = readlink("/proc/self/exe", buffer, sizeof(buffer) - 1);
+	if (len <= 0) {
+		LOG_ERROR("getting executable path");
+		return std::string();
+	}
+	buffer[len] = '\0';
+	return std::string{ buffer };
 #else
     uint32_t size = 0;
     _NSGetExecutablePath(nullptr, &size);
@@ -1482,16 +1544,59 @@ bool PlatformCommonUtils::is_process_running_by_name(const std::string& proc_nam
 #ifdef _MSC_VER
 void PlatformCommonUtils::usleep(uint32_t waitTime)
 {
-	LARGE_INTEGER perfCnt, start, now;
-	QueryPerformanceFrequency(&perfCnt);
-	QueryPerformanceCounter(&start);
-
-	do {
-		QueryPerformanceCounter((LARGE_INTEGER*)&now);
-	} while ((now.QuadPart - start.QuadPart) / (float)(perfCnt.QuadPart) * 1000 * 1000 < waitTime);
+	precise_usleep(waitTime);
 }
 #endif
 
+static void coarse_sleep_ns(int64_t ns)
+{
+#ifdef _MSC_VER
+	// high resolution waitable timers (Windows 10 1803+) are not bound to the 15.6 ms tick
+	thread_local HANDLE timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (timer != nullptr) {
+		LARGE_INTEGER due;
+		due.QuadPart = -(ns / 100);
+		if (SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE)) {
+			WaitForSingleObject(timer, INFINITE);
+			return;
+		}
+	}
+	Sleep((DWORD)(ns / 1000000));
+#else
+	std::this_thread::sleep_for(std::chrono::nanoseconds(ns));
+#endif
+}
+
+void PlatformCommonUtils::precise_usleep(uint32_t waitTime)
+{
+	using clock = std::chrono::steady_clock;
+	auto deadline = clock::now() + std::chrono::microseconds(waitTime);
+
+	// one preemption must not turn every later wait into a spin
+	const int64_t MAX_SLACK_NS = 2000000;
+	// waits this short only spin, a sleep would not come back in time
+	const int64_t SPIN_ONLY_NS = 50000;
+
+	int64_t slack = s_sleep_overshoot_ns.load(std::memory_order_relaxed);
+	auto before = clock::now();
+	int64_t left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - before).count();
+	if (left > SPIN_ONLY_NS) {
+		// sleep at least once, even inside the slack: short waits in a polling loop must not burn a core
+		int64_t target = left > slack ? left - slack : left / 2;
+		coarse_sleep_ns(target);
+		int64_t slept = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - before).count();
+		int64_t overshoot = std::max<int64_t>(slept - target, 0);
+		s_sleep_overshoot_ns.store(std::min(std::max(overshoot, slack - slack / 16), MAX_SLACK_NS), std::memory_order_relaxed);
+	}
+	else {
+		s_sleep_overshoot_ns.store(slack - slack / 16, std::memory_order_relaxed);
+	}
+
+	while (clock::now() < deadline) {
+		sync_cpu_relax();
+	}
+}
+
 void PlatformCommonUtils::msleep(uint32_t waitTime)
 {
 #ifdef _MSC_VER
@@ -1503,26 +1608,20 @@ void PlatformCommonUtils::msleep(uint32_t waitTime)
 
 void PlatformCommonUtils::start_clock()
 {
-	s_start_time_clock[get_current_thread_id()] = std::chrono::high_resolution_clock::now();
+	s_start_time_clock = TscClock::now();
 }
 
 uint64_t PlatformCommonUtils::end_clock_with_us()
 {
-	auto start = s_start_time_clock[get_current_thread_id()];
-	auto end = std::chrono::high_resolution_clock::now();;
-	return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+	return std::chrono::duration_cast<std::chrono::microseconds>(TscClock::now() - s_start_time_clock).count();
 }
 
 uint64_t PlatformCommonUtils::end_clock_with_ms()
 {
-	auto start = s_start_time_clock[get_current_thread_id()];
-	auto end = std::chrono::high_resolution_clock::now();;
-	return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+	return std::chrono::duration_cast<std::chrono::milliseconds>(TscClock::now() - s_start_time_clock).count();
 }
 
 uint64_t PlatformCommonUtils::end_clock_with_s()
 {
-	auto start = s_start_time_clock[get_current_thread_id()];
-	auto end = std::chrono::high_resolution_clock::now();;
-	return std::chrono::duration_cast<std::chrono::seconds>(end - start).count();
+	return std::chrono::duration_cast<std::chrono::seconds>(TscClock::now() - s_start_time_clock).count();
 }
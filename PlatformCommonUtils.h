@@ -16,6 +16,7 @@
 #include <memory>
 #include <chrono>
 #include <filesystem>
+#include "PlatformClock.h"
 
 #ifdef _MSC_VER
 #ifndef WIN32_LEAN_AND_MEAN
@@ -27,6 +28,8 @@
 #include <os/log.h>
 #include <utility>
 #include <pthread.h>
+#else
+#include <pthread.h>
 #endif 
 
 /**
@@ -43,7 +46,7 @@ namespace PlatformCommonUtils
 #ifdef _MSC_VER
 	using mutex_t = LPCRITICAL_SECTION;
 #else 
-	using mutex_t = pthread_mutex_t;
+	using mutex_t = pthread_mutex_t*;
 #endif
 	using log_info_callback = void(*)(const char*, void*);
 
@@ -101,6 +104,7 @@ namespace PlatformCommonUtils
 	std::vector<uint8_t> read_data_from_file(const std::string& path);
 
 	/************ Mutex ************/
+	// mutex_t points to the native mutex, prefer AdaptiveMutex / RWLock / SpinLock from PlatformSync.h
 	void mutex_lock(mutex_t mutex);
 	void mutex_unlock(mutex_t mutex);
 
@@ -124,6 +128,8 @@ namespace PlatformCommonUtils
 	bool is_process_running(int process_id);
 	bool is_process_running(const std::string& proc_path);
 	bool is_process_running_by_name(const std::string& proc_name);
+	// is_process_running* and kill_process* walk the whole process list per call, use ProcessTable for repeated queries
+	// and ProcessWatcher::killAllByPath / killAllByName to kill and wait for the exits without polling
 
 	/************ Log output ************/
 	void set_log_info_callback(log_info_callback cb, void* user_data, bool debug);
@@ -151,7 +157,7 @@ namespace PlatformCommonUtils
 			OutputDebugStringA(buffer);
 #else
 			//os_log(OS_LOG_DEFAULT, "%{public}s", buffer);
-            printf(buffer);
+            printf("%s", buffer);
 #endif // WIN32
 		}
 		delete[] buffer;
@@ -211,6 +217,8 @@ namespace PlatformCommonUtils
 	void usleep(uint32_t waitTime);
 #endif
 	void msleep(uint32_t waitTime);
+	// sleeps until shortly before the deadline, then spins; microsecond accurate without burning the whole wait
+	void precise_usleep(uint32_t waitTime);
 
 	void start_clock();
 	uint64_t end_clock_with_us();
@@ -237,15 +245,15 @@ namespace PlatformCommonUtils
 	} \
 } while (0)
 
-#define TEST_TIMER_START    auto start = std::chrono::high_resolution_clock::now();
+#define TEST_TIMER_START    auto start = TscClock::now();
 
-#define TEST_TIMER_US_END   auto end = std::chrono::high_resolution_clock::now(); \
+#define TEST_TIMER_US_END   auto end = TscClock::now(); \
 						    LOG_INFO("Execution time: %lld microseconds", std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
 
-#define TEST_TIMER_MS_END   auto end = std::chrono::high_resolution_clock::now(); \
+#define TEST_TIMER_MS_END   auto end = TscClock::now(); \
 						    LOG_INFO("Execution time: %lld milliseconds", std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
 
-#define TEST_TIMER_S_END    auto end = std::chrono::high_resolution_clock::now(); \
+#define TEST_TIMER_S_END    auto end = TscClock::now(); \
 						    LOG_INFO("Execution time: %lld second", std::chrono::duration_cast<std::chrono::seconds>(end - start).count());
 
 #define UNUSED(x) (void)(x)
\ No newline at end of file
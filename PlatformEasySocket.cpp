@@ -8,8 +8,13 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
 #endif
 
 #define INVALID_SOCKET_VALUE  0
@@ -18,6 +23,13 @@
 #define SOCKET_ERROR  -1
 #endif
 
+// a peer that closes must fail the send, not raise SIGPIPE; Apple platforms use SO_NOSIGPIPE instead
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS  MSG_NOSIGNAL
+#else
+#define SEND_FLAGS  0
+#endif
+
 #ifdef _MSC_VER
 static std::once_flag s_wsaInitFlag;
 class InitializeWSAMgr
@@ -79,10 +91,25 @@ bool PlatformEasySocket::setupSocket(const SocketSetupOptions& opts)
         return false;
     }
 
+    if (!applyOptions()) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+PlatformEasySocket::PlatformEasySocket(socket_t socket, const SocketSetupOptions& opts):
+    m_socket(socket),
+    m_opts(opts)
+{
+}
+
+bool PlatformEasySocket::applyOptions()
+{
     if (m_opts.recv_timeout != 0) {
 #ifdef _MSC_VER
         if (setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&m_opts.recv_timeout, sizeof(m_opts.recv_timeout)) == SOCKET_ERROR) {
-            close();
             return false;
         }
 #else
@@ -90,7 +117,6 @@ bool PlatformEasySocket::setupSocket(const SocketSetupOptions& opts)
         tv.tv_sec = m_opts.recv_timeout / 1000;
         tv.tv_usec = (m_opts.recv_timeout % 1000) * 1000;
         if (setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv)) == SOCKET_ERROR) {
-            close();
             return false;
         }
 #endif
@@ -99,19 +125,29 @@ bool PlatformEasySocket::setupSocket(const SocketSetupOptions& opts)
     if (m_opts.send_timeout != 0) {
 #ifdef _MSC_VER
         if (setsockopt(m_socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&m_opts.send_timeout, sizeof(m_opts.send_timeout)) == SOCKET_ERROR) {
-            close();
             return false;
         }
 #else
         struct timeval tv;
-        tv.tv_sec = m_opts.recv_timeout / 1000;
-        tv.tv_usec = (m_opts.recv_timeout % 1000) * 1000;
+        tv.tv_sec = m_opts.send_timeout / 1000;
+        tv.tv_usec = (m_opts.send_timeout % 1000) * 1000;
         if (setsockopt(m_socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv, sizeof tv) == SOCKET_ERROR) {
-            close();
             return false;
         }
 #endif
     }
+#ifdef SO_NOSIGPIPE
+    int noSigPipe = 1;
+    if (setsockopt(m_socket, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe)) == SOCKET_ERROR) {
+        return false;
+    }
+#endif
+    if (m_opts.no_delay && m_opts.type == SOCK_STREAM) {
+        int flag = 1;
+        if (setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&flag, sizeof(flag)) == SOCKET_ERROR) {
+            return false;
+        }
+    }
 
     return true;
 }
@@ -154,6 +190,92 @@ bool PlatformEasySocket::connect()
     return true;
 }
 
+bool PlatformEasySocket::listen(int backlog)
+{
+    if (m_socket == INVALID_SOCKET_VALUE) {
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+    if (m_opts.af == AF_INET) {
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (!m_opts.ip.empty() && inet_pton(AF_INET, m_opts.ip.c_str(), &addr.sin_addr) != 1) {
+            return false;
+        }
+        addr.sin_port = htons(m_opts.port);
+        if (::bind(m_socket, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+            return false;
+        }
+    }
+    else if (m_opts.af == AF_INET6) {
+        sockaddr_in6 addr = {};
+        addr.sin6_family = AF_INET6;
+        addr.sin6_addr = in6addr_any;
+        if (!m_opts.ip.empty() && inet_pton(AF_INET6, m_opts.ip.c_str(), &addr.sin6_addr) != 1) {
+            return false;
+        }
+        addr.sin6_port = htons(m_opts.port);
+        if (::bind(m_socket, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+            return false;
+        }
+    }
+    else {
+        return false;
+    }
+
+    return ::listen(m_socket, backlog) != SOCKET_ERROR;
+}
+
+std::unique_ptr<PlatformEasySocket> PlatformEasySocket::accept()
+{
+    if (m_socket == INVALID_SOCKET_VALUE) {
+        return nullptr;
+    }
+    // a receive timeout bounds accept as well, so the caller can check for shutdown
+    socket_t client = (socket_t)::accept(m_socket, nullptr, nullptr);
+#ifdef _MSC_VER
+    if (client == INVALID_SOCKET) {
+        m_recvTimedOut = ::WSAGetLastError() == WSAETIMEDOUT;
+        return nullptr;
+    }
+#else
+    if (client < 0) {
+        m_recvTimedOut = errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        return nullptr;
+    }
+#endif
+    m_recvTimedOut = false;
+
+    std::unique_ptr<PlatformEasySocket> socket(new PlatformEasySocket(client, m_opts));
+    socket->m_opts.port = 0;
+    if (!socket->applyOptions()) {
+        return nullptr;
+    }
+    return socket;
+}
+
+int PlatformEasySocket::localPort() const
+{
+    if (m_socket == INVALID_SOCKET_VALUE) {
+        return 0;
+    }
+    sockaddr_storage addr = {};
+    socklen_t len = sizeof(addr);
+    if (::getsockname(m_socket, (sockaddr*)&addr, &len) == SOCKET_ERROR) {
+        return 0;
+    }
+    if (addr.ss_family == AF_INET) {
+        return ntohs(((sockaddr_in*)&addr)->sin_port);
+    }
+    if (addr.ss_family == AF_INET6) {
+        return ntohs(((sockaddr_in6*)&addr)->sin6_port);
+    }
+    return 0;
+}
+
 bool PlatformEasySocket::close()
 {
     if (m_socket == INVALID_SOCKET_VALUE) {
@@ -194,7 +316,7 @@ std::optional<int> PlatformEasySocket::sendData(const std::vector<uint8_t>& send
         size_t sent = ::send(m_socket,
             reinterpret_cast<const char*>(sendData.data() + totalSent),
             static_cast<int>(dataSize - totalSent),
-            0);
+            SEND_FLAGS);
 
         if (sent == SOCKET_ERROR) {
             return std::nullopt; 
@@ -231,7 +353,7 @@ std::optional<int> PlatformEasySocket::sendMessage(const std::string& message)
         size_t sent = ::send(m_socket,
             reinterpret_cast<const char*>(message.data() + totalSent),
             static_cast<int>(dataSize - totalSent),
-            0);
+            SEND_FLAGS);
 
         if (sent == SOCKET_ERROR) {
             return std::nullopt;
@@ -259,19 +381,61 @@ std::optional<int> PlatformEasySocket::sendRaw(const char* byte, int len)
     if (m_socket == INVALID_SOCKET_VALUE) {
         return std::nullopt;
     }
-    int res = (int)::send(m_socket, byte, len, 0);
+    int res = (int)::send(m_socket, byte, len, SEND_FLAGS);
     if (res != SOCKET_ERROR) {
         return res;
     }
     return std::nullopt;
 }
 
+std::optional<int> PlatformEasySocket::sendGather(const EasyIoVec* iov, int count)
+{
+    if (m_socket == INVALID_SOCKET_VALUE) {
+        return std::nullopt;
+    }
+    static constexpr int MAX_PIECES = 64;
+    count = count > MAX_PIECES ? MAX_PIECES : count;
+#ifdef _MSC_VER
+    WSABUF buffers[MAX_PIECES];
+    for (int i = 0; i < count; ++i) {
+        buffers[i].buf = (CHAR*)iov[i].data;
+        buffers[i].len = (ULONG)iov[i].size;
+    }
+    DWORD sent = 0;
+    if (::WSASend(m_socket, buffers, (DWORD)count, &sent, 0, nullptr, nullptr) == SOCKET_ERROR) {
+        return std::nullopt;
+    }
+    return (int)sent;
+#else
+    struct iovec buffers[MAX_PIECES];
+    for (int i = 0; i < count; ++i) {
+        buffers[i].iov_base = (void*)iov[i].data;
+        buffers[i].iov_len = iov[i].size;
+    }
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = buffers;
+    message.msg_iovlen = count;
+    ssize_t res = ::sendmsg(m_socket, &message, SEND_FLAGS);
+    if (res != SOCKET_ERROR) {
+        return (int)res;
+    }
+    return std::nullopt;
+#endif
+}
+
 std::optional<int> PlatformEasySocket::recvRaw(char* byte, int len)
 {
     int recvSize = (int)::recv(m_socket, byte, len, 0);
     if (recvSize > 0) {
+        m_recvTimedOut = false;
         return recvSize;
     }
+#ifdef _MSC_VER
+    m_recvTimedOut = recvSize < 0 && ::WSAGetLastError() == WSAETIMEDOUT;
+#else
+    m_recvTimedOut = recvSize < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+#endif
     return std::nullopt;
 }
 
@@ -303,3 +467,38 @@ std::string PlatformEasySocket::getErrorString() const
     return std::string(strerror(errno));
 #endif
 }
+
+int PlatformEasySocket::nativeHandle() const
+{
+    return m_socket == INVALID_SOCKET_VALUE ? -1 : m_socket;
+}
+
+bool PlatformEasySocket::interrupt()
+{
+    if (m_socket == INVALID_SOCKET_VALUE) {
+        return false;
+    }
+#ifdef _MSC_VER
+    return ::shutdown(m_socket, SD_BOTH) == 0;
+#else
+    return ::shutdown(m_socket, SHUT_RDWR) == 0;
+#endif
+}
+
+bool PlatformEasySocket::setNonBlocking(bool nonBlocking)
+{
+    if (m_socket == INVALID_SOCKET_VALUE) {
+        return false;
+    }
+#ifdef _MSC_VER
+    u_long mode = nonBlocking ? 1 : 0;
+    return ::ioctlsocket(m_socket, FIONBIO, &mode) == 0;
+#else
+    int flags = ::fcntl(m_socket, F_GETFL, 0);
+    if (flags < 0) {
+        return false;
+    }
+    flags = nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return ::fcntl(m_socket, F_SETFL, flags) == 0;
+#endif
+}
@@ -9,6 +9,7 @@
 
 #include "IEasySocket.h"
 #include <string>
+#include <memory>
 
 struct SocketSetupOptions
 {
@@ -19,6 +20,7 @@ struct SocketSetupOptions
 
 	int send_timeout = 5000; // send timeout (ms)
 	int recv_timeout = 5000; // recv timeout (ms)
+	bool no_delay = false; // TCP_NODELAY, for protocols that write small frames and wait for the answer
 
 	int port = 0; // port
 	std::string ip; // ip
@@ -43,6 +45,16 @@ public:
 	bool close() override;
 	bool shutdown();
 
+	/** bind to ip:port of the options (empty ip: any address, port 0: a free one) and listen */
+	bool listen(int backlog = 128);
+	/**
+	 * @brief  Wait for a connection on a listening socket, up to recv_timeout
+	 * @return the connected socket with this socket's timeouts, null on timeout (recvTimedOut()) or error
+	 */
+	std::unique_ptr<PlatformEasySocket> accept();
+	/** port the socket is bound to, 0 if it is not */
+	int localPort() const;
+
 	std::optional<int> sendData(const std::vector<uint8_t>& sendData) override;
 	std::optional<std::vector<uint8_t>> recvData(int recvLen = 1024) override;
 
@@ -51,13 +63,30 @@ public:
 
 	std::optional<int> sendRaw(const char* byte, int len) override;
 	std::optional<int> recvRaw(char* byte, int len) override;
+	/** sendmsg / WSASend of at most 64 buffers per call */
+	std::optional<int> sendGather(const EasyIoVec* iov, int count) override;
 
 	int error() const;
 	std::string getErrorString() const;
 
+	/** descriptor for CoExecutor::readable / writable, -1 when not set up */
+	int nativeHandle() const override;
+	bool recvTimedOut() const override { return m_recvTimedOut; }
+	/** shut down both directions, a blocked recv returns at once */
+	bool interrupt() override;
+	/** non-blocking mode is required before awaiting the socket on a CoExecutor */
+	bool setNonBlocking(bool nonBlocking = true);
+
 private:
 	using socket_t = int;
+
+	/** take over a socket returned by accept */
+	PlatformEasySocket(socket_t socket, const SocketSetupOptions& opts);
+	/** timeouts and TCP_NODELAY from m_opts */
+	bool applyOptions();
+
     socket_t m_socket;
 	SocketSetupOptions m_opts;
+	bool m_recvTimedOut = false;
 };
 
@@ -0,0 +1,304 @@
+#include "PlatformSync.h"
+#include "PlatformCommonUtils.h"
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr uint32_t SPIN_BEFORE_YIELD = 64;
+
+static std::mutex& stats_registry_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<LockStats*>& stats_registry()
+{
+    static std::vector<LockStats*> registry;
+    return registry;
+}
+
+static inline uint64_t elapsed_ns(Clock::time_point start)
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+static inline void atomic_store_max(std::atomic<uint64_t>& target, uint64_t value)
+{
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed));
+}
+
+/** LockStats */
+LockStats::LockStats(const std::string& name):
+    m_name(name)
+{
+    std::lock_guard<std::mutex> lock(stats_registry_mutex());
+    stats_registry().push_back(this);
+}
+
+LockStats::~LockStats()
+{
+    std::lock_guard<std::mutex> lock(stats_registry_mutex());
+    auto& registry = stats_registry();
+    registry.erase(std::remove(registry.begin(), registry.end(), this), registry.end());
+}
+
+size_t LockStats::bucketOf(uint64_t ns)
+{
+    size_t bucket = 0;
+    while (ns > 1 && bucket < BUCKETS - 1) {
+        ns >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void LockStats::recordWait(uint64_t waitNs)
+{
+    m_contended.fetch_add(1, std::memory_order_relaxed);
+    m_totalWaitNs.fetch_add(waitNs, std::memory_order_relaxed);
+    m_waitHistogram[bucketOf(waitNs)].fetch_add(1, std::memory_order_relaxed);
+    atomic_store_max(m_maxWaitNs, waitNs);
+}
+
+void LockStats::recordHold(uint64_t holdNs)
+{
+    m_holdHistogram[bucketOf(holdNs)].fetch_add(1, std::memory_order_relaxed);
+    atomic_store_max(m_maxHoldNs, holdNs);
+}
+
+LockStats::Snapshot LockStats::snapshot() const
+{
+    Snapshot snap;
+    snap.name = m_name;
+    snap.acquisitions = m_acquisitions.load(std::memory_order_relaxed);
+    snap.contended = m_contended.load(std::memory_order_relaxed);
+    snap.totalWaitNs = m_totalWaitNs.load(std::memory_order_relaxed);
+    snap.maxWaitNs = m_maxWaitNs.load(std::memory_order_relaxed);
+    snap.maxHoldNs = m_maxHoldNs.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        snap.waitHistogram[i] = m_waitHistogram[i].load(std::memory_order_relaxed);
+        snap.holdHistogram[i] = m_holdHistogram[i].load(std::memory_order_relaxed);
+    }
+    return snap;
+}
+
+void LockStats::reset()
+{
+    m_acquisitions.store(0, std::memory_order_relaxed);
+    m_contended.store(0, std::memory_order_relaxed);
+    m_totalWaitNs.store(0, std::memory_order_relaxed);
+    m_maxWaitNs.store(0, std::memory_order_relaxed);
+    m_maxHoldNs.store(0, std::memory_order_relaxed);
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        m_waitHistogram[i].store(0, std::memory_order_relaxed);
+        m_holdHistogram[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t LockStats::Snapshot::waitPercentile(double percentile) const
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) total += waitHistogram[i];
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(total * percentile / 100.0);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += waitHistogram[i];
+        if (seen > rank) {
+            return 1ULL << (i + 1); // upper bound of the bucket
+        }
+    }
+    return maxWaitNs;
+}
+
+void LockStats::dumpAll()
+{
+    std::vector<Snapshot> snaps;
+    {
+        std::lock_guard<std::mutex> lock(stats_registry_mutex());
+        for (LockStats* stats : stats_registry()) {
+            snaps.push_back(stats->snapshot());
+        }
+    }
+    std::sort(snaps.begin(), snaps.end(), [](const Snapshot& a, const Snapshot& b) { return a.totalWaitNs > b.totalWaitNs; });
+    LOG_INFO("%-24s %12s %10s %8s %10s %10s %10s %10s", "lock", "acquired", "contended", "ratio", "avg(ns)", "p99(ns)", "max(ns)", "hold(ns)");
+    for (const auto& snap : snaps) {
+        double ratio = snap.acquisitions > 0 ? (double)snap.contended * 100.0 / snap.acquisitions : 0;
+        uint64_t avg = snap.contended > 0 ? snap.totalWaitNs / snap.contended : 0;
+        LOG_INFO("%-24s %12llu %10llu %7.2f%% %10llu %10llu %10llu %10llu",
+            snap.name.c_str(),
+            (unsigned long long)snap.acquisitions,
+            (unsigned long long)snap.contended,
+            ratio,
+            (unsigned long long)avg,
+            (unsigned long long)snap.waitPercentile(99),
+            (unsigned long long)snap.maxWaitNs,
+            (unsigned long long)snap.maxHoldNs);
+    }
+}
+
+/** LockDebugInfo */
+#ifdef _DEBUG
+void LockDebugInfo::acquired(LockStats* stats)
+{
+    m_owner.store(PlatformCommonUtils::get_current_thread_id(), std::memory_order_relaxed);
+    if (stats != nullptr) {
+        m_lockedAt = Clock::now();
+    }
+}
+
+void LockDebugInfo::released(LockStats* stats)
+{
+    assert(ownedByCurrentThread() && "lock released by a thread which does not own it");
+    m_owner.store(0, std::memory_order_relaxed);
+    if (stats != nullptr) {
+        stats->recordHold(elapsed_ns(m_lockedAt));
+    }
+}
+
+bool LockDebugInfo::ownedByCurrentThread() const
+{
+    return m_owner.load(std::memory_order_relaxed) == PlatformCommonUtils::get_current_thread_id();
+}
+#endif
+
+/** SpinLock */
+void SpinLock::lockSlow()
+{
+    Clock::time_point start;
+    if (m_stats != nullptr) {
+        start = Clock::now();
+    }
+    uint32_t spins = 0;
+    do {
+        // spin on a plain load so the cache line stays shared while it is held
+        while (m_locked.load(std::memory_order_relaxed)) {
+            if (++spins < SPIN_BEFORE_YIELD) {
+                sync_cpu_relax();
+            }
+            else {
+                std::this_thread::yield();
+            }
+        }
+    } while (m_locked.exchange(true, std::memory_order_acquire));
+    if (m_stats != nullptr) {
+        m_stats->recordWait(elapsed_ns(start));
+    }
+    onAcquired();
+}
+
+/** AdaptiveMutex */
+void AdaptiveMutex::lockSlow()
+{
+    Clock::time_point start;
+    if (m_stats != nullptr) {
+        start = Clock::now();
+    }
+    // owner is probably about to release, spin before paying for a sleep
+    bool acquired = false;
+    for (uint32_t i = 0; i < m_spinCount && !acquired; ++i) {
+        uint32_t state = m_state.load(std::memory_order_relaxed);
+        if (state == CONTENDED) {
+            break; // others are already sleeping, queue behind them
+        }
+        if (state == UNLOCKED) {
+            acquired = m_state.compare_exchange_weak(state, LOCKED, std::memory_order_acquire, std::memory_order_relaxed);
+        }
+        else {
+            sync_cpu_relax();
+        }
+    }
+    if (!acquired) {
+        // from now on we may sleep, so unlock() has to wake somebody
+        while (m_state.exchange(CONTENDED, std::memory_order_acquire) != UNLOCKED) {
+            m_state.wait(CONTENDED, std::memory_order_relaxed);
+        }
+    }
+    if (m_stats != nullptr) {
+        m_stats->recordWait(elapsed_ns(start));
+    }
+    onAcquired();
+}
+
+/** RWLock */
+void RWLock::lock()
+{
+    m_writer.lock();
+    Clock::time_point start;
+    if (m_stats != nullptr) {
+        start = Clock::now();
+    }
+    // block new readers, then wait for the active ones to leave
+    uint32_t state = m_state.fetch_or(WRITER, std::memory_order_acquire) | WRITER;
+    if (state != WRITER) {
+        uint32_t spins = 0;
+        while (state != WRITER) {
+            if (++spins < SPIN_BEFORE_YIELD) {
+                sync_cpu_relax();
+            }
+            else {
+                m_state.wait(state, std::memory_order_relaxed);
+            }
+            state = m_state.load(std::memory_order_acquire);
+        }
+        if (m_stats != nullptr) {
+            m_stats->recordWait(elapsed_ns(start));
+        }
+    }
+}
+
+bool RWLock::try_lock()
+{
+    if (!m_writer.try_lock()) {
+        return false;
+    }
+    uint32_t expected = 0;
+    if (m_state.compare_exchange_strong(expected, WRITER, std::memory_order_acquire, std::memory_order_relaxed)) {
+        return true;
+    }
+    m_writer.unlock();
+    return false;
+}
+
+void RWLock::unlock()
+{
+    m_state.fetch_and(~WRITER, std::memory_order_release);
+    m_state.notify_all();
+    m_writer.unlock();
+}
+
+void RWLock::lockSharedSlow()
+{
+    Clock::time_point start;
+    if (m_stats != nullptr) {
+        start = Clock::now();
+    }
+    uint32_t spins = 0;
+    uint32_t state = m_state.load(std::memory_order_relaxed);
+    for (;;) {
+        if ((state & WRITER) == 0) {
+            if (m_state.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                break;
+            }
+            continue;
+        }
+        if (++spins < SPIN_BEFORE_YIELD) {
+            sync_cpu_relax();
+        }
+        else {
+            m_state.wait(state, std::memory_order_relaxed);
+        }
+        state = m_state.load(std::memory_order_relaxed);
+    }
+    if (m_stats != nullptr) {
+        m_stats->recordAcquire();
+        m_stats->recordWait(elapsed_ns(start));
+    }
+}
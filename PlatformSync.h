@@ -0,0 +1,275 @@
+/**
+ *   Synchronization primitives (Windows，MacOs，Linux)
+ *
+ *   SpinLock       very short critical sections
+ *   AdaptiveMutex  spins briefly, then sleeps on the lock word (futex / ulock / WaitOnAddress)
+ *   RWLock         writer preferring reader-writer lock for read-mostly maps
+ *
+ *   All of them satisfy Lockable so std::lock_guard / std::unique_lock work,
+ *   RWLock also works with std::shared_lock. Pass a LockStats to collect
+ *   contention data; the uncontended path then only adds a relaxed increment.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian All Rights Reserved.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stdint.h>
+#include <assert.h>
+
+#ifdef _MSC_VER
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#endif
+
+/** Pause instruction for spin loops */
+inline void sync_cpu_relax()
+{
+#ifdef _MSC_VER
+    YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ * @brief Contention statistics shared by one or more locks
+ */
+class LockStats
+{
+public:
+    static constexpr size_t BUCKETS = 32;   // bucket i counts waits in [2^i, 2^(i+1)) ns
+
+    struct Snapshot
+    {
+        std::string name;
+        uint64_t acquisitions = 0;
+        uint64_t contended = 0;
+        uint64_t totalWaitNs = 0;
+        uint64_t maxWaitNs = 0;
+        uint64_t maxHoldNs = 0;   // debug builds only
+        uint64_t waitHistogram[BUCKETS] = {};
+        uint64_t holdHistogram[BUCKETS] = {};   // debug builds only
+
+        /** approximate percentile (0-100) of the wait time of contended acquisitions, in ns */
+        uint64_t waitPercentile(double percentile) const;
+    };
+
+    explicit LockStats(const std::string& name);
+    ~LockStats();
+
+    LockStats(const LockStats&) = delete;
+    LockStats& operator=(const LockStats&) = delete;
+
+    void recordAcquire() { m_acquisitions.fetch_add(1, std::memory_order_relaxed); }
+    void recordWait(uint64_t waitNs);
+    void recordHold(uint64_t holdNs);
+
+    Snapshot snapshot() const;
+    void reset();
+
+    /** log a table of every live LockStats */
+    static void dumpAll();
+
+private:
+    static size_t bucketOf(uint64_t ns);
+
+private:
+    std::string m_name;
+    std::atomic<uint64_t> m_acquisitions{ 0 };
+    std::atomic<uint64_t> m_contended{ 0 };
+    std::atomic<uint64_t> m_totalWaitNs{ 0 };
+    std::atomic<uint64_t> m_maxWaitNs{ 0 };
+    std::atomic<uint64_t> m_maxHoldNs{ 0 };
+    std::atomic<uint64_t> m_waitHistogram[BUCKETS] = {};
+    std::atomic<uint64_t> m_holdHistogram[BUCKETS] = {};
+};
+
+/**
+ * @brief Owner and hold time tracking, compiled in for _DEBUG only
+ */
+class LockDebugInfo
+{
+public:
+#ifdef _DEBUG
+    void acquired(LockStats* stats);
+    void released(LockStats* stats);
+    bool ownedByCurrentThread() const;
+
+private:
+    std::atomic<int> m_owner{ 0 };
+    std::chrono::steady_clock::time_point m_lockedAt;
+#else
+    void acquired(LockStats*) {}
+    void released(LockStats*) {}
+    bool ownedByCurrentThread() const { return false; }
+#endif
+};
+
+class SpinLock
+{
+public:
+    explicit SpinLock(LockStats* stats = nullptr) : m_stats(stats) {}
+    SpinLock(const SpinLock&) = delete;
+    SpinLock& operator=(const SpinLock&) = delete;
+
+    void lock()
+    {
+        assert(!m_debug.ownedByCurrentThread() && "SpinLock is not recursive");
+        if (!m_locked.exchange(true, std::memory_order_acquire)) {
+            onAcquired();
+            return;
+        }
+        lockSlow();
+    }
+
+    bool try_lock()
+    {
+        if (!m_locked.load(std::memory_order_relaxed) && !m_locked.exchange(true, std::memory_order_acquire)) {
+            onAcquired();
+            return true;
+        }
+        return false;
+    }
+
+    void unlock()
+    {
+        m_debug.released(m_stats);
+        m_locked.store(false, std::memory_order_release);
+    }
+
+private:
+    void lockSlow();
+    void onAcquired()
+    {
+        if (m_stats != nullptr) m_stats->recordAcquire();
+        m_debug.acquired(m_stats);
+    }
+
+private:
+    std::atomic_bool m_locked{ false };
+    LockStats* m_stats;
+    LockDebugInfo m_debug;
+};
+
+class AdaptiveMutex
+{
+public:
+    /**
+     * @param spinCount  pause iterations before sleeping on the lock word
+     */
+    explicit AdaptiveMutex(LockStats* stats = nullptr, uint32_t spinCount = 100) : m_stats(stats), m_spinCount(spinCount) {}
+    AdaptiveMutex(const AdaptiveMutex&) = delete;
+    AdaptiveMutex& operator=(const AdaptiveMutex&) = delete;
+
+    void lock()
+    {
+        assert(!m_debug.ownedByCurrentThread() && "AdaptiveMutex is not recursive");
+        uint32_t expected = UNLOCKED;
+        if (m_state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) {
+            onAcquired();
+            return;
+        }
+        lockSlow();
+    }
+
+    bool try_lock()
+    {
+        uint32_t expected = UNLOCKED;
+        if (m_state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) {
+            onAcquired();
+            return true;
+        }
+        return false;
+    }
+
+    void unlock()
+    {
+        m_debug.released(m_stats);
+        if (m_state.exchange(UNLOCKED, std::memory_order_release) == CONTENDED) {
+            m_state.notify_one();
+        }
+    }
+
+private:
+    // 0: free, 1: locked, 2: locked and somebody may sleep on it
+    static constexpr uint32_t UNLOCKED = 0;
+    static constexpr uint32_t LOCKED = 1;
+    static constexpr uint32_t CONTENDED = 2;
+
+    void lockSlow();
+    void onAcquired()
+    {
+        if (m_stats != nullptr) m_stats->recordAcquire();
+        m_debug.acquired(m_stats);
+    }
+
+private:
+    std::atomic<uint32_t> m_state{ UNLOCKED };
+    LockStats* m_stats;
+    uint32_t m_spinCount;
+    LockDebugInfo m_debug;
+};
+
+class RWLock
+{
+public:
+    explicit RWLock(LockStats* stats = nullptr) : m_writer(stats), m_stats(stats) {}
+    RWLock(const RWLock&) = delete;
+    RWLock& operator=(const RWLock&) = delete;
+
+    /** exclusive */
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    /** shared, new readers wait as soon as a writer is queued */
+    void lock_shared()
+    {
+        uint32_t state = m_state.load(std::memory_order_relaxed);
+        if ((state & WRITER) == 0 &&
+            m_state.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+            if (m_stats != nullptr) m_stats->recordAcquire();
+            return;
+        }
+        lockSharedSlow();
+    }
+
+    bool try_lock_shared()
+    {
+        uint32_t state = m_state.load(std::memory_order_relaxed);
+        while ((state & WRITER) == 0) {
+            if (m_state.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                if (m_stats != nullptr) m_stats->recordAcquire();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void unlock_shared()
+    {
+        // the last reader out wakes a writer waiting for the readers to drain
+        if (m_state.fetch_sub(1, std::memory_order_release) - 1 == WRITER) {
+            m_state.notify_all();
+        }
+    }
+
+private:
+    static constexpr uint32_t WRITER = 0x80000000u;  // low 31 bits count active readers
+
+    void lockSharedSlow();
+
+private:
+    std::atomic<uint32_t> m_state{ 0 };
+    AdaptiveMutex m_writer;     // queues writers, holds the stats of the exclusive side
+    LockStats* m_stats;
+};
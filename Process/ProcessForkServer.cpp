@@ -0,0 +1,565 @@
+#include "ProcessForkServer.h"
+#include "PlatformCommonUtils.h"
+#include <string.h>
+#include <errno.h>
+#include <chrono>
+#include <algorithm>
+
+#ifndef _MSC_VER
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+
+extern char** environ;
+#endif
+
+using namespace PlatformCommonUtils;
+
+#ifndef _MSC_VER
+static constexpr uint32_t FORK_MAGIC = 0x464B5356; // "FKSV"
+
+enum ForkReplyKind : uint32_t
+{
+    SpawnResult = 1,
+    ChildExit = 2
+};
+
+/** Request head, followed by bodyLen bytes of NUL terminated argv and env strings */
+struct ForkRequestHead
+{
+    uint32_t magic;
+    uint32_t bodyLen;
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t fdMask;    // bit 0/1/2: stdin/stdout/stderr attached as SCM_RIGHTS
+};
+
+struct ForkReply
+{
+    uint32_t magic;
+    uint32_t kind;
+    int32_t pid;        // SpawnResult: pid or -errno
+    int32_t status;     // ChildExit: raw wait status
+};
+
+#ifdef MSG_NOSIGNAL
+static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static constexpr int SEND_FLAGS = 0;
+#endif
+
+static bool read_full(int fd, void* buf, size_t len)
+{
+    uint8_t* p = static_cast<uint8_t*>(buf);
+    while (len > 0) {
+        ssize_t n = ::read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool send_full(int fd, const void* buf, size_t len)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(buf);
+    while (len > 0) {
+        ssize_t n = ::send(fd, p, len, SEND_FLAGS);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static void set_cloexec(int fd)
+{
+    int flags = fcntl(fd, F_GETFD);
+    if (flags >= 0) fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
+}
+
+static void disable_sigpipe(int fd)
+{
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+    UNUSED(fd);
+#endif
+}
+
+static int wait_status_to_exit_code(int status)
+{
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return -1;
+}
+
+// Same splitting rules as execute_process(cmd): optional quoted program path, space separated arguments
+static std::vector<std::string> split_command(const std::string& cmd)
+{
+    std::vector<std::string> argv;
+    std::string arguments;
+    if (!cmd.empty() && cmd[0] == '"') {
+        size_t closing_quote = cmd.find('"', 1);
+        if (closing_quote == std::string::npos) {
+            return argv;
+        }
+        argv.push_back(cmd.substr(1, closing_quote - 1));
+        if (closing_quote + 2 < cmd.size()) {
+            arguments = cmd.substr(closing_quote + 2);
+        }
+    }
+    else {
+        size_t first_space = cmd.find(' ');
+        argv.push_back(cmd.substr(0, first_space));
+        if (first_space != std::string::npos) {
+            arguments = cmd.substr(first_space + 1);
+        }
+    }
+    for (auto& arg : str_split(arguments, ' ')) {
+        if (!arg.empty()) {
+            argv.push_back(arg);
+        }
+    }
+    return argv;
+}
+
+static int s_sigchld_pipe[2] = { -1, -1 };
+
+static void on_sigchld(int)
+{
+    int saved = errno;
+    char c = 0;
+    ssize_t n = ::write(s_sigchld_pipe[1], &c, 1);
+    UNUSED(n);
+    errno = saved;
+}
+
+static bool send_reply(int sock, uint32_t kind, int pid, int status)
+{
+    ForkReply reply{ FORK_MAGIC, kind, pid, status };
+    return send_full(sock, &reply, sizeof(reply));
+}
+
+// Runs in the resident helper, returns false when the control socket is gone
+static bool handle_spawn_request(int sock, ProcessForkServer::HelperMain helperMain)
+{
+    ForkRequestHead head{};
+    int fds[3] = { -1, -1, -1 };
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * 3)];
+
+    struct iovec iov = { &head, sizeof(head) };
+    struct msghdr msg {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        return false;
+    }
+    // keep the first three fds received, anything beyond is not ours to hold open
+    int fdCount = 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            int count = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            for (int i = 0; i < count; ++i) {
+                int fd;
+                memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                if (fdCount < 3) {
+                    fds[fdCount++] = fd;
+                }
+                else {
+                    ::close(fd);
+                }
+            }
+        }
+    }
+    auto closeReceived = [&]() {
+        for (int i = 0; i < fdCount; ++i) {
+            ::close(fds[i]);
+        }
+    };
+    if ((size_t)n < sizeof(head) && !read_full(sock, (uint8_t*)&head + n, sizeof(head) - n)) {
+        closeReceived();
+        return false;
+    }
+    if (head.magic != FORK_MAGIC) {
+        LOG_ERROR("Fork server received a bad request");
+        closeReceived();
+        return false;
+    }
+
+    std::vector<char> body(head.bodyLen + 1, '\0');
+    if (head.bodyLen > 0 && !read_full(sock, body.data(), head.bodyLen)) {
+        closeReceived();
+        return false;
+    }
+
+    // map received fds back to stdin/stdout/stderr slots, close those fdMask has no slot for
+    int stdio[3] = { -1, -1, -1 };
+    int mapped = 0;
+    for (int i = 0; i < 3 && mapped < fdCount; ++i) {
+        if (head.fdMask & (1u << i)) {
+            stdio[i] = fds[mapped++];
+        }
+    }
+    for (int i = mapped; i < fdCount; ++i) {
+        ::close(fds[i]);
+    }
+
+    std::vector<char*> argv;
+    std::vector<char*> envp;
+    char* p = body.data();
+    char* end = body.data() + head.bodyLen;
+    for (uint32_t i = 0; i < head.argc && p < end; ++i, p += strlen(p) + 1) argv.push_back(p);
+    for (uint32_t i = 0; i < head.envc && p < end; ++i, p += strlen(p) + 1) envp.push_back(p);
+    argv.push_back(nullptr);
+    envp.push_back(nullptr);
+
+    pid_t pid = argv.size() > 1 ? fork() : -1;
+    if (pid == 0) {
+        ::close(sock);
+        ::close(s_sigchld_pipe[0]);
+        ::close(s_sigchld_pipe[1]);
+        signal(SIGCHLD, SIG_DFL);
+        for (int i = 0; i < 3; ++i) {
+            if (stdio[i] >= 0) {
+                dup2(stdio[i], i);
+                if (stdio[i] > 2) ::close(stdio[i]);
+            }
+        }
+        if (head.envc > 0) {
+            environ = envp.data();
+        }
+        exit(helperMain((int)argv.size() - 1, argv.data()));
+    }
+
+    int err = errno;
+    for (int i = 0; i < 3; ++i) {
+        if (stdio[i] >= 0) ::close(stdio[i]);
+    }
+    return send_reply(sock, SpawnResult, pid > 0 ? pid : -err, 0);
+}
+#endif
+
+ProcessForkServer::ProcessForkServer(const std::string& helperPath):
+    m_helperPath(helperPath)
+{
+}
+
+ProcessForkServer::~ProcessForkServer()
+{
+    stop();
+}
+
+bool ProcessForkServer::start()
+{
+#ifndef _MSC_VER
+    stop();
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        LOG_ERROR("socketpair failed with error %s", strerror(errno));
+        return false;
+    }
+    set_cloexec(sv[0]);
+    disable_sigpipe(sv[0]);
+
+    // everything the child needs is built here: between fork and exec in a multithreaded
+    // process only async-signal-safe calls are allowed, setenv may block on a libc lock
+    std::string fdEnv = std::string(ENV_FORK_SERVER_FD) + "=" + std::to_string(sv[1]);
+    size_t prefixLen = strlen(ENV_FORK_SERVER_FD) + 1;
+    std::vector<char*> envp;
+    for (char** env = environ; *env != nullptr; ++env) {
+        if (strncmp(*env, fdEnv.c_str(), prefixLen) != 0) {
+            envp.push_back(*env);
+        }
+    }
+    envp.push_back(fdEnv.data());
+    envp.push_back(nullptr);
+    char* argv[] = { m_helperPath.data(), nullptr };
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        LOG_ERROR("fork failed with error %s", strerror(errno));
+        ::close(sv[0]);
+        ::close(sv[1]);
+        return false;
+    }
+    if (pid == 0) {
+        execve(argv[0], argv, envp.data());
+        _exit(127);
+    }
+    ::close(sv[1]);
+
+    m_socket = sv[0];
+    m_serverPid = pid;
+    m_hasSpawnReply = false;
+    m_exitCodes.clear();
+    m_bRunning.store(true);
+    if (!m_reader.run([this]() { readReplies(); })) {
+        stop();
+        return false;
+    }
+    return true;
+#else
+    LOG_ERROR("Fork server is not supported on Windows");
+    return false;
+#endif
+}
+
+void ProcessForkServer::stop()
+{
+#ifndef _MSC_VER
+    if (m_socket >= 0) {
+        ::shutdown(m_socket, SHUT_RDWR);
+    }
+    m_reader.join();
+    if (m_socket >= 0) {
+        ::close(m_socket);
+        m_socket = -1;
+    }
+    if (m_serverPid > 0) {
+        int status = 0;
+        waitpid(m_serverPid, &status, 0);
+        m_serverPid = -1;
+    }
+    m_bRunning.store(false);
+    m_cond.notify_all();
+#endif
+}
+
+bool ProcessForkServer::isRunning() const
+{
+    return m_bRunning.load();
+}
+
+int ProcessForkServer::spawn(const ForkSpawnOptions& opts)
+{
+#ifndef _MSC_VER
+    if (!isRunning() || opts.argv.empty()) {
+        return -1;
+    }
+
+    std::string body;
+    for (const auto& arg : opts.argv) body.append(arg.c_str(), arg.size() + 1);
+    for (const auto& env : opts.env) body.append(env.c_str(), env.size() + 1);
+
+    ForkRequestHead head{ FORK_MAGIC, (uint32_t)body.size(), (uint32_t)opts.argv.size(), (uint32_t)opts.env.size(), 0 };
+    int fds[3];
+    int fdCount = 0;
+    const int stdio[3] = { opts.stdinFd, opts.stdoutFd, opts.stderrFd };
+    for (int i = 0; i < 3; ++i) {
+        if (stdio[i] >= 0) {
+            head.fdMask |= 1u << i;
+            fds[fdCount++] = stdio[i];
+        }
+    }
+
+    std::lock_guard<std::mutex> spawnLock(m_spawnMutex);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_hasSpawnReply = false;
+    }
+
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * 3)] = {};
+    struct iovec iov[2] = { { &head, sizeof(head) }, { body.data(), body.size() } };
+    struct msghdr msg {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = body.empty() ? 1 : 2;
+    if (fdCount > 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fdCount);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fdCount);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * fdCount);
+    }
+
+    ssize_t n;
+    do {
+        n = sendmsg(m_socket, &msg, SEND_FLAGS);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        LOG_ERROR("Fork server request failed with error %s", strerror(errno));
+        return -1;
+    }
+    // the fds travelled with the first byte, push the rest as plain data
+    size_t total = sizeof(head) + body.size();
+    if ((size_t)n < total) {
+        std::string rest((const char*)&head, sizeof(head));
+        rest += body;
+        if (!send_full(m_socket, rest.data() + n, total - n)) {
+            return -1;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait(lock, [this]() { return m_hasSpawnReply || !isRunning(); });
+    if (!m_hasSpawnReply) {
+        return -1;
+    }
+    if (m_spawnReply < 0) {
+        LOG_ERROR("Fork server failed to fork with error %s", strerror(-m_spawnReply));
+        return -1;
+    }
+    return m_spawnReply;
+#else
+    UNUSED(opts);
+    return -1;
+#endif
+}
+
+int ProcessForkServer::spawn(const std::string& cmd)
+{
+#ifndef _MSC_VER
+    ForkSpawnOptions opts;
+    opts.argv = split_command(cmd);
+    return spawn(opts);
+#else
+    UNUSED(cmd);
+    return -1;
+#endif
+}
+
+bool ProcessForkServer::waitExit(int pid, int& exitCode, uint32_t timeout)
+{
+    auto find = [this, pid]() {
+        return std::find_if(m_exitCodes.begin(), m_exitCodes.end(), [pid](const std::pair<int, int>& entry) {
+            return entry.first == pid;
+        });
+    };
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto ready = [&]() { return find() != m_exitCodes.end() || !isRunning(); };
+    if (timeout == 0) {
+        m_cond.wait(lock, ready);
+    }
+    else {
+        m_cond.wait_for(lock, std::chrono::milliseconds(timeout), ready);
+    }
+    auto it = find();
+    if (it == m_exitCodes.end()) {
+        return false;
+    }
+    exitCode = it->second;
+    m_exitCodes.erase(it);
+    return true;
+}
+
+void ProcessForkServer::setExitCallback(ExitCallback cb, void* user_data)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_exitCb = cb;
+    m_exitCbData = user_data;
+}
+
+void ProcessForkServer::readReplies()
+{
+#ifndef _MSC_VER
+    ForkReply reply;
+    while (read_full(m_socket, &reply, sizeof(reply)) && reply.magic == FORK_MAGIC) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (reply.kind == SpawnResult) {
+            m_spawnReply = reply.pid;
+            m_hasSpawnReply = true;
+        }
+        else if (reply.kind == ChildExit) {
+            int exitCode = wait_status_to_exit_code(reply.status);
+            if (m_exitCb != nullptr) {
+                ExitCallback cb = m_exitCb;
+                void* data = m_exitCbData;
+                lock.unlock();
+                cb(reply.pid, exitCode, data);
+                continue;
+            }
+            // children spawned and never waited for must not pile up
+            m_exitCodes.emplace_back(reply.pid, exitCode);
+            if (m_exitCodes.size() > MAX_UNCOLLECTED_EXITS) {
+                m_exitCodes.pop_front();
+            }
+        }
+        lock.unlock();
+        m_cond.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bRunning.store(false);
+    }
+    m_cond.notify_all();
+#endif
+}
+
+bool ProcessForkServer::isForkServerLaunch()
+{
+    return getenv(ENV_FORK_SERVER_FD) != nullptr;
+}
+
+int ProcessForkServer::serve(HelperMain helperMain)
+{
+#ifndef _MSC_VER
+    const char* fdEnv = getenv(ENV_FORK_SERVER_FD);
+    if (fdEnv == nullptr || helperMain == nullptr) {
+        return 1;
+    }
+    int sock = atoi(fdEnv);
+    unsetenv(ENV_FORK_SERVER_FD);
+    set_cloexec(sock);
+    disable_sigpipe(sock);
+
+    if (pipe(s_sigchld_pipe) != 0) {
+        return 1;
+    }
+    for (int fd : s_sigchld_pipe) {
+        set_cloexec(fd);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    struct sigaction sa {};
+    sa.sa_handler = on_sigchld;
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, nullptr);
+
+    struct pollfd pfds[2] = { { sock, POLLIN, 0 }, { s_sigchld_pipe[0], POLLIN, 0 } };
+    bool alive = true;
+    while (alive) {
+        if (poll(pfds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (pfds[1].revents & POLLIN) {
+            char drain[64];
+            while (::read(s_sigchld_pipe[0], drain, sizeof(drain)) > 0);
+            int status = 0;
+            pid_t pid;
+            while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+                alive = send_reply(sock, ChildExit, pid, status) && alive;
+            }
+        }
+        if (pfds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            alive = handle_spawn_request(sock, helperMain) && alive;
+        }
+    }
+
+    signal(SIGCHLD, SIG_DFL);
+    ::close(sock);
+    ::close(s_sigchld_pipe[0]);
+    ::close(s_sigchld_pipe[1]);
+    return 0;
+#else
+    UNUSED(helperMain);
+    return 1;
+#endif
+}
@@ -0,0 +1,123 @@
+/**
+ *   Fork server (zygote) for frequently launched helper processes
+ *
+ *   The helper binary is started once and stays resident. Every spawn request
+ *   forks the already initialized helper instead of exec'ing a new image, so
+ *   dynamic linking and static initialization are paid only once.
+ *
+ *   Helper side:
+ *       int main(int argc, char** argv) {
+ *           if (ProcessForkServer::isForkServerLaunch()) {
+ *               return ProcessForkServer::serve(helper_main);
+ *           }
+ *           return helper_main(argc, argv);
+ *       }
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdint.h>
+#include "CThread.hpp"
+
+struct ForkSpawnOptions
+{
+    std::vector<std::string> argv;  // argv[0] included
+    std::vector<std::string> env;   // "KEY=VALUE" list, empty means inherit the server environment
+    int stdinFd = -1;               // -1 keeps the stdio of the fork server
+    int stdoutFd = -1;
+    int stderrFd = -1;
+};
+
+class ProcessForkServer
+{
+public:
+    using HelperMain = int(*)(int, char**);
+    using ExitCallback = void(*)(int pid, int exitCode, void* user_data);
+
+    /** Exit codes kept for waitExit, older ones nobody collected are dropped */
+    static constexpr size_t MAX_UNCOLLECTED_EXITS = 1024;
+
+    /** Environment variable carrying the control socket fd to the helper */
+    static constexpr const char* ENV_FORK_SERVER_FD = "PLATFORM_FORK_SERVER_FD";
+
+    explicit ProcessForkServer(const std::string& helperPath);
+    ~ProcessForkServer();
+
+    /**
+     * @brief  Launch the resident helper, not supported on Windows
+     * @return true if the fork server is up
+     */
+    bool start();
+
+    /**
+     * @brief Close the control socket and reap the resident helper
+     */
+    void stop();
+
+    bool isRunning() const;
+
+    /**
+     * @brief       Fork a child from the resident helper
+     * @param opts  argv, environment and stdio fds of the child, fds are not taken over
+     * @return      pid of the child, -1 if failed
+     */
+    int spawn(const ForkSpawnOptions& opts);
+
+    /**
+     * @brief       Same as spawn(opts), cmd is split like execute_process(cmd)
+     */
+    int spawn(const std::string& cmd);
+
+    /**
+     * @brief           Wait for a child spawned by this server; the exit code of a child
+     *                  that ended earlier is kept until MAX_UNCOLLECTED_EXITS later exits
+     * @param exitCode  exit code, 128 + signal number if the child was killed
+     * @param timeout   milliseconds, 0 means wait forever
+     * @return          false on timeout or if the server went away
+     */
+    bool waitExit(int pid, int& exitCode, uint32_t timeout = 0);
+
+    /**
+     * @brief Exit reports go to the callback (on the reader thread) instead of waitExit
+     */
+    void setExitCallback(ExitCallback cb, void* user_data);
+
+    /** Helper side: whether this process was launched by ProcessForkServer::start */
+    static bool isForkServerLaunch();
+
+    /**
+     * @brief             Helper side: serve spawn requests until the control socket closes
+     * @param helperMain  entry point run in every forked child
+     * @return            exit code for the resident helper
+     */
+    static int serve(HelperMain helperMain);
+
+private:
+    void readReplies();
+
+private:
+    std::string m_helperPath;
+    int m_socket = -1;
+    int m_serverPid = -1;
+    std::atomic_bool m_bRunning = false;
+
+    std::mutex m_spawnMutex;    // one request in flight, replies come back in order
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_hasSpawnReply = false;
+    int m_spawnReply = -1;
+    std::deque<std::pair<int, int>> m_exitCodes;   // pid, exit code not collected yet, oldest first
+    ExitCallback m_exitCb = nullptr;
+    void* m_exitCbData = nullptr;
+
+    CThread<void> m_reader;
+};
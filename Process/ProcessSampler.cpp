@@ -0,0 +1,384 @@
+#include "ProcessSampler.h"
+#include "PlatformCommonUtils.h"
+#include <cstring>
+#include <algorithm>
+#include <errno.h>
+
+#ifdef _MSC_VER
+#include <Windows.h>
+#include <Psapi.h>
+#include <TlHelp32.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef __APPLE__
+#include <libproc.h>
+#include <mach/mach_time.h>
+#endif
+#endif
+
+using namespace PlatformCommonUtils;
+using Clock = std::chrono::steady_clock;
+
+#if !defined(_MSC_VER) && !defined(__APPLE__)
+// Re-reads an open /proc file from the start, the kernel regenerates the content on every read
+static ssize_t pread_proc(int fd, char* buffer, size_t size)
+{
+    ssize_t len = pread(fd, buffer, size - 1, 0);
+    if (len >= 0) {
+        buffer[len] = '\0';
+    }
+    return len;
+}
+
+static uint64_t parse_io_field(const char* content, const char* key)
+{
+    const char* p = strstr(content, key);
+    return p != nullptr ? strtoull(p + strlen(key), nullptr, 10) : 0;
+}
+#endif
+
+ProcessSampler::ProcessSampler(uint32_t intervalMs, size_t windowSize):
+    m_interval(intervalMs > 0 ? intervalMs : 1),
+    m_windowSize(windowSize > 0 ? windowSize : 1)
+{
+}
+
+ProcessSampler::~ProcessSampler()
+{
+    stop();
+    for (auto& entry : m_targets) {
+        closeTarget(entry.second);
+    }
+}
+
+bool ProcessSampler::start()
+{
+    if (m_bRunning.exchange(true)) {
+        return true;
+    }
+    if (!m_thread.run([this]() { loop(); })) {
+        m_bRunning.store(false);
+        return false;
+    }
+    return true;
+}
+
+void ProcessSampler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_bRunning.exchange(false)) {
+            return;
+        }
+    }
+    m_cond.notify_all();
+    m_thread.join();
+}
+
+void ProcessSampler::setInterval(uint32_t intervalMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_interval = intervalMs > 0 ? intervalMs : 1;
+}
+
+void ProcessSampler::setCallback(SampleCallback cb, void* user_data)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cb = cb;
+    m_cbData = user_data;
+}
+
+bool ProcessSampler::openTarget(int pid, Target& target)
+{
+#ifdef _MSC_VER
+    target.handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, (DWORD)pid);
+    return target.handle != nullptr;
+#elif defined(__APPLE__)
+    struct rusage_info_v2 ri;
+    return proc_pid_rusage(pid, RUSAGE_INFO_V2, (rusage_info_t*)&ri) == 0;
+#else
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    target.statFd = open(path, O_RDONLY | O_CLOEXEC);
+    snprintf(path, sizeof(path), "/proc/%d/statm", pid);
+    target.statmFd = open(path, O_RDONLY | O_CLOEXEC);
+    snprintf(path, sizeof(path), "/proc/%d/io", pid);
+    target.ioFd = open(path, O_RDONLY | O_CLOEXEC); // needs ptrace permission, optional
+    if (target.statFd < 0 || target.statmFd < 0) {
+        closeTarget(target);
+        return false;
+    }
+    return true;
+#endif
+}
+
+void ProcessSampler::closeTarget(Target& target)
+{
+#ifdef _MSC_VER
+    if (target.handle != nullptr) {
+        CloseHandle(target.handle);
+        target.handle = nullptr;
+    }
+#elif !defined(__APPLE__)
+    for (int* fd : { &target.statFd, &target.statmFd, &target.ioFd }) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+#else
+    UNUSED(target);
+#endif
+}
+
+bool ProcessSampler::addProcess(int pid)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_targets.count(pid) > 0) {
+        return true;
+    }
+    Target target;
+    if (!openTarget(pid, target)) {
+        return false;
+    }
+    m_targets.emplace(pid, std::move(target));
+    return true;
+}
+
+void ProcessSampler::removeProcess(int pid)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_targets.find(pid);
+    if (it != m_targets.end()) {
+        closeTarget(it->second);
+        m_targets.erase(it);
+    }
+}
+
+std::vector<ProcessSample> ProcessSampler::history(int pid)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_targets.find(pid);
+    if (it == m_targets.end()) {
+        return {};
+    }
+    return std::vector<ProcessSample>(it->second.window.begin(), it->second.window.end());
+}
+
+bool ProcessSampler::getStats(int pid, ProcessSampleStats& stats)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_targets.find(pid);
+    if (it == m_targets.end() || it->second.window.empty()) {
+        return false;
+    }
+    stats = computeStats(pid, it->second);
+    return true;
+}
+
+bool ProcessSampler::readSample(int pid, Target& target, ProcessSample& sample)
+{
+    sample.pid = pid;
+    sample.time = Clock::now();
+#ifdef _MSC_VER
+    DWORD code = 0;
+    if (!GetExitCodeProcess((HANDLE)target.handle, &code) || code != STILL_ACTIVE) {
+        return false;
+    }
+    FILETIME creation, exit, kernel, user;
+    if (GetProcessTimes((HANDLE)target.handle, &creation, &exit, &kernel, &user)) {
+        uint64_t k = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+        uint64_t u = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+        sample.cpuTimeUs = (k + u) / 10; // 100 ns units
+    }
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo((HANDLE)target.handle, &pmc, sizeof(pmc))) {
+        sample.rssBytes = pmc.WorkingSetSize;
+    }
+    IO_COUNTERS io;
+    if (GetProcessIoCounters((HANDLE)target.handle, &io)) {
+        sample.readBytes = io.ReadTransferCount;
+        sample.writeBytes = io.WriteTransferCount;
+    }
+    return true;
+#elif defined(__APPLE__)
+    UNUSED(target);
+    static mach_timebase_info_data_t timebase = []() {
+        mach_timebase_info_data_t info;
+        mach_timebase_info(&info);
+        return info;
+    }();
+    struct rusage_info_v2 ri;
+    if (proc_pid_rusage(pid, RUSAGE_INFO_V2, (rusage_info_t*)&ri) != 0) {
+        return false;
+    }
+    uint64_t cpu = ri.ri_user_time + ri.ri_system_time;
+    sample.cpuTimeUs = cpu * timebase.numer / timebase.denom / 1000;
+    sample.rssBytes = ri.ri_resident_size;
+    sample.readBytes = ri.ri_diskio_bytesread;
+    sample.writeBytes = ri.ri_diskio_byteswritten;
+    struct proc_taskinfo ti;
+    if (proc_pidinfo(pid, PROC_PIDTASKINFO, 0, &ti, sizeof(ti)) == sizeof(ti)) {
+        sample.threads = (uint32_t)ti.pti_threadnum;
+    }
+    return true;
+#else
+    static const long ticks = sysconf(_SC_CLK_TCK);
+    static const long page_size = sysconf(_SC_PAGESIZE);
+    char buffer[1024];
+
+    // reading a /proc file of an exited process fails with ESRCH, even after pid reuse
+    if (pread_proc(target.statFd, buffer, sizeof(buffer)) <= 0) {
+        return false;
+    }
+    char* p = strrchr(buffer, ')');
+    if (p == nullptr) {
+        return false;
+    }
+    ++p;
+    uint64_t utime = 0, stime = 0;
+    for (int field = 3; field <= 20 && *p != '\0'; ++field) {
+        while (*p == ' ') ++p;
+        if (field == 3 && (*p == 'Z' || *p == 'X')) {
+            return false;
+        }
+        if (field == 14) utime = strtoull(p, nullptr, 10);
+        else if (field == 15) stime = strtoull(p, nullptr, 10);
+        else if (field == 20) sample.threads = (uint32_t)strtoul(p, nullptr, 10);
+        while (*p != ' ' && *p != '\0') ++p;
+    }
+    sample.cpuTimeUs = (utime + stime) * 1000000ULL / (uint64_t)ticks;
+
+    if (pread_proc(target.statmFd, buffer, sizeof(buffer)) > 0) {
+        unsigned long long size = 0, resident = 0;
+        if (sscanf(buffer, "%llu %llu", &size, &resident) == 2) {
+            sample.rssBytes = resident * (uint64_t)page_size;
+        }
+    }
+    if (target.ioFd >= 0 && pread_proc(target.ioFd, buffer, sizeof(buffer)) > 0) {
+        sample.readBytes = parse_io_field(buffer, "\nread_bytes:");
+        sample.writeBytes = parse_io_field(buffer, "\nwrite_bytes:");
+    }
+    return true;
+#endif
+}
+
+ProcessSampleStats ProcessSampler::computeStats(int pid, const Target& target) const
+{
+    ProcessSampleStats stats;
+    stats.pid = pid;
+    stats.count = target.window.size();
+    if (stats.count == 0) {
+        return stats;
+    }
+    double cpuSum = 0;
+    uint64_t rssSum = 0;
+    for (const auto& sample : target.window) {
+        cpuSum += sample.cpuUsage;
+        rssSum += sample.rssBytes;
+        stats.maxCpuUsage = std::max(stats.maxCpuUsage, sample.cpuUsage);
+        stats.maxRssBytes = std::max(stats.maxRssBytes, sample.rssBytes);
+        stats.maxThreads = std::max(stats.maxThreads, sample.threads);
+    }
+    stats.avgCpuUsage = cpuSum / stats.count;
+    stats.avgRssBytes = rssSum / stats.count;
+
+    const ProcessSample& first = target.window.front();
+    const ProcessSample& last = target.window.back();
+    double seconds = std::chrono::duration<double>(last.time - first.time).count();
+    if (seconds > 0) {
+        stats.readBytesPerSec = (double)(last.readBytes - first.readBytes) / seconds;
+        stats.writeBytesPerSec = (double)(last.writeBytes - first.writeBytes) / seconds;
+    }
+    return stats;
+}
+
+void ProcessSampler::sampleAll()
+{
+    m_samples.clear();
+    m_stats.clear();
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+#ifdef _MSC_VER
+    // one thread snapshot per tick for all targets
+    std::unordered_map<DWORD, uint32_t> threadCounts;
+    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (hSnapshot != INVALID_HANDLE_VALUE) {
+        THREADENTRY32 te;
+        te.dwSize = sizeof(THREADENTRY32);
+        if (Thread32First(hSnapshot, &te)) {
+            do {
+                if (m_targets.count((int)te.th32OwnerProcessID) > 0) {
+                    ++threadCounts[te.th32OwnerProcessID];
+                }
+            } while (Thread32Next(hSnapshot, &te));
+        }
+        CloseHandle(hSnapshot);
+    }
+#endif
+
+    for (auto it = m_targets.begin(); it != m_targets.end();) {
+        int pid = it->first;
+        Target& target = it->second;
+        ProcessSample sample;
+        if (!readSample(pid, target, sample)) {
+            sample.exited = true;
+            m_samples.push_back(sample);
+            m_stats.push_back(computeStats(pid, target));
+            closeTarget(target);
+            it = m_targets.erase(it);
+            continue;
+        }
+#ifdef _MSC_VER
+        sample.threads = threadCounts[(DWORD)pid];
+#endif
+        if (target.hasPrev) {
+            double elapsedUs = (double)std::chrono::duration_cast<std::chrono::microseconds>(sample.time - target.prevTime).count();
+            if (elapsedUs > 0 && sample.cpuTimeUs >= target.prevCpuTimeUs) {
+                sample.cpuUsage = (double)(sample.cpuTimeUs - target.prevCpuTimeUs) * 100.0 / elapsedUs;
+            }
+        }
+        target.hasPrev = true;
+        target.prevCpuTimeUs = sample.cpuTimeUs;
+        target.prevTime = sample.time;
+
+        target.window.push_back(sample);
+        while (target.window.size() > m_windowSize) {
+            target.window.pop_front();
+        }
+        m_samples.push_back(sample);
+        m_stats.push_back(computeStats(pid, target));
+        ++it;
+    }
+}
+
+void ProcessSampler::loop()
+{
+    auto next = Clock::now();
+    while (m_bRunning.load()) {
+        sampleAll();
+
+        SampleCallback cb;
+        void* cbData;
+        uint32_t interval;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            cb = m_cb;
+            cbData = m_cbData;
+            interval = m_interval;
+        }
+        if (cb != nullptr && !m_samples.empty()) {
+            cb(m_samples.data(), m_stats.data(), m_samples.size(), cbData);
+        }
+
+        // fixed rate, skip ticks we are late for
+        next += std::chrono::milliseconds(interval);
+        auto now = Clock::now();
+        if (next < now) {
+            next = now;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait_until(lock, next, [this]() { return !m_bRunning.load(); });
+    }
+}
@@ -0,0 +1,115 @@
+/**
+ *   Per-process resource sampler
+ *
+ *   Samples CPU time, resident memory, storage I/O and thread count of a set of
+ *   processes from one thread. On Linux the /proc/<pid>/{stat,statm,io} files
+ *   stay open and are re-read with pread on every tick.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <unordered_map>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include "CThread.hpp"
+
+struct ProcessSample
+{
+    int pid = 0;
+    std::chrono::steady_clock::time_point time;
+    uint64_t cpuTimeUs = 0;     // user + system, since process start
+    double cpuUsage = 0;        // percent of one core since the previous sample
+    uint64_t rssBytes = 0;
+    uint64_t readBytes = 0;     // storage I/O since process start, 0 if not permitted
+    uint64_t writeBytes = 0;
+    uint32_t threads = 0;
+    bool exited = false;        // last report of a process, it is no longer sampled
+};
+
+/** Rolling aggregates over the sample window */
+struct ProcessSampleStats
+{
+    int pid = 0;
+    size_t count = 0;
+    double avgCpuUsage = 0;
+    double maxCpuUsage = 0;
+    uint64_t avgRssBytes = 0;
+    uint64_t maxRssBytes = 0;
+    double readBytesPerSec = 0;
+    double writeBytesPerSec = 0;
+    uint32_t maxThreads = 0;
+};
+
+class ProcessSampler
+{
+public:
+    /** samples and stats of one tick, stats[i] belongs to samples[i] */
+    using SampleCallback = void(*)(const ProcessSample* samples, const ProcessSampleStats* stats, size_t count, void* user_data);
+
+    /**
+     * @param intervalMs  sampling period
+     * @param windowSize  samples kept per process for history and stats
+     */
+    explicit ProcessSampler(uint32_t intervalMs = 1000, size_t windowSize = 60);
+    ~ProcessSampler();
+
+    bool start();
+    void stop();
+
+    void setInterval(uint32_t intervalMs);
+    void setCallback(SampleCallback cb, void* user_data);
+
+    bool addProcess(int pid);
+    void removeProcess(int pid);
+
+    std::vector<ProcessSample> history(int pid);
+    bool getStats(int pid, ProcessSampleStats& stats);
+
+private:
+    struct Target
+    {
+#ifdef _MSC_VER
+        void* handle = nullptr;
+#elif !defined(__APPLE__)
+        int statFd = -1;
+        int statmFd = -1;
+        int ioFd = -1;
+#endif
+        bool hasPrev = false;
+        uint64_t prevCpuTimeUs = 0;
+        std::chrono::steady_clock::time_point prevTime;
+        std::deque<ProcessSample> window;
+    };
+
+    void loop();
+    void sampleAll();
+    bool readSample(int pid, Target& target, ProcessSample& sample);
+    bool openTarget(int pid, Target& target);
+    void closeTarget(Target& target);
+    ProcessSampleStats computeStats(int pid, const Target& target) const;
+
+private:
+    uint32_t m_interval;
+    size_t m_windowSize;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::unordered_map<int, Target> m_targets;
+    SampleCallback m_cb = nullptr;
+    void* m_cbData = nullptr;
+
+    std::atomic_bool m_bRunning = false;
+    CThread<void> m_thread;
+
+    // reused between ticks
+    std::vector<ProcessSample> m_samples;
+    std::vector<ProcessSampleStats> m_stats;
+};
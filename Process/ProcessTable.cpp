@@ -0,0 +1,387 @@
+#include "ProcessTable.h"
+#include "PlatformCommonUtils.h"
+#include <filesystem>
+#include <cstring>
+#include <errno.h>
+
+#ifdef _MSC_VER
+#include <Windows.h>
+#include <TlHelp32.h>
+#else
+#include <sys/types.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef __APPLE__
+#include <libproc.h>
+#include <sys/proc.h>
+#else
+#include <dirent.h>
+#include <limits.h>
+#endif
+#endif
+
+using namespace PlatformCommonUtils;
+namespace fs = std::filesystem;
+
+#if !defined(_MSC_VER) && !defined(__APPLE__)
+// Reads ppid and start time (clock ticks since boot) from /proc/<pid>/stat, false for zombies
+static bool read_proc_stat(long pid, ProcessInfo& info, std::string& comm)
+{
+    char path[64];
+    char buffer[1024];
+    snprintf(path, sizeof(path), "/proc/%ld/stat", pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t len = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (len <= 0) {
+        return false;
+    }
+    buffer[len] = '\0';
+
+    // comm may contain spaces and ')', fields restart after the last ')'
+    char* open_paren = strchr(buffer, '(');
+    char* close_paren = strrchr(buffer, ')');
+    if (open_paren == nullptr || close_paren == nullptr || close_paren < open_paren) {
+        return false;
+    }
+    comm.assign(open_paren + 1, close_paren);
+
+    // field 3 is state, field 4 ppid, field 22 starttime
+    char* p = close_paren + 1;
+    for (int field = 3; field <= 22 && *p != '\0'; ++field) {
+        while (*p == ' ') ++p;
+        char* end = p;
+        while (*end != ' ' && *end != '\0') ++end;
+        if (field == 3 && (*p == 'Z' || *p == 'X')) {
+            return false; // already dead, only waits to be reaped
+        }
+        else if (field == 4) {
+            info.ppid = (int)strtol(p, nullptr, 10);
+        }
+        else if (field == 22) {
+            info.startTime = strtoull(p, nullptr, 10);
+        }
+        p = end;
+    }
+    return true;
+}
+
+static std::string read_exe_path(long pid)
+{
+    static const char deleted_suffix[] = " (deleted)";
+    char link[64];
+    char path[PATH_MAX];
+    snprintf(link, sizeof(link), "/proc/%ld/exe", pid);
+    ssize_t len = readlink(link, path, sizeof(path) - 1);
+    if (len <= 0) {
+        return std::string();
+    }
+    std::string res(path, (size_t)len);
+    size_t suffix_len = sizeof(deleted_suffix) - 1;
+    if (res.size() > suffix_len && res.compare(res.size() - suffix_len, suffix_len, deleted_suffix) == 0) {
+        res.resize(res.size() - suffix_len);
+    }
+    return res;
+}
+#endif
+
+bool ProcessTable::scan(std::unordered_map<int, ProcessInfo>& fresh)
+{
+#ifdef _MSC_VER
+    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (hSnapshot == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    PROCESSENTRY32W ps;
+    memset(&ps, 0, sizeof(PROCESSENTRY32W));
+    ps.dwSize = sizeof(PROCESSENTRY32W);
+    if (!Process32FirstW(hSnapshot, &ps)) {
+        CloseHandle(hSnapshot);
+        return false;
+    }
+    do {
+        if (ps.th32ProcessID == 0) continue;
+        int pid = (int)ps.th32ProcessID;
+        auto name = wchar_to_utf8(ps.szExeFile);
+        // Toolhelp has no start time, pid + parent + name identify an unchanged entry
+        auto it = m_byPid.find(pid);
+        if (it != m_byPid.end() && it->second.ppid == (int)ps.th32ParentProcessID && name && it->second.name == name.get()) {
+            fresh.emplace(pid, std::move(it->second));
+            continue;
+        }
+        ProcessInfo info;
+        info.pid = pid;
+        info.ppid = (int)ps.th32ParentProcessID;
+        info.name = name ? name.get() : "";
+        HANDLE hProc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, ps.th32ProcessID);
+        if (hProc != nullptr) {
+            wchar_t path[MAX_PATH] = { 0 };
+            DWORD size = MAX_PATH;
+            if (QueryFullProcessImageNameW(hProc, 0, path, &size)) {
+                auto utf8 = wchar_to_utf8(path);
+                info.path = utf8 ? canonicalPath(utf8.get()) : "";
+            }
+            FILETIME creation, exit, kernel, user;
+            if (GetProcessTimes(hProc, &creation, &exit, &kernel, &user)) {
+                info.startTime = ((uint64_t)creation.dwHighDateTime << 32) | creation.dwLowDateTime;
+            }
+            CloseHandle(hProc);
+        }
+        fresh.emplace(pid, std::move(info));
+    } while (Process32NextW(hSnapshot, &ps));
+    CloseHandle(hSnapshot);
+    return true;
+#elif defined(__APPLE__)
+    int buffer_size = proc_listpids(PROC_ALL_PIDS, 0, nullptr, 0);
+    if (buffer_size <= 0) {
+        return false;
+    }
+    std::vector<pid_t> pids(buffer_size / sizeof(pid_t));
+    buffer_size = proc_listpids(PROC_ALL_PIDS, 0, pids.data(), (int)(pids.size() * sizeof(pid_t)));
+    int n = buffer_size / sizeof(pid_t);
+    for (int i = 0; i < n; i++) {
+        pid_t pid = pids[i];
+        if (pid == 0) continue;
+        struct proc_bsdinfo bsd;
+        if (proc_pidinfo(pid, PROC_PIDTBSDINFO, 0, &bsd, sizeof(bsd)) != sizeof(bsd) || bsd.pbi_status == SZOMB) {
+            continue;
+        }
+        uint64_t startTime = (uint64_t)bsd.pbi_start_tvsec * 1000000 + bsd.pbi_start_tvusec;
+        auto it = m_byPid.find(pid);
+        if (it != m_byPid.end() && it->second.startTime == startTime) {
+            fresh.emplace(pid, std::move(it->second));
+            continue;
+        }
+        ProcessInfo info;
+        info.pid = pid;
+        info.ppid = (int)bsd.pbi_ppid;
+        info.startTime = startTime;
+        char pathbuf[PROC_PIDPATHINFO_MAXSIZE];
+        if (proc_pidpath(pid, pathbuf, sizeof(pathbuf)) > 0) {
+            info.path = canonicalPath(pathbuf);
+            info.name = extract_filename(pathbuf);
+        }
+        else {
+            info.name = bsd.pbi_comm;
+        }
+        fresh.emplace(pid, std::move(info));
+    }
+    return true;
+#else
+    DIR* dir = opendir("/proc");
+    if (dir == nullptr) {
+        return false;
+    }
+    std::string comm;
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != nullptr) {
+        char* end = nullptr;
+        long pid = strtol(ent->d_name, &end, 10);
+        if (pid <= 0 || *end != '\0') continue;
+
+        ProcessInfo info;
+        if (!read_proc_stat(pid, info, comm)) {
+            continue; // exited while scanning or zombie
+        }
+        auto it = m_byPid.find((int)pid);
+        if (it != m_byPid.end() && it->second.startTime == info.startTime) {
+            fresh.emplace((int)pid, std::move(it->second));
+            continue;
+        }
+        info.pid = (int)pid;
+        info.path = read_exe_path(pid);
+        // kernel threads and foreign processes without permission only have comm
+        info.name = info.path.empty() ? comm : extract_filename(info.path);
+        if (!info.path.empty()) {
+            info.path = canonicalPath(info.path);
+        }
+        fresh.emplace((int)pid, std::move(info));
+    }
+    closedir(dir);
+    return true;
+#endif
+}
+
+bool ProcessTable::refresh()
+{
+    std::unordered_map<int, ProcessInfo> fresh;
+    fresh.reserve(m_byPid.size() + 64);
+    if (!scan(fresh)) {
+        return false;
+    }
+    m_byPid.swap(fresh);
+    rebuildIndex();
+    return true;
+}
+
+void ProcessTable::clear()
+{
+    m_byPid.clear();
+    m_byName.clear();
+    m_byPath.clear();
+}
+
+void ProcessTable::rebuildIndex()
+{
+    m_byName.clear();
+    m_byPath.clear();
+    m_byName.reserve(m_byPid.size());
+    m_byPath.reserve(m_byPid.size());
+    for (const auto& [pid, info] : m_byPid) {
+        m_byName.emplace(info.name, pid);
+        if (!info.path.empty()) {
+            m_byPath.emplace(info.path, pid);
+        }
+    }
+}
+
+size_t ProcessTable::size() const
+{
+    return m_byPid.size();
+}
+
+std::vector<ProcessInfo> ProcessTable::processes() const
+{
+    std::vector<ProcessInfo> res;
+    res.reserve(m_byPid.size());
+    for (const auto& entry : m_byPid) {
+        res.push_back(entry.second);
+    }
+    return res;
+}
+
+const ProcessInfo* ProcessTable::findByPid(int pid) const
+{
+    auto it = m_byPid.find(pid);
+    return it != m_byPid.end() ? &it->second : nullptr;
+}
+
+std::vector<const ProcessInfo*> ProcessTable::findByName(const std::string& name) const
+{
+    std::vector<const ProcessInfo*> res;
+    auto range = m_byName.equal_range(name);
+    for (auto it = range.first; it != range.second; ++it) {
+        res.push_back(findByPid(it->second));
+    }
+    return res;
+}
+
+std::vector<const ProcessInfo*> ProcessTable::findByPath(const std::string& path) const
+{
+    std::vector<const ProcessInfo*> res;
+    auto range = m_byPath.equal_range(canonicalPath(path));
+    for (auto it = range.first; it != range.second; ++it) {
+        res.push_back(findByPid(it->second));
+    }
+    return res;
+}
+
+bool ProcessTable::isRunning(int pid) const
+{
+    return m_byPid.count(pid) > 0;
+}
+
+bool ProcessTable::isRunningByName(const std::string& name) const
+{
+    return m_byName.count(name) > 0;
+}
+
+bool ProcessTable::isRunningByPath(const std::string& path) const
+{
+    return m_byPath.count(canonicalPath(path)) > 0;
+}
+
+std::vector<bool> ProcessTable::areRunningByName(const std::vector<std::string>& names) const
+{
+    std::vector<bool> res;
+    res.reserve(names.size());
+    for (const auto& name : names) {
+        res.push_back(isRunningByName(name));
+    }
+    return res;
+}
+
+std::vector<bool> ProcessTable::areRunningByPath(const std::vector<std::string>& paths) const
+{
+    std::vector<bool> res;
+    res.reserve(paths.size());
+    for (const auto& path : paths) {
+        res.push_back(isRunningByPath(path));
+    }
+    return res;
+}
+
+bool ProcessTable::killEntry(int pid)
+{
+    auto it = m_byPid.find(pid);
+    if (it == m_byPid.end()) {
+        return false;
+    }
+#ifdef _MSC_VER
+    bool res = false;
+    HANDLE hProc = OpenProcess(PROCESS_TERMINATE, FALSE, (DWORD)pid);
+    if (hProc != nullptr) {
+        res = TerminateProcess(hProc, 0);
+        CloseHandle(hProc);
+    }
+    if (!res) {
+        LOG_ERROR("ERROR KILL: %d", GetLastError());
+        return false;
+    }
+#else
+    if (kill(pid, SIGKILL) != 0) {
+        LOG_ERROR("ERROR KILL: %d", errno);
+        return false;
+    }
+#endif
+    LOG_INFO("kill process: %s", it->second.path.empty() ? it->second.name.c_str() : it->second.path.c_str());
+    m_byPid.erase(it);
+    return true;
+}
+
+int ProcessTable::killByPid(const std::vector<int>& pids)
+{
+    int killed = 0;
+    for (int pid : pids) {
+        killed += killEntry(pid) ? 1 : 0;
+    }
+    if (killed > 0) {
+        rebuildIndex();
+    }
+    return killed;
+}
+
+int ProcessTable::killByName(const std::vector<std::string>& names)
+{
+    std::vector<int> pids;
+    for (const auto& name : names) {
+        auto range = m_byName.equal_range(name);
+        for (auto it = range.first; it != range.second; ++it) {
+            pids.push_back(it->second);
+        }
+    }
+    return killByPid(pids);
+}
+
+int ProcessTable::killByPath(const std::vector<std::string>& paths)
+{
+    std::vector<int> pids;
+    for (const auto& path : paths) {
+        auto range = m_byPath.equal_range(canonicalPath(path));
+        for (auto it = range.first; it != range.second; ++it) {
+            pids.push_back(it->second);
+        }
+    }
+    return killByPid(pids);
+}
+
+std::string ProcessTable::canonicalPath(const std::string& path)
+{
+    std::error_code ec;
+    fs::path canonical = fs::weakly_canonical(fs::path(path), ec);
+    return ec ? path : canonical.string();
+}
@@ -0,0 +1,79 @@
+/**
+ *   Indexed process table snapshot
+ *
+ *   One scan of the OS process list, indexed by pid, executable name and
+ *   canonical executable path. Use it instead of is_process_running* and
+ *   kill_process* when many processes are checked in one go.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+struct ProcessInfo
+{
+    int pid = 0;
+    int ppid = 0;
+    std::string name;        // executable file name
+    std::string path;        // canonical executable path, empty if not accessible
+    uint64_t startTime = 0;  // detects pid reuse between refreshes, 0 if unknown
+};
+
+class ProcessTable
+{
+public:
+    ProcessTable() {}
+
+    /**
+     * @brief  Rescan the process list, entries whose pid and start time did not
+     *         change are kept without querying their executable path again
+     * @return false if the process list could not be read
+     */
+    bool refresh();
+
+    /** drop all entries */
+    void clear();
+
+    size_t size() const;
+    std::vector<ProcessInfo> processes() const;
+
+    const ProcessInfo* findByPid(int pid) const;
+    std::vector<const ProcessInfo*> findByName(const std::string& name) const;
+    std::vector<const ProcessInfo*> findByPath(const std::string& path) const;
+
+    bool isRunning(int pid) const;
+    bool isRunningByName(const std::string& name) const;
+    bool isRunningByPath(const std::string& path) const;
+
+    /** batched queries, result[i] answers names[i] / paths[i] */
+    std::vector<bool> areRunningByName(const std::vector<std::string>& names) const;
+    std::vector<bool> areRunningByPath(const std::vector<std::string>& paths) const;
+
+    /**
+     * @brief  Kill every process of the snapshot matching one of the names / paths,
+     *         killed entries are removed from the table
+     * @return count of processes killed
+     */
+    int killByName(const std::vector<std::string>& names);
+    int killByPath(const std::vector<std::string>& paths);
+    int killByPid(const std::vector<int>& pids);
+
+    /** canonical form of ProcessInfo::path on every platform, queries are compared in it */
+    static std::string canonicalPath(const std::string& path);
+
+private:
+    bool scan(std::unordered_map<int, ProcessInfo>& fresh);
+    void rebuildIndex();
+    bool killEntry(int pid);
+
+private:
+    std::unordered_map<int, ProcessInfo> m_byPid;
+    std::unordered_multimap<std::string, int> m_byName;
+    std::unordered_multimap<std::string, int> m_byPath;
+};
@@ -0,0 +1,494 @@
+#include "ProcessWatcher.h"
+#include "ProcessTable.h"
+#include "PlatformCommonUtils.h"
+#include <condition_variable>
+#include <cstring>
+#include <errno.h>
+
+#ifndef _MSC_VER
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <sys/event.h>
+#else
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+using namespace PlatformCommonUtils;
+
+static constexpr int POLL_FALLBACK_INTERVAL = 10; // ms, kernels without pidfd_open
+
+#if !defined(_MSC_VER) && !defined(__APPLE__)
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+static int pidfd_open(int pid)
+{
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+}
+
+// Peek the exit status of our own child without reaping it, -1 for foreign processes
+static int peek_child_exit_code(int pid)
+{
+    siginfo_t info;
+    memset(&info, 0, sizeof(info));
+    if (waitid(P_PID, (id_t)pid, &info, WEXITED | WNOHANG | WNOWAIT) != 0 || info.si_pid != pid) {
+        return -1;
+    }
+    if (info.si_code == CLD_EXITED) {
+        return info.si_status;
+    }
+    return 128 + info.si_status;
+}
+#endif
+
+ProcessWatcher::ProcessWatcher()
+{
+}
+
+ProcessWatcher::~ProcessWatcher()
+{
+    stop();
+}
+
+ProcessWatcher& ProcessWatcher::shared()
+{
+    static ProcessWatcher watcher;
+    watcher.start();
+    return watcher;
+}
+
+bool ProcessWatcher::start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_bRunning.load()) {
+        return true;
+    }
+#ifdef _MSC_VER
+    m_wakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    if (m_wakeEvent == nullptr) {
+        return false;
+    }
+#elif defined(__APPLE__)
+    m_kqueue = kqueue();
+    if (m_kqueue < 0) {
+        LOG_ERROR("kqueue failed with error %s", strerror(errno));
+        return false;
+    }
+    struct kevent kev;
+    EV_SET(&kev, 0, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+    kevent(m_kqueue, &kev, 1, nullptr, 0, nullptr);
+#else
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_epoll < 0 || m_wakeFd < 0) {
+        LOG_ERROR("epoll setup failed with error %s", strerror(errno));
+        if (m_epoll >= 0) close(m_epoll);
+        if (m_wakeFd >= 0) close(m_wakeFd);
+        m_epoll = m_wakeFd = -1;
+        return false;
+    }
+    struct epoll_event ev {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0; // pids are > 0
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeFd, &ev);
+#endif
+    m_bRunning.store(true);
+    if (!m_thread.run([this]() { loop(); })) {
+        m_bRunning.store(false);
+        return false;
+    }
+    return true;
+}
+
+void ProcessWatcher::stop()
+{
+    if (!m_bRunning.exchange(false)) {
+        return;
+    }
+    wakeup();
+    m_thread.join();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& entry : m_watches) {
+        releaseWatch(entry.second);
+    }
+    m_watches.clear();
+#ifdef _MSC_VER
+    CloseHandle(m_wakeEvent);
+    m_wakeEvent = nullptr;
+#elif defined(__APPLE__)
+    close(m_kqueue);
+    m_kqueue = -1;
+#else
+    close(m_epoll);
+    close(m_wakeFd);
+    m_epoll = m_wakeFd = -1;
+#endif
+}
+
+void ProcessWatcher::wakeup()
+{
+#ifdef _MSC_VER
+    SetEvent(m_wakeEvent);
+#elif defined(__APPLE__)
+    struct kevent kev;
+    EV_SET(&kev, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+    kevent(m_kqueue, &kev, 1, nullptr, 0, nullptr);
+#else
+    uint64_t one = 1;
+    ssize_t n = write(m_wakeFd, &one, sizeof(one));
+    UNUSED(n);
+#endif
+}
+
+// Called with m_mutex held
+bool ProcessWatcher::addWatch(int pid, Watch& watch)
+{
+#ifdef _MSC_VER
+    if (m_watches.size() >= MAXIMUM_WAIT_OBJECTS - 1) {
+        LOG_ERROR("Too many watched processes");
+        return false;
+    }
+    watch.handle = OpenProcess(SYNCHRONIZE | PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_TERMINATE, FALSE, (DWORD)pid);
+    if (watch.handle == nullptr) {
+        return false;
+    }
+    wakeup(); // rebuild the wait set
+    return true;
+#elif defined(__APPLE__)
+    struct kevent kev;
+    EV_SET(&kev, pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT | NOTE_EXITSTATUS, 0, nullptr);
+    if (kevent(m_kqueue, &kev, 1, nullptr, 0, nullptr) != 0) {
+        return false; // ESRCH: already gone
+    }
+    return true;
+#else
+    watch.fd = pidfd_open(pid);
+    if (watch.fd < 0) {
+        if (errno == ESRCH) {
+            return false;
+        }
+        // ENOSYS before Linux 5.3
+        if (kill(pid, 0) != 0 && errno == ESRCH) {
+            return false;
+        }
+        watch.polling = true;
+        wakeup(); // shorten the wait timeout
+        return true;
+    }
+    struct epoll_event ev {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = (uint64_t)pid;
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, watch.fd, &ev) != 0) {
+        close(watch.fd);
+        watch.fd = -1;
+        return false;
+    }
+    return true;
+#endif
+}
+
+// Called with m_mutex held
+void ProcessWatcher::releaseWatch(Watch& watch)
+{
+#ifdef _MSC_VER
+    if (watch.handle != nullptr) {
+        CloseHandle(watch.handle);
+        watch.handle = nullptr;
+    }
+#elif defined(__APPLE__)
+    UNUSED(watch); // EV_ONESHOT, or removed by unwatch
+#else
+    if (watch.fd >= 0) {
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, watch.fd, nullptr);
+        close(watch.fd);
+        watch.fd = -1;
+    }
+#endif
+}
+
+bool ProcessWatcher::watch(int pid, ExitCallback cb, void* user_data)
+{
+    if (pid <= 0 || !m_bRunning.load()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_watches.count(pid) > 0) {
+        return false;
+    }
+    Watch watch;
+    watch.cb = cb;
+    watch.user_data = user_data;
+    if (!addWatch(pid, watch)) {
+        return false;
+    }
+    m_watches.emplace(pid, watch);
+    return true;
+}
+
+void ProcessWatcher::unwatch(int pid)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_watches.find(pid);
+        if (it == m_watches.end()) {
+            return;
+        }
+#ifdef __APPLE__
+        struct kevent kev;
+        EV_SET(&kev, pid, EVFILT_PROC, EV_DELETE, 0, 0, nullptr);
+        kevent(m_kqueue, &kev, 1, nullptr, 0, nullptr);
+#endif
+        releaseWatch(it->second);
+        m_watches.erase(it);
+    }
+    // wait for a callback of this pid which may be running right now
+    std::lock_guard<std::recursive_mutex> dispatchLock(m_dispatchMutex);
+}
+
+bool ProcessWatcher::terminate(int pid, uint32_t graceMs, ExitCallback cb, void* user_data)
+{
+    if (pid <= 0 || !m_bRunning.load()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_watches.find(pid);
+    if (it == m_watches.end()) {
+        Watch watch;
+        if (!addWatch(pid, watch)) {
+            return false;
+        }
+        it = m_watches.emplace(pid, watch).first;
+    }
+    if (cb != nullptr) {
+        it->second.cb = cb;
+        it->second.user_data = user_data;
+    }
+#ifdef _MSC_VER
+    UNUSED(graceMs);
+    TerminateProcess(it->second.handle, 1);
+#else
+    it->second.hasDeadline = true;
+    it->second.deadline = Clock::now() + std::chrono::milliseconds(graceMs);
+    kill(pid, SIGTERM);
+    wakeup();
+#endif
+    return true;
+}
+
+struct ExitWaiter
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool exited = false;
+    ProcessExitEvent event;
+};
+
+static void on_waiter_exit(const ProcessExitEvent* event, void* user_data)
+{
+    ExitWaiter* waiter = static_cast<ExitWaiter*>(user_data);
+    std::lock_guard<std::mutex> lock(waiter->mutex);
+    waiter->event = *event;
+    waiter->exited = true;
+    waiter->cond.notify_all();
+}
+
+bool ProcessWatcher::waitExit(int pid, uint32_t timeout, ProcessExitEvent* event)
+{
+    if (!m_bRunning.load()) {
+        return false;
+    }
+    ExitWaiter waiter;
+    if (!watch(pid, on_waiter_exit, &waiter)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_watches.count(pid) > 0) {
+            return false; // watched by someone else, cannot hook in
+        }
+        if (event != nullptr) {
+            event->pid = pid;
+            event->exitTime = Clock::now();
+        }
+        return true; // not running
+    }
+    bool exited;
+    {
+        std::unique_lock<std::mutex> lock(waiter.mutex);
+        if (timeout == 0) {
+            waiter.cond.wait(lock, [&waiter]() { return waiter.exited; });
+        }
+        else {
+            waiter.cond.wait_for(lock, std::chrono::milliseconds(timeout), [&waiter]() { return waiter.exited; });
+        }
+        exited = waiter.exited;
+    }
+    unwatch(pid);
+    if (exited && event != nullptr) {
+        *event = waiter.event;
+    }
+    return exited;
+}
+
+// Kill every match of one scan and wait for the exits before rescanning for processes started meanwhile
+template<typename FindFunc>
+static void kill_matches_completely(ProcessWatcher& watcher, FindFunc&& find)
+{
+    ProcessTable table;
+    while (table.refresh()) {
+        std::vector<int> pids;
+        for (const ProcessInfo* info : find(table)) {
+            pids.push_back(info->pid);
+        }
+        if (pids.empty() || table.killByPid(pids) == 0) {
+            break;
+        }
+        for (int pid : pids) {
+            watcher.waitExit(pid, 1000);
+        }
+    }
+}
+
+void ProcessWatcher::killAllByPath(const std::string& path)
+{
+    kill_matches_completely(*this, [&path](const ProcessTable& table) { return table.findByPath(path); });
+}
+
+void ProcessWatcher::killAllByName(const std::string& name)
+{
+    kill_matches_completely(*this, [&name](const ProcessTable& table) { return table.findByName(name); });
+}
+
+int ProcessWatcher::nextTimeout()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int timeout = -1;
+    auto now = Clock::now();
+    for (const auto& entry : m_watches) {
+        const Watch& w = entry.second;
+        if (w.polling) {
+            timeout = timeout < 0 ? POLL_FALLBACK_INTERVAL : std::min(timeout, POLL_FALLBACK_INTERVAL);
+        }
+        if (w.hasDeadline) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(w.deadline - now).count();
+            // round up so the deadline has passed when we wake up
+            int ms = left <= 0 ? 0 : (int)left + 1;
+            timeout = timeout < 0 ? ms : std::min(timeout, ms);
+        }
+    }
+    return timeout;
+}
+
+void ProcessWatcher::checkDeadlines()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto now = Clock::now();
+    for (auto& [pid, w] : m_watches) {
+        if (w.hasDeadline && w.deadline <= now) {
+            w.hasDeadline = false;
+#ifndef _MSC_VER
+            if (kill(pid, SIGKILL) == 0) {
+                w.forceKilled = true;
+                LOG_INFO("process %d did not exit in time, killed", pid);
+            }
+#endif
+        }
+    }
+}
+
+void ProcessWatcher::waitEvents(int timeout, std::vector<std::pair<int, int>>& exited)
+{
+#ifdef _MSC_VER
+    std::vector<HANDLE> handles{ m_wakeEvent };
+    std::vector<int> pids{ 0 };
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& entry : m_watches) {
+            handles.push_back(entry.second.handle);
+            pids.push_back(entry.first);
+        }
+    }
+    DWORD res = WaitForMultipleObjects((DWORD)handles.size(), handles.data(), FALSE, timeout < 0 ? INFINITE : (DWORD)timeout);
+    if (res > WAIT_OBJECT_0 && res < WAIT_OBJECT_0 + handles.size()) {
+        size_t index = res - WAIT_OBJECT_0;
+        DWORD code = 0;
+        int exitCode = GetExitCodeProcess(handles[index], &code) ? (int)code : -1;
+        exited.emplace_back(pids[index], exitCode);
+    }
+#elif defined(__APPLE__)
+    struct kevent events[32];
+    struct timespec ts;
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000L;
+    int n = kevent(m_kqueue, nullptr, 0, events, 32, timeout < 0 ? nullptr : &ts);
+    for (int i = 0; i < n; ++i) {
+        if (events[i].filter != EVFILT_PROC) continue;
+        int status = (int)events[i].data;
+        int exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : (WIFSIGNALED(status) ? 128 + WTERMSIG(status) : -1);
+        exited.emplace_back((int)events[i].ident, exitCode);
+    }
+#else
+    struct epoll_event events[32];
+    int n = epoll_wait(m_epoll, events, 32, timeout);
+    for (int i = 0; i < n; ++i) {
+        int pid = (int)events[i].data.u64;
+        if (pid == 0) {
+            uint64_t value;
+            ssize_t r = read(m_wakeFd, &value, sizeof(value));
+            UNUSED(r);
+            continue;
+        }
+        exited.emplace_back(pid, peek_child_exit_code(pid));
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& entry : m_watches) {
+        if (entry.second.polling && kill(entry.first, 0) != 0 && errno == ESRCH) {
+            exited.emplace_back(entry.first, -1);
+        }
+    }
+#endif
+}
+
+void ProcessWatcher::dispatchExit(int pid, int exitCode)
+{
+    std::lock_guard<std::recursive_mutex> dispatchLock(m_dispatchMutex);
+    ProcessExitEvent event;
+    event.pid = pid;
+    event.exitCode = exitCode;
+    event.exitTime = Clock::now();
+    ExitCallback cb = nullptr;
+    void* user_data = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_watches.find(pid);
+        if (it == m_watches.end()) {
+            return; // unwatched meanwhile
+        }
+        cb = it->second.cb;
+        user_data = it->second.user_data;
+        event.forceKilled = it->second.forceKilled;
+        releaseWatch(it->second);
+        m_watches.erase(it);
+    }
+    if (cb != nullptr) {
+        cb(&event, user_data);
+    }
+}
+
+void ProcessWatcher::loop()
+{
+    std::vector<std::pair<int, int>> exited;
+    while (m_bRunning.load()) {
+        exited.clear();
+        waitEvents(nextTimeout(), exited);
+        for (const auto& [pid, exitCode] : exited) {
+            dispatchExit(pid, exitCode);
+        }
+        checkDeadlines();
+    }
+}
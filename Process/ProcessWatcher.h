@@ -0,0 +1,127 @@
+/**
+ *   Event driven process exit watching
+ *
+ *   Linux: pidfd_open + epoll (polls kill(pid, 0) on kernels without pidfd)
+ *   MacOS: kqueue EVFILT_PROC
+ *   Windows: WaitForMultipleObjects on process handles
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <unordered_map>
+#include <string>
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include "CThread.hpp"
+
+#ifdef _MSC_VER
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#endif
+
+struct ProcessExitEvent
+{
+    int pid = 0;
+    int exitCode = -1;      // 128 + signal if killed by a signal, -1 if unknown (not our child)
+    bool forceKilled = false;  // terminate() had to escalate to SIGKILL
+    std::chrono::steady_clock::time_point exitTime;
+};
+
+class ProcessWatcher
+{
+public:
+    using ExitCallback = void(*)(const ProcessExitEvent*, void*);
+
+    ProcessWatcher();
+    ~ProcessWatcher();
+
+    /** process wide watcher, started on first use */
+    static ProcessWatcher& shared();
+
+    bool start();
+    void stop();
+
+    /**
+     * @brief  Call cb on the watcher thread when pid exits, one watch per pid
+     * @return false if the process does not exist or is already watched
+     */
+    bool watch(int pid, ExitCallback cb, void* user_data);
+
+    /**
+     * @brief After unwatch returns the callback of pid is neither running nor called again
+     */
+    void unwatch(int pid);
+
+    /**
+     * @brief          Ask pid to terminate (SIGTERM) and SIGKILL it if it is still alive after graceMs.
+     *                 On Windows the process is terminated immediately.
+     * @param cb       exit callback, may be null if pid is already watched
+     * @return         false if the process does not exist
+     */
+    bool terminate(int pid, uint32_t graceMs, ExitCallback cb = nullptr, void* user_data = nullptr);
+
+    /**
+     * @brief          Block until pid exits without polling
+     * @param timeout  milliseconds, 0 means wait forever
+     * @return         false on timeout, true also if the process did not exist
+     */
+    bool waitExit(int pid, uint32_t timeout = 0, ProcessExitEvent* event = nullptr);
+
+    /**
+     * @brief Kill every process running path / named name and wait for the exits,
+     *        rescanning until nothing matches to catch processes started meanwhile
+     */
+    void killAllByPath(const std::string& path);
+    void killAllByName(const std::string& name);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Watch
+    {
+        ExitCallback cb = nullptr;
+        void* user_data = nullptr;
+        bool hasDeadline = false;
+        bool forceKilled = false;
+        bool polling = false;     // no pidfd available
+        Clock::time_point deadline;
+#ifdef _MSC_VER
+        HANDLE handle = nullptr;
+#else
+        int fd = -1;
+#endif
+    };
+
+    void loop();
+    void wakeup();
+    int nextTimeout();
+    void checkDeadlines();
+    void waitEvents(int timeout, std::vector<std::pair<int, int>>& exited);
+    bool addWatch(int pid, Watch& watch);
+    void releaseWatch(Watch& watch);
+    void dispatchExit(int pid, int exitCode);
+
+private:
+    std::mutex m_mutex;
+    std::recursive_mutex m_dispatchMutex;  // held while callbacks run
+    std::unordered_map<int, Watch> m_watches;
+    std::atomic_bool m_bRunning = false;
+    CThread<void> m_thread;
+
+#ifdef _MSC_VER
+    HANDLE m_wakeEvent = nullptr;
+#elif defined(__APPLE__)
+    int m_kqueue = -1;
+#else
+    int m_epoll = -1;
+    int m_wakeFd = -1;
+#endif
+};
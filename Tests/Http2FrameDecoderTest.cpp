@@ -0,0 +1,337 @@
+/**
+ *   Tests of Http2FrameDecoder: every frame type, input split at every size,
+ *   and the malformed frames RFC 9113 makes a connection error.
+ *
+ *   On Linux, from the repository root:
+ *
+ *      g++ -std=c++20 -I. Tests/Http2FrameDecoderTest.cpp Http2FrameDecoder.cpp Http2Frame.cpp \
+ *          Http2Hpack.cpp Http2BufferPool.cpp Http2FrameArena.cpp PlatformCommonUtils.cpp PlatformClock.cpp \
+ *          -o Http2FrameDecoderTest -lpthread
+ *      ./Http2FrameDecoderTest
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#include "Http2FrameDecoder.h"
+#include "TestCheck.h"
+#include <string.h>
+#include <algorithm>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+using Bytes = std::vector<uint8_t>;
+
+static Bytes make_frame(uint8_t type, uint8_t flags, uint32_t streamId, const Bytes& payload)
+{
+    Bytes frame = {
+        (uint8_t)(payload.size() >> 16), (uint8_t)(payload.size() >> 8), (uint8_t)payload.size(),
+        type, flags,
+        (uint8_t)(streamId >> 24), (uint8_t)(streamId >> 16), (uint8_t)(streamId >> 8), (uint8_t)streamId
+    };
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    return frame;
+}
+
+static Bytes make_frame(Http2FrameType type, uint8_t flags, uint32_t streamId, const Bytes& payload)
+{
+    return make_frame((uint8_t)type, flags, streamId, payload);
+}
+
+static Bytes u32(uint32_t value)
+{
+    return { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+}
+
+static Bytes concat(std::initializer_list<Bytes> parts)
+{
+    Bytes out;
+    for (const Bytes& part : parts) {
+        out.insert(out.end(), part.begin(), part.end());
+    }
+    return out;
+}
+
+static Bytes text(const char* value)
+{
+    return Bytes(value, value + strlen(value));
+}
+
+static bool same(std::span<const uint8_t> actual, const Bytes& expected)
+{
+    return actual.size() == expected.size() && std::equal(actual.begin(), actual.end(), expected.begin());
+}
+
+/** a decoded frame with its views copied out, they only live until the next call */
+struct DecodedFrame
+{
+    Http2FrameView view;
+    Bytes payload;
+    Bytes data;
+};
+
+/**
+ * @brief  Feed input in chunks of chunk bytes, each chunk from its own buffer so nothing
+ *         outlives the chunk it came from, and collect every frame
+ * @return the status the decoder ended with
+ */
+static Http2FrameDecoder::Status decode_all(Http2FrameDecoder& decoder, const Bytes& input, size_t chunk,
+    std::vector<DecodedFrame>& frames)
+{
+    Http2FrameDecoder::Status status = Http2FrameDecoder::NeedMore;
+    for (size_t offset = 0; offset < input.size(); offset += chunk) {
+        Bytes piece(input.begin() + offset, input.begin() + std::min(input.size(), offset + chunk));
+        decoder.feed(piece.data(), piece.size());
+        Http2FrameView view;
+        while ((status = decoder.next(view)) == Http2FrameDecoder::Frame) {
+            DecodedFrame frame;
+            frame.view = view;
+            frame.payload.assign(view.payload.begin(), view.payload.end());
+            frame.data.assign(view.data.begin(), view.data.end());
+            frame.view.payload = {};
+            frame.view.data = {};
+            frames.push_back(std::move(frame));
+        }
+        if (status == Http2FrameDecoder::Error) {
+            return status;
+        }
+    }
+    return status;
+}
+
+static void test_every_type_at_every_split()
+{
+    Bytes body(40000);
+    for (size_t i = 0; i < body.size(); ++i) {
+        body[i] = (uint8_t)(i * 31 + 7);
+    }
+    Bytes settings = concat({ { 0x00, 0x01 }, u32(8192), { 0x00, 0x04 }, u32(1 << 20), { 0x00, 0x05 }, u32(32768) });
+
+    Bytes input = concat({
+        make_frame(Http2FrameType::Settings, 0, 0, settings),
+        make_frame(Http2FrameType::Settings, Http2FrameView::FLAG_ACK, 0, {}),
+        make_frame(Http2FrameType::Data, Http2FrameView::FLAG_END_STREAM, 1, text("hello")),
+        // padded DATA: pad length 3, "abc", 3 bytes padding
+        make_frame(Http2FrameType::Data, Http2FrameView::FLAG_PADDED, 3, concat({ { 3 }, text("abc"), { 0, 0, 0 } })),
+        // HEADERS with padding and priority, continued by a CONTINUATION
+        make_frame(Http2FrameType::Headers, Http2FrameView::FLAG_PADDED | Http2FrameView::FLAG_PRIORITY, 5,
+            concat({ { 2 }, u32(0x80000003), { 15 }, text("hd"), { 0, 0 } })),
+        make_frame(Http2FrameType::Continuation, Http2FrameView::FLAG_END_HEADERS, 5, text("tail")),
+        make_frame(Http2FrameType::Priority, 0, 7, concat({ u32(1), { 200 } })),
+        make_frame(Http2FrameType::RstStream, 0, 7, u32(0x8)),
+        make_frame(Http2FrameType::PushPromise, Http2FrameView::FLAG_END_HEADERS, 1, concat({ u32(2), text("pp") })),
+        make_frame(Http2FrameType::Ping, 0, 0, text("12345678")),
+        make_frame(Http2FrameType::GoAway, 0, 0, concat({ u32(9), u32(0x2), text("bye") })),
+        make_frame(Http2FrameType::WindowUpdate, 0, 0, u32(0x80010000)),
+        make_frame(Http2FrameType::PriorityUpdate, 0, 0, concat({ u32(11), text("u=1, i") })),
+        make_frame(0xEE, 0x0F, 13, text("unknown")),
+        // a DATA frame larger than any chunk below it, gathered across many of them
+        make_frame(Http2FrameType::Data, 0, 15, body),
+    });
+
+    const size_t chunks[] = { 1, 2, 3, 5, 8, 9, 10, 17, 64, 1000, 4096, 16393, input.size() };
+    for (size_t chunk : chunks) {
+        Http2FrameDecoder decoder(65536);
+        std::vector<DecodedFrame> frames;
+        CHECK(decode_all(decoder, input, chunk, frames) == Http2FrameDecoder::NeedMore);
+        CHECK_EQ(decoder.buffered(), 0u);
+        CHECK_EQ(frames.size(), 15u);
+        if (frames.size() != 15) {
+            fprintf(stderr, "  with chunks of %zu bytes\n", chunk);
+            continue;
+        }
+
+        const DecodedFrame& settingsFrame = frames[0];
+        CHECK(settingsFrame.view.is(Http2FrameType::Settings));
+        CHECK(same(settingsFrame.payload, settings));
+
+        CHECK(frames[1].view.is(Http2FrameType::Settings) && frames[1].view.hasFlag(Http2FrameView::FLAG_ACK));
+        CHECK_EQ(frames[1].view.length, 0u);
+
+        CHECK(frames[2].view.is(Http2FrameType::Data) && frames[2].view.hasFlag(Http2FrameView::FLAG_END_STREAM));
+        CHECK_EQ(frames[2].view.streamId, 1u);
+        CHECK(same(frames[2].data, text("hello")));
+
+        CHECK_EQ(frames[3].view.padLength, 3);
+        CHECK(same(frames[3].data, text("abc")));
+
+        const Http2FrameView& headers = frames[4].view;
+        CHECK(headers.is(Http2FrameType::Headers) && headers.hasPriority);
+        CHECK(headers.exclusive);
+        CHECK_EQ(headers.dependsOn, 3u);
+        CHECK_EQ(headers.weight, 15);
+        CHECK(same(frames[4].data, text("hd")));
+        CHECK(frames[5].view.is(Http2FrameType::Continuation));
+        CHECK(same(frames[5].data, text("tail")));
+
+        CHECK(frames[6].view.is(Http2FrameType::Priority) && !frames[6].view.exclusive);
+        CHECK_EQ(frames[6].view.dependsOn, 1u);
+        CHECK_EQ(frames[6].view.weight, 200);
+
+        CHECK_EQ(frames[7].view.errorCode, 0x8u);
+
+        CHECK_EQ(frames[8].view.promisedStreamId, 2u);
+        CHECK(same(frames[8].data, text("pp")));
+
+        CHECK(same(frames[9].data, text("12345678")));
+
+        CHECK_EQ(frames[10].view.lastStreamId, 9u);
+        CHECK_EQ(frames[10].view.errorCode, 0x2u);
+        CHECK(same(frames[10].data, text("bye")));
+
+        // the reserved bit is not part of the increment
+        CHECK_EQ(frames[11].view.windowIncrement, 0x10000u);
+
+        CHECK_EQ(frames[12].view.prioritizedStreamId, 11u);
+        CHECK(same(frames[12].data, text("u=1, i")));
+
+        CHECK_EQ(frames[13].view.type, 0xEE);
+        CHECK(same(frames[13].data, text("unknown")));
+
+        CHECK_EQ(frames[14].view.streamId, 15u);
+        CHECK(same(frames[14].data, body));
+    }
+}
+
+static void test_settings_entries()
+{
+    Bytes input = make_frame(Http2FrameType::Settings, 0, 0,
+        concat({ { 0x00, 0x03 }, u32(100), { 0x00, 0x04 }, u32(65535), { 0xAB, 0xCD }, u32(7) }));
+    Http2FrameDecoder decoder;
+    decoder.feed(input.data(), input.size());
+    Http2FrameView frame;
+    CHECK(decoder.next(frame) == Http2FrameDecoder::Frame);
+    CHECK_EQ(frame.settingsCount(), 3u);
+    CHECK_EQ(frame.settingId(0), 0x03);
+    CHECK_EQ(frame.settingValue(0), 100u);
+    CHECK_EQ(frame.settingId(1), 0x04);
+    CHECK_EQ(frame.settingValue(1), 65535u);
+    // unknown settings are passed on, the receiver ignores them
+    CHECK_EQ(frame.settingId(2), 0xABCD);
+    CHECK_EQ(frame.settingValue(2), 7u);
+    CHECK(decoder.next(frame) == Http2FrameDecoder::NeedMore);
+}
+
+static void test_max_frame_size()
+{
+    Http2FrameDecoder decoder;
+    CHECK(!decoder.setMaxFrameSize(16383));
+    CHECK(!decoder.setMaxFrameSize(16777216));
+    CHECK(decoder.setMaxFrameSize(16384));
+
+    // exactly the limit is fine, one more byte is not
+    std::vector<DecodedFrame> frames;
+    CHECK(decode_all(decoder, make_frame(Http2FrameType::Data, 0, 1, Bytes(16384)), 4096, frames) == Http2FrameDecoder::NeedMore);
+    CHECK_EQ(frames.size(), 1u);
+    CHECK(decode_all(decoder, make_frame(Http2FrameType::Data, 0, 1, Bytes(16385)), 4096, frames) == Http2FrameDecoder::Error);
+    CHECK(decoder.error() == Http2ErrorCode::FrameSizeError);
+    CHECK_EQ(frames.size(), 1u);
+}
+
+struct MalformedCase
+{
+    const char* name;
+    Bytes input;
+    Http2ErrorCode error;
+};
+
+static void test_malformed_frames()
+{
+    const MalformedCase cases[] = {
+        { "DATA on stream 0", make_frame(Http2FrameType::Data, 0, 0, text("x")), Http2ErrorCode::ProtocolError },
+        { "HEADERS on stream 0", make_frame(Http2FrameType::Headers, Http2FrameView::FLAG_END_HEADERS, 0, text("x")), Http2ErrorCode::ProtocolError },
+        { "RST_STREAM on stream 0", make_frame(Http2FrameType::RstStream, 0, 0, u32(0)), Http2ErrorCode::ProtocolError },
+        { "SETTINGS on a stream", make_frame(Http2FrameType::Settings, 0, 1, {}), Http2ErrorCode::ProtocolError },
+        { "PING on a stream", make_frame(Http2FrameType::Ping, 0, 1, Bytes(8)), Http2ErrorCode::ProtocolError },
+        { "GOAWAY on a stream", make_frame(Http2FrameType::GoAway, 0, 1, Bytes(8)), Http2ErrorCode::ProtocolError },
+        { "SETTINGS length not a multiple of 6", make_frame(Http2FrameType::Settings, 0, 0, Bytes(5)), Http2ErrorCode::FrameSizeError },
+        { "SETTINGS ACK with a payload", make_frame(Http2FrameType::Settings, Http2FrameView::FLAG_ACK, 0, Bytes(6)), Http2ErrorCode::FrameSizeError },
+        { "PING of 7 bytes", make_frame(Http2FrameType::Ping, 0, 0, Bytes(7)), Http2ErrorCode::FrameSizeError },
+        { "PRIORITY of 4 bytes", make_frame(Http2FrameType::Priority, 0, 1, Bytes(4)), Http2ErrorCode::FrameSizeError },
+        { "RST_STREAM of 5 bytes", make_frame(Http2FrameType::RstStream, 0, 1, Bytes(5)), Http2ErrorCode::FrameSizeError },
+        { "WINDOW_UPDATE of 3 bytes", make_frame(Http2FrameType::WindowUpdate, 0, 0, Bytes(3)), Http2ErrorCode::FrameSizeError },
+        { "GOAWAY of 7 bytes", make_frame(Http2FrameType::GoAway, 0, 0, Bytes(7)), Http2ErrorCode::FrameSizeError },
+        { "PRIORITY_UPDATE of 3 bytes", make_frame(Http2FrameType::PriorityUpdate, 0, 0, Bytes(3)), Http2ErrorCode::FrameSizeError },
+        { "PADDED DATA without a pad length", make_frame(Http2FrameType::Data, Http2FrameView::FLAG_PADDED, 1, {}), Http2ErrorCode::FrameSizeError },
+        { "padding longer than the payload", make_frame(Http2FrameType::Data, Http2FrameView::FLAG_PADDED, 1, { 4, 'a', 0, 0 }), Http2ErrorCode::ProtocolError },
+        { "HEADERS too short for its priority", make_frame(Http2FrameType::Headers, Http2FrameView::FLAG_PRIORITY | Http2FrameView::FLAG_END_HEADERS, 1, Bytes(4)), Http2ErrorCode::FrameSizeError },
+        { "PUSH_PROMISE without a promised stream", make_frame(Http2FrameType::PushPromise, Http2FrameView::FLAG_END_HEADERS, 1, Bytes(3)), Http2ErrorCode::FrameSizeError },
+        { "CONTINUATION without a header block", make_frame(Http2FrameType::Continuation, Http2FrameView::FLAG_END_HEADERS, 1, text("x")), Http2ErrorCode::ProtocolError },
+        { "header block interrupted by DATA", concat({
+            make_frame(Http2FrameType::Headers, 0, 1, text("x")),
+            make_frame(Http2FrameType::Data, 0, 1, text("y")) }), Http2ErrorCode::ProtocolError },
+        { "header block continued on another stream", concat({
+            make_frame(Http2FrameType::Headers, 0, 1, text("x")),
+            make_frame(Http2FrameType::Continuation, Http2FrameView::FLAG_END_HEADERS, 3, text("y")) }), Http2ErrorCode::ProtocolError },
+        { "header block interrupted by PING", concat({
+            make_frame(Http2FrameType::PushPromise, 0, 1, concat({ u32(2), text("x") })),
+            make_frame(Http2FrameType::Ping, 0, 0, Bytes(8)) }), Http2ErrorCode::ProtocolError },
+        { "frame above SETTINGS_MAX_FRAME_SIZE", make_frame(Http2FrameType::Data, 0, 1, Bytes(16385)), Http2ErrorCode::FrameSizeError },
+    };
+
+    for (const MalformedCase& test : cases) {
+        // whole, then a byte at a time so the head is checked on the gathering path too
+        for (size_t chunk : { test.input.size(), (size_t)1 }) {
+            Http2FrameDecoder decoder;
+            std::vector<DecodedFrame> frames;
+            Http2FrameDecoder::Status status = decode_all(decoder, test.input, chunk, frames);
+            if (status != Http2FrameDecoder::Error || decoder.error() != test.error) {
+                fprintf(stderr, "  case \"%s\", chunks of %zu bytes: status %d error %u\n", test.name, chunk, (int)status, (uint32_t)decoder.error());
+            }
+            CHECK(status == Http2FrameDecoder::Error);
+            CHECK(decoder.error() == test.error);
+            CHECK(strlen(decoder.errorMessage()) > 0);
+        }
+    }
+}
+
+static void test_error_is_sticky_until_reset()
+{
+    Http2FrameDecoder decoder;
+    Bytes bad = make_frame(Http2FrameType::Ping, 0, 0, Bytes(7));
+    Bytes good = make_frame(Http2FrameType::Ping, 0, 0, Bytes(8));
+
+    decoder.feed(bad.data(), bad.size());
+    Http2FrameView frame;
+    CHECK(decoder.next(frame) == Http2FrameDecoder::Error);
+    decoder.feed(good.data(), good.size());
+    CHECK(decoder.next(frame) == Http2FrameDecoder::Error);
+
+    decoder.reset();
+    CHECK(decoder.error() == Http2ErrorCode::NoError);
+    decoder.feed(good.data(), good.size());
+    CHECK(decoder.next(frame) == Http2FrameDecoder::Frame);
+    CHECK(frame.is(Http2FrameType::Ping));
+}
+
+static void test_partial_frame_is_held()
+{
+    Bytes input = make_frame(Http2FrameType::Data, 0, 1, text("split here"));
+    Http2FrameDecoder decoder;
+    Http2FrameView frame;
+
+    // a partial head, then the rest of the head and part of the payload
+    decoder.feed(input.data(), 4);
+    CHECK(decoder.next(frame) == Http2FrameDecoder::NeedMore);
+    CHECK_EQ(decoder.buffered(), 4u);
+    decoder.feed(input.data() + 4, 10);
+    CHECK(decoder.next(frame) == Http2FrameDecoder::NeedMore);
+    CHECK_EQ(decoder.buffered(), 14u);
+    decoder.feed(input.data() + 14, input.size() - 14);
+    CHECK(decoder.next(frame) == Http2FrameDecoder::Frame);
+    CHECK(same(frame.data, text("split here")));
+    CHECK_EQ(decoder.buffered(), 0u);
+    CHECK(decoder.next(frame) == Http2FrameDecoder::NeedMore);
+}
+
+int main()
+{
+    test_every_type_at_every_split();
+    test_settings_entries();
+    test_max_frame_size();
+    test_malformed_frames();
+    test_error_is_sticky_until_reset();
+    test_partial_frame_is_held();
+    return test_result();
+}
@@ -0,0 +1,367 @@
+/**
+ *   Tests of the HPACK codec against the examples of RFC 7541 Appendix C,
+ *   plus a Huffman round trip over every symbol and the invalid Huffman
+ *   strings of section 5.2.
+ *
+ *   On Linux, from the repository root:
+ *
+ *      g++ -std=c++20 -I. Tests/Http2HpackTest.cpp Http2Hpack.cpp Http2FrameDecoder.cpp Http2Frame.cpp \
+ *          Http2BufferPool.cpp Http2FrameArena.cpp PlatformCommonUtils.cpp PlatformClock.cpp -o Http2HpackTest -lpthread
+ *      ./Http2HpackTest
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#include "Http2Hpack.h"
+#include "TestCheck.h"
+#include <ctype.h>
+#include <string>
+#include <vector>
+
+using Bytes = std::vector<uint8_t>;
+
+/** bytes from hex as printed in the RFC, spaces ignored */
+static Bytes hex(const char* text)
+{
+    Bytes out;
+    int high = -1;
+    for (const char* p = text; *p != '\0'; ++p) {
+        if (!isxdigit((unsigned char)*p)) {
+            continue;
+        }
+        int digit = isdigit((unsigned char)*p) ? *p - '0' : tolower((unsigned char)*p) - 'a' + 10;
+        if (high < 0) {
+            high = digit;
+        }
+        else {
+            out.push_back((uint8_t)(high << 4 | digit));
+            high = -1;
+        }
+    }
+    return out;
+}
+
+static bool same_headers(const Http2HeaderList& actual, const Http2HeaderList& expected)
+{
+    if (actual.size() != expected.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < actual.size(); ++i) {
+        if (actual[i].name != expected[i].name || actual[i].value != expected[i].value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** one header block of an Appendix C sequence and the dynamic table size after it */
+struct BlockVector
+{
+    const char* wire;
+    Http2HeaderList headers;
+    size_t tableSize;
+};
+
+/**
+ * @brief  Decode a sequence of blocks through one decoder and encode it through one encoder,
+ *         which indexing every field makes the same choices as the examples
+ */
+static void check_sequence(const char* name, const std::vector<BlockVector>& blocks, uint32_t tableSize,
+    HpackHuffman huffman)
+{
+    HpackDecoder decoder(tableSize);
+    HpackEncoder encoder(tableSize);
+    encoder.setIndexing(HpackIndexing::Always);
+    encoder.setHuffman(huffman);
+
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        const BlockVector& block = blocks[i];
+        Bytes wire = hex(block.wire);
+
+        Http2HeaderList headers;
+        bool decoded = decoder.decode(wire.data(), wire.size(), headers);
+        if (!decoded || !same_headers(headers, block.headers) || decoder.table().size() != block.tableSize) {
+            fprintf(stderr, "  %s, block %zu: decode\n", name, i + 1);
+        }
+        CHECK(decoded);
+        CHECK(same_headers(headers, block.headers));
+        CHECK_EQ(decoder.table().size(), block.tableSize);
+
+        Bytes out;
+        encoder.encode(block.headers, out);
+        if (out != wire || encoder.table().size() != block.tableSize) {
+            fprintf(stderr, "  %s, block %zu: encode\n", name, i + 1);
+        }
+        CHECK(out == wire);
+        CHECK_EQ(encoder.table().size(), block.tableSize);
+    }
+}
+
+/** C.1 */
+static void test_integers()
+{
+    Bytes out;
+    Hpack::encode_integer(out, 10, 5, 0);
+    CHECK(out == hex("0a"));
+    out.clear();
+    Hpack::encode_integer(out, 1337, 5, 0);
+    CHECK(out == hex("1f 9a 0a"));
+    out.clear();
+    Hpack::encode_integer(out, 42, 8, 0);
+    CHECK(out == hex("2a"));
+
+    // the bits above the prefix belong to the caller, in both directions
+    out.clear();
+    Hpack::encode_integer(out, 1337, 5, 0xE0);
+    CHECK(out == hex("ff 9a 0a"));
+    const uint8_t* data = out.data();
+    uint64_t value = 0;
+    CHECK(Hpack::decode_integer(data, out.data() + out.size(), 5, value));
+    CHECK_EQ(value, 1337u);
+    CHECK(data == out.data() + out.size());
+
+    // truncated, and longer than any value we accept
+    Bytes truncated = hex("1f 9a");
+    data = truncated.data();
+    CHECK(!Hpack::decode_integer(data, truncated.data() + truncated.size(), 5, value));
+    Bytes overflow = hex("1f ff ff ff ff ff ff ff ff ff ff ff 01");
+    data = overflow.data();
+    CHECK(!Hpack::decode_integer(data, overflow.data() + overflow.size(), 5, value));
+
+    // zero continuation bytes past the fifth, which once shifted out of range and decoded 127
+    Bytes overlong = hex("7f 80 80 80 80 80 80 80 80 80 02");
+    data = overlong.data();
+    CHECK(!Hpack::decode_integer(data, overlong.data() + overlong.size(), 7, value));
+    Bytes longer = hex("7f 80 80 80 80 80 80 80 80 80 80 02");
+    data = longer.data();
+    CHECK(!Hpack::decode_integer(data, longer.data() + longer.size(), 7, value));
+    Bytes sixBytes = hex("7f 80 80 80 80 80 00");
+    data = sixBytes.data();
+    CHECK(!Hpack::decode_integer(data, sixBytes.data() + sixBytes.size(), 7, value));
+
+    for (uint64_t v : { 0ull, 30ull, 31ull, 32ull, 127ull, 128ull, 16383ull, 16384ull, 0xFFFFFFFFull }) {
+        for (uint8_t prefix = 1; prefix <= 8; ++prefix) {
+            Bytes encoded;
+            Hpack::encode_integer(encoded, v, prefix, 0);
+            data = encoded.data();
+            CHECK(Hpack::decode_integer(data, encoded.data() + encoded.size(), prefix, value));
+            CHECK_EQ(value, v);
+            CHECK(data == encoded.data() + encoded.size());
+        }
+    }
+}
+
+/** C.2: one field each, through a fresh decoder */
+static void test_field_representations()
+{
+    struct FieldVector
+    {
+        const char* wire;
+        Http2Header header;
+        size_t tableSize;
+        HpackIndexing indexing;
+    };
+    const FieldVector fields[] = {
+        // C.2.1 literal with incremental indexing
+        { "400a 6375 7374 6f6d 2d6b 6579 0d63 7573 746f 6d2d 6865 6164 6572",
+            { "custom-key", "custom-header" }, 55, HpackIndexing::Always },
+        // C.2.2 literal without indexing
+        { "040c 2f73 616d 706c 652f 7061 7468", { ":path", "/sample/path" }, 0, HpackIndexing::Never },
+        // C.2.3 literal never indexed
+        { "1008 7061 7373 776f 7264 0673 6563 7265 74", { "password", "secret", true }, 0, HpackIndexing::Always },
+        // C.2.4 indexed
+        { "82", { ":method", "GET" }, 0, HpackIndexing::Always },
+    };
+
+    for (const FieldVector& field : fields) {
+        Bytes wire = hex(field.wire);
+        HpackDecoder decoder;
+        Http2HeaderList headers;
+        CHECK(decoder.decode(wire.data(), wire.size(), headers));
+        CHECK(same_headers(headers, { field.header }));
+        CHECK(headers.size() == 1 && headers[0].sensitive == field.header.sensitive);
+        CHECK_EQ(decoder.table().size(), field.tableSize);
+
+        HpackEncoder encoder;
+        encoder.setIndexing(field.indexing);
+        encoder.setHuffman(HpackHuffman::Never);
+        Bytes out;
+        encoder.encode({ field.header }, out);
+        CHECK(out == wire);
+        CHECK_EQ(encoder.table().size(), field.tableSize);
+    }
+}
+
+static std::vector<BlockVector> request_blocks(const char* first, const char* second, const char* third)
+{
+    return {
+        { first, { { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" } }, 57 },
+        { second, { { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" },
+            { "cache-control", "no-cache" } }, 110 },
+        { third, { { ":method", "GET" }, { ":scheme", "https" }, { ":path", "/index.html" }, { ":authority", "www.example.com" },
+            { "custom-key", "custom-value" } }, 164 },
+    };
+}
+
+static std::vector<BlockVector> response_blocks(const char* first, const char* second, const char* third)
+{
+    return {
+        { first, { { ":status", "302" }, { "cache-control", "private" }, { "date", "Mon, 21 Oct 2013 20:13:21 GMT" },
+            { "location", "https://www.example.com" } }, 222 },
+        { second, { { ":status", "307" }, { "cache-control", "private" }, { "date", "Mon, 21 Oct 2013 20:13:21 GMT" },
+            { "location", "https://www.example.com" } }, 222 },
+        { third, { { ":status", "200" }, { "cache-control", "private" }, { "date", "Mon, 21 Oct 2013 20:13:22 GMT" },
+            { "location", "https://www.example.com" }, { "content-encoding", "gzip" },
+            { "set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1" } }, 215 },
+    };
+}
+
+/** C.3 to C.6 */
+static void test_header_block_sequences()
+{
+    check_sequence("C.3 requests without Huffman", request_blocks(
+        "8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d",
+        "8286 84be 5808 6e6f 2d63 6163 6865",
+        "8287 85bf 400a 6375 7374 6f6d 2d6b 6579 0c63 7573 746f 6d2d 7661 6c75 65"),
+        HPACK_DEFAULT_TABLE_SIZE, HpackHuffman::Never);
+
+    check_sequence("C.4 requests with Huffman", request_blocks(
+        "8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff",
+        "8286 84be 5886 a8eb 1064 9cbf",
+        "8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf"),
+        HPACK_DEFAULT_TABLE_SIZE, HpackHuffman::Always);
+
+    check_sequence("C.5 responses without Huffman", response_blocks(
+        "4803 3330 3258 0770 7269 7661 7465 611d 4d6f 6e2c 2032 3120 4f63 7420 3230 3133 2032 303a 3133 3a32 3120 474d"
+        "546e 1768 7474 7073 3a2f 2f77 7777 2e65 7861 6d70 6c65 2e63 6f6d",
+        "4803 3330 37c1 c0bf",
+        "88c1 611d 4d6f 6e2c 2032 3120 4f63 7420 3230 3133 2032 303a 3133 3a32 3220 474d 54c0 5a04 677a 6970 7738 666f"
+        "6f3d 4153 444a 4b48 514b 425a 584f 5157 454f 5049 5541 5851 5745 4f49 553b 206d 6178 2d61 6765 3d33 3630 303b"
+        "2076 6572 7369 6f6e 3d31"),
+        256, HpackHuffman::Never);
+
+    check_sequence("C.6 responses with Huffman", response_blocks(
+        "4882 6402 5885 aec3 771a 4b61 96d0 7abe 9410 54d4 44a8 2005 9504 0b81 66e0 82a6 2d1b ff6e 919d 29ad 1718 63c7"
+        "8f0b 97c8 e9ae 82ae 43d3",
+        "4883 640e ffc1 c0bf",
+        "88c1 6196 d07a be94 1054 d444 a820 0595 040b 8166 e084 a62d 1bff c05a 839b d9ab 77ad 94e7 821d d7f2 e6c7 b335"
+        "dfdf cd5b 3960 d5af 2708 7f36 72c1 ab27 0fb5 291f 9587 3160 65c0 03ed 4ee5 b106 3d50 07"),
+        256, HpackHuffman::Always);
+}
+
+static void test_table_size_updates()
+{
+    // a shrink and a grow between two blocks are both announced, smallest first
+    HpackEncoder encoder;
+    encoder.setMaxTableSize(0);
+    encoder.setMaxTableSize(4096);
+    Bytes out;
+    encoder.encode({ { ":method", "GET" } }, out);
+    CHECK(out == hex("20 3fe1 1f 82"));
+
+    HpackDecoder decoder;
+    Http2HeaderList headers;
+    CHECK(decoder.decode(out.data(), out.size(), headers));
+    CHECK(same_headers(headers, { { ":method", "GET" } }));
+
+    // larger than the SETTINGS_HEADER_TABLE_SIZE we sent, and after the first field
+    Bytes tooLarge = hex("3fe2 1f 82");
+    CHECK(!decoder.decode(tooLarge.data(), tooLarge.size(), headers));
+    HpackDecoder late;
+    Bytes afterField = hex("82 20");
+    CHECK(!late.decode(afterField.data(), afterField.size(), headers));
+}
+
+static void test_invalid_blocks()
+{
+    const char* blocks[] = {
+        "80",           // index 0
+        "be",           // index 62 with an empty dynamic table
+        "ff ff ff ff 0f",   // index far past the tables
+        "40 0a 6375 7374",  // string shorter than its length
+        "41 81 1c",     // Huffman value with bad padding
+    };
+    for (const char* block : blocks) {
+        Bytes wire = hex(block);
+        HpackDecoder decoder;
+        Http2HeaderList headers;
+        if (decoder.decode(wire.data(), wire.size(), headers)) {
+            fprintf(stderr, "  block %s decoded\n", block);
+            CHECK(!"invalid block decoded");
+        }
+    }
+}
+
+static void test_huffman_round_trip()
+{
+    std::string all;
+    for (int symbol = 0; symbol < 256; ++symbol) {
+        std::string value(1, (char)symbol);
+        Bytes encoded;
+        Hpack::huffman_encode(value, encoded);
+        CHECK_EQ(encoded.size(), Hpack::huffman_encoded_size(value));
+        std::string decoded;
+        if (!Hpack::huffman_decode(encoded.data(), encoded.size(), decoded) || decoded != value) {
+            fprintf(stderr, "  symbol %d\n", symbol);
+            CHECK(!"symbol did not round trip");
+        }
+        all += value;
+    }
+
+    // every symbol together, forwards and backwards, so codes straddle bytes at every offset
+    for (int pass = 0; pass < 2; ++pass) {
+        Bytes encoded;
+        Hpack::huffman_encode(all, encoded);
+        CHECK_EQ(encoded.size(), Hpack::huffman_encoded_size(all));
+        std::string decoded;
+        CHECK(Hpack::huffman_decode(encoded.data(), encoded.size(), decoded));
+        CHECK(decoded == all);
+        all.assign(all.rbegin(), all.rend());
+    }
+
+    std::string empty;
+    CHECK(Hpack::huffman_decode(nullptr, 0, empty));
+    CHECK(empty.empty());
+}
+
+/** RFC 7541 5.2: padding is the most significant bits of EOS, at most 7 of them */
+static void test_huffman_invalid()
+{
+    struct HuffmanVector
+    {
+        const char* wire;
+        bool valid;
+        const char* value;
+    };
+    const HuffmanVector vectors[] = {
+        { "1f", true, "a" },           // 'a' is 00011, then 111
+        { "18", false, nullptr },      // 'a', then padding of zeros
+        { "1c", false, nullptr },      // 'a', then 100
+        { "ff", false, nullptr },      // 8 bits of padding
+        { "1f ff", false, nullptr },   // 'a', then 11 bits of padding
+        { "ff ff ff ff", false, nullptr },  // EOS is not allowed in a string
+        { "f1 e3 c2 e5 f2 3a 6b a0 ab 90 f4 ff", true, "www.example.com" },
+    };
+    for (const HuffmanVector& vector : vectors) {
+        Bytes wire = hex(vector.wire);
+        std::string decoded;
+        bool ok = Hpack::huffman_decode(wire.data(), wire.size(), decoded);
+        if (ok != vector.valid || (ok && decoded != vector.value)) {
+            fprintf(stderr, "  Huffman %s\n", vector.wire);
+            CHECK(!"unexpected Huffman result");
+        }
+    }
+}
+
+int main()
+{
+    test_integers();
+    test_field_representations();
+    test_header_block_sequences();
+    test_table_size_updates();
+    test_invalid_blocks();
+    test_huffman_round_trip();
+    test_huffman_invalid();
+    return test_result();
+}
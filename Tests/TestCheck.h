@@ -0,0 +1,45 @@
+/**
+ *   Minimal checks for the standalone tests in this directory
+ *
+ *   Every test is one executable: CHECK records a failure and carries on,
+ *   main returns test_result() so a non-zero exit code means something failed.
+ *
+ *      CHECK(decoder.next(frame) == Http2FrameDecoder::Frame);
+ *      CHECK_EQ(frame.streamId, 1u);
+ *      return test_result();
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <stdio.h>
+
+inline int& test_failures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+inline void test_fail(const char* file, int line, const char* expression)
+{
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+    ++test_failures();
+}
+
+inline int test_result()
+{
+    if (test_failures() != 0) {
+        fprintf(stderr, "%d check(s) failed\n", test_failures());
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
+
+#define CHECK(expression) \
+    do { if (!(expression)) test_fail(__FILE__, __LINE__, #expression); } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { if (!((actual) == (expected))) test_fail(__FILE__, __LINE__, #actual " == " #expected); } while (0)
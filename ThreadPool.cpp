@@ -0,0 +1,267 @@
+#include "ThreadPool.h"
+#include "PlatformCommonUtils.h"
+#include "PlatformSync.h"
+#include "PlatformClock.h"
+#include "ThreadTelemetry.h"
+#include <thread>
+#include <algorithm>
+
+static constexpr int IDLE_SPIN_ROUNDS = 64;
+
+// the pool and index of the calling worker thread
+static thread_local const ThreadPool* s_current_pool = nullptr;
+static thread_local int s_current_worker = -1;
+
+static inline uint64_t xorshift(uint64_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+ThreadPool::ThreadPool(size_t threads, PinPolicy pin, int node):
+    m_pin(pin),
+    m_node(node)
+{
+    if (threads == 0 && pin == PinPolicy::Node) {
+        threads = CpuTopology::shared().cpusOfNode(node).size();
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    m_workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        m_workers.emplace_back(new Worker());
+        m_workers.back()->rng = 0x9e3779b97f4a7c15ull * (i + 1);
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        m_workers[i]->thread.setStartHook([this, i] {
+            std::string name = "pool-" + std::to_string(i);
+            PlatformCommonUtils::set_current_thread_name(name);
+            ThreadTelemetry::shared().attach(name);
+            PlatformCommonUtils::apply_pin_policy(m_pin, i, m_node);
+        });
+        if (!m_workers[i]->thread.run([this, i] { workerLoop(i); })) {
+            LOG_ERROR("ThreadPool: failed to start worker %zu", i);
+        }
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    shutdown(true);
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+int ThreadPool::currentWorker() const
+{
+    return s_current_pool == this ? s_current_worker : -1;
+}
+
+bool ThreadPool::enqueue(Task* task, TaskPriority priority)
+{
+    size_t level = std::min((size_t)priority, PRIORITIES - 1);
+    int self = currentWorker();
+    if (self >= 0) {
+        // tasks spawned by tasks stay local and are still accepted while draining
+        m_workers[self]->deques[level].push(task);
+    }
+    else {
+        if (!m_accepting) {
+            LOG_ERROR("ThreadPool: submit after shutdown");
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(m_injectMutex);
+        m_inject[level].push_back(task);
+        m_injectCount.fetch_add(1, std::memory_order_release);
+    }
+    wakeOne();
+    return true;
+}
+
+void ThreadPool::wakeOne()
+{
+    m_epoch.fetch_add(1, std::memory_order_seq_cst);
+    if (m_sleepers.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_sleepCond.notify_one();
+    }
+}
+
+ThreadPool::Task* ThreadPool::findTask(int index)
+{
+    // threads outside the pool have no deque of their own and only help
+    static thread_local uint64_t s_helper_rng = 0x2545f4914f6cdd1dull;
+    Worker* self = index >= 0 ? m_workers[index].get() : nullptr;
+    uint64_t& rng = self != nullptr ? self->rng : s_helper_rng;
+    for (size_t level = 0; level < PRIORITIES; ++level) {
+        if (self != nullptr) {
+            if (Task* task = self->deques[level].pop()) {
+                return task;
+            }
+        }
+        if (m_injectCount.load(std::memory_order_acquire) > 0) {
+            std::lock_guard<std::mutex> lock(m_injectMutex);
+            if (!m_inject[level].empty()) {
+                Task* task = m_inject[level].front();
+                m_inject[level].pop_front();
+                m_injectCount.fetch_sub(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+        // start at a random victim so thieves do not pile onto worker 0
+        size_t count = m_workers.size();
+        size_t start = (size_t)(xorshift(rng) % count);
+        for (size_t i = 0; i < count; ++i) {
+            size_t victim = (start + i) % count;
+            if ((int)victim == index) {
+                continue;
+            }
+            if (Task* task = m_workers[victim]->deques[level].steal()) {
+                if (self != nullptr) {
+                    self->steals.fetch_add(1, std::memory_order_relaxed);
+                }
+                return task;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+    s_current_pool = this;
+    s_current_worker = (int)index;
+    Worker& self = *m_workers[index];
+
+    while (!m_discard) {
+        Task* task = findTask((int)index);
+        if (task == nullptr) {
+            uint64_t idleStart = TscClock::nowNs();
+            for (int i = 0; i < IDLE_SPIN_ROUNDS && task == nullptr; ++i) {
+                sync_cpu_relax();
+                task = findTask((int)index);
+            }
+            if (task == nullptr) {
+                uint64_t epoch = m_epoch.load(std::memory_order_seq_cst);
+                task = findTask((int)index);
+                if (task == nullptr) {
+                    if (m_stopping) {
+                        break;
+                    }
+                    std::unique_lock<std::mutex> lock(m_sleepMutex);
+                    m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+                    m_sleepCond.wait(lock, [&] { return m_epoch.load(std::memory_order_seq_cst) != epoch || m_stopping; });
+                    m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+            self.idleNs.fetch_add(TscClock::nowNs() - idleStart, std::memory_order_relaxed);
+            if (task == nullptr) {
+                continue;
+            }
+        }
+        runTask(task);
+        self.tasksRun.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    s_current_pool = nullptr;
+    s_current_worker = -1;
+}
+
+void ThreadPool::runTask(Task* task)
+{
+    try {
+        task->run();
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("ThreadPool: task threw: %s", e.what());
+    }
+    catch (...) {
+        LOG_ERROR("ThreadPool: task threw an unknown exception");
+    }
+    delete task;
+}
+
+bool ThreadPool::tryRunOne()
+{
+    if (m_discard) {
+        return false;
+    }
+    int self = currentWorker();
+    Task* task = findTask(self);
+    if (task == nullptr) {
+        return false;
+    }
+    runTask(task);
+    if (self >= 0) {
+        m_workers[self]->tasksRun.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+size_t ThreadPool::localPending() const
+{
+    int self = currentWorker();
+    if (self < 0) {
+        return 0;
+    }
+    size_t pending = 0;
+    for (const auto& deque : m_workers[self]->deques) {
+        pending += deque.size();
+    }
+    return pending;
+}
+
+void ThreadPool::shutdown(bool drain)
+{
+    if (m_stopping.exchange(true)) {
+        return;
+    }
+    m_accepting = false;
+    m_discard = !drain;
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_epoch.fetch_add(1);
+        m_sleepCond.notify_all();
+    }
+    for (auto& worker : m_workers) {
+        worker->thread.join();
+    }
+
+    // whatever is left was discarded, deleting it breaks the promises
+    for (auto& worker : m_workers) {
+        for (auto& deque : worker->deques) {
+            while (Task* task = deque.steal()) {
+                delete task;
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_injectMutex);
+    for (auto& queue : m_inject) {
+        for (Task* task : queue) {
+            delete task;
+        }
+        queue.clear();
+    }
+    m_injectCount = 0;
+}
+
+std::vector<WorkerStats> ThreadPool::stats() const
+{
+    std::vector<WorkerStats> result;
+    result.reserve(m_workers.size());
+    for (const auto& worker : m_workers) {
+        WorkerStats stats;
+        stats.tasksRun = worker->tasksRun.load(std::memory_order_relaxed);
+        stats.steals = worker->steals.load(std::memory_order_relaxed);
+        stats.idleNs = worker->idleNs.load(std::memory_order_relaxed);
+        result.push_back(stats);
+    }
+    return result;
+}
@@ -0,0 +1,184 @@
+/**
+ *   Work stealing thread pool on CThread
+ *
+ *   Every worker owns one Chase-Lev deque per priority. Tasks submitted from a
+ *   worker go to its own deque, tasks from other threads go to a shared
+ *   injection queue. An idle worker looks, highest priority first, at its own
+ *   deque, the injection queue and then steals from the other workers before
+ *   it parks.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <future>
+#include <functional>
+#include <type_traits>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdint.h>
+#include "CThread.hpp"
+#include "WorkStealingDeque.h"
+#include "CpuTopology.h"
+
+enum class TaskPriority : uint32_t
+{
+    High = 0,
+    Normal,
+    Low,
+};
+
+struct WorkerStats
+{
+    uint64_t tasksRun = 0;
+    uint64_t steals = 0;        // tasks taken from another worker's deque
+    uint64_t idleNs = 0;        // time spent looking for work or parked
+};
+
+class ThreadPool
+{
+public:
+    /**
+     * @param threads  worker count, 0 means one per hardware thread (of node for PinPolicy::Node)
+     * @param pin      placement of the workers, worker i goes to cpuOrder(pin, node)[i]
+     */
+    explicit ThreadPool(size_t threads = 0, PinPolicy pin = PinPolicy::None, int node = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /** process wide pool for directory walks, copies, unarchiving and database work */
+    static ThreadPool& shared();
+
+    /**
+     * @brief  Run func(args...) on a worker
+     * @return future of the result, invalid if the pool is shut down
+     */
+    template<typename Func, typename... Args>
+    auto submit(TaskPriority priority, Func&& func, Args&&... args) -> std::future<std::invoke_result_t<Func, Args...>>;
+
+    template<typename Func, typename... Args>
+    auto submit(Func&& func, Args&&... args) -> std::future<std::invoke_result_t<Func, Args...>>
+    {
+        return submit(TaskPriority::Normal, std::forward<Func>(func), std::forward<Args>(args)...);
+    }
+
+    /** fire and forget, no future is allocated */
+    template<typename Func>
+    bool post(Func&& func, TaskPriority priority = TaskPriority::Normal);
+
+    /**
+     * @brief        Stop the workers, further submits from outside the pool fail
+     * @param drain  true: run every queued task first. false: drop the queue, its futures get broken_promise
+     */
+    void shutdown(bool drain = true);
+
+    size_t size() const { return m_workers.size(); }
+
+    /** false once shutdown() started, submits from outside the pool then fail */
+    bool isAccepting() const { return m_accepting.load(std::memory_order_acquire); }
+
+    /** index of the calling worker of this pool, -1 for other threads */
+    int currentWorker() const;
+
+    /**
+     * @brief  Run one queued task on the calling thread, for waits that must not block a worker
+     * @return false if no task was found
+     */
+    bool tryRunOne();
+
+    /** tasks waiting in the calling worker's own deques, 0 for other threads */
+    size_t localPending() const;
+
+    std::vector<WorkerStats> stats() const;
+
+private:
+    static constexpr size_t PRIORITIES = 3;
+
+    struct Task
+    {
+        virtual ~Task() = default;
+        virtual void run() = 0;
+    };
+
+    template<typename Func>
+    struct TaskImpl : Task
+    {
+        explicit TaskImpl(Func&& f) : func(std::move(f)) {}
+        void run() override { func(); }
+        Func func;
+    };
+
+    struct Worker
+    {
+        WorkStealingDeque<Task*> deques[PRIORITIES];
+        std::atomic<uint64_t> tasksRun{ 0 };
+        std::atomic<uint64_t> steals{ 0 };
+        std::atomic<uint64_t> idleNs{ 0 };
+        uint64_t rng = 0;
+        CThread<void> thread;
+    };
+
+    /** run and delete a task; an exception escaping it is logged, it must not end the worker */
+    static void runTask(Task* task);
+    bool enqueue(Task* task, TaskPriority priority);
+    Task* findTask(int index);
+    void workerLoop(size_t index);
+    void wakeOne();
+
+private:
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    PinPolicy m_pin;
+    int m_node;
+
+    std::mutex m_injectMutex;
+    std::deque<Task*> m_inject[PRIORITIES];
+    std::atomic<size_t> m_injectCount{ 0 };
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCond;
+    std::atomic<uint64_t> m_epoch{ 0 };     // bumped on every enqueue so parking cannot miss one
+    std::atomic<uint32_t> m_sleepers{ 0 };
+
+    std::atomic_bool m_accepting{ true };
+    std::atomic_bool m_stopping{ false };
+    std::atomic_bool m_discard{ false };
+};
+
+template<typename Func, typename ...Args>
+inline auto ThreadPool::submit(TaskPriority priority, Func&& func, Args&&... args) -> std::future<std::invoke_result_t<Func, Args...>>
+{
+    using R = std::invoke_result_t<Func, Args...>;
+    std::packaged_task<R()> task(
+        [func = std::forward<Func>(func), ... args = std::forward<Args>(args)]() mutable {
+            return func(args...);
+        }
+    );
+    std::future<R> future = task.get_future();
+    auto wrapper = [task = std::move(task)]() mutable { task(); };
+    Task* t = new TaskImpl<decltype(wrapper)>(std::move(wrapper));
+    if (!enqueue(t, priority)) {
+        delete t;
+        return std::future<R>();
+    }
+    return future;
+}
+
+template<typename Func>
+inline bool ThreadPool::post(Func&& func, TaskPriority priority)
+{
+    using F = std::decay_t<Func>;
+    Task* t = new TaskImpl<F>(F(std::forward<Func>(func)));
+    if (!enqueue(t, priority)) {
+        delete t;
+        return false;
+    }
+    return true;
+}
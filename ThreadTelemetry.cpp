@@ -0,0 +1,303 @@
+#include "ThreadTelemetry.h"
+#include "PlatformCommonUtils.h"
+#include "PlatformClock.h"
+#include <algorithm>
+
+#ifdef _MSC_VER
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <mach/mach.h>
+#include <mach/thread_info.h>
+#else
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+// detaches the thread from the registry when it exits
+struct TelemetryAttachment
+{
+    ThreadTelemetry* owner = nullptr;
+    ~TelemetryAttachment()
+    {
+        if (owner != nullptr) {
+            owner->detach();
+        }
+    }
+};
+static thread_local TelemetryAttachment s_attachment;
+
+#ifdef _MSC_VER
+static uint64_t filetime_ns(const FILETIME& time)
+{
+    return ((((uint64_t)time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100;
+}
+#elif !defined(__APPLE__)
+static bool read_proc_file(const std::string& path, char* buffer, size_t size)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return false;
+    }
+    size_t n = fread(buffer, 1, size - 1, file);
+    fclose(file);
+    buffer[n] = '\0';
+    return n > 0;
+}
+
+static uint64_t status_value(const char* status, const char* key)
+{
+    const char* line = strstr(status, key);
+    return line != nullptr ? strtoull(line + strlen(key), nullptr, 10) : 0;
+}
+#endif
+
+ThreadTelemetry& ThreadTelemetry::shared()
+{
+    static ThreadTelemetry telemetry;
+    return telemetry;
+}
+
+std::function<void()> ThreadTelemetry::startHook(const std::string& name)
+{
+    return [name] { ThreadTelemetry::shared().attach(name); };
+}
+
+void ThreadTelemetry::attach(const std::string& name)
+{
+    if (s_attachment.owner != nullptr) {
+        s_attachment.owner->detach();
+    }
+
+    Entry entry;
+    entry.name = name;
+    entry.tid = PlatformCommonUtils::get_current_thread_id();
+    entry.startNs = TscClock::nowNs();
+#ifdef _MSC_VER
+    entry.handle = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, GetCurrentThreadId());
+#elif defined(__APPLE__)
+    entry.port = pthread_mach_thread_np(pthread_self());
+#endif
+    readUsage(entry, entry.startUsage);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_threads.push_back(entry);
+    s_attachment.owner = this;
+}
+
+void ThreadTelemetry::detach()
+{
+    if (s_attachment.owner != this) {
+        return;
+    }
+    s_attachment.owner = nullptr;
+    int tid = PlatformCommonUtils::get_current_thread_id();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = std::find_if(m_threads.begin(), m_threads.end(), [tid](const Entry& entry) { return entry.tid == tid; });
+    if (it == m_threads.end()) {
+        return;
+    }
+    // keep the final numbers, short lived session threads are the interesting ones
+    ThreadUsage usage;
+    if (readUsage(*it, usage)) {
+        m_exited.push_back(makeReport(*it, usage, TscClock::nowNs(), false));
+        if (m_exited.size() > MAX_EXITED) {
+            m_exited.pop_front();
+        }
+    }
+    closeEntry(*it);
+    m_threads.erase(it);
+}
+
+void ThreadTelemetry::closeEntry(Entry& entry)
+{
+#ifdef _MSC_VER
+    if (entry.handle != nullptr) {
+        CloseHandle(entry.handle);
+        entry.handle = nullptr;
+    }
+#else
+    (void)entry;
+#endif
+}
+
+bool ThreadTelemetry::currentUsage(ThreadUsage& usage)
+{
+    usage = ThreadUsage();
+#ifdef _MSC_VER
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        return false;
+    }
+    usage.userNs = filetime_ns(user);
+    usage.systemNs = filetime_ns(kernel);
+    usage.cpuNs = usage.userNs + usage.systemNs;
+    return true;
+#elif defined(__APPLE__)
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    if (thread_info(pthread_mach_thread_np(pthread_self()), THREAD_BASIC_INFO, (thread_info_t)&info, &count) != KERN_SUCCESS) {
+        return false;
+    }
+    usage.userNs = (uint64_t)info.user_time.seconds * 1000000000ull + (uint64_t)info.user_time.microseconds * 1000;
+    usage.systemNs = (uint64_t)info.system_time.seconds * 1000000000ull + (uint64_t)info.system_time.microseconds * 1000;
+    usage.cpuNs = usage.userNs + usage.systemNs;
+    return true;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_THREAD, &ru) != 0) {
+        return false;
+    }
+    usage.userNs = (uint64_t)ru.ru_utime.tv_sec * 1000000000ull + (uint64_t)ru.ru_utime.tv_usec * 1000;
+    usage.systemNs = (uint64_t)ru.ru_stime.tv_sec * 1000000000ull + (uint64_t)ru.ru_stime.tv_usec * 1000;
+    usage.voluntarySwitches = (uint64_t)ru.ru_nvcsw;
+    usage.involuntarySwitches = (uint64_t)ru.ru_nivcsw;
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        usage.cpuNs = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    }
+    else {
+        usage.cpuNs = usage.userNs + usage.systemNs;
+    }
+    return true;
+#endif
+}
+
+bool ThreadTelemetry::readUsage(const Entry& entry, ThreadUsage& usage)
+{
+    usage = ThreadUsage();
+#ifdef _MSC_VER
+    FILETIME creation, exit, kernel, user;
+    if (entry.handle == nullptr || !GetThreadTimes(entry.handle, &creation, &exit, &kernel, &user)) {
+        return false;
+    }
+    usage.userNs = filetime_ns(user);
+    usage.systemNs = filetime_ns(kernel);
+    usage.cpuNs = usage.userNs + usage.systemNs;
+    return true;
+#elif defined(__APPLE__)
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    if (thread_info(entry.port, THREAD_BASIC_INFO, (thread_info_t)&info, &count) != KERN_SUCCESS) {
+        return false;
+    }
+    usage.userNs = (uint64_t)info.user_time.seconds * 1000000000ull + (uint64_t)info.user_time.microseconds * 1000;
+    usage.systemNs = (uint64_t)info.system_time.seconds * 1000000000ull + (uint64_t)info.system_time.microseconds * 1000;
+    usage.cpuNs = usage.userNs + usage.systemNs;
+    return true;
+#else
+    std::string dir = "/proc/self/task/" + std::to_string(entry.tid) + "/";
+    char buffer[2048];
+
+    // cpu time and run queue wait in ns
+    if (read_proc_file(dir + "schedstat", buffer, sizeof(buffer))) {
+        unsigned long long cpu = 0, wait = 0;
+        if (sscanf(buffer, "%llu %llu", &cpu, &wait) == 2) {
+            usage.cpuNs = cpu;
+            usage.runDelayNs = wait;
+        }
+    }
+
+    // utime / stime in clock ticks, fields 14 and 15, after the parenthesised name
+    if (!read_proc_file(dir + "stat", buffer, sizeof(buffer))) {
+        return false;
+    }
+    const char* p = strrchr(buffer, ')');
+    unsigned long long utime = 0, stime = 0;
+    if (p == nullptr || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2) {
+        return false;
+    }
+    uint64_t tickNs = 1000000000ull / (uint64_t)sysconf(_SC_CLK_TCK);
+    usage.userNs = utime * tickNs;
+    usage.systemNs = stime * tickNs;
+    if (usage.cpuNs == 0) {
+        usage.cpuNs = usage.userNs + usage.systemNs;
+    }
+
+    if (read_proc_file(dir + "status", buffer, sizeof(buffer))) {
+        usage.voluntarySwitches = status_value(buffer, "\nvoluntary_ctxt_switches:");
+        usage.involuntarySwitches = status_value(buffer, "\nnonvoluntary_ctxt_switches:");
+    }
+    return true;
+#endif
+}
+
+ThreadReport ThreadTelemetry::makeReport(const Entry& entry, const ThreadUsage& usage, uint64_t nowNs, bool alive)
+{
+    auto since = [](uint64_t now, uint64_t start) { return now > start ? now - start : 0; };
+
+    ThreadReport report;
+    report.name = entry.name;
+    report.tid = entry.tid;
+    report.alive = alive;
+    report.wallNs = since(nowNs, entry.startNs);
+    report.usage.cpuNs = since(usage.cpuNs, entry.startUsage.cpuNs);
+    report.usage.userNs = since(usage.userNs, entry.startUsage.userNs);
+    report.usage.systemNs = since(usage.systemNs, entry.startUsage.systemNs);
+    report.usage.runDelayNs = since(usage.runDelayNs, entry.startUsage.runDelayNs);
+    report.usage.voluntarySwitches = since(usage.voluntarySwitches, entry.startUsage.voluntarySwitches);
+    report.usage.involuntarySwitches = since(usage.involuntarySwitches, entry.startUsage.involuntarySwitches);
+    report.cpuPercent = report.wallNs > 0 ? (double)report.usage.cpuNs * 100.0 / (double)report.wallNs : 0;
+
+    double delayPercent = report.wallNs > 0 ? (double)report.usage.runDelayNs * 100.0 / (double)report.wallNs : 0;
+    // a cpu bound thread is preempted at the end of every time slice, that alone is not contention
+    if (delayPercent >= 20) {
+        report.state = "preempted";
+    }
+    else if (report.cpuPercent >= 80) {
+        report.state = "busy";
+    }
+    else if (report.usage.involuntarySwitches > 10 && report.usage.involuntarySwitches > 2 * report.usage.voluntarySwitches) {
+        report.state = "preempted";
+    }
+    else if (report.cpuPercent < 20) {
+        report.state = "waiting";
+    }
+    else {
+        report.state = "mixed";
+    }
+    return report;
+}
+
+std::vector<ThreadReport> ThreadTelemetry::snapshot()
+{
+    std::vector<ThreadReport> reports;
+    uint64_t now = TscClock::nowNs();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const Entry& entry : m_threads) {
+        ThreadUsage usage;
+        if (readUsage(entry, usage)) {
+            reports.push_back(makeReport(entry, usage, now, true));
+        }
+    }
+    reports.insert(reports.end(), m_exited.begin(), m_exited.end());
+    return reports;
+}
+
+void ThreadTelemetry::dump()
+{
+    std::vector<ThreadReport> reports = snapshot();
+    std::sort(reports.begin(), reports.end(), [](const ThreadReport& a, const ThreadReport& b) { return a.usage.cpuNs > b.usage.cpuNs; });
+    LOG_INFO("%-20s %8s %5s %10s %10s %7s %10s %8s %8s  %s", "thread", "tid", "alive", "wall(ms)", "cpu(ms)", "cpu%", "delay(ms)", "vcsw", "ivcsw", "state");
+    for (const auto& r : reports) {
+        LOG_INFO("%-20s %8d %5s %10.1f %10.1f %6.1f%% %10.1f %8llu %8llu  %s",
+            r.name.c_str(),
+            r.tid,
+            r.alive ? "yes" : "no",
+            r.wallNs / 1e6,
+            r.usage.cpuNs / 1e6,
+            r.cpuPercent,
+            r.usage.runDelayNs / 1e6,
+            (unsigned long long)r.usage.voluntarySwitches,
+            (unsigned long long)r.usage.involuntarySwitches,
+            r.state);
+    }
+}
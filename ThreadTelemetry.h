@@ -0,0 +1,94 @@
+/**
+ *   Per-thread CPU and scheduling telemetry
+ *
+ *   A thread attaches itself (directly, or through a CThread start hook) and
+ *   is then listed by dump(): wall time, user / system CPU time, voluntary and
+ *   involuntary context switches and, on Linux, the time it sat runnable on a
+ *   run queue. Threads are read from the dumping thread, the attached threads
+ *   pay nothing after attach().
+ *
+ *   Linux: /proc/self/task/<tid>/{schedstat,stat,status}
+ *   MacOs: thread_info(THREAD_BASIC_INFO), no context switch counts
+ *   Windows: GetThreadTimes, no context switch counts
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
+#include <stdint.h>
+
+/** usage of one thread since it started */
+struct ThreadUsage
+{
+    uint64_t cpuNs = 0;             // user + system, scheduler precision where available
+    uint64_t userNs = 0;
+    uint64_t systemNs = 0;
+    uint64_t runDelayNs = 0;        // runnable but waiting for a cpu (Linux)
+    uint64_t voluntarySwitches = 0;     // blocked: locks, I/O, sleeps
+    uint64_t involuntarySwitches = 0;   // preempted
+};
+
+struct ThreadReport
+{
+    std::string name;
+    int tid = 0;
+    bool alive = true;
+    uint64_t wallNs = 0;            // since attach
+    ThreadUsage usage;              // since attach
+    double cpuPercent = 0;          // cpu time / wall time
+    const char* state = "";         // busy, preempted, waiting, mixed
+};
+
+class ThreadTelemetry
+{
+public:
+    static ThreadTelemetry& shared();
+
+    /** register the calling thread, it is detached automatically when it exits */
+    void attach(const std::string& name);
+    void detach();
+
+    /** start hook for CThread::setStartHook */
+    static std::function<void()> startHook(const std::string& name);
+
+    /** usage of the calling thread, cheap enough for per-request accounting */
+    static bool currentUsage(ThreadUsage& usage);
+
+    /** attached threads plus the most recently exited ones */
+    std::vector<ThreadReport> snapshot();
+
+    /** log a table of snapshot(), busiest first */
+    void dump();
+
+private:
+    struct Entry
+    {
+        std::string name;
+        int tid = 0;
+        uint64_t startNs = 0;
+        ThreadUsage startUsage;
+#ifdef _MSC_VER
+        void* handle = nullptr;
+#elif defined(__APPLE__)
+        unsigned int port = 0;
+#endif
+    };
+
+    static bool readUsage(const Entry& entry, ThreadUsage& usage);
+    static ThreadReport makeReport(const Entry& entry, const ThreadUsage& usage, uint64_t nowNs, bool alive);
+    static void closeEntry(Entry& entry);
+
+private:
+    static constexpr size_t MAX_EXITED = 128;
+
+    std::mutex m_mutex;
+    std::vector<Entry> m_threads;
+    std::deque<ThreadReport> m_exited;
+};
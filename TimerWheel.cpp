@@ -0,0 +1,345 @@
+#include "TimerWheel.h"
+#include "PlatformCommonUtils.h"
+#include <algorithm>
+
+TimerWheel::TimerWheel(std::chrono::microseconds resolution):
+    m_resolution(std::max<Clock::duration>(resolution, std::chrono::microseconds(1))),
+    m_base(Clock::now())
+{
+    std::fill(std::begin(m_slots), std::end(m_slots), NIL);
+}
+
+TimerWheel::~TimerWheel()
+{
+    stop();
+}
+
+TimerWheel& TimerWheel::shared()
+{
+    static TimerWheel wheel;
+    wheel.start();
+    return wheel;
+}
+
+bool TimerWheel::start()
+{
+    if (m_bRunning.exchange(true)) {
+        return true;
+    }
+    if (!m_thread.run([this] { loop(); })) {
+        LOG_ERROR("TimerWheel: failed to start the timer thread");
+        m_bRunning = false;
+        return false;
+    }
+    return true;
+}
+
+void TimerWheel::stop()
+{
+    if (!m_bRunning.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cond.notify_all();
+    }
+    m_thread.join();
+}
+
+TimerWheel::TimerId TimerWheel::scheduleAfter(std::chrono::microseconds delay, TimerCallback cb)
+{
+    return schedule(delay, std::chrono::microseconds(0), std::move(cb));
+}
+
+TimerWheel::TimerId TimerWheel::scheduleEvery(std::chrono::microseconds interval, TimerCallback cb)
+{
+    if (interval.count() <= 0) {
+        LOG_ERROR("TimerWheel: periodic timer needs a positive interval");
+        return 0;
+    }
+    return schedule(interval, interval, std::move(cb));
+}
+
+TimerWheel::TimerId TimerWheel::schedule(std::chrono::microseconds delay, std::chrono::microseconds interval, TimerCallback cb)
+{
+    if (!cb) {
+        return 0;
+    }
+    auto deadline = Clock::now() + std::max(delay, std::chrono::microseconds(0));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t index;
+    if (!m_free.empty()) {
+        index = m_free.back();
+        m_free.pop_back();
+    }
+    else {
+        index = (uint32_t)m_nodes.size();
+        m_nodes.emplace_back();
+    }
+    Node& node = m_nodes[index];
+    node.cb = std::move(cb);
+    node.interval = interval;
+    node.deadline = deadline;
+    node.expires = deadlineTick(deadline);
+    node.running = false;
+    node.cancelled = false;
+    link(index);
+    ++m_count;
+
+    // the wheel thread may be sleeping past the new deadline
+    if (node.expires < m_wakeTick) {
+        m_cond.notify_one();
+    }
+    return ((uint64_t)node.generation << 32) | index;
+}
+
+bool TimerWheel::cancel(TimerId id)
+{
+    uint32_t index = (uint32_t)(id & 0xffffffffu);
+    uint32_t generation = (uint32_t)(id >> 32);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id == 0 || index >= m_nodes.size() || m_nodes[index].generation != generation) {
+        return false;
+    }
+    Node& node = m_nodes[index];
+    if (node.running) {
+        // one shot: too late. periodic: finish this run, do not re-arm
+        if (node.interval.count() == 0 || node.cancelled) {
+            return false;
+        }
+        node.cancelled = true;
+        return true;
+    }
+    unlink(index);
+    release(index);
+    return true;
+}
+
+size_t TimerWheel::size()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_count;
+}
+
+uint64_t TimerWheel::tickOf(Clock::time_point time) const
+{
+    if (time <= m_base) {
+        return 0;
+    }
+    return (uint64_t)((time - m_base) / m_resolution);
+}
+
+uint64_t TimerWheel::deadlineTick(Clock::time_point deadline) const
+{
+    // round up, the tick has to start at or after the deadline
+    uint64_t tick = deadline <= m_base ? 0 : (uint64_t)((deadline - m_base + m_resolution - Clock::duration(1)) / m_resolution);
+    return std::max(tick, m_currentTick + 1);
+}
+
+void TimerWheel::link(uint32_t index)
+{
+    Node& node = m_nodes[index];
+    uint64_t expires = node.expires;
+    uint64_t delta = expires - m_currentTick;
+    if (delta >= MAX_DELTA) {
+        // beyond the last level, park it and re-hash when that slot comes around
+        expires = m_currentTick + MAX_DELTA - 1;
+        delta = MAX_DELTA - 1;
+    }
+
+    uint32_t slot;
+    if (delta < LEVEL0_SLOTS) {
+        slot = (uint32_t)(expires & (LEVEL0_SLOTS - 1));
+        ++m_level0Count;
+    }
+    else {
+        uint32_t level = 1;
+        while (delta >= (1ull << (LEVEL0_BITS + level * LEVELN_BITS))) {
+            ++level;
+        }
+        uint32_t shift = LEVEL0_BITS + (level - 1) * LEVELN_BITS;
+        slot = LEVEL0_SLOTS + (level - 1) * LEVELN_SLOTS + (uint32_t)((expires >> shift) & (LEVELN_SLOTS - 1));
+    }
+
+    node.slot = slot;
+    node.prev = NIL;
+    node.next = m_slots[slot];
+    if (node.next != NIL) {
+        m_nodes[node.next].prev = index;
+    }
+    m_slots[slot] = index;
+}
+
+void TimerWheel::unlink(uint32_t index)
+{
+    Node& node = m_nodes[index];
+    if (node.slot == NIL) {
+        return;
+    }
+    if (node.prev != NIL) {
+        m_nodes[node.prev].next = node.next;
+    }
+    else {
+        m_slots[node.slot] = node.next;
+    }
+    if (node.next != NIL) {
+        m_nodes[node.next].prev = node.prev;
+    }
+    if (node.slot < LEVEL0_SLOTS) {
+        --m_level0Count;
+    }
+    node.slot = NIL;
+    node.prev = NIL;
+    node.next = NIL;
+}
+
+void TimerWheel::release(uint32_t index)
+{
+    Node& node = m_nodes[index];
+    node.cb = nullptr;
+    if (++node.generation == 0) {
+        node.generation = 1;    // keep ids non zero
+    }
+    m_free.push_back(index);
+    --m_count;
+}
+
+uint32_t TimerWheel::cascade(uint32_t level)
+{
+    uint32_t shift = LEVEL0_BITS + (level - 1) * LEVELN_BITS;
+    uint32_t index = (uint32_t)((m_currentTick >> shift) & (LEVELN_SLOTS - 1));
+    uint32_t slot = LEVEL0_SLOTS + (level - 1) * LEVELN_SLOTS + index;
+
+    uint32_t cur = m_slots[slot];
+    m_slots[slot] = NIL;
+    while (cur != NIL) {
+        uint32_t next = m_nodes[cur].next;
+        m_nodes[cur].slot = NIL;
+        link(cur);
+        cur = next;
+    }
+    return index;
+}
+
+size_t TimerWheel::advance(Clock::time_point now)
+{
+    std::vector<std::pair<uint32_t, Node*>> expired;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint64_t target = tickOf(now);
+        while (m_currentTick < target) {
+            if (m_count == 0) {
+                m_currentTick = target;
+                break;
+            }
+            if (m_level0Count == 0) {
+                // nothing can fire before the next cascade, skip to it
+                uint64_t boundary = m_currentTick | (LEVEL0_SLOTS - 1);
+                if (boundary >= target) {
+                    m_currentTick = target;
+                    break;
+                }
+                m_currentTick = boundary;
+            }
+
+            ++m_currentTick;
+            if ((m_currentTick & (LEVEL0_SLOTS - 1)) == 0) {
+                for (uint32_t level = 1; level < LEVELS; ++level) {
+                    if (cascade(level) != 0) {
+                        break;
+                    }
+                }
+            }
+
+            uint32_t slot = (uint32_t)(m_currentTick & (LEVEL0_SLOTS - 1));
+            uint32_t cur = m_slots[slot];
+            while (cur != NIL) {
+                Node& node = m_nodes[cur];
+                uint32_t next = node.next;
+                if (node.expires <= m_currentTick) {
+                    unlink(cur);
+                    node.running = true;
+                    expired.emplace_back(cur, &node);
+                }
+                cur = next;
+            }
+        }
+    }
+
+    // deque elements do not move, so callbacks run without the lock and may schedule or cancel
+    for (auto& item : expired) {
+        item.second->cb();
+    }
+
+    if (!expired.empty()) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& item : expired) {
+            Node& node = *item.second;
+            node.running = false;
+            if (node.interval.count() == 0 || node.cancelled) {
+                release(item.first);
+                continue;
+            }
+            // re-arm from the previous deadline, skipping periods we were too late for
+            node.deadline += node.interval;
+            if (node.deadline <= now) {
+                auto missed = (now - node.deadline) / node.interval + 1;
+                node.deadline += node.interval * missed;
+            }
+            node.expires = deadlineTick(node.deadline);
+            link(item.first);
+        }
+    }
+    return expired.size();
+}
+
+std::chrono::microseconds TimerWheel::nextTimeout()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t tick = nextTick();
+    if (tick == UINT64_MAX) {
+        return std::chrono::microseconds::max();
+    }
+    auto left = m_base + m_resolution * tick - Clock::now();
+    return std::max(std::chrono::duration_cast<std::chrono::microseconds>(left), std::chrono::microseconds(0));
+}
+
+uint64_t TimerWheel::nextTick() const
+{
+    if (m_count == 0) {
+        return UINT64_MAX;
+    }
+    // first occupied level 0 slot before the next cascade, else the cascade itself
+    uint64_t boundary = (m_currentTick | (LEVEL0_SLOTS - 1)) + 1;
+    if (m_level0Count > 0) {
+        for (uint64_t tick = m_currentTick + 1; tick < boundary; ++tick) {
+            if (m_slots[tick & (LEVEL0_SLOTS - 1)] != NIL) {
+                return tick;
+            }
+        }
+    }
+    return boundary;
+}
+
+void TimerWheel::loop()
+{
+    while (m_bRunning) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (!m_bRunning) {
+                break;
+            }
+            m_wakeTick = nextTick();
+            if (m_wakeTick == UINT64_MAX) {
+                m_cond.wait(lock);
+            }
+            else {
+                m_cond.wait_until(lock, m_base + m_resolution * m_wakeTick);
+            }
+            m_wakeTick = 0;
+        }
+        advance(Clock::now());
+    }
+}
@@ -0,0 +1,122 @@
+/**
+ *   Hashed hierarchical timer wheel
+ *
+ *   One thread (or an external event loop calling advance()) drives every
+ *   delayed and periodic task of the process. Four levels of 256/64/64/64
+ *   slots cover about 18 hours at 1 ms resolution, longer delays are parked in
+ *   the last level and re-hashed when it comes around. Insert and cancel are
+ *   O(1); a timer never fires before its deadline and at most one tick after.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include "CThread.hpp"
+
+class TimerWheel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimerId = uint64_t;   // 0 is never a valid id
+    using TimerCallback = std::function<void()>;
+
+    /**
+     * @param resolution  length of one tick, deadlines are rounded up to it
+     */
+    explicit TimerWheel(std::chrono::microseconds resolution = std::chrono::milliseconds(1));
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /** process wide wheel with 1 ms ticks, started on first use */
+    static TimerWheel& shared();
+
+    /** run the wheel on its own thread, not needed when advance() is driven by an event loop; false if the thread failed to start */
+    bool start();
+    void stop();
+
+    /** run cb once after delay, on the wheel thread */
+    TimerId scheduleAfter(std::chrono::microseconds delay, TimerCallback cb);
+
+    /** run cb every interval, the first time after interval; deadlines do not drift */
+    TimerId scheduleEvery(std::chrono::microseconds interval, TimerCallback cb);
+
+    /**
+     * @brief  Remove a timer. A callback which is already running finishes, a periodic one is not re-armed.
+     * @return false if the timer already fired or was cancelled
+     */
+    bool cancel(TimerId id);
+
+    /**
+     * @brief  Fire everything due at now, for event loop integration
+     * @return number of callbacks run
+     */
+    size_t advance(Clock::time_point now = Clock::now());
+
+    /** how long an event loop may block before the next advance(), max() if nothing is scheduled */
+    std::chrono::microseconds nextTimeout();
+
+    size_t size();
+
+private:
+    static constexpr uint32_t LEVEL0_BITS = 8;
+    static constexpr uint32_t LEVELN_BITS = 6;
+    static constexpr uint32_t LEVELS = 4;
+    static constexpr uint32_t LEVEL0_SLOTS = 1u << LEVEL0_BITS;
+    static constexpr uint32_t LEVELN_SLOTS = 1u << LEVELN_BITS;
+    static constexpr uint32_t SLOTS = LEVEL0_SLOTS + (LEVELS - 1) * LEVELN_SLOTS;
+    static constexpr uint64_t MAX_DELTA = 1ull << (LEVEL0_BITS + (LEVELS - 1) * LEVELN_BITS);
+    static constexpr uint32_t NIL = 0xffffffffu;
+
+    struct Node
+    {
+        uint32_t prev = NIL;
+        uint32_t next = NIL;
+        uint32_t slot = NIL;        // NIL while not linked
+        uint32_t generation = 1;
+        uint64_t expires = 0;       // absolute tick
+        Clock::duration interval{ 0 };  // zero for one shot timers
+        Clock::time_point deadline;
+        TimerCallback cb;
+        bool running = false;
+        bool cancelled = false;
+    };
+
+    TimerId schedule(std::chrono::microseconds delay, std::chrono::microseconds interval, TimerCallback cb);
+    uint64_t tickOf(Clock::time_point time) const;
+    uint64_t deadlineTick(Clock::time_point deadline) const;
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+    uint32_t cascade(uint32_t level);
+    uint64_t nextTick() const;
+    void loop();
+
+private:
+    Clock::duration m_resolution;
+    Clock::time_point m_base;
+    uint64_t m_currentTick = 0;
+    uint64_t m_wakeTick = 0;        // tick the wheel thread sleeps until, 0 while it is awake
+    size_t m_count = 0;
+    size_t m_level0Count = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Node> m_nodes;       // deque keeps callbacks in place while they run unlocked
+    std::vector<uint32_t> m_free;
+    uint32_t m_slots[SLOTS];
+
+    std::atomic_bool m_bRunning = false;
+    CThread<void> m_thread;
+};
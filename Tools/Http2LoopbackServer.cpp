@@ -0,0 +1,124 @@
+/**
+ *   Loopback h2c server for testing Http 2.0 clients
+ *
+ *      Http2LoopbackServer [--port N] [--threads N] [--ip ADDRESS]
+ *
+ *   Routes:
+ *      /echo               the request body back, with its content-type
+ *      /bytes?n=N          N bytes of payload
+ *      /delay?ms=N         an empty 200 after N milliseconds
+ *      /headers            the request headers as text
+ *      /trailers           a body followed by trailers
+ *
+ *   Runs until stdin is closed or a line is entered. Clients must speak h2c
+ *   with prior knowledge, e.g. curl --http2-prior-knowledge.
+ *
+ *   Not part of PlatformCommonUtils.vcxproj, build it with
+ *
+ *      Tools/build_http2_loopback_server.sh [output]
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#include "Http2Server.h"
+#include "ThreadPool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <charconv>
+#include <chrono>
+#include <thread>
+
+static size_t query_number(std::string_view query, std::string_view key, size_t fallback)
+{
+    while (!query.empty()) {
+        size_t amp = query.find('&');
+        std::string_view pair = query.substr(0, amp);
+        query = amp == std::string_view::npos ? std::string_view() : query.substr(amp + 1);
+        if (pair.size() > key.size() && pair.substr(0, key.size()) == key && pair[key.size()] == '=') {
+            size_t value = fallback;
+            std::string_view digits = pair.substr(key.size() + 1);
+            std::from_chars(digits.data(), digits.data() + digits.size(), value);
+            return value;
+        }
+    }
+    return fallback;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string ip = "127.0.0.1";
+    int port = 8080;
+    size_t threads = 4;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--port") == 0) {
+            port = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--threads") == 0) {
+            threads = (size_t)atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--ip") == 0) {
+            ip = argv[i + 1];
+        }
+    }
+
+    ThreadPool pool(threads);
+    Http2ServerOptions options;
+    options.pool = &pool;
+    options.settings.maxConcurrentStreams = 256;
+    Http2Server server(options);
+
+    server.route("/echo", [](const Http2Request& request, Http2Response& response) {
+        Http2HeaderList headers;
+        std::string_view type = request.header("content-type");
+        if (!type.empty()) {
+            headers.emplace_back("content-type", std::string(type));
+        }
+        response.respond(200, request.body, headers);
+    });
+    server.route("/bytes", [](const Http2Request& request, Http2Response& response) {
+        static constexpr size_t CHUNK = 64 * 1024;
+        size_t total = query_number(request.query(), "n", 1024);
+        std::vector<uint8_t> chunk(std::min(total, CHUNK), 'x');
+        response.sendHeaders(200, { { "content-length", std::to_string(total) } }, total == 0);
+        for (size_t sent = 0; sent < total;) {
+            size_t size = std::min(total - sent, CHUNK);
+            sent += size;
+            if (!response.sendData({ chunk.data(), size }, sent == total)) {
+                break;
+            }
+        }
+    });
+    server.route("/delay", [](const Http2Request& request, Http2Response& response) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(query_number(request.query(), "ms", 100)));
+        response.respond(200);
+    });
+    server.route("/headers", [](const Http2Request& request, Http2Response& response) {
+        std::string text;
+        for (const Http2Header& header : request.headers) {
+            text += header.name + ": " + header.value + "\n";
+        }
+        response.respond(200, text, { { "content-type", "text/plain" } });
+    });
+    server.route("/trailers", [](const Http2Request&, Http2Response& response) {
+        std::string_view body = "body before trailers\n";
+        response.sendHeaders(200, { { "content-type", "text/plain" } });
+        response.sendData({ (const uint8_t*)body.data(), body.size() });
+        response.sendTrailers({ { "x-checksum", "none" } });
+    });
+
+    if (!server.listen(ip, port) || !server.start()) {
+        fprintf(stderr, "cannot serve on %s:%d\n", ip.c_str(), port);
+        return 1;
+    }
+    printf("h2c on %s:%d, press enter to stop\n", ip.c_str(), server.port());
+    fflush(stdout);
+    getchar();
+
+    server.stop();
+    Http2ServerStats stats = server.stats();
+    printf("accepted %llu, rejected %llu, requests %llu, resets %llu\n", (unsigned long long)stats.accepted,
+        (unsigned long long)stats.rejected, (unsigned long long)stats.requests, (unsigned long long)stats.resets);
+    return 0;
+}
@@ -0,0 +1,47 @@
+#!/bin/sh
+#
+#   Builds Tools/Http2LoopbackServer on Linux and MacOS
+#
+#      Tools/build_http2_loopback_server.sh [output]
+#
+#   CXX and CXXFLAGS are honoured, the default output is ./Http2LoopbackServer.
+#   Keep SOURCES in step with what the server links against.
+#
+#   Created by lihuanqian on 10/18/2026
+#
+#   Copyright (c) lihuanqian. All rights reserved.
+#
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+OUTPUT=${1:-Http2LoopbackServer}
+CXX=${CXX:-c++}
+CXXFLAGS=${CXXFLAGS:--O2}
+
+SOURCES="
+    Tools/Http2LoopbackServer.cpp
+    Http2Server.cpp
+    Http2Connection.cpp
+    Http2Frame.cpp
+    Http2FrameArena.cpp
+    Http2FrameDecoder.cpp
+    Http2FrameWriter.cpp
+    Http2Hpack.cpp
+    Http2Priority.cpp
+    Http2BdpEstimator.cpp
+    Http2BufferPool.cpp
+    ThreadPool.cpp
+    TimerWheel.cpp
+    PlatformEasySocket.cpp
+    PlatformClock.cpp
+    CpuTopology.cpp
+    ThreadTelemetry.cpp
+    PlatformCommonUtils.cpp
+"
+
+FILES=
+for source in $SOURCES; do
+    FILES="$FILES $ROOT/$source"
+done
+
+$CXX -std=c++20 $CXXFLAGS -I"$ROOT" $FILES -o "$OUTPUT" -lpthread
@@ -0,0 +1,136 @@
+/**
+ *   Chase-Lev work stealing deque
+ *
+ *   The owner thread pushes and pops at the bottom (LIFO, cache warm), other
+ *   threads steal from the top (FIFO). Memory orderings follow Le, Pop, Cohen
+ *   and Zappa Nardelli, "Correct and Efficient Work-Stealing for Weak Memory
+ *   Models" (PPoPP 2013). T must be a pointer, nullptr means empty.
+ *
+ *   Created by lihuanqian on 10/18/2026
+ *
+ *   Copyright (c) lihuanqian. All rights reserved.
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+#include <type_traits>
+
+template <typename T>
+class WorkStealingDeque
+{
+    static_assert(std::is_pointer<T>::value, "WorkStealingDeque stores pointers");
+
+public:
+    explicit WorkStealingDeque(int64_t capacity = 256)
+    {
+        int64_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        m_arrays.emplace_back(new Array(cap));
+        m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    /** owner only */
+    void push(T item)
+    {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_acquire);
+        Array* a = m_array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1) {
+            a = grow(a, t, b);
+        }
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /** owner only, newest first */
+    T pop()
+    {
+        int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        Array* a = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+
+        T item = nullptr;
+        if (t <= b) {
+            item = a->get(b);
+            if (t == b) {
+                // last element, race the thieves for it
+                if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    item = nullptr;
+                }
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+            }
+        }
+        else {
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    /** any thread, oldest first; nullptr if empty or another thief won */
+    T steal()
+    {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        Array* a = m_array.load(std::memory_order_acquire);
+        T item = a->get(t);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    bool empty() const
+    {
+        return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+    }
+
+    size_t size() const
+    {
+        int64_t n = m_bottom.load(std::memory_order_relaxed) - m_top.load(std::memory_order_relaxed);
+        return n > 0 ? (size_t)n : 0;
+    }
+
+private:
+    struct Array
+    {
+        explicit Array(int64_t cap) : capacity(cap), mask(cap - 1), slots(new std::atomic<T>[cap]) {}
+
+        T get(int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T item) { slots[i & mask].store(item, std::memory_order_relaxed); }
+
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    Array* grow(Array* old, int64_t t, int64_t b)
+    {
+        // thieves may still read the old array, it lives until the deque is destroyed
+        Array* a = new Array(old->capacity * 2);
+        for (int64_t i = t; i < b; ++i) {
+            a->put(i, old->get(i));
+        }
+        m_arrays.emplace_back(a);
+        m_array.store(a, std::memory_order_release);
+        return a;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> m_top{ 0 };
+    alignas(64) std::atomic<int64_t> m_bottom{ 0 };
+    std::atomic<Array*> m_array{ nullptr };
+    std::vector<std::unique_ptr<Array>> m_arrays;   // owner only
+};